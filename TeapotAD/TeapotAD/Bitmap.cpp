@@ -17,8 +17,12 @@
  */
 
 #include "Bitmap.h"
+#include "mappedfile.h"
+#include "pixelconverter.h"
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
+#include <climits>
 
 //uses stb_image to try load files
 #define STBI_FAILURE_USERMSG
@@ -27,130 +31,6 @@
 
 
 
-inline unsigned char AverageRGB(unsigned char rgb[3]) {
-    return (unsigned char)(((double)rgb[0] + (double)rgb[1] + (double)rgb[2]) / 3.0);
-}
-
-static void Grayscale2GrayscaleAlpha(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = 255;
-}
-
-static void Grayscale2RGB(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[0];
-    dest[2] = src[0];
-}
-
-static void Grayscale2RGBA(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[0];
-    dest[2] = src[0];
-    dest[3] = 255;
-}
-
-static void GrayscaleAlpha2Grayscale(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-}
-
-static void GrayscaleAlpha2RGB(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[0];
-    dest[2] = src[0];
-}
-
-static void GrayscaleAlpha2RGBA(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[0];
-    dest[2] = src[0];
-    dest[3] = src[1];
-}
-
-static void RGB2Grayscale(unsigned char* src, unsigned char* dest){
-    dest[0] = AverageRGB(src);
-}
-
-static void RGB2GrayscaleAlpha(unsigned char* src, unsigned char* dest){
-    dest[0] = AverageRGB(src);
-    dest[1] = 255;
-}
-
-static void RGB2RGBA(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[1];
-    dest[2] = src[2];
-    dest[3] = 255;
-}
-
-static void RGBA2Grayscale(unsigned char* src, unsigned char* dest){
-    dest[0] = AverageRGB(src);
-}
-
-static void RGBA2GrayscaleAlpha(unsigned char* src, unsigned char* dest){
-    dest[0] = AverageRGB(src);
-    dest[1] = src[3];
-}
-
-static void RGBA2RGB(unsigned char* src, unsigned char* dest){
-    dest[0] = src[0];
-    dest[1] = src[1];
-    dest[2] = src[2];
-}
-
-typedef void(*FormatConverterFunc)(unsigned char*, unsigned char*);
-
-static FormatConverterFunc ConverterFuncForFormats(Bitmap::Format srcFormat, Bitmap::Format destFormat){
-    if(srcFormat == destFormat)
-        throw std::runtime_error("Just use memcpy if pixel formats are the same");
-    
-    switch(srcFormat){
-            
-        case Bitmap::Format_Grayscale:
-            switch(destFormat){
-                case Bitmap::Format_GrayscaleAlpha: return Grayscale2GrayscaleAlpha;
-                case Bitmap::Format_RGB:            return Grayscale2RGB;
-                case Bitmap::Format_RGBA:           return Grayscale2RGBA;
-                default:
-                    throw std::runtime_error("Unhandled bitmap format");
-            }
-            break;
-            
-        case Bitmap::Format_GrayscaleAlpha:
-            switch(destFormat){
-                case Bitmap::Format_Grayscale: return GrayscaleAlpha2Grayscale;
-                case Bitmap::Format_RGB:       return GrayscaleAlpha2RGB;
-                case Bitmap::Format_RGBA:      return GrayscaleAlpha2RGBA;
-                default:
-                    throw std::runtime_error("Unhandled bitmap format");
-            }
-            break;
-            
-        case Bitmap::Format_RGB:
-            switch(destFormat){
-                case Bitmap::Format_Grayscale:      return RGB2Grayscale;
-                case Bitmap::Format_GrayscaleAlpha: return RGB2GrayscaleAlpha;
-                case Bitmap::Format_RGBA:           return RGB2RGBA;
-                default:
-                    throw std::runtime_error("Unhandled bitmap format");
-            }
-            break;
-            
-        case Bitmap::Format_RGBA:
-            switch(destFormat){
-                case Bitmap::Format_Grayscale:      return RGBA2Grayscale;
-                case Bitmap::Format_GrayscaleAlpha: return RGBA2GrayscaleAlpha;
-                case Bitmap::Format_RGB:            return RGBA2RGB;
-                default:
-                    throw std::runtime_error("Unhandled bitmap format");
-            }
-            break;
-            
-        default:
-            throw std::runtime_error("Unhandled bitmap format");
-    }
-}
-
-
 /*
  * Misc funcs
  */
@@ -160,15 +40,10 @@ inline unsigned GetPixelOffset(unsigned col, unsigned row, unsigned width, unsig
 }
 
 inline bool RectsOverlap(unsigned srcCol, unsigned srcRow, unsigned destCol, unsigned destRow, unsigned width, unsigned height){
+    //the rects only overlap if they overlap both horizontally and vertically
     unsigned colDiff = srcCol > destCol ? srcCol - destCol : destCol - srcCol;
-    if(colDiff < width)
-        return true;
-    
     unsigned rowDiff = srcRow > destRow ? srcRow - destRow : destRow - srcRow;
-    if(rowDiff < height)
-        return true;
-    
-    return false;
+    return colDiff < width && rowDiff < height;
 }
 
 
@@ -185,18 +60,46 @@ Bitmap::Bitmap(unsigned width,
     _set(width, height, format, pixels);
 }
 
+Bitmap::Bitmap(unsigned width,
+               unsigned height,
+               Format format,
+               unsigned char* pixels,
+               Deleter deleter) :
+    _format(format),
+    _width(width),
+    _height(height),
+    _pixels(pixels),
+    _deleter(deleter)
+{
+    if(!pixels) throw std::runtime_error("Bitmap can't adopt NULL pixels");
+    if(width == 0 || height == 0 || format <= 0 || format > 4){
+        _release();
+        throw std::runtime_error("Invalid bitmap size or format");
+    }
+}
+
 Bitmap::~Bitmap() {
-    if(_pixels) free(_pixels);
+    _release();
 }
 
-Bitmap Bitmap::bitmapFromFile(std::string filePath) {    
+Bitmap Bitmap::bitmapFromFile(std::string filePath) {
+    MappedFile file(filePath);
+    return bitmapFromFile(file);
+}
+
+Bitmap Bitmap::bitmapFromFile(const MappedFile& file) {
+    return bitmapFromMemory(file.getData(), file.getSize());
+}
+
+Bitmap Bitmap::bitmapFromMemory(const unsigned char* data, size_t size) {
+    if(size == 0 || size > INT_MAX) throw std::runtime_error("Image file is empty or too large");
+    
     int width, height, channels;
-    unsigned char* pixels = stbi_load(filePath.c_str(), &width, &height, &channels, 0);
+    unsigned char* pixels = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 0);
     if(!pixels) throw std::runtime_error(stbi_failure_reason());
     
-    Bitmap bmp(width, height, (Format)channels, pixels);
-    stbi_image_free(pixels);
-    return bmp;
+    //stb_image allocated the pixels, so it must free them
+    return Bitmap(width, height, (Format)channels, pixels, [](unsigned char* p){ stbi_image_free(p); });
 }
 
 Bitmap::Bitmap(const Bitmap& other) :
@@ -206,7 +109,36 @@ Bitmap::Bitmap(const Bitmap& other) :
 }
 
 Bitmap& Bitmap::operator = (const Bitmap& other) {
-    _set(other._width, other._height, other._format, other._pixels);
+    if(this != &other)
+        _set(other._width, other._height, other._format, other._pixels);
+    return *this;
+}
+
+Bitmap::Bitmap(Bitmap&& other) :
+    _format(other._format),
+    _width(other._width),
+    _height(other._height),
+    _pixels(other._pixels),
+    _deleter(std::move(other._deleter))
+{
+    other._pixels = NULL;
+    other._deleter = nullptr;
+    other._width = other._height = 0;
+}
+
+Bitmap& Bitmap::operator = (Bitmap&& other) {
+    if(this != &other){
+        _release();
+        _format = other._format;
+        _width = other._width;
+        _height = other._height;
+        _pixels = other._pixels;
+        _deleter = std::move(other._deleter);
+        
+        other._pixels = NULL;
+        other._deleter = nullptr;
+        other._width = other._height = 0;
+    }
     return *this;
 }
 
@@ -239,39 +171,27 @@ void Bitmap::setPixel(unsigned int column, unsigned int row, const unsigned char
 }
 
 void Bitmap::flipVertically() {
-    unsigned long rowSize = _format*_width;
-    unsigned char* rowBuffer = new unsigned char[rowSize];
-    unsigned halfRows = _height / 2;
-    
-    for(unsigned rowIdx = 0; rowIdx < halfRows; ++rowIdx){
-        unsigned char* row = _pixels + GetPixelOffset(0, rowIdx, _width, _height, _format);
-        unsigned char* oppositeRow = _pixels + GetPixelOffset(0, _height - rowIdx - 1, _width, _height, _format);
-        
-        memcpy(rowBuffer, row, rowSize);
-        memcpy(row, oppositeRow, rowSize);
-        memcpy(oppositeRow, rowBuffer, rowSize);
-    }
-    
-    delete rowBuffer;
+    _transform(PixelTransform::FLIP_VERTICAL);
+}
+
+void Bitmap::flipHorizontally() {
+    _transform(PixelTransform::FLIP_HORIZONTAL);
 }
 
 void Bitmap::rotate90CounterClockwise() {
-    unsigned char* newPixels = (unsigned char*) malloc(_format*_width*_height);
-    
-    for(unsigned row = 0; row < _height; ++row){
-        for(unsigned col = 0; col < _width; ++col){
-            unsigned srcOffset = GetPixelOffset(col, row, _width, _height, _format);
-            unsigned destOffset = GetPixelOffset(row, _width - col - 1, _height, _width, _format);
-            memcpy(newPixels + destOffset, _pixels + srcOffset, _format); //copy one pixel
-        }
-    }
-    
-    free(_pixels);
-    _pixels = newPixels;
-    
-    unsigned swapTmp = _height;
-    _height = _width;
-    _width = swapTmp;
+    _transform(PixelTransform::ROTATE_90);
+}
+
+void Bitmap::rotate90Clockwise() {
+    _transform(PixelTransform::ROTATE_270);
+}
+
+void Bitmap::rotate180() {
+    _transform(PixelTransform::ROTATE_180);
+}
+
+void Bitmap::transpose() {
+    _transform(PixelTransform::TRANSPOSE);
 }
 
 void Bitmap::copyRectFromBitmap(const Bitmap& src, 
@@ -290,31 +210,42 @@ void Bitmap::copyRectFromBitmap(const Bitmap& src,
     if(width == 0 || height == 0)
         throw std::runtime_error("Can't copy zero height/width rectangle");
     
-    if(srcCol + width >= src.width() || srcRow + height >= src.height())
+    if(srcCol + width > src.width() || srcRow + height > src.height())
         throw std::runtime_error("Rectangle doesn't fit within source bitmap");
 
-    if(destCol + width >= _width || destRow + height >= _height)
+    if(destCol + width > _width || destRow + height > _height)
         throw std::runtime_error("Rectangle doesn't fit within destination bitmap");
     
     if(_pixels == src._pixels && RectsOverlap(srcCol, srcRow, destCol, destRow, width, height))
         throw std::runtime_error("Source and destination are the same bitmap, and rects overlap. Not allowed!");
     
-    FormatConverterFunc converter = NULL;
-    if(_format != src._format)
-        converter = ConverterFuncForFormats(_format, src._format);
-    
+    //converts (or copies, if the formats match) a row at a time
+    static const PixelConverter converter;
     for(unsigned row = 0; row < height; ++row){
-        for(unsigned col = 0; col < width; ++col){
-            unsigned char* srcPixel = src._pixels + GetPixelOffset(srcCol + col, srcRow + row, src._width, src._height, src._format);
-            unsigned char* destPixel = _pixels + GetPixelOffset(destCol + col, destRow + row, _width, _height, _format);
-            
-            if(converter){
-                converter(srcPixel, destPixel);
-            } else {
-                memcpy(destPixel, srcPixel, _format);
-            }
-        }
+        unsigned char* srcRowStart = src._pixels + GetPixelOffset(srcCol, srcRow + row, src._width, src._height, src._format);
+        unsigned char* destRowStart = _pixels + GetPixelOffset(destCol, destRow + row, _width, _height, _format);
+        converter.convertRow(srcRowStart, src._format, destRowStart, _format, width);
+    }
+}
+
+void Bitmap::_transform(PixelTransform::Operation operation) {
+    static const PixelTransform transform;
+    
+    //flips and 180 degree rotations keep the size, so they don't need a second buffer
+    if(!PixelTransform::swapsSize(operation)){
+        transform.applyInPlace(operation, _pixels, _width, _height, _format);
+        return;
     }
+    
+    unsigned char* newPixels = (unsigned char*) malloc(_format*_width*_height);
+    transform.apply(operation, _pixels, _width, _height, _format, newPixels);
+    
+    _release();
+    _pixels = newPixels;
+    
+    unsigned swapTmp = _height;
+    _height = _width;
+    _width = swapTmp;
 }
 
 void Bitmap::_set(unsigned width, 
@@ -330,7 +261,10 @@ void Bitmap::_set(unsigned width,
     _height = height;
     _format = format;
     
-    size_t newSize = _width * _height * _format;
+    //adopted pixels can't be reallocated, so they are swapped for malloc'd ones
+    if(_deleter) _release();
+    
+    size_t newSize = (size_t)_width * _height * _format;
     if(_pixels){
         _pixels = (unsigned char*)realloc(_pixels, newSize);
     } else {
@@ -341,13 +275,11 @@ void Bitmap::_set(unsigned width,
         memcpy(_pixels, pixels, newSize);
 }
 
-
-
-
-
-
-
-
-
-
-
+void Bitmap::_release() {
+    if(_pixels){
+        if(_deleter) _deleter(_pixels);
+        else free(_pixels);
+    }
+    _pixels = NULL;
+    _deleter = nullptr;
+}
@@ -19,6 +19,10 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include "pixeltransform.h"
+
+class MappedFile;
 
     
     /**
@@ -41,6 +45,11 @@
             Format_RGBA = 4 /**< four channels: red, green, blue, alpha */
         };
         
+        /**
+         Releases pixels that a bitmap adopted, instead of free().
+         */
+        typedef std::function<void(unsigned char*)> Deleter;
+        
         /**
          Creates a new image with the specified width, height and format.
          
@@ -51,12 +60,38 @@
                unsigned height, 
                Format format,
                const unsigned char* pixels = NULL);
+        
+        /**
+         Creates an image that takes ownership of existing pixels, without copying them.
+         
+         The pixels must hold width*height pixels of the given format, and stay
+         valid and writable until the bitmap calls deleter on them. The bitmap
+         frees them with free() when deleter is empty.
+         */
+        Bitmap(unsigned width,
+               unsigned height,
+               Format format,
+               unsigned char* pixels,
+               Deleter deleter);
         ~Bitmap();
         
         /**
          Tries to load the given file into a tdogl::Bitmap.
+         
+         The file is mapped into memory and decoded straight from it. The bitmap
+         adopts the decoded pixels, so they are not copied afterwards.
          */
         static Bitmap bitmapFromFile(std::string filePath);
+        
+        /**
+         Decodes an image file that is already mapped into memory.
+         */
+        static Bitmap bitmapFromFile(const MappedFile& file);
+        
+        /**
+         Decodes an image file held in memory, in any format stb_image reads.
+         */
+        static Bitmap bitmapFromMemory(const unsigned char* data, size_t size);
                 
         /** width in pixels */
         unsigned width() const;
@@ -93,14 +128,37 @@
         
         /**
          Reverses the row order of the pixels, so the bitmap will be upside down.
+         
+         Works in place, without allocating.
          */
         void flipVertically();
         
+        /**
+         Reverses the order of the pixels in each row, so the bitmap will be mirrored.
+         */
+        void flipHorizontally();
+        
         /**
          Rotates the image 90 degrees counter clockwise.
          */
         void rotate90CounterClockwise();
         
+        /**
+         Rotates the image 90 degrees clockwise.
+         */
+        void rotate90Clockwise();
+        
+        /**
+         Rotates the image 180 degrees, in place.
+         */
+        void rotate180();
+        
+        /**
+         Swaps rows and columns, mirroring the image about its top left to
+         bottom right diagonal.
+         */
+        void transpose();
+        
         /**
          Copies a rectangular area from the given source bitmap into this bitmap.
          
@@ -128,13 +186,22 @@
         /** Assignment operator */
         Bitmap& operator = (const Bitmap& other);
         
+        /** Move constructor, takes the pixels of other and leaves it empty */
+        Bitmap(Bitmap&& other);
+        
+        /** Move assignment operator, takes the pixels of other and leaves it empty */
+        Bitmap& operator = (Bitmap&& other);
+        
     private:
         Format _format;
         unsigned _width;
         unsigned _height;
         unsigned char* _pixels;
+        Deleter _deleter;   //empty when the pixels came from malloc()
         
         void _set(unsigned width, unsigned height, Format format, const unsigned char* pixels);
+        void _release();
+        void _transform(PixelTransform::Operation operation);
         static void _getPixelOffset(unsigned col, unsigned row, unsigned width, unsigned height, Format format);
     };
     
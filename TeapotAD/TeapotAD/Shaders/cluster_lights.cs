@@ -0,0 +1,89 @@
+#version 430
+
+layout (local_size_x = 64) in;		// One Work Group per Cluster, Sharing its Lights Out.
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Point Lights  //////////////////////////////
+///////////////////////////////////////////////////////////////////
+struct PointLightData
+{
+	vec4 positionRadius;	// World Position, Radius in w.
+	vec4 colourFalloff;		// Intensity, Quadratic Attenuation in w.
+};
+layout (std430) readonly buffer PointLights
+{
+	PointLightData light[];
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Lights of Each Cluster  ////////////////////
+///////////////////////////////////////////////////////////////////
+const uvec3 ClusterGrid = uvec3(16, 12, 24);	// Must Match phong_clustered.frag and scenediffuse.cpp.
+const uint MaxClusterLights = 256;
+
+layout (std430) writeonly buffer ClusterCounts
+{
+	uint clusterCount[];	// Lights Touching Each Cluster.
+};
+layout (std430) writeonly buffer ClusterLights
+{
+	uint clusterLight[];	// MaxClusterLights Entries per Cluster, the First clusterCount[] Used.
+};
+
+uniform uint LightCount;
+uniform float ClusterDepthScale;	// Slice = log(depth) * Scale + Bias.
+uniform float ClusterDepthBias;
+
+shared uint count;
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Lists the Lights whose Spheres Reach into the Work Group's Cluster  /////
+//////////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	uvec3 id = gl_WorkGroupID;
+	uint cluster = (id.z * ClusterGrid.y + id.y) * ClusterGrid.x + id.x;
+
+	if (gl_LocalInvocationIndex == 0) count = 0;
+	barrier();
+
+	// The cluster's eye-space bounding box. The slices are spaced evenly in log(depth), so far
+	// away clusters are about as deep as they are wide.
+	float nearDepth = exp((float(id.z) - ClusterDepthBias) / ClusterDepthScale);
+	float farDepth = exp((float(id.z + 1) - ClusterDepthBias) / ClusterDepthScale);
+	vec2 toEye = 1.0 / vec2(frame.P[0][0], frame.P[1][1]);		// The projection is symmetric.
+	vec2 lower = (vec2(id.xy) / vec2(ClusterGrid.xy) * 2.0 - 1.0) * toEye;
+	vec2 upper = (vec2(id.xy + 1) / vec2(ClusterGrid.xy) * 2.0 - 1.0) * toEye;
+	vec3 boxMin = vec3(min(lower * nearDepth, lower * farDepth), -farDepth);
+	vec3 boxMax = vec3(max(upper * nearDepth, upper * farDepth), -nearDepth);
+
+	for (uint i = gl_LocalInvocationIndex; i < LightCount; i += gl_WorkGroupSize.x)
+	{
+		vec4 positionRadius = light[i].positionRadius;
+		vec3 centre = vec3(frame.V * vec4(positionRadius.xyz, 1.0));
+		vec3 outside = centre - clamp(centre, boxMin, boxMax);
+		if (dot(outside, outside) < positionRadius.w * positionRadius.w)
+		{
+			// Lights past the cluster's room are dropped, keeping the cost of every fragment bounded.
+			uint slot = atomicAdd(count, 1);
+			if (slot < MaxClusterLights) clusterLight[cluster * MaxClusterLights + slot] = i;
+		}
+	}
+
+	barrier();
+	if (gl_LocalInvocationIndex == 0) clusterCount[cluster] = min(count, MaxClusterLights);
+}
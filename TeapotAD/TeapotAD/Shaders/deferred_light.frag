@@ -0,0 +1,78 @@
+#version 430
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} Light;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Material Table  ////////////////////////////
+///////////////////////////////////////////////////////////////////
+struct MaterialData
+{
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material.
+	vec4 Ks;			// Specular Reflectivity in Material.
+};
+layout (std430) readonly buffer Materials
+{
+	MaterialData material[];
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  G-buffer  //////////////////////////////////
+///////////////////////////////////////////////////////////////////
+uniform sampler2D AlbedoTexture;	// Diffuse Reflectivity, Material Index / 255 in Alpha.
+uniform sampler2D NormalTexture;	// Eye-space Normal Scaled and Biased into [0,1].
+uniform sampler2D DepthTexture;		// Distance in Front of the Camera, 0 where Nothing was Drawn.
+uniform vec2 ViewportSize;
+
+layout( location = 0 ) out vec4 FragColour; // The Lit Colour of the Surface under this Pixel.
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Rebuild the Eye-space Position from the Pixel and its Stored Depth  ////
+/////////////////////////////////////////////////////////////////////////////////////////////
+vec3 eyePosition(vec2 fragCoord, float depth)
+{
+	vec2 ndc = fragCoord / ViewportSize * 2.0 - 1.0;
+	return vec3(ndc.x * depth / Light.P[0][0], ndc.y * depth / Light.P[1][1], -depth);	// The projection is symmetric.
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///// Main Function Lights the Stored Surface Exactly as phong.frag Lights a Forward Fragment ///////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void main() 
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(DepthTexture, texel, 0).r;
+	if (depth == 0.0) discard;		// Nothing was drawn here, the clear colour stays.
+
+	vec4 albedo = texelFetch(AlbedoTexture, texel, 0);
+	vec3 N = texelFetch(NormalTexture, texel, 0).xyz * 2.0 - 1.0;
+	vec3 vertPos = eyePosition(gl_FragCoord.xy, depth);
+	vec3 lightPos = vec3(Light.V * vec4(Light.LightPosition.xyz, 1.0));
+	MaterialData mat = material[int(albedo.a * 255.0 + 0.5)];
+
+	vec3 vectorsNorm = normalize(lightPos - vertPos);
+
+	vec4 ambience = clamp(vec4(Light.La.rgb, 1.0) * vec4(mat.Ka.rgb, 1.0), 0.0, 1.0);
+
+	vec4 Id = clamp(vec4(Light.Ld.rgb, 1.0) * max(dot(N, vectorsNorm), 0.0), 0.0, 1.0);
+	vec4 diffusion = vec4(albedo.rgb, 1.0) * Id;
+
+	vec3 reflection = reflect(-vectorsNorm, N);
+	vec4 Is = clamp(vec4(max(dot(reflection, vectorsNorm), 0.0)), 0.0, 1.0);
+	vec4 specularity = vec4(Light.Ls.rgb, 1.0) * vec4(mat.Ks.rgb, 1.0) * Is;
+
+	float atten = clamp(Light.attenuation / length(lightPos - vertPos), 0.0, 1.0);
+	FragColour = atten * (ambience + diffusion + specularity);
+}
@@ -0,0 +1,41 @@
+#version 430
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D Source;						// The depth buffer, or the pyramid itself for the levels after the first.
+layout (r32f) writeonly uniform image2D Destination;	// The pyramid level being written.
+
+uniform int SourceLevel;	// Level of Source to read.
+uniform vec2 SourceSize;	// Size of that level in texels.
+uniform bool Copy;			// Level 0, copy the depth buffer texel for texel.
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Writes the Furthest Depth of the Source Texels Under one Destination Texel  /////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	ivec2 size = imageSize(Destination);
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (texel.x >= size.x || texel.y >= size.y) return;
+
+	if (Copy)
+	{
+		imageStore(Destination, texel, vec4(texelFetch(Source, texel, 0).r));
+		return;
+	}
+
+	// Each texel covers 2x2 of the level before. When that level has an odd size the last
+	// column or row also takes the texels left over, so no depth is ever skipped.
+	ivec2 sourceSize = ivec2(SourceSize);
+	ivec2 first = 2 * texel;
+	ivec2 last = 2 * texel + 1;
+	if (texel.x == size.x - 1) last.x = sourceSize.x - 1;
+	if (texel.y == size.y - 1) last.y = sourceSize.y - 1;
+
+	float depth = 0.0;
+	for (int y = first.y; y <= last.y; y++)
+		for (int x = first.x; x <= last.x; x++)
+			depth = max(depth, texelFetch(Source, ivec2(x, y), SourceLevel).r);
+
+	imageStore(Destination, texel, vec4(depth));
+}
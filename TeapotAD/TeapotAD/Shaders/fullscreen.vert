@@ -0,0 +1,11 @@
+#version 430
+
+///////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Outputs a Triangle Covering the Viewport, Drawn Without Attributes  //
+///////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	// Vertices 0, 1, 2 go to (-1,-1), (3,-1) and (-1,3).
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 430
+
+/////////////////////////////////////////////////////////////////////////
+/////  Data Passed into the Fragment Shader from the Vertex Shader  /////
+/////////////////////////////////////////////////////////////////////////
+in Data 
+{
+	vec3 N;			// Vertex Normal as Translated into Eye-space by the Vertex Shader.
+	vec3 lightPos;  // Unused, the Lights are Applied by the Lighting Passes.
+	vec3 vertPos;   // Models Vertexs' Positions as Translated into Eye-space by the Vertex Shader.
+	flat vec3 Ka;	// Unused, Looked up in the Material Table by the Lighting Passes.
+	flat vec3 Kd;	// Diffusion Reflectivity in Material, Passed Through by the Vertex Shader.
+	flat vec3 Ks;	// Unused, Looked up in the Material Table by the Lighting Passes.
+} data;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Object Data  ///////////////////////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform ObjectData
+{
+	mat4 M;				// Model's Matrix.
+	mat4 NormalMatrix;	// Model's Matrix Multiplied with the Camera's View. Only the upper 3x3 is used.
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material, w is the Material's Index in the Material Table.
+	vec4 Ks;			// Specular Reflectivity in Material.
+} object;
+
+/////////////////////////////////////////////////////////////////
+/////////////////////  G-buffer Targets  ////////////////////////
+/////////////////////////////////////////////////////////////////
+layout (location = 0) out vec4 Albedo;	// Diffuse Reflectivity, Material Index / 255 in Alpha.
+layout (location = 1) out vec4 Normal;	// Eye-space Normal Scaled and Biased into [0,1].
+layout (location = 2) out float Depth;	// Distance in Front of the Camera.
+
+/////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Stores the Surface for the Lighting Passes to Light  ///////
+/////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	Albedo = vec4(data.Kd, object.Kd.w / 255.0);
+	Normal = vec4(data.N * 0.5 + 0.5, 0.0);		// Not renormalised, as in phong.frag.
+	Depth = -data.vertPos.z;
+}
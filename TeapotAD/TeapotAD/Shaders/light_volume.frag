@@ -0,0 +1,90 @@
+#version 430
+
+/////////////////////////////////////////////////////////////////////////
+/////  Light Passed into the Fragment Shader from the Vertex Shader  ////
+/////////////////////////////////////////////////////////////////////////
+in Volume
+{
+	flat vec3 lightPos;		// Light's Position in Eye Co-ordinates.
+	flat vec3 colour;		// Light's Intensity.
+	flat float falloff;		// Quadratic Attenuation of the Light.
+	flat float radius;		// Distance Beyond Which the Light Adds Nothing.
+} volume;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Material Table  ////////////////////////////
+///////////////////////////////////////////////////////////////////
+struct MaterialData
+{
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material.
+	vec4 Ks;			// Specular Reflectivity in Material.
+};
+layout (std430) readonly buffer Materials
+{
+	MaterialData material[];
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  G-buffer  //////////////////////////////////
+///////////////////////////////////////////////////////////////////
+uniform sampler2D AlbedoTexture;	// Diffuse Reflectivity, Material Index / 255 in Alpha.
+uniform sampler2D NormalTexture;	// Eye-space Normal Scaled and Biased into [0,1].
+uniform sampler2D DepthTexture;		// Distance in Front of the Camera, 0 where Nothing was Drawn.
+uniform vec2 ViewportSize;
+
+layout( location = 0 ) out vec4 FragColour; // Added to the Lit Colour.
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Rebuild the Eye-space Position from the Pixel and its Stored Depth  ////
+/////////////////////////////////////////////////////////////////////////////////////////////
+vec3 eyePosition(vec2 fragCoord, float depth)
+{
+	vec2 ndc = fragCoord / ViewportSize * 2.0 - 1.0;
+	return vec3(ndc.x * depth / frame.P[0][0], ndc.y * depth / frame.P[1][1], -depth);	// The projection is symmetric.
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///// Main Function Adds the Diffuse and Specular Light of One Point Light to the Stored Surface ///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void main() 
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(DepthTexture, texel, 0).r;
+	if (depth == 0.0) discard;		// Nothing was drawn here.
+
+	vec3 vertPos = eyePosition(gl_FragCoord.xy, depth);
+	vec3 toLight = volume.lightPos - vertPos;
+	float dist = length(toLight);
+	if (dist >= volume.radius) discard;		// The volume's pixel is lit, but not this far from the light.
+
+	vec4 albedo = texelFetch(AlbedoTexture, texel, 0);
+	vec3 N = texelFetch(NormalTexture, texel, 0).xyz * 2.0 - 1.0;
+	MaterialData mat = material[int(albedo.a * 255.0 + 0.5)];
+
+	// Inverse square falloff, windowed so it reaches exactly zero at the volume's edge.
+	float ratio = dist / volume.radius;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	vec3 intensity = volume.colour * (window * window / (1.0 + volume.falloff * dist * dist));
+
+	vec3 vectorsNorm = toLight / dist;
+	vec3 diffusion = albedo.rgb * clamp(intensity * max(dot(N, vectorsNorm), 0.0), 0.0, 1.0);
+	vec3 reflection = reflect(-vectorsNorm, N);
+	vec3 specularity = intensity * mat.Ks.rgb * clamp(max(dot(reflection, vectorsNorm), 0.0), 0.0, 1.0);
+
+	FragColour = vec4(diffusion + specularity, 0.0);
+}
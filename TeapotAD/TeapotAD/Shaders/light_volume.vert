@@ -0,0 +1,60 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Vertex of a Unit Sphere.
+
+//////////////////////////////////////////////////////////////////////////
+/////  Light Passed out of the Vertex Shader into the Fragment Shader  ///
+//////////////////////////////////////////////////////////////////////////
+out Volume
+{
+	flat vec3 lightPos;		// Light's Position in Eye Co-ordinates.
+	flat vec3 colour;		// Light's Intensity.
+	flat float falloff;		// Quadratic Attenuation of the Light.
+	flat float radius;		// Distance Beyond Which the Light Adds Nothing.
+} volume;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Point Lights  //////////////////////////////
+///////////////////////////////////////////////////////////////////
+struct PointLightData
+{
+	vec4 positionRadius;	// World Position, Radius in w.
+	vec4 colourFalloff;		// Intensity, Quadratic Attenuation in w.
+};
+layout (std430) readonly buffer PointLights
+{
+	PointLightData light[];	// One Entry per Instance.
+};
+
+uniform float VolumeScale;	// Grows the Sphere Mesh to Contain the True Sphere Between its Vertices.
+
+/////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Places the Sphere Around the Instance's Light  /////////////
+/////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	PointLightData pointLight = light[gl_InstanceID];
+	vec3 centre = pointLight.positionRadius.xyz;
+	float radius = pointLight.positionRadius.w;
+
+	volume.lightPos = vec3(frame.V * vec4(centre, 1.0));
+	volume.colour = pointLight.colourFalloff.rgb;
+	volume.falloff = pointLight.colourFalloff.w;
+	volume.radius = radius;
+
+	gl_Position = frame.P * frame.V * vec4(centre + VertexPosition * radius * VolumeScale, 1.0);
+}
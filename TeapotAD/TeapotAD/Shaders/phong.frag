@@ -8,30 +8,29 @@ in Data
 	vec3 N;			// Vertex Normal as Translated into Eye-space by the Vertex Shader.
 	vec3 lightPos;  // Light's Position as Translated into Eye-space by the Vertex Shader.
 	vec3 vertPos;   // Models Vertexs' Positions as Translated into Eye-space by the Vertex Shader.
+	flat vec3 Ka;	// Ambient Reflectivity in Material, Passed Through by the Vertex Shader.
+	flat vec3 Kd;	// Diffusion Reflectivity in Material, Passed Through by the Vertex Shader.
+	flat vec3 Ks;	// Specular Reflectivity in Material, Passed Through by the Vertex Shader.
 } data;				// Object of the Data structure to hold the input variables.
 
-////////////////////////////////////////////////////////////////////
-/////////////////////  The Light's Properties  /////////////////////
-////////////////////////////////////////////////////////////////////
-struct LightData
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
 {
-	float attenuation;  // Intensity of Attenuation.
-	vec3 La;            // Ambient Light Intensity.
-	vec3 Ld;            // Diffuse Light Intensity.
-	vec3 Ls;            // Specular Light Intensity.
-};
-uniform LightData Light;		// The Uniform Light Source for the Parameters to be Passed into.
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} Light;				// Only the Light's Properties are Used Here.
 
-////////////////////////////////////////////////////////////////////////
-/////////////////////  The Materials's Properties  /////////////////////
-////////////////////////////////////////////////////////////////////////
-struct MaterialData		
-{
-	vec3 Ka;            // Ambient Reflectivity in Material
-	vec3 Kd;            // Diffusion Reflectivity in Material
-	vec3 Ks;            // Specular Reflectivity in Material
-};
-uniform MaterialData Material;	// The Uniform Model Material for the Parameters to be Passed into.
+///////////////////////////////////////////////////////////////////
+/////////////////////  Shadow of the Light  ///////////////////////
+///////////////////////////////////////////////////////////////////
+#include "shadow.glsl"
 
 layout( location = 0 ) out vec4 FragColour; // The Final Output Fragment Colour with Consideration of the Lighting and Materials' Properties.
 
@@ -85,7 +84,12 @@ void main()
 	vec4 ambience, diffusion, specularity, final;
 
 	// Calling the Light Function
-	light(data.N, data.vertPos, data.lightPos, Light.La, Light.Ld, Light.Ls, Material.Ka, Material.Kd, Material.Ks, ambience, diffusion, specularity);
+	light(data.N, data.vertPos, data.lightPos, Light.La.rgb, Light.Ld.rgb, Light.Ls.rgb, data.Ka, data.Kd, data.Ks, ambience, diffusion, specularity);
+
+	// The Shadow Blocks the Light's Diffusion and Specularity, the Ambience Remains
+	float shadow = lit(data.vertPos);
+	diffusion *= shadow;
+	specularity *= shadow;
 
 	// Attenuating and Combining the Lighting Element's Output
 	attenuate(Light.attenuation, data.lightPos, data.vertPos, ambience, diffusion, specularity, final); // Results Output into "final".
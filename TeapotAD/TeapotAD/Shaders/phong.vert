@@ -11,29 +11,50 @@ out Data
 	vec3 N;				 // Normal transformed into the eye co-ordinates.
 	vec3 lightPos;		 // Light's position transformed into the eye co-ordinates. (Camera plane).
 	vec3 vertPos;		 //	Models vertexs' position transformed into the eye co-ordinates.
+	flat vec3 Ka;		 // Ambient reflectivity of the object's material.
+	flat vec3 Kd;		 // Diffusion reflectivity of the object's material.
+	flat vec3 Ks;		 // Specular reflectivity of the object's material.
 } data;					 // Object of the Data structure to hold the output variables.
 
-///////////////////////////////////////////////////////////
-/////////////////////  Matrices Data  /////////////////////
-///////////////////////////////////////////////////////////
-struct MatrixData
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
 {
-	vec3 LightPosition; // Light's Position as Declared in scenediffuse.cpp's setLightParams() function.
-	mat3 NormalMatrix;	// Model's Vertex Normal Multiplied with the Camera's View in scenediffuse.cpp's setMatricies() function.
-	mat4 M;				// Model's Matrix.
 	mat4 V;				// Camera View Matrix.
 	mat4 P;				// Camera Projection Matrix.
-};	
-uniform MatrixData matrixProperties;	// Object of the MatrixData structure to hold the declared variables.
+	vec4 LightPosition;	// Light's World Position as Declared in scenediffuse.cpp's setLightParams() function.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Object Data  ///////////////////////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform ObjectData
+{
+	mat4 M;				// Model's Matrix.
+	mat4 NormalMatrix;	// Model's Matrix Multiplied with the Camera's View in scenediffuse.cpp's render() function. Only the upper 3x3 is used.
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material.
+	vec4 Ks;			// Specular Reflectivity in Material.
+} object;
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////  Main Function Return the Objects in the Scene's Local Vertex Positions Transformed into the Eye Co-ordinates  /////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void main()
 {
-   data.N = normalize( matrixProperties.NormalMatrix * VertexNormal);														// Translation of the Local Vertex Normal
-   data.lightPos = vec3(matrixProperties.V * matrixProperties.M * vec4(matrixProperties.LightPosition, 1.0));				// Translation of the Local Light Position
-   data.vertPos = vec3(matrixProperties.V * matrixProperties.M * vec4(VertexPosition, 1.0));								// Translation of the Local Models Vertexs' Position
+   mat4 MV = frame.V * object.M;
+
+   data.N = normalize( mat3(object.NormalMatrix) * VertexNormal);				// Translation of the Local Vertex Normal
+   data.lightPos = vec3(MV * vec4(frame.LightPosition.xyz, 1.0));				// Translation of the Local Light Position
+   data.vertPos = vec3(MV * vec4(VertexPosition, 1.0));							// Translation of the Local Models Vertexs' Position
+   data.Ka = object.Ka.rgb;
+   data.Kd = object.Kd.rgb;
+   data.Ks = object.Ks.rgb;
 
-   gl_Position = gl_Position = matrixProperties.P * matrixProperties.V * matrixProperties.M * vec4(VertexPosition, 1.0);	// Unused gl_Position Variable
+   gl_Position = frame.P * MV * vec4(VertexPosition, 1.0);						// Clip Space Position of the Vertex
 }
@@ -0,0 +1,164 @@
+#version 430
+
+/////////////////////////////////////////////////////////////////////////
+/////  Data Passed into the Fragment Shader from the Vertex Shader  /////
+/////////////////////////////////////////////////////////////////////////
+in Data 
+{
+	vec3 N;			// Vertex Normal as Translated into Eye-space by the Vertex Shader.
+	vec3 lightPos;  // Light's Position as Translated into Eye-space by the Vertex Shader.
+	vec3 vertPos;   // Models Vertexs' Positions as Translated into Eye-space by the Vertex Shader.
+	flat vec3 Ka;	// Ambient Reflectivity in Material, Passed Through by the Vertex Shader.
+	flat vec3 Kd;	// Diffusion Reflectivity in Material, Passed Through by the Vertex Shader.
+	flat vec3 Ks;	// Specular Reflectivity in Material, Passed Through by the Vertex Shader.
+} data;				// Object of the Data structure to hold the input variables.
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} Light;				// The Light's Properties, and the View to Move the Point Lights into Eye-space.
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Point Lights  //////////////////////////////
+///////////////////////////////////////////////////////////////////
+struct PointLightData
+{
+	vec4 positionRadius;	// World Position, Radius in w.
+	vec4 colourFalloff;		// Intensity, Quadratic Attenuation in w.
+};
+layout (std430) readonly buffer PointLights
+{
+	PointLightData lights[];
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Lights of Each Cluster  ////////////////////
+///////////////////////////////////////////////////////////////////
+const uvec3 ClusterGrid = uvec3(16, 12, 24);	// Must Match cluster_lights.cs and scenediffuse.cpp.
+const uint MaxClusterLights = 256;
+
+layout (std430) readonly buffer ClusterCounts
+{
+	uint clusterCount[];	// Lights Touching Each Cluster.
+};
+layout (std430) readonly buffer ClusterLights
+{
+	uint clusterLight[];	// MaxClusterLights Entries per Cluster, the First clusterCount[] Used.
+};
+
+uniform vec2 ViewportSize;
+uniform float ClusterDepthScale;	// Slice = log(depth) * Scale + Bias.
+uniform float ClusterDepthBias;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Shadow of the Light  ///////////////////////
+///////////////////////////////////////////////////////////////////
+#include "shadow.glsl"
+
+layout( location = 0 ) out vec4 FragColour; // The Final Output Fragment Colour with Consideration of the Lighting and Materials' Properties.
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Calculate the Colour Output Contribution of Each Lighting Element  //////
+/////////////////////////////////////////////////////////////////////////////////////////////
+void light(vec3 N, vec3 vertPos, vec3 lightPos, vec3 La, vec3 Ld, vec3 Ls, vec3 Ka, vec3 Kd, vec3 Ks, out vec4 ambience, out vec4 diffusion, out vec4 specularity)
+{
+	vec3 vectorsNorm = normalize(lightPos - vertPos);					// Gets the difference between the light's position and the material vertex's position, then normalizes it to a unit vector so it just indicates direction.
+
+/////////////////////////////////
+///// AMBIENCE CONTRIBUTION /////
+/////////////////////////////////
+	ambience = clamp(vec4(vec4(La, 1.0) * vec4(Ka, 1.0)), 0.0, 1.0);	// Ambient lighting intensity multiplied with the material reflectivity.					
+
+//////////////////////////////////
+///// DIFFUSION CONTRIBUTION /////
+//////////////////////////////////
+	vec4 Id = vec4(Ld, 1.0) * max(dot(N, vectorsNorm), 0.0);			// Substitution for cos(theta) * Ld.
+	Id = clamp(Id, 0.0, 1.0);											// Contrains the value of specular intensity between 0 and 1. Because the light intensity can't be negative, or more than 1.				
+	diffusion = vec4(Kd,1.0) * Id;										// The diffused light intensity multiplied with the material's reflectivity.
+
+////////////////////////////////////
+///// SPECULARITY CONTRIBUTION /////
+////////////////////////////////////
+	vec3 normalisedVertPos = normalize(lightPos - vertPos);				// Inverted model vertex position.
+	vec3 reflection = reflect(-vectorsNorm, N);							// Inverted model vertex position reflected across its normal.
+		
+	vec4 Is = vec4(pow(max(dot(reflection, normalisedVertPos), 0.0), 1.0));	// Substitution for cos^normal(angle between light and object).
+	Is = clamp(Is, 0.0, 1.0);											    // Contrains the value of specular intensity between 0 and 1. Because the light intensity can't be negative, or more than 1.	
+	specularity = vec4(vec4(Ls, 1.0) * vec4(Ks, 1.0) * Is);				    // The specular light intensity multiplied with the material's reflectivity and the model's curviture.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Output the Sum of all the Lighting Elements as Subject to the Attenuation  //////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+void attenuate(float attenuation, vec3 lightPos, vec3 vertPos, vec4 ambi, vec4 diff, vec4 spec, out vec4 final)
+{
+	float dist = length(lightPos - vertPos);				// Distance of the light source to the model's vertex.
+	float atten = clamp(attenuation / dist, 0.0, 1.0);		// Clamps the attenuation between 0 and 1;
+
+	final = atten * (ambi + diff + spec);					// The sum of the lighting elements multiplied with the distance of the model's vertex to the light.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Add the Diffuse and Specular Light of the Cluster's Point Lights  ///////
+/////////////////////////////////////////////////////////////////////////////////////////////
+vec3 pointLights(vec3 N, vec3 vertPos, vec3 Kd, vec3 Ks)
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / ViewportSize * vec2(ClusterGrid.xy)), ClusterGrid.xy - 1);
+	uint slice = uint(clamp(log(-vertPos.z) * ClusterDepthScale + ClusterDepthBias, 0.0, float(ClusterGrid.z - 1)));
+	uint cluster = (slice * ClusterGrid.y + tile.y) * ClusterGrid.x + tile.x;
+
+	mat4 V = Light.V;
+	vec3 sum = vec3(0.0);
+	uint count = clusterCount[cluster];
+	for (uint i = 0; i < count; i++)
+	{
+		PointLightData pointLight = lights[clusterLight[cluster * MaxClusterLights + i]];
+		vec3 toLight = vec3(V * vec4(pointLight.positionRadius.xyz, 1.0)) - vertPos;
+		float dist = length(toLight);
+		float radius = pointLight.positionRadius.w;
+		if (dist >= radius) continue;		// In the cluster's box but not this far from the light.
+
+		// Inverse square falloff, windowed so it reaches exactly zero at the radius, as light_volume.frag.
+		float ratio = dist / radius;
+		float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+		vec3 intensity = pointLight.colourFalloff.rgb * (window * window / (1.0 + pointLight.colourFalloff.w * dist * dist));
+
+		vec3 vectorsNorm = toLight / dist;
+		vec3 reflection = reflect(-vectorsNorm, N);
+		sum += Kd * clamp(intensity * max(dot(N, vectorsNorm), 0.0), 0.0, 1.0);
+		sum += intensity * Ks * clamp(max(dot(reflection, vectorsNorm), 0.0), 0.0, 1.0);
+	}
+	return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///// Main Function to Call the Lighting Calculations and Return the Resultant Fragment Colour /////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void main() 
+{
+	// Variables to Hold the Output Lighting Values
+	vec4 ambience, diffusion, specularity, final;
+
+	// Calling the Light Function
+	light(data.N, data.vertPos, data.lightPos, Light.La.rgb, Light.Ld.rgb, Light.Ls.rgb, data.Ka, data.Kd, data.Ks, ambience, diffusion, specularity);
+
+	// The Shadow Blocks the Light's Diffusion and Specularity, the Ambience Remains
+	float shadow = lit(data.vertPos);
+	diffusion *= shadow;
+	specularity *= shadow;
+
+	// Attenuating and Combining the Lighting Element's Output
+	attenuate(Light.attenuation, data.lightPos, data.vertPos, ambience, diffusion, specularity, final); // Results Output into "final".
+
+	// Final Fragment Colour Output, with the Point Lights Added
+	FragColour = final + vec4(pointLights(data.N, data.vertPos, data.Kd, data.Ks), 0.0);
+}
\ No newline at end of file
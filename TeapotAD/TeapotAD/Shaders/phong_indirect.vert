@@ -0,0 +1,66 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Input of the models vertexs' local position.
+layout (location = 1) in vec3 VertexNormal;	  // Input of the models vertexs' local normal.
+layout (location = 3) in uint DrawIndex;	  // Index of the draw's object data, baseInstance plus the instance.
+
+///////////////////////////////////////////////////////////////////////////
+/////  Data Passed out of the Vertex Shader into the Fragment Shader  /////
+///////////////////////////////////////////////////////////////////////////
+out Data	
+{
+	vec3 N;				 // Normal transformed into the eye co-ordinates.
+	vec3 lightPos;		 // Light's position transformed into the eye co-ordinates. (Camera plane).
+	vec3 vertPos;		 //	Models vertexs' position transformed into the eye co-ordinates.
+	flat vec3 Ka;		 // Ambient reflectivity of the object's material.
+	flat vec3 Kd;		 // Diffusion reflectivity of the object's material.
+	flat vec3 Ks;		 // Specular reflectivity of the object's material.
+} data;					 // Object of the Data structure to hold the output variables.
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position as Declared in scenediffuse.cpp's setLightParams() function.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Draw Object Data  //////////////////////
+///////////////////////////////////////////////////////////////////
+struct ObjectData
+{
+	mat4 M;				// Model's Matrix.
+	mat4 NormalMatrix;	// Model's Matrix Multiplied with the Camera's View. Only the upper 3x3 is used.
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material.
+	vec4 Ks;			// Specular Reflectivity in Material.
+};
+layout (std430) readonly buffer Objects
+{
+	ObjectData objects[];	// One Entry per Indirect Draw Command, Indexed by DrawIndex.
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Return the Objects in the Scene's Local Vertex Positions Transformed into the Eye Co-ordinates  /////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+   ObjectData object = objects[DrawIndex];
+   mat4 MV = frame.V * object.M;
+
+   data.N = normalize( mat3(object.NormalMatrix) * VertexNormal);				// Translation of the Local Vertex Normal
+   data.lightPos = vec3(MV * vec4(frame.LightPosition.xyz, 1.0));				// Translation of the Local Light Position
+   data.vertPos = vec3(MV * vec4(VertexPosition, 1.0));							// Translation of the Local Models Vertexs' Position
+   data.Ka = object.Ka.rgb;
+   data.Kd = object.Kd.rgb;
+   data.Ks = object.Ks.rgb;
+
+   gl_Position = frame.P * MV * vec4(VertexPosition, 1.0);						// Clip Space Position of the Vertex
+}
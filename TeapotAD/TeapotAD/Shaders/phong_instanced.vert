@@ -0,0 +1,85 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Input of the models vertexs' local position.
+layout (location = 1) in vec3 VertexNormal;	  // Input of the models vertexs' local normal.
+
+///////////////////////////////////////////////////////////////////////////
+/////  Data Passed out of the Vertex Shader into the Fragment Shader  /////
+///////////////////////////////////////////////////////////////////////////
+out Data	
+{
+	vec3 N;				 // Normal transformed into the eye co-ordinates.
+	vec3 lightPos;		 // Light's position transformed into the eye co-ordinates. (Camera plane).
+	vec3 vertPos;		 //	Models vertexs' position transformed into the eye co-ordinates.
+	flat vec3 Ka;		 // Ambient reflectivity of the instance's material.
+	flat vec3 Kd;		 // Diffusion reflectivity of the instance's material.
+	flat vec3 Ks;		 // Specular reflectivity of the instance's material.
+} data;					 // Object of the Data structure to hold the output variables.
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Instance Data  /////////////////////////
+///////////////////////////////////////////////////////////////////
+struct InstanceData
+{
+	mat4 M;				// Instance's Model Matrix.
+	uint materialIndex;	// Index of the Instance's Material in the Materials Buffer.
+};
+layout (std430) readonly buffer Instances
+{
+	InstanceData instance[];	// One Entry per Instance, Indexed through InstanceIndices.
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Instances of this Draw Call  ///////////////
+///////////////////////////////////////////////////////////////////
+layout (std430) readonly buffer InstanceIndices
+{
+	uint instanceIndex[];		// Element of instance[] Drawn by each gl_InstanceID.
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Material Palette  //////////////////////////
+///////////////////////////////////////////////////////////////////
+struct MaterialData
+{
+	vec4 Ka;			// Ambient Reflectivity in Material.
+	vec4 Kd;			// Diffusion Reflectivity in Material.
+	vec4 Ks;			// Specular Reflectivity in Material.
+};
+layout (std430) readonly buffer Materials
+{
+	MaterialData material[];
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Return the Instance's Local Vertex Positions Transformed into the Eye Co-ordinates  /////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+   InstanceData inst = instance[instanceIndex[gl_InstanceID]];
+   MaterialData mat = material[inst.materialIndex];
+   mat4 MV = frame.V * inst.M;
+
+   data.N = normalize( mat3(MV) * VertexNormal);								// Translation of the Local Vertex Normal
+   data.lightPos = vec3(frame.V * vec4(frame.LightPosition.xyz, 1.0));			// Translation of the World Light Position, shared by every instance
+   data.vertPos = vec3(MV * vec4(VertexPosition, 1.0));							// Translation of the Local Models Vertexs' Position
+   data.Ka = mat.Ka.rgb;
+   data.Kd = mat.Kd.rgb;
+   data.Ks = mat.Ks.rgb;
+
+   gl_Position = frame.P * MV * vec4(VertexPosition, 1.0);						// Clip Space Position of the Vertex
+}
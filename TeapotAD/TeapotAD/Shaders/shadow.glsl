@@ -0,0 +1,16 @@
+// Shared by the forward fragment shaders, pulled in by GLSLProgram's #include.
+
+uniform bool Shadows;				// False Unless the Scene Binds a Shadow Map.
+uniform mat4 ShadowMatrix;			// Eye-space to Shadow Map Texture Co-ordinates and Depth.
+uniform sampler2DShadow ShadowMap;
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////  Function to Return how Much of the Light Reaches the Fragment, 0 in Full Shadow  //////
+//////////////////////////////////////////////////////////////////////////////////////////////
+float lit(vec3 vertPos)
+{
+	if (!Shadows) return 1.0;
+
+	// The filtered comparison blends the four nearest shadow map texels.
+	return textureProj(ShadowMap, ShadowMatrix * vec4(vertPos, 1.0));
+}
@@ -0,0 +1,13 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Input of the models vertexs' local position.
+
+uniform mat4 ShadowMVP;	// Model to the Light's Clip Space.
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Places the Caster in the Shadow Map, Only its Depth is Written  ////////
+/////////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	gl_Position = ShadowMVP * vec4(VertexPosition, 1.0);
+}
@@ -0,0 +1,141 @@
+#version 430
+
+layout (local_size_x = 64) in;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Frame Camera and Light Data  ///////////
+///////////////////////////////////////////////////////////////////
+layout (std140) uniform FrameData
+{
+	mat4 V;				// Camera View Matrix.
+	mat4 P;				// Camera Projection Matrix.
+	vec4 LightPosition;	// Light's World Position.
+	vec4 La;			// Ambient Light Intensity.
+	vec4 Ld;			// Diffuse Light Intensity.
+	vec4 Ls;			// Specular Light Intensity.
+	float attenuation;	// Intensity of Attenuation.
+} frame;
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Per-Instance Data  /////////////////////////
+///////////////////////////////////////////////////////////////////
+struct InstanceData
+{
+	mat4 M;				// Instance's Model Matrix.
+	uint materialIndex;	// Index of the Instance's Material in the Materials Buffer.
+};
+layout (std430) readonly buffer Instances
+{
+	InstanceData instance[];	// One Entry per Teapot.
+};
+
+///////////////////////////////////////////////////////////////////
+/////////////////////  Output Draw Commands  //////////////////////
+///////////////////////////////////////////////////////////////////
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;	// Zero when the pass starts, one added per teapot drawn with this level.
+	uint firstIndex;
+	int  baseVertex;
+	uint baseInstance;	// Start of this level's part of InstanceIndices.
+};
+layout (std430) buffer DrawCommands
+{
+	DrawCommand command[];		// One per Level of Detail.
+};
+layout (std430) writeonly buffer InstanceIndices
+{
+	uint instanceIndex[];		// The Teapots Drawn by Each Command, from its baseInstance.
+};
+
+uniform uint InstanceCount;		// Teapots to test, also the room each level has in InstanceIndices.
+uniform vec3 BoundsMin;			// The teapot's object space bounding box.
+uniform vec3 BoundsMax;
+uniform vec3 SphereCentre;		// Centre of its bounding sphere, where the distance for the level of detail is taken.
+
+uniform int LodCount;			// Levels of detail, at most 8.
+uniform float LodErrors[8];		// Furthest each level strays from the true surface, in object units.
+uniform float PixelsPerUnit;	// Pixels one unit covers one unit from the camera.
+uniform float MaxPixelError;	// Largest error allowed to show on screen.
+
+uniform sampler2D DepthPyramid;	// Furthest depth of each texel's footprint, built from the previous frame.
+uniform int PyramidLevels;
+uniform vec2 PyramidSize;		// Size of level 0 in texels, the viewport's size.
+uniform bool PyramidValid;		// False until a frame has been rendered into the pyramid.
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/////  True if the Box's Screen Rectangle is Behind Everything the Pyramid Saw There  ////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+bool occluded(vec3 ndcMin, vec3 ndcMax)
+{
+	ivec2 size = ivec2(PyramidSize);
+	ivec2 pixelMin = clamp(ivec2((ndcMin.xy * 0.5 + 0.5) * PyramidSize), ivec2(0), size - 1);
+	ivec2 pixelMax = clamp(ivec2((ndcMax.xy * 0.5 + 0.5) * PyramidSize), ivec2(0), size - 1);
+
+	// The level where the rectangle spans at most two texels each way.
+	ivec2 extent = pixelMax - pixelMin + 1;
+	int level = clamp(int(ceil(log2(float(max(extent.x, extent.y))))), 0, PyramidLevels - 1);
+
+	// A pixel's texel at any level is its coordinate shifted down, clamped to the level's size.
+	ivec2 levelSize = max(size >> level, ivec2(1));
+	ivec2 texelMin = min(pixelMin >> level, levelSize - 1);
+	ivec2 texelMax = min(pixelMax >> level, levelSize - 1);
+
+	float furthest = 0.0;
+	for (int y = texelMin.y; y <= texelMax.y; y++)
+		for (int x = texelMin.x; x <= texelMax.x; x++)
+			furthest = max(furthest, texelFetch(DepthPyramid, ivec2(x, y), level).r);
+
+	return ndcMin.z * 0.5 + 0.5 > furthest;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Tests one Teapot and Appends it to its Level's Draw Command  //////
+////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= InstanceCount) return;
+
+	mat4 M = instance[i].M;
+	mat4 MVP = frame.P * frame.V * M;
+
+	// Project the corners of the bounding box. The box is outside the frustum if every
+	// corner is outside the same plane, and is only tested against the pyramid if it is
+	// entirely in front of the camera.
+	ivec3 below = ivec3(0), above = ivec3(0);	// Corners outside each plane.
+	bool inFront = true;
+	vec3 ndcMin = vec3(1.0), ndcMax = vec3(-1.0);
+	for (int c = 0; c < 8; c++)
+	{
+		vec3 corner = mix(BoundsMin, BoundsMax, vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+		vec4 clip = MVP * vec4(corner, 1.0);
+
+		below += ivec3(lessThan(clip.xyz, vec3(-clip.w)));
+		above += ivec3(greaterThan(clip.xyz, vec3(clip.w)));
+
+		if (clip.w <= 0.0)
+		{
+			inFront = false;
+		}
+		else
+		{
+			vec3 ndc = clip.xyz / clip.w;
+			ndcMin = min(ndcMin, ndc);
+			ndcMax = max(ndcMax, ndc);
+		}
+	}
+	if (any(equal(below, ivec3(8))) || any(equal(above, ivec3(8)))) return;
+	if (inFront && PyramidValid && occluded(ndcMin, ndcMax)) return;
+
+	// The coarsest level whose error still projects to less than MaxPixelError.
+	float distance = length(vec3(frame.V * M * vec4(SphereCentre, 1.0)));
+	float pixels = PixelsPerUnit / max(distance, 0.001);
+	int level = 0;
+	while (level + 1 < LodCount && LodErrors[level + 1] * pixels <= MaxPixelError)
+		level++;
+
+	uint slot = atomicAdd(command[level].instanceCount, 1u);
+	instanceIndex[command[level].baseInstance + slot] = i;
+}
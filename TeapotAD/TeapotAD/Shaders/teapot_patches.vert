@@ -0,0 +1,11 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Input of a control point of one of the teapot's patches.
+
+//////////////////////////////////////////////////////////////////////////////////////////
+/////  Main Function Passes the Control Point to the Tessellation Control Shader  ////////
+//////////////////////////////////////////////////////////////////////////////////////////
+void main()
+{
+   gl_Position = vec4(VertexPosition, 1.0);		// Still in the Model's Local Co-ordinates
+}
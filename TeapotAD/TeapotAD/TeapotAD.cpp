@@ -11,6 +11,35 @@
 #include "scene.h"
 
 #include "scenediffuse.h"
+#include "sceneteapotfield.h"
+
+#include "benchmark.h"
+#include "offscreentarget.h"
+#include "headlesscontext.h"
+#include "beziertessellator.h"
+#include "vboteapot.h"
+#include "vboplane.h"
+#include "softwarerasterizer.h"
+#include "pixelconverter.h"
+#include "pixeltransform.h"
+#include "ppmimage.h"
+#include "shaderwatcher.h"
+#include "texturestreamer.h"
+#include "texturecache.h"
+#include "texturecontainer.h"
+#include "mipgenerator.h"
+#include "blockcompressor.h"
+#include "Texture.h"
+#include "defines.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <gtx/transform2.hpp>
 
 
 //#include <string>
@@ -41,6 +70,42 @@ double lastCursorPositionX, lastCursorPositionY, cursorPositionX, cursorPosition
 //Track whether or not lighting value changing keys are currently down.
 bool shift, a, d, s, space, r;
 
+//Command line options
+struct Options
+{
+	bool benchmark;		// Render a fixed camera path offscreen and write the frame timings to a CSV file.
+	int warmupFrames;	// Frames rendered before timing starts.
+	int timedFrames;	// Frames that are timed.
+	string csvFile;		// Where the frame timings are written.
+	string sceneName;	// "diffuse" for the lit teapot, "field" for the instanced teapot field.
+	int fieldTeapots;	// Number of teapots in the field scene.
+	bool multiDraw;		// Draw the diffuse scene from one geometry arena with a single indirect call.
+	VertexFormat::Format vertexFormat;	// Layout of the meshes' vertex buffers.
+	bool gpuTessellation;	// Tessellate the diffuse scene's teapot on the GPU.
+	int lodLevels;		// Teapot meshes to choose from by size on screen, 1 for a single mesh.
+	bool culling;		// Skip objects outside the view frustum.
+	bool occlusionCulling;	// Cull the field scene's teapots on the GPU against a depth pyramid.
+	int deferredLights;	// Point lights of the diffuse scene's deferred renderer, 0 to render forward.
+	int clusteredLights;	// Point lights the diffuse scene shades forward from per-cluster light lists.
+	bool shadows;		// Shadow the diffuse scene's light with a cached shadow map.
+	bool shaderCache;	// Keep linked shader programs on disk and load them instead of compiling.
+	string lightSweepCsv;	// If set, time the deferred and clustered renderers over a range of light counts and write the results here.
+	string tessellationCsv;	// If set, time the teapot tessellator and write the results here instead of rendering.
+	string conversionCsv;	// If set, time the pixel format conversions and write the results here instead of rendering.
+	string transformCsv;	// If set, time the image rotations and flips and write the results here instead of rendering.
+	string compressionImage;	// If set, time building the mips of this image and compressing them, instead of rendering.
+	string compressionCsv;
+	string softwareImage;	// If set, render the diffuse scene with the software rasterizer to this PPM file instead.
+	string goldenImage;		// If set, the software rasterizer's image must match this PPM file.
+	string screenshotImage;	// If set, render one frame from the starting camera to this PPM file and exit.
+	string streamImage;		// If set, load this image streamTextures times while rendering, with and without the texture streamer.
+	int streamTextures;
+	BlockCompressor::Format textureFormat;	// Block format of the textures loaded through the texture cache.
+	string containerImage;	// If set, also load this DDS or KTX2 file streamTextures times, uploading its levels as stored.
+};
+
+Options options;
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //	Callback function for keypress use to toggle animate.
 //	R key resets the camera and lighting values.
@@ -95,7 +160,11 @@ void initializeGL()
 	cursorPositionY=0.0;
 	
 	// Create the scene class and initialise it for the camera
-	scene = new SceneDiffuse();
+	if (options.sceneName == "field")
+		scene = new SceneTeapotField(options.fieldTeapots, options.vertexFormat, options.lodLevels, options.culling, options.occlusionCulling);
+	else
+		scene = new SceneDiffuse(options.multiDraw, options.vertexFormat, options.gpuTessellation, options.lodLevels, options.culling,
+			options.deferredLights, options.clusteredLights, options.shadows);
     scene->initScene(camera);
 }
 
@@ -147,15 +216,772 @@ void update( float t )
 // Main loop updates scene and renders until we quit
 /////////////////////////////////////////////////////////////////////////////////////////////
 void mainLoop() {
+	// Edited shaders are rebuilt while the old programs keep drawing.
+	ShaderWatcher watcher;
+	scene->watchShaders(watcher);
+
 	while( ! glfwWindowShouldClose(window) && !glfwGetKey(window, GLFW_KEY_ESCAPE) ) {
 		//GLUtils::checkForOpenGLError(__FILE__,__LINE__);
 		update((float)glfwGetTime());
+		int reloads = watcher.getReloadCount();
+		watcher.update(glfwGetTime());
+		if (watcher.getReloadCount() != reloads) scene->shadersReloaded();
 		scene->render(camera);
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Place the camera on the benchmark path. The path only depends on the frame number so every
+// run renders exactly the same frames.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void setBenchmarkCamera(int frame, int totalFrames)
+{
+	float t = (float)frame / totalFrames;
+
+	camera.reset();
+	camera.setPosition(glm::vec3(8.0f * sin(TWOPI_F * t), 2.0f + 3.0f * t, 20.0f - 8.0f * t));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark loop renders the camera path into an offscreen target and writes the timings
+/////////////////////////////////////////////////////////////////////////////////////////////
+void benchmarkLoop()
+{
+	OffscreenTarget target(WIN_WIDTH, WIN_HEIGHT);
+	FrameBenchmark benchmark(options.warmupFrames, options.timedFrames);
+
+	target.bind();
+	while (!benchmark.isFinished()) {
+		setBenchmarkCamera(benchmark.frameNumber(), benchmark.totalFrames());
+		benchmark.beginFrame();
+		scene->render(camera);
+		benchmark.endFrame();
+
+		std::map<string, double> counters;
+		scene->frameCounters(counters);
+		benchmark.recordCounters(counters);
+		gl::Flush();	// Nothing is swapped so make sure each frame is actually submitted.
+	}
+	target.unbind();
+
+	benchmark.writeCSV(options.csvFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Render the benchmark camera path with the clustered and the deferred renderers for 16 to
+// 16384 point lights, and write each one's mean frame time. The lights for a smaller count are
+// the first of those for a larger one.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void lightSweep()
+{
+	std::ofstream out(options.lightSweepCsv.c_str());
+	if (!out)
+		throw std::runtime_error("Unable to open " + options.lightSweepCsv + " for writing");
+	out << "renderer,lights,cpu_submit_ms,gpu_ms" << std::endl;
+
+	// The deferred renderer cannot draw with one indirect call or tessellate the teapot.
+	int renderers = (options.multiDraw || options.gpuTessellation) ? 1 : 2;
+	const char *names[] = { "clustered", "deferred" };
+
+	OffscreenTarget target(WIN_WIDTH, WIN_HEIGHT);
+	printf("%10s %8s %10s %10s\n", "renderer", "lights", "cpu ms", "gpu ms");
+	for (int r = 0; r < renderers; r++) {
+		bool deferred = r == 1;
+		SceneDiffuse *sweepScene = new SceneDiffuse(options.multiDraw, options.vertexFormat, options.gpuTessellation, options.lodLevels, options.culling,
+			deferred ? 16 : 0, deferred ? 0 : 16);
+		sweepScene->initScene(camera);
+		sweepScene->resize(camera, WIN_WIDTH, WIN_HEIGHT);
+
+		target.bind();
+		for (int lights = 16; lights <= 16384; lights *= 4) {
+			sweepScene->setPointLightCount(lights);
+
+			FrameBenchmark benchmark(20, 100);
+			while (!benchmark.isFinished()) {
+				setBenchmarkCamera(benchmark.frameNumber(), benchmark.totalFrames());
+				benchmark.beginFrame();
+				sweepScene->render(camera);
+				benchmark.endFrame();
+				gl::Flush();
+			}
+
+			double cpu, gpu;
+			benchmark.meanTimes(cpu, gpu);
+			printf("%10s %8d %10.3f %10.3f\n", names[r], lights, cpu, gpu);
+			out << names[r] << "," << lights << "," << cpu << "," << gpu << std::endl;
+		}
+		target.unbind();
+
+		delete sweepScene;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Time the teapot's CPU tessellation for grid sizes 16 to 512, with the scalar kernel on one
+// thread, the best SIMD kernel on one thread and the SIMD kernel on every hardware thread.
+// Each configuration keeps its fastest of three runs.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void tessellationBenchmark()
+{
+	std::ofstream out(options.tessellationCsv.c_str());
+	if (!out)
+		throw std::runtime_error("Unable to open " + options.tessellationCsv + " for writing");
+	out << "grid,vertices,kernel,threads,ms,mvertices_per_s" << std::endl;
+
+	std::vector<BezierTessellator::Patch> patches;
+	VBOTeapot::buildPatches(patches);
+
+	ThreadPool serial(1);
+	ThreadPool parallel;
+	BezierTessellator::Kernel simd = BezierTessellator::bestKernel();
+
+	struct Config { BezierTessellator::Kernel kernel; ThreadPool *pool; };
+	Config configs[] = { { BezierTessellator::SCALAR, &serial }, { simd, &serial }, { simd, &parallel } };
+
+	printf("%6s %10s %8s %8s %10s %12s\n", "grid", "vertices", "kernel", "threads", "ms", "Mvertices/s");
+	MeshData mesh;
+	for (int grid = 16; grid <= 512; grid *= 2) {
+		for (int c = 0; c < 3; c++) {
+			BezierTessellator tessellator(grid, configs[c].pool, configs[c].kernel);
+
+			double best = 0.0;
+			for (int run = 0; run < 3; run++) {
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				tessellator.tessellate(patches, mesh);
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				if (run == 0 || ms < best) best = ms;
+			}
+
+			unsigned int vertices = mesh.getVertexCount();
+			double rate = vertices / (best * 1000.0);
+			const char *kernel = BezierTessellator::kernelName(tessellator.getKernel());
+			int threads = configs[c].pool->getThreadCount();
+
+			printf("%6d %10u %8s %8d %10.3f %12.2f\n", grid, vertices, kernel, threads, best, rate);
+			out << grid << "," << vertices << "," << kernel << "," << threads << "," << best << "," << rate << std::endl;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Time the conversion of a 3840x2160 image between every pair of Bitmap formats, with the
+// scalar kernel and every vector kernel up to the best on one thread, then the best on every
+// hardware thread. Each configuration keeps its fastest of three runs and must produce the
+// same pixels as the scalar kernel. MB/s counts the bytes read and written.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void conversionBenchmark()
+{
+	std::ofstream out(options.conversionCsv.c_str());
+	if (!out)
+		throw std::runtime_error("Unable to open " + options.conversionCsv + " for writing");
+	out << "from,to,kernel,threads,ms,mb_per_s" << std::endl;
+
+	const int width = 3840, height = 2160;
+	const char *formatNames[] = { "", "gray", "grayalpha", "rgb", "rgba" };
+
+	ThreadPool serial(1);
+	ThreadPool parallel;
+	PixelConverter::Kernel widest = PixelConverter::bestKernel();
+
+	struct Config { PixelConverter::Kernel kernel; ThreadPool *pool; };
+	std::vector<Config> configs;
+	for (int k = PixelConverter::SCALAR; k <= widest; k++) {
+		Config config = { (PixelConverter::Kernel)k, &serial };
+		configs.push_back(config);
+	}
+	Config threaded = { widest, &parallel };
+	configs.push_back(threaded);
+
+	std::vector<unsigned char> src(width * height * 4), dest(width * height * 4), reference;
+	for (size_t i = 0; i < src.size(); i++) src[i] = (unsigned char)(i * 2654435761u >> 24);
+
+	printf("%10s %10s %8s %8s %10s %10s\n", "from", "to", "kernel", "threads", "ms", "MB/s");
+	for (int from = 1; from <= 4; from++) {
+		for (int to = 1; to <= 4; to++) {
+			if (from == to) continue;
+			for (size_t c = 0; c < configs.size(); c++) {
+				PixelConverter converter(configs[c].pool, configs[c].kernel);
+
+				double best = 0.0;
+				for (int run = 0; run < 3; run++) {
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					converter.convert(&src[0], width * from, from, &dest[0], width * to, to, width, height);
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+					if (run == 0 || ms < best) best = ms;
+				}
+
+				const char *kernel = PixelConverter::kernelName(converter.getKernel());
+				if (c == 0) reference.assign(dest.begin(), dest.begin() + width * height * to);
+				else if (!std::equal(reference.begin(), reference.end(), dest.begin()))
+					throw std::runtime_error(string("The ") + kernel + " kernel's " + formatNames[from] + " to " + formatNames[to] + " conversion differs from the scalar kernel's");
+
+				double rate = (double)width * height * (from + to) / (best * 1000.0);
+				int threads = configs[c].pool->getThreadCount();
+				printf("%10s %10s %8s %8d %10.3f %10.1f\n", formatNames[from], formatNames[to], kernel, threads, best, rate);
+				out << formatNames[from] << "," << formatNames[to] << "," << kernel << "," << threads << "," << best << "," << rate << std::endl;
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Transform an image one pixel at a time as Bitmap used to: a memcpy of each pixel to where
+// it ends up, or for a vertical flip an exchange of rows through a row buffer.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void transformPerPixel(PixelTransform::Operation operation, unsigned char *pixels, int width, int height, int channels, unsigned char *dest)
+{
+	size_t rowSize = (size_t)width * channels;
+	if (operation == PixelTransform::FLIP_VERTICAL) {
+		unsigned char *rowBuffer = new unsigned char[rowSize];
+		for (int row = 0; row < height / 2; row++) {
+			memcpy(rowBuffer, pixels + row * rowSize, rowSize);
+			memcpy(pixels + row * rowSize, pixels + (height - row - 1) * rowSize, rowSize);
+			memcpy(pixels + (height - row - 1) * rowSize, rowBuffer, rowSize);
+		}
+		delete[] rowBuffer;
+		return;
+	}
+
+	int destWidth = PixelTransform::swapsSize(operation) ? height : width;
+	for (int row = 0; row < height; row++) {
+		for (int col = 0; col < width; col++) {
+			int destCol, destRow;
+			PixelTransform::destination(operation, col, row, width, height, destCol, destRow);
+			memcpy(dest + ((size_t)destRow * destWidth + destCol) * channels, pixels + row * rowSize + col * channels, channels);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Time every rotation, transpose and flip of a 7680x4320 image in every Bitmap format, one
+// pixel at a time as Bitmap used to, then with the tiled kernels on one thread and on every
+// hardware thread. Operations that keep the size work in place as Bitmap now does. Each keeps
+// its fastest of three runs and must produce the same pixels. MB/s counts bytes read and written.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void transformBenchmark()
+{
+	std::ofstream out(options.transformCsv.c_str());
+	if (!out)
+		throw std::runtime_error("Unable to open " + options.transformCsv + " for writing");
+	out << "operation,format,method,threads,ms,mb_per_s" << std::endl;
+
+	const int width = 7680, height = 4320;
+	const char *formatNames[] = { "", "gray", "grayalpha", "rgb", "rgba" };
+
+	ThreadPool serial(1);
+	ThreadPool parallel;
+	ThreadPool *pools[] = { NULL, &serial, &parallel };
+
+	std::vector<unsigned char> src(width * height * 4), work(src.size()), dest(src.size()), reference;
+	for (size_t i = 0; i < src.size(); i++) src[i] = (unsigned char)(i * 2654435761u >> 24);
+
+	printf("%10s %10s %10s %8s %10s %10s\n", "operation", "format", "method", "threads", "ms", "MB/s");
+	for (int op = PixelTransform::ROTATE_90; op <= PixelTransform::FLIP_HORIZONTAL; op++) {
+		PixelTransform::Operation operation = (PixelTransform::Operation)op;
+		bool inPlace = !PixelTransform::swapsSize(operation);
+
+		for (int channels = 1; channels <= 4; channels++) {
+			size_t bytes = (size_t)width * height * channels;
+
+			for (int c = 0; c < 3; c++) {
+				PixelTransform transform(pools[c]);
+				bool perPixel = pools[c] == NULL;
+				unsigned char *result = &dest[0];
+
+				double best = 0.0;
+				for (int run = 0; run < 3; run++) {
+					// In place operations start from a fresh copy every run
+					memcpy(&work[0], &src[0], bytes);
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					if (perPixel) {
+						transformPerPixel(operation, &work[0], width, height, channels, &dest[0]);
+						if (operation == PixelTransform::FLIP_VERTICAL) result = &work[0];
+					}
+					else if (inPlace) {
+						transform.applyInPlace(operation, &work[0], width, height, channels);
+						result = &work[0];
+					}
+					else {
+						transform.apply(operation, &work[0], width, height, channels, &dest[0]);
+					}
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+					if (run == 0 || ms < best) best = ms;
+				}
+
+				if (perPixel) reference.assign(result, result + bytes);
+				else if (!std::equal(reference.begin(), reference.end(), result))
+					throw std::runtime_error(string("The tiled ") + PixelTransform::operationName(operation) + " of " + formatNames[channels] + " pixels differs from the per-pixel one");
+
+				const char *method = perPixel ? "per-pixel" : inPlace ? "in-place" : "tiled";
+				int threads = perPixel ? 1 : pools[c]->getThreadCount();
+				double rate = 2.0 * bytes / (best * 1000.0);
+				printf("%10s %10s %10s %8d %10.3f %10.1f\n", PixelTransform::operationName(operation), formatNames[channels], method, threads, best, rate);
+				out << PixelTransform::operationName(operation) << "," << formatNames[channels] << "," << method << "," << threads << "," << best << "," << rate << std::endl;
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Time building the mip chain of an image, with the scalar kernel and the AVX2 one where the
+// CPU has it on one thread and the best on every hardware thread, then compressing every level
+// to BC1, BC3 and BC7 on one thread and on all of them. Each keeps its fastest of three runs
+// and must produce the same bytes as the first. MB/s counts the RGBA bytes of the levels read.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void compressionBenchmark()
+{
+	std::ofstream out(options.compressionCsv.c_str());
+	if (!out)
+		throw std::runtime_error("Unable to open " + options.compressionCsv + " for writing");
+	out << "stage,kernel,threads,ms,mb_per_s" << std::endl;
+
+	Bitmap image = Bitmap::bitmapFromFile(options.compressionImage);
+	Bitmap rgba(image.width(), image.height(), Bitmap::Format_RGBA);
+	rgba.copyRectFromBitmap(image, 0, 0, 0, 0, 0, 0);
+	int width = (int)rgba.width(), height = (int)rgba.height();
+	int levels = MipGenerator::levelCount(width, height);
+
+	ThreadPool serial(1);
+	ThreadPool parallel;
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Bytes of RGBA read to build the levels below level 0, and to compress all of them
+	double mipBytes = 0.0, chainBytes = (double)width * height * 4;
+	for (int level = 1; level < levels; level++) {
+		mipBytes += (double)MipGenerator::levelSize(width, level - 1) * MipGenerator::levelSize(height, level - 1) * 4;
+		chainBytes += (double)MipGenerator::levelSize(width, level) * MipGenerator::levelSize(height, level) * 4;
+	}
+
+	printf("%dx%d, %d levels, %.1f MB of RGBA with mips\n", width, height, levels, chainBytes / (1 << 20));
+	printf("%10s %8s %8s %10s %10s\n", "stage", "kernel", "threads", "ms", "MB/s");
+
+	struct Config { MipGenerator::Kernel kernel; ThreadPool *pool; };
+	std::vector<Config> configs;
+	for (int k = MipGenerator::SCALAR; k <= MipGenerator::bestKernel(); k++) {
+		Config config = { (MipGenerator::Kernel)k, &serial };
+		configs.push_back(config);
+	}
+	Config threaded = { MipGenerator::bestKernel(), &parallel };
+	configs.push_back(threaded);
+
+	std::vector< std::vector<unsigned char> > mips, reference;
+	for (size_t c = 0; c < configs.size(); c++) {
+		MipGenerator generator(configs[c].pool, configs[c].kernel);
+		double best = 0.0;
+		for (int run = 0; run < 3; run++) {
+			Clock::time_point start = Clock::now();
+			generator.generate(rgba.pixelBuffer(), width, height, mips);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (run == 0 || ms < best) best = ms;
+		}
+
+		const char *kernel = MipGenerator::kernelName(generator.getKernel());
+		if (c == 0) reference = mips;
+		else if (mips != reference)
+			throw std::runtime_error(string("The ") + kernel + " kernel's mips differ from the scalar kernel's");
+
+		double rate = mipBytes / (best * 1000.0);
+		int threads = configs[c].pool->getThreadCount();
+		printf("%10s %8s %8d %10.3f %10.1f\n", "mips", kernel, threads, best, rate);
+		out << "mips," << kernel << "," << threads << "," << best << "," << rate << std::endl;
+	}
+
+	for (int f = BlockCompressor::BC1; f <= BlockCompressor::BC7; f++) {
+		BlockCompressor::Format format = (BlockCompressor::Format)f;
+		size_t size = 0;
+		for (int level = 0; level < levels; level++)
+			size += BlockCompressor::compressedSize(format, MipGenerator::levelSize(width, level), MipGenerator::levelSize(height, level));
+
+		std::vector<unsigned char> blocks(size), first;
+		ThreadPool *pools[] = { &serial, &parallel };
+		for (int p = 0; p < 2; p++) {
+			BlockCompressor compressor(pools[p]);
+			double best = 0.0;
+			for (int run = 0; run < 3; run++) {
+				Clock::time_point start = Clock::now();
+				unsigned char *dest = &blocks[0];
+				for (int level = 0; level < levels; level++) {
+					int levelWidth = MipGenerator::levelSize(width, level), levelHeight = MipGenerator::levelSize(height, level);
+					compressor.compress(format, level == 0 ? rgba.pixelBuffer() : &mips[level - 1][0], levelWidth, levelHeight, dest);
+					dest += BlockCompressor::compressedSize(format, levelWidth, levelHeight);
+				}
+				double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				if (run == 0 || ms < best) best = ms;
+			}
+
+			if (p == 0) first = blocks;
+			else if (blocks != first)
+				throw std::runtime_error(string("Threaded ") + BlockCompressor::formatName(format) + " compression differs from single threaded");
+
+			double rate = chainBytes / (best * 1000.0);
+			int threads = pools[p]->getThreadCount();
+			printf("%10s %8s %8d %10.3f %10.1f\n", BlockCompressor::formatName(format), "-", threads, best, rate);
+			out << BlockCompressor::formatName(format) << ",," << threads << "," << best << "," << rate << std::endl;
+		}
+		printf("%s with mips is %.1f MB, %.1f%% of RGBA without mips\n", BlockCompressor::formatName(format),
+			size / (double)(1 << 20), 100.0 * size / ((double)width * height * 4));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Render the diffuse scene from the starting camera with the software rasterizer, with the
+// scalar kernel on one thread, the best SIMD kernel on one thread and the SIMD kernel on every
+// hardware thread. Each configuration keeps its fastest of five frames. Every configuration
+// must produce the same image, which is written out and checked against the golden image.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void softwareRender()
+{
+	// The same meshes, materials and light as SceneDiffuse.
+	MeshData plane, teapot;
+	VBOPlane::buildMesh(100.0f, 100.0f, 100, 100, plane);
+
+	std::vector<BezierTessellator::Patch> patches;
+	VBOTeapot::buildPatches(patches);
+	ThreadPool serial(1);
+	ThreadPool parallel;
+	VBOTeapot::buildMesh(16, glm::translate(vec3(0.0f, 0.0f, 0.1f)), patches, &parallel, teapot);
+
+	SoftwareRasterizer::Light light;
+	light.position = vec3(10.0f, 10.0f, 10.0f);
+	light.La = vec3(0.3f);
+	light.Ld = vec3(0.9f);
+	light.Ls = vec3(0.3f);
+	light.attenuation = 30.0f;
+
+	SoftwareRasterizer::Material planeMaterial = { vec3(0.51f, 1.0f, 0.49f), vec3(0.51f, 1.0f, 0.49f), vec3(0.1f) };
+	SoftwareRasterizer::Material teapotMaterial = { vec3(0.46f, 0.29f, 0.0f), vec3(0.46f, 0.29f, 0.0f), vec3(0.29f) };
+
+	camera.reset();
+	SoftwareRasterizer::Kernel simd = SoftwareRasterizer::bestKernel();
+
+	struct Config { SoftwareRasterizer::Kernel kernel; ThreadPool *pool; };
+	Config configs[] = { { SoftwareRasterizer::SCALAR, &serial }, { simd, &serial }, { simd, &parallel } };
+
+	printf("%8s %8s %10s %10s %10s\n", "kernel", "threads", "ms", "Mtri/s", "Mpix/s");
+	std::vector<unsigned char> firstPixels, pixels;
+	for (int c = 0; c < 3; c++) {
+		SoftwareRasterizer rasterizer(WIN_WIDTH, WIN_HEIGHT, configs[c].pool, configs[c].kernel);
+		rasterizer.setCamera(camera.view(), camera.projection());
+		rasterizer.setLight(light);
+
+		double best = 0.0;
+		for (int run = 0; run < 5; run++) {
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			rasterizer.clear(vec3(0.5f));
+			rasterizer.draw(plane, mat4(1.0f), planeMaterial);
+			rasterizer.draw(teapot, mat4(1.0f), teapotMaterial);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (run == 0 || ms < best) best = ms;
+		}
+
+		const SoftwareRasterizer::Statistics & stats = rasterizer.getStatistics();
+		printf("%8s %8d %10.3f %10.2f %10.2f\n", SoftwareRasterizer::kernelName(rasterizer.getKernel()), configs[c].pool->getThreadCount(),
+			best, stats.triangles / (best * 1000.0), stats.pixelsShaded / (best * 1000.0));
+		if (c == 2) {
+			printf("%llu of %llu triangles rasterized, %llu tile and %llu of %llu block depth rejections, %llu pixels shaded\n",
+				stats.rasterized, stats.triangles, stats.tilesRejected, stats.blocksRejected, stats.blocksTested, stats.pixelsShaded);
+		}
+
+		rasterizer.readPixels(pixels);
+		if (c == 0) firstPixels = pixels;
+		else if (pixels != firstPixels) throw std::runtime_error(string("The ") + SoftwareRasterizer::kernelName(rasterizer.getKernel()) + " kernel's image differs from the scalar kernel's");
+	}
+
+	PPMImage image(WIN_WIDTH, WIN_HEIGHT, &pixels[0]);
+	image.write(options.softwareImage);
+
+	// The golden image may be a --screenshot of the GL renderer, which covers silhouette pixels by its own rules
+	// and rounds the lighting differently, or a software image from another compiler, whose floating point
+	// contractions can move an edge or a colour by a level. Either only touches a thin band along the edges of
+	// the plane and the teapot, so up to 0.5% of the pixels may differ by more than 2 levels. A wrong light,
+	// material or camera changes far more of the image than that.
+	if (!options.goldenImage.empty()) {
+		PPMImage golden;
+		golden.read(options.goldenImage);
+		int largest;
+		int differences = image.countDifferences(golden, 2, largest);
+		printf("%d pixels differ from %s by more than 2, largest difference %d\n", differences, options.goldenImage.c_str(), largest);
+		if (differences > WIN_WIDTH * WIN_HEIGHT / 200)
+			throw std::runtime_error("The image does not match " + options.goldenImage);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Render one frame from the starting camera offscreen and write it out, e.g. as a golden image
+// for the software rasterizer.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void screenshot()
+{
+	OffscreenTarget target(WIN_WIDTH, WIN_HEIGHT);
+	std::vector<unsigned char> pixels(4 * WIN_WIDTH * WIN_HEIGHT);
+
+	camera.reset();
+	target.bind();
+	scene->render(camera);
+
+	target.bind();	// Scenes that render through a target of their own rebind theirs.
+	gl::PixelStorei(gl::PACK_ALIGNMENT, 1);
+	gl::ReadPixels(0, 0, WIN_WIDTH, WIN_HEIGHT, gl::RGBA, gl::UNSIGNED_BYTE, &pixels[0]);
+	target.unbind();
+
+	PPMImage(WIN_WIDTH, WIN_HEIGHT, &pixels[0]).write(options.screenshotImage);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Load the same image many times while rendering the scene offscreen, first on the render
+// thread with Bitmap and Texture, one texture per frame, then through the texture streamer,
+// which decodes on worker threads and uploads from a pixel unpack buffer, then through the
+// texture cache, one block compressed texture with mips per frame, and if one is given from a
+// DDS or KTX2 file uploaded as it is stored. Every frame waits for the GPU so its time includes
+// the upload. Reports the total and the worst frame of each.
+/////////////////////////////////////////////////////////////////////////////////////////////
+void textureStreamBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	OffscreenTarget target(WIN_WIDTH, WIN_HEIGHT);
+	camera.reset();
+
+	enum { BLOCKING, STREAMED, CACHED, CONTAINER };
+	const char *loaders[] = { "blocking", "streamed", "cached", "container" };
+	int last = options.containerImage.empty() ? CACHED : CONTAINER;
+	ThreadPool pool;
+
+	printf("%10s %8s %10s %10s %10s\n", "loader", "frames", "total ms", "mean ms", "worst ms");
+	for (int loader = BLOCKING; loader <= last; loader++) {
+		std::vector<Texture *> textures;
+		std::vector<GLuint> compressed;
+		TextureStreamer *streamer = loader == STREAMED ? new TextureStreamer() : NULL;
+		if (streamer) {
+			for (int i = 0; i < options.streamTextures; i++) streamer->request(options.streamImage);
+		}
+		TextureCache *cache = loader == CACHED ? new TextureCache("TextureCache", options.textureFormat, &pool) : NULL;
+
+		int frames = 0;
+		double worst = 0.0;
+		Clock::time_point start = Clock::now();
+		target.bind();
+		while (streamer ? streamer->getOutstanding() > 0 : (int)(textures.size() + compressed.size()) < options.streamTextures) {
+			Clock::time_point frameStart = Clock::now();
+			if (streamer) streamer->update();
+			else if (cache) {
+				int width, height;
+				compressed.push_back(cache->load(options.streamImage, width, height));
+			}
+			else if (loader == CONTAINER) {
+				textures.push_back(new Texture(TextureContainer(options.containerImage)));
+			}
+			else textures.push_back(new Texture(Bitmap::bitmapFromFile(options.streamImage)));
+			scene->render(camera);
+			gl::Finish();
+			worst = std::max(worst, std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+			frames++;
+		}
+		target.unbind();
+		double total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		printf("%10s %8d %10.1f %10.3f %10.3f\n", loaders[loader], frames, total, total / frames, worst);
+		if (streamer) {
+			printf("%d decoding threads, %s\n", streamer->getThreadCount(), streamer->isPersistent() ? "persistently mapped unpack buffer" : "uploads from memory");
+			if (streamer->getStatus(0) == TextureStreamer::FAILED) {
+				string error = streamer->getError(0);
+				delete streamer;
+				throw std::runtime_error(error);
+			}
+		}
+
+		if (cache) {
+			printf("%s with mips, %u loaded from the texture cache, %u compressed on %d threads\n",
+				BlockCompressor::formatName(options.textureFormat), cache->getHits(), cache->getMisses(), pool.getThreadCount());
+		}
+
+		if (loader == CONTAINER) {
+			TextureContainer container(options.containerImage);
+			printf("%dx%d, %d levels %s from the mapped file\n", container.getWidth(), container.getHeight(),
+				(int)container.getLevels().size(), container.isCompressed() ? "block compressed" : "of pixels");
+		}
+
+		delete streamer;
+		delete cache;
+		for (size_t i = 0; i < textures.size(); i++) delete textures[i];
+		if (!compressed.empty()) gl::DeleteTextures((GLsizei)compressed.size(), &compressed[0]);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Convert a command line argument to a string (arguments are wide when built as Unicode)
+/////////////////////////////////////////////////////////////////////////////////////////////
+string argument(const _TCHAR *arg)
+{
+	string result;
+	for (; *arg; arg++) result += (char)*arg;
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Parse the command line, returns false if it was not understood
+//	--benchmark <warmup frames> <timed frames> <output.csv>
+//	--scene <diffuse|field>
+//	--teapots <count>
+//	--multidraw
+//	--vertex-format <separate|interleaved|compact>
+//	--tessellation-benchmark <output.csv>
+//	--conversion-benchmark <output.csv>
+//	--transform-benchmark <output.csv>
+//	--gpu-tessellation
+//	--lod
+//	--no-culling
+//	--occlusion-culling
+//	--deferred <point lights>
+//	--clustered <point lights>
+//	--light-sweep <output.csv>
+//	--shadows
+//	--no-shader-cache
+//	--software-render <output.ppm> [--golden <reference.ppm>]
+//	--screenshot <output.ppm>
+//	--texture-stream <image> <count>
+//	--texture-format <bc1|bc3|bc7>
+//	--texture-container <image.dds|image.ktx2>
+//	--compression-benchmark <image> <output.csv>
+/////////////////////////////////////////////////////////////////////////////////////////////
+bool parseOptions(int argc, _TCHAR* argv[])
+{
+	options.benchmark = false;
+	options.warmupFrames = 0;
+	options.timedFrames = 0;
+	options.sceneName = "diffuse";
+	options.fieldTeapots = 10000;
+	options.multiDraw = false;
+	options.vertexFormat = VertexFormat::SEPARATE;
+	options.gpuTessellation = false;
+	options.lodLevels = 1;
+	options.culling = true;
+	options.occlusionCulling = false;
+	options.deferredLights = 0;
+	options.clusteredLights = 0;
+	options.shadows = false;
+	options.shaderCache = true;
+	options.streamTextures = 0;
+	options.textureFormat = BlockCompressor::BC7;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argument(argv[i]);
+
+		if (arg == "--benchmark" && i + 3 < argc) {
+			options.benchmark = true;
+			options.warmupFrames = atoi(argument(argv[++i]).c_str());
+			options.timedFrames = atoi(argument(argv[++i]).c_str());
+			options.csvFile = argument(argv[++i]);
+			if (options.warmupFrames < 0 || options.timedFrames <= 0) return false;
+		}
+		else if (arg == "--scene" && i + 1 < argc) {
+			options.sceneName = argument(argv[++i]);
+			if (options.sceneName != "diffuse" && options.sceneName != "field") return false;
+		}
+		else if (arg == "--teapots" && i + 1 < argc) {
+			options.fieldTeapots = atoi(argument(argv[++i]).c_str());
+			if (options.fieldTeapots <= 0) return false;
+		}
+		else if (arg == "--multidraw") {
+			options.multiDraw = true;
+		}
+		else if (arg == "--vertex-format" && i + 1 < argc) {
+			string format = argument(argv[++i]);
+			if (format == "separate") options.vertexFormat = VertexFormat::SEPARATE;
+			else if (format == "interleaved") options.vertexFormat = VertexFormat::INTERLEAVED;
+			else if (format == "compact") options.vertexFormat = VertexFormat::COMPACT;
+			else return false;
+		}
+		else if (arg == "--gpu-tessellation") {
+			options.gpuTessellation = true;
+		}
+		else if (arg == "--lod") {
+			options.lodLevels = 5;	// Grids of 32 down to 2, the finest that still has 16-bit indices.
+		}
+		else if (arg == "--no-culling") {
+			options.culling = false;
+		}
+		else if (arg == "--occlusion-culling") {
+			options.occlusionCulling = true;
+		}
+		else if (arg == "--deferred" && i + 1 < argc) {
+			options.deferredLights = atoi(argument(argv[++i]).c_str());
+			if (options.deferredLights <= 0) return false;
+		}
+		else if (arg == "--clustered" && i + 1 < argc) {
+			options.clusteredLights = atoi(argument(argv[++i]).c_str());
+			if (options.clusteredLights <= 0) return false;
+		}
+		else if (arg == "--shadows") {
+			options.shadows = true;
+		}
+		else if (arg == "--no-shader-cache") {
+			options.shaderCache = false;
+		}
+		else if (arg == "--light-sweep" && i + 1 < argc) {
+			options.lightSweepCsv = argument(argv[++i]);
+		}
+		else if (arg == "--tessellation-benchmark" && i + 1 < argc) {
+			options.tessellationCsv = argument(argv[++i]);
+		}
+		else if (arg == "--conversion-benchmark" && i + 1 < argc) {
+			options.conversionCsv = argument(argv[++i]);
+		}
+		else if (arg == "--transform-benchmark" && i + 1 < argc) {
+			options.transformCsv = argument(argv[++i]);
+		}
+		else if (arg == "--software-render" && i + 1 < argc) {
+			options.softwareImage = argument(argv[++i]);
+		}
+		else if (arg == "--golden" && i + 1 < argc) {
+			options.goldenImage = argument(argv[++i]);
+		}
+		else if (arg == "--screenshot" && i + 1 < argc) {
+			options.screenshotImage = argument(argv[++i]);
+		}
+		else if (arg == "--texture-stream" && i + 2 < argc) {
+			options.streamImage = argument(argv[++i]);
+			options.streamTextures = atoi(argument(argv[++i]).c_str());
+			if (options.streamTextures <= 0) return false;
+		}
+		else if (arg == "--texture-format" && i + 1 < argc) {
+			string format = argument(argv[++i]);
+			if (format == "bc1") options.textureFormat = BlockCompressor::BC1;
+			else if (format == "bc3") options.textureFormat = BlockCompressor::BC3;
+			else if (format == "bc7") options.textureFormat = BlockCompressor::BC7;
+			else return false;
+		}
+		else if (arg == "--texture-container" && i + 1 < argc) {
+			options.containerImage = argument(argv[++i]);
+		}
+		else if (arg == "--compression-benchmark" && i + 2 < argc) {
+			options.compressionImage = argument(argv[++i]);
+			options.compressionCsv = argument(argv[++i]);
+		}
+		else {
+			return false;
+		}
+	}
+	// Golden images are only checked for the software rasterizer, screenshots replace the benchmark.
+	if (!options.goldenImage.empty() && options.softwareImage.empty()) return false;
+	if (!options.screenshotImage.empty() && options.benchmark) return false;
+	if (!options.containerImage.empty() && options.streamImage.empty()) return false;
+	if (!options.streamImage.empty() && (options.benchmark || !options.screenshotImage.empty() || !options.lightSweepCsv.empty())) return false;
+	// Patches cannot be drawn by the same indirect call as triangles, and choose their own detail.
+	if (options.gpuTessellation && (options.multiDraw || options.lodLevels > 1)) return false;
+	// The G-buffer is written with the per-object uniform blocks of the diffuse scene's forward path.
+	if (options.deferredLights > 0 && (options.sceneName != "diffuse" || options.multiDraw || options.gpuTessellation)) return false;
+	// Point lights are only in the diffuse scene, shaded one way at a time. The sweep chooses its own.
+	if (options.clusteredLights > 0 && (options.sceneName != "diffuse" || options.deferredLights > 0)) return false;
+	// The shadow map is drawn with triangles and read by the forward shading only.
+	if (options.shadows && (options.sceneName != "diffuse" || options.gpuTessellation || options.deferredLights > 0)) return false;
+	if (!options.lightSweepCsv.empty() && (options.sceneName != "diffuse" || options.deferredLights > 0 || options.clusteredLights > 0 || options.shadows ||
+		options.benchmark || !options.screenshotImage.empty())) return false;
+	// Occlusion culling is only implemented for the field, and includes the frustum test.
+	return !(options.occlusionCulling && (options.sceneName != "field" || !options.culling));
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 // resize
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -172,34 +998,97 @@ int _tmain(int argc, _TCHAR* argv[])
 
 	string name ="Teapot with Diffuse Lighting";
 
-	// Initialize GLFW
-	if( !glfwInit() ) exit( EXIT_FAILURE );
-
-	// Select OpenGL 4.3 with a forward compatible core profile.
-	glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
-	glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_RESIZABLE, FALSE);
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, TRUE);
-
-	// Open the window
-	string title = "imat2908 - " + name;
-	window = glfwCreateWindow( WIN_WIDTH, WIN_HEIGHT, title.c_str(), NULL, NULL );
-	if( ! window ) {
-		glfwTerminate();
+	if (!parseOptions(argc, argv)) {
+		std::cerr << "Usage: TeapotAD [--benchmark <warmup frames> <timed frames> <output.csv>] [--scene <diffuse|field>] [--teapots <count>] [--multidraw] [--vertex-format <separate|interleaved|compact>] [--tessellation-benchmark <output.csv>] [--conversion-benchmark <output.csv>] [--transform-benchmark <output.csv>] [--gpu-tessellation] [--lod] [--no-culling] [--occlusion-culling] [--deferred <point lights>] [--clustered <point lights>] [--light-sweep <output.csv>] [--shadows] [--no-shader-cache] [--software-render <output.ppm> [--golden <reference.ppm>]] [--screenshot <output.ppm>] [--texture-stream <image> <count> [--texture-format <bc1|bc3|bc7>] [--texture-container <image.dds|image.ktx2>]] [--compression-benchmark <image> <output.csv>]" << std::endl;
 		exit( EXIT_FAILURE );
 	}
-	glfwMakeContextCurrent(window);
+	if (options.sceneName == "field") name = "Instanced Teapot Field";
+
+	// The tessellation benchmark is CPU only, so it runs without a window.
+	if (!options.tessellationCsv.empty()) {
+		try {
+			tessellationBenchmark();
+		}
+		catch (std::runtime_error & e) {
+			std::cerr << e.what() << std::endl;
+			exit( EXIT_FAILURE );
+		}
+		exit( EXIT_SUCCESS );
+	}
+
+	// So are the pixel conversion, transform and compression benchmarks.
+	if (!options.conversionCsv.empty() || !options.transformCsv.empty() || !options.compressionCsv.empty()) {
+		try {
+			if (!options.conversionCsv.empty()) conversionBenchmark();
+			if (!options.transformCsv.empty()) transformBenchmark();
+			if (!options.compressionCsv.empty()) compressionBenchmark();
+		}
+		catch (std::runtime_error & e) {
+			std::cerr << e.what() << std::endl;
+			exit( EXIT_FAILURE );
+		}
+		exit( EXIT_SUCCESS );
+	}
+
+	// And the software rasterizer.
+	if (!options.softwareImage.empty()) {
+		try {
+			softwareRender();
+		}
+		catch (std::runtime_error & e) {
+			std::cerr << e.what() << std::endl;
+			exit( EXIT_FAILURE );
+		}
+		exit( EXIT_SUCCESS );
+	}
+
+	// The benchmarks, the light sweep and screenshots render offscreen, so they need no window, only a context.
+	// Through EGL that works with no display server at all, e.g. with llvmpipe on a build machine.
+	bool offscreen = options.benchmark || !options.screenshotImage.empty() || !options.lightSweepCsv.empty() || !options.streamImage.empty();
+	HeadlessContext *headless = NULL;
+	if (offscreen) {
+		try {
+			headless = new HeadlessContext();
+			gl::sys::SetProcAddressLoader(HeadlessContext::getProcAddress);
+		}
+		catch (std::runtime_error & e) {
+			std::cerr << "No headless context, rendering with a hidden window instead: " << e.what() << std::endl;
+		}
+	}
 
-	//Key callback
-	glfwSetKeyCallback(window,key_callback);
+	if (headless == NULL) {
+		// Initialize GLFW
+		if( !glfwInit() ) exit( EXIT_FAILURE );
 
-	//Mouse callback, not used at the moment
-	//glfwSetMouseButtonCallback(window,mouse_callback);
+		// Select OpenGL 4.3 with a forward compatible core profile.
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_RESIZABLE, FALSE);
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, TRUE);
 
-	//Scroll callback
-	glfwSetScrollCallback(window,scroll_callback);//Set callback
+		// Without EGL the offscreen modes fall back to a window that only provides the context and is never shown.
+		if (offscreen) glfwWindowHint(GLFW_VISIBLE, FALSE);
+
+		// Open the window
+		string title = "imat2908 - " + name;
+		window = glfwCreateWindow( WIN_WIDTH, WIN_HEIGHT, title.c_str(), NULL, NULL );
+		if( ! window ) {
+			glfwTerminate();
+			exit( EXIT_FAILURE );
+		}
+		glfwMakeContextCurrent(window);
+
+		//Key callback
+		glfwSetKeyCallback(window,key_callback);
+
+		//Mouse callback, not used at the moment
+		//glfwSetMouseButtonCallback(window,mouse_callback);
+
+		//Scroll callback
+		glfwSetScrollCallback(window,scroll_callback);//Set callback
+	}
 
 	// Load the OpenGL functions.
 	gl::exts::LoadTest didLoad = gl::sys::LoadFunctions();
@@ -210,19 +1099,41 @@ int _tmain(int argc, _TCHAR* argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	// Initialization
+	// Initialization, with the shader programs from the cache where they are already there
+	if (options.shaderCache) GLSLProgram::setBinaryCacheDirectory("ShaderCache");
+	std::chrono::high_resolution_clock::time_point initStart = std::chrono::high_resolution_clock::now();
 	initializeGL();
+	double initMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - initStart).count();
+	printf("Scene initialised in %.1f ms: %u programs loaded from the shader cache, %u compiled, %u cached binaries rejected\n",
+		initMs, GLSLProgram::getBinariesLoaded(), GLSLProgram::getProgramsCompiled(), GLSLProgram::getBinariesRejected());
 
 	resizeGL(camera,WIN_WIDTH,WIN_HEIGHT);
 
-	// Enter the main loop
-	mainLoop();
+	// Enter the main loop, or run a benchmark, the light sweep or take a screenshot instead
+	if (offscreen) {
+		try {
+			if (options.benchmark) benchmarkLoop();
+			else if (!options.lightSweepCsv.empty()) lightSweep();
+			else if (!options.streamImage.empty()) textureStreamBenchmark();
+			else screenshot();
+		}
+		catch (std::runtime_error & e) {
+			std::cerr << e.what() << std::endl;
+			glfwTerminate();
+			exit( EXIT_FAILURE );
+		}
+	}
+	else {
+		mainLoop();
+	}
+
+	// The scene's GL objects go while the context is still current.
+	delete scene;
+	delete headless;
 
 	// Close window and terminate GLFW
 	glfwTerminate();
 
-	delete scene;
-
 	// Exit program
 	exit( EXIT_SUCCESS );
 }
@@ -54,6 +54,13 @@ Texture::Texture(const Bitmap& bitmap, GLint minMagFiler, GLint wrapMode) :
     gl::BindTexture(gl::TEXTURE_2D, 0);
 }
 
+Texture::Texture(const TextureContainer& container) :
+    _object(container.createTexture()),
+    _originalWidth((GLfloat)container.getWidth()),
+    _originalHeight((GLfloat)container.getHeight())
+{
+}
+
 Texture::~Texture()
 {
     gl::DeleteTextures(1, &_object);
@@ -20,6 +20,7 @@
 
 #include "gl_core_4_3.hpp"
 #include "Bitmap.h"
+#include "texturecontainer.h"
 
 
     
@@ -43,6 +44,17 @@
                 GLint minMagFiler = gl::LINEAR,
                 GLint wrapMode = gl::CLAMP_TO_EDGE);
         
+        /**
+         Creates a texture from every level stored in a DDS or KTX2 file,
+         uploaded straight from the mapped file.
+         
+         Like a bitmap, the file holds the top row first, so the texture is
+         upside down too.
+         
+         @param container  The mapped file to load the texture from
+         */
+        explicit Texture(const TextureContainer& container);
+        
         /**
          Deletes the texture object with glDeleteTextures
          */
@@ -0,0 +1,157 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Nearest-rank percentile of an already sorted sample, p in [0,100]: the smallest value
+// that at least p percent of the sample is less than or equal to.
+/////////////////////////////////////////////////////////////////////////////////////////////
+static double percentile(const std::vector<double> & sorted, double p)
+{
+    if( sorted.empty() ) return 0.0;
+
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+static double mean(const std::vector<double> & values)
+{
+    if( values.empty() ) return 0.0;
+
+    double sum = 0.0;
+    for( size_t i = 0; i < values.size(); i++ )
+        sum += values[i];
+    return sum / values.size();
+}
+
+FrameBenchmark::FrameBenchmark(int warmup, int timed) :
+    warmupFrames(warmup), timedFrames(timed), frame(0)
+{
+    if( warmupFrames < 0 || timedFrames <= 0 )
+        throw std::runtime_error("Benchmark needs a positive number of timed frames");
+
+    queries.resize(timedFrames);
+    gl::GenQueries(timedFrames, &queries[0]);
+    cpuTimes.reserve(timedFrames);
+}
+
+FrameBenchmark::~FrameBenchmark()
+{
+    gl::DeleteQueries((GLsizei)queries.size(), &queries[0]);
+}
+
+void FrameBenchmark::beginFrame()
+{
+    if( frame >= warmupFrames )
+        gl::BeginQuery(gl::TIME_ELAPSED, queries[frame - warmupFrames]);
+
+    frameStart = Clock::now();
+}
+
+void FrameBenchmark::endFrame()
+{
+    Clock::time_point frameEnd = Clock::now();
+
+    if( frame >= warmupFrames ) {
+        gl::EndQuery(gl::TIME_ELAPSED);
+        cpuTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+    }
+
+    frame++;
+}
+
+void FrameBenchmark::recordCounters(const std::map<std::string, double> & counters)
+{
+    // Only timed frames are recorded, and endFrame() has already moved past this one
+    int timedFrame = frame - 1 - warmupFrames;
+    if( timedFrame < 0 ) return;
+
+    std::map<std::string, double>::const_iterator it;
+    for( it = counters.begin(); it != counters.end(); ++it ) {
+        size_t column = std::find(counterNames.begin(), counterNames.end(), it->first) - counterNames.begin();
+        if( column == counterNames.size() ) {
+            counterNames.push_back(it->first);
+            counterValues.push_back(std::vector<double>(timedFrames, 0.0));
+        }
+        counterValues[column][timedFrame] = it->second;
+    }
+}
+
+bool FrameBenchmark::isFinished() const
+{
+    return frame >= totalFrames();
+}
+
+int FrameBenchmark::frameNumber() const
+{
+    return frame;
+}
+
+int FrameBenchmark::totalFrames() const
+{
+    return warmupFrames + timedFrames;
+}
+
+std::vector<double> FrameBenchmark::resolveGpuTimes()
+{
+    // Blocks until the GPU has finished the last timed frame
+    std::vector<double> gpuTimes(cpuTimes.size());
+    for( size_t i = 0; i < cpuTimes.size(); i++ ) {
+        GLuint64 elapsed = 0;
+        gl::GetQueryObjectui64v(queries[i], gl::QUERY_RESULT, &elapsed);
+        gpuTimes[i] = elapsed / 1.0e6;
+    }
+    return gpuTimes;
+}
+
+void FrameBenchmark::writeCSV(const std::string & fileName)
+{
+    std::vector<double> gpuTimes = resolveGpuTimes();
+
+    std::ofstream out(fileName.c_str());
+    if( !out )
+        throw std::runtime_error("Unable to open benchmark output: " + fileName);
+
+    out << "frame,cpu_submit_ms,gpu_ms";
+    for( size_t c = 0; c < counterNames.size(); c++ )
+        out << "," << counterNames[c];
+    out << "\n";
+
+    for( size_t i = 0; i < cpuTimes.size(); i++ ) {
+        out << i << "," << cpuTimes[i] << "," << gpuTimes[i];
+        for( size_t c = 0; c < counterNames.size(); c++ )
+            out << "," << counterValues[c][i];
+        out << "\n";
+    }
+
+    std::vector<double> cpuSorted(cpuTimes), gpuSorted(gpuTimes);
+    std::sort(cpuSorted.begin(), cpuSorted.end());
+    std::sort(gpuSorted.begin(), gpuSorted.end());
+
+    const char * names[] = { "min", "p50", "p90", "p95", "p99", "max" };
+    const double ranks[] = { 0.0, 50.0, 90.0, 95.0, 99.0, 100.0 };
+
+    out << "\nstatistic,cpu_submit_ms,gpu_ms\n";
+    out << "mean," << mean(cpuTimes) << "," << mean(gpuTimes) << "\n";
+    printf("Benchmark: %d timed frames (%d warm-up)\n", timedFrames, warmupFrames);
+    printf("  mean  CPU %8.3f ms  GPU %8.3f ms\n", mean(cpuTimes), mean(gpuTimes));
+    for( int i = 0; i < 6; i++ ) {
+        double cpu = percentile(cpuSorted, ranks[i]);
+        double gpu = percentile(gpuSorted, ranks[i]);
+        out << names[i] << "," << cpu << "," << gpu << "\n";
+        printf("  %-5s CPU %8.3f ms  GPU %8.3f ms\n", names[i], cpu, gpu);
+    }
+
+    for( size_t c = 0; c < counterNames.size(); c++ )
+        printf("  mean %s: %.1f\n", counterNames[c].c_str(), mean(counterValues[c]));
+}
+
+void FrameBenchmark::meanTimes(double & cpuMs, double & gpuMs)
+{
+    cpuMs = mean(cpuTimes);
+    gpuMs = mean(resolveGpuTimes());
+}
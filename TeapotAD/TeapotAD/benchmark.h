@@ -0,0 +1,65 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "gl_core_4_3.hpp"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ Times a fixed number of rendered frames.
+
+ The first warmupFrames are rendered but not recorded. For every timed frame
+ the CPU time spent submitting it (between beginFrame() and endFrame()) is
+ measured with a high resolution clock, and the GPU time with a TIME_ELAPSED
+ query. Query results are only read back in writeCSV(), so timing never
+ stalls the pipeline.
+ */
+class FrameBenchmark
+{
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    int warmupFrames;
+    int timedFrames;
+    int frame;                      // Frames completed so far, including warm-up
+
+    std::vector<GLuint> queries;    // One TIME_ELAPSED query per timed frame
+    std::vector<double> cpuTimes;   // Submit time of each timed frame in ms
+    Clock::time_point frameStart;
+
+    std::vector<std::string> counterNames;            // Columns, in the order first seen
+    std::vector< std::vector<double> > counterValues; // Per timed frame, one per column
+
+    // Waits for the GPU to finish the timed frames and returns their times in ms
+    std::vector<double> resolveGpuTimes();
+
+    // Non-copyable, the query objects are owned by this instance
+    FrameBenchmark( const FrameBenchmark & ) { }
+    FrameBenchmark & operator=( const FrameBenchmark & ) { return *this; }
+
+public:
+    FrameBenchmark(int warmupFrames, int timedFrames);
+    ~FrameBenchmark();
+
+    void beginFrame();
+    void endFrame();
+
+    // Records scene statistics for the frame that has just ended. Written
+    // as extra columns, frames that did not report a counter get 0.
+    void recordCounters(const std::map<std::string, double> & counters);
+
+    bool isFinished() const;
+    int  frameNumber() const;       // Index of the current frame, from 0
+    int  totalFrames() const;       // Warm-up plus timed frames
+
+    // Writes one row per timed frame followed by a percentile summary.
+    void writeCSV(const std::string & fileName);
+
+    // Mean CPU submit and GPU time of the timed frames, for runs summarised elsewhere.
+    void meanTimes(double & cpuMs, double & gpuMs);
+};
+
+#endif // BENCHMARK_H
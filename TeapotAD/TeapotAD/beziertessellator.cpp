@@ -0,0 +1,281 @@
+#include "beziertessellator.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC accepts AVX intrinsics in any function, other compilers only when building for AVX.
+#if defined(_MSC_VER) || defined(__AVX__)
+#define BEZIER_AVX_KERNEL
+#endif
+
+namespace
+{
+    // Arithmetic on one grid point at a time
+    struct ScalarLanes {
+        typedef float Value;
+        enum { WIDTH = 1 };
+        static Value set(float x) { return x; }
+        static Value load(const float * p) { return *p; }
+        static void store(float * p, Value v) { *p = v; }
+        static Value add(Value a, Value b) { return a + b; }
+        static Value sub(Value a, Value b) { return a - b; }
+        static Value mul(Value a, Value b) { return a * b; }
+        static Value div(Value a, Value b) { return a / b; }
+        static Value sqrt(Value a) { return std::sqrt(a); }
+    };
+
+    // Four grid points per instruction
+    struct SseLanes {
+        typedef __m128 Value;
+        enum { WIDTH = 4 };
+        static Value set(float x) { return _mm_set1_ps(x); }
+        static Value load(const float * p) { return _mm_loadu_ps(p); }
+        static void store(float * p, Value v) { _mm_storeu_ps(p, v); }
+        static Value add(Value a, Value b) { return _mm_add_ps(a, b); }
+        static Value sub(Value a, Value b) { return _mm_sub_ps(a, b); }
+        static Value mul(Value a, Value b) { return _mm_mul_ps(a, b); }
+        static Value div(Value a, Value b) { return _mm_div_ps(a, b); }
+        static Value sqrt(Value a) { return _mm_sqrt_ps(a); }
+    };
+
+#ifdef BEZIER_AVX_KERNEL
+    // Eight grid points per instruction
+    struct AvxLanes {
+        typedef __m256 Value;
+        enum { WIDTH = 8 };
+        static Value set(float x) { return _mm256_set1_ps(x); }
+        static Value load(const float * p) { return _mm256_loadu_ps(p); }
+        static void store(float * p, Value v) { _mm256_storeu_ps(p, v); }
+        static Value add(Value a, Value b) { return _mm256_add_ps(a, b); }
+        static Value sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+        static Value mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+        static Value div(Value a, Value b) { return _mm256_div_ps(a, b); }
+        static Value sqrt(Value a) { return _mm256_sqrt_ps(a); }
+    };
+#endif
+
+    // Rows of a row's results, each stride floats long
+    enum { PX, PY, PZ, NX, NY, NZ, ROW_ARRAYS };
+
+    // Blends the four points q (and their u derivatives dq) along v for count grid points,
+    // writing the positions and unit normals of the row to out.
+    template <class Lanes>
+    void evaluateRow(const float q[4][3], const float dq[4][3], const float * B, const float * dB, int stride, int count, float * out)
+    {
+        typedef typename Lanes::Value Value;
+
+        Value qv[4][3], dqv[4][3];
+        for (int b = 0; b < 4; b++) {
+            for (int c = 0; c < 3; c++) {
+                qv[b][c] = Lanes::set(q[b][c]);
+                dqv[b][c] = Lanes::set(dq[b][c]);
+            }
+        }
+
+        for (int j = 0; j < count; j += Lanes::WIDTH) {
+            Value p[3], du[3], dv[3];
+            for (int c = 0; c < 3; c++) {
+                p[c] = du[c] = dv[c] = Lanes::set(0.0f);
+            }
+
+            for (int b = 0; b < 4; b++) {
+                Value basis = Lanes::load(B + b * stride + j);
+                Value slope = Lanes::load(dB + b * stride + j);
+                for (int c = 0; c < 3; c++) {
+                    p[c] = Lanes::add(p[c], Lanes::mul(qv[b][c], basis));
+                    du[c] = Lanes::add(du[c], Lanes::mul(dqv[b][c], basis));
+                    dv[c] = Lanes::add(dv[c], Lanes::mul(qv[b][c], slope));
+                }
+            }
+
+            // The normal is the normalised cross product of the two tangents.
+            Value nx = Lanes::sub(Lanes::mul(du[1], dv[2]), Lanes::mul(du[2], dv[1]));
+            Value ny = Lanes::sub(Lanes::mul(du[2], dv[0]), Lanes::mul(du[0], dv[2]));
+            Value nz = Lanes::sub(Lanes::mul(du[0], dv[1]), Lanes::mul(du[1], dv[0]));
+            Value length = Lanes::sqrt(Lanes::add(Lanes::add(Lanes::mul(nx, nx), Lanes::mul(ny, ny)), Lanes::mul(nz, nz)));
+
+            Lanes::store(out + PX * stride + j, p[0]);
+            Lanes::store(out + PY * stride + j, p[1]);
+            Lanes::store(out + PZ * stride + j, p[2]);
+            Lanes::store(out + NX * stride + j, Lanes::div(nx, length));
+            Lanes::store(out + NY * stride + j, Lanes::div(ny, length));
+            Lanes::store(out + NZ * stride + j, Lanes::div(nz, length));
+        }
+    }
+}
+
+BezierTessellator::BezierTessellator(int grid, ThreadPool * pool, Kernel kernel) : grid(grid), pool(pool), kernel(kernel)
+{
+    if (grid < 1)
+        throw std::runtime_error("Bezier tessellation grid must have at least one quad per side");
+
+#ifndef BEZIER_AVX_KERNEL
+    if (this->kernel == AVX) this->kernel = SSE;
+#endif
+
+    // Pad the rows so the vector kernels never need a scalar tail; the padding is evaluated
+    // along with the real points and thrown away.
+    stride = (grid + 1 + 7) / 8 * 8;
+    basis.assign(4 * stride, 0.0f);
+    derivative.assign(4 * stride, 0.0f);
+
+    float inc = 1.0f / grid;
+    for (int i = 0; i <= grid; i++)
+    {
+        float t = i * inc;
+        float tSqr = t * t;
+        float oneMinusT = (1.0f - t);
+        float oneMinusT2 = oneMinusT * oneMinusT;
+
+        basis[0 * stride + i] = oneMinusT * oneMinusT2;
+        basis[1 * stride + i] = 3.0f * oneMinusT2 * t;
+        basis[2 * stride + i] = 3.0f * oneMinusT * tSqr;
+        basis[3 * stride + i] = t * tSqr;
+
+        derivative[0 * stride + i] = -3.0f * oneMinusT2;
+        derivative[1 * stride + i] = -6.0f * t * oneMinusT + 3.0f * oneMinusT2;
+        derivative[2 * stride + i] = -3.0f * tSqr + 6.0f * t * oneMinusT;
+        derivative[3 * stride + i] = 3.0f * tSqr;
+    }
+}
+
+void BezierTessellator::tessellate(const std::vector<Patch> & patches, MeshData & mesh) const
+{
+    unsigned int slots = 0;
+    for (size_t p = 0; p < patches.size(); p++)
+        for (size_t c = 0; c < patches[p].copies.size(); c++)
+            slots = glm::max(slots, patches[p].copies[c].slot + 1);
+
+    // Sized up front, the patches then write to disjoint parts of the mesh.
+    mesh.resize(slots * (grid + 1) * (grid + 1), slots * grid * grid * 2);
+
+    if (pool != NULL) {
+        pool->parallelFor((int)patches.size(), [&](int p) { tessellatePatch(patches[p], mesh); });
+    } else {
+        for (size_t p = 0; p < patches.size(); p++)
+            tessellatePatch(patches[p], mesh);
+    }
+}
+
+void BezierTessellator::tessellatePatch(const Patch & patch, MeshData & mesh) const
+{
+    int points = grid + 1;
+    float tcFactor = 1.0f / grid;
+    std::vector<float> row(ROW_ARRAYS * stride);
+
+    for (int i = 0; i <= grid; i++)
+    {
+        // Reduce the control points along u to four points along v for this row.
+        float q[4][3], dq[4][3];
+        for (int b = 0; b < 4; b++) {
+            for (int c = 0; c < 3; c++) {
+                q[b][c] = dq[b][c] = 0.0f;
+                for (int a = 0; a < 4; a++) {
+                    q[b][c] += basis[a * stride + i] * patch.controlPoints[a][b][c];
+                    dq[b][c] += derivative[a * stride + i] * patch.controlPoints[a][b][c];
+                }
+            }
+        }
+
+        switch (kernel) {
+#ifdef BEZIER_AVX_KERNEL
+        case AVX:
+            evaluateRow<AvxLanes>(q, dq, &basis[0], &derivative[0], stride, points, &row[0]);
+            break;
+#endif
+        case SSE:
+            evaluateRow<SseLanes>(q, dq, &basis[0], &derivative[0], stride, points, &row[0]);
+            break;
+        default:
+            evaluateRow<ScalarLanes>(q, dq, &basis[0], &derivative[0], stride, points, &row[0]);
+            break;
+        }
+
+        // Write the row out once for every copy of the patch.
+        for (size_t c = 0; c < patch.copies.size(); c++)
+        {
+            const Copy & copy = patch.copies[c];
+            float normalSign = copy.invertNormal ? -1.0f : 1.0f;
+            unsigned int vertex = copy.slot * points * points + i * points;
+
+            for (int j = 0; j < points; j++, vertex++)
+            {
+                float * v = &mesh.positions[3 * vertex];
+                float * n = &mesh.normals[3 * vertex];
+                float * tc = &mesh.texCoords[2 * vertex];
+
+                v[0] = copy.scale.x * row[PX * stride + j];
+                v[1] = copy.scale.y * row[PY * stride + j];
+                v[2] = copy.scale.z * row[PZ * stride + j];
+
+                n[0] = normalSign * copy.scale.x * row[NX * stride + j];
+                n[1] = normalSign * copy.scale.y * row[NY * stride + j];
+                n[2] = normalSign * copy.scale.z * row[NZ * stride + j];
+
+                tc[0] = i * tcFactor;
+                tc[1] = j * tcFactor;
+            }
+        }
+    }
+
+    // Two triangles per quad, wound the same way for every copy.
+    for (size_t c = 0; c < patch.copies.size(); c++)
+    {
+        unsigned int startIndex = patch.copies[c].slot * points * points;
+        unsigned int * el = &mesh.indices[patch.copies[c].slot * grid * grid * 6];
+
+        for (int i = 0; i < grid; i++)
+        {
+            unsigned int iStart = i * points + startIndex;
+            unsigned int nextiStart = (i + 1) * points + startIndex;
+            for (int j = 0; j < grid; j++)
+            {
+                el[0] = iStart + j;
+                el[1] = nextiStart + j + 1;
+                el[2] = nextiStart + j;
+
+                el[3] = iStart + j;
+                el[4] = iStart + j + 1;
+                el[5] = nextiStart + j + 1;
+
+                el += 6;
+            }
+        }
+    }
+}
+
+BezierTessellator::Kernel BezierTessellator::getKernel() const
+{
+    return kernel;
+}
+
+BezierTessellator::Kernel BezierTessellator::bestKernel()
+{
+#if defined(_MSC_VER)
+    // AVX needs the CPU to support it and the OS to save the YMM registers.
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+        return AVX;
+#elif defined(BEZIER_AVX_KERNEL)
+    return AVX;
+#endif
+    return SSE;
+}
+
+const char * BezierTessellator::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case AVX: return "avx";
+    case SSE: return "sse";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef BEZIERTESSELLATOR_H
+#define BEZIERTESSELLATOR_H
+
+#include "meshdata.h"
+#include "threadpool.h"
+
+#include <glm.hpp>
+#include <vector>
+
+/**
+ Evaluates bicubic Bezier patches on a regular grid into a MeshData.
+
+ A patch is evaluated as the tensor product B(u)^T C B(v): for every row u
+ the control points are first reduced to four points along v, which are
+ then blended for a whole row of grid points at once, 4 (SSE) or 8 (AVX)
+ points per instruction. Each patch is evaluated once however many
+ reflected copies of it the mesh needs, and patches are spread over a
+ ThreadPool.
+ */
+class BezierTessellator
+{
+public:
+    enum Kernel {
+        SCALAR,
+        SSE,
+        AVX
+    };
+
+    // One copy of a patch in the mesh, scaled (reflected) component-wise.
+    struct Copy {
+        glm::vec3 scale;        // Applied to positions and normals, each component +1 or -1
+        bool invertNormal;      // Negate the normal after scaling
+        unsigned int slot;      // Position of the copy's vertices and triangles in the mesh
+    };
+
+    struct Patch {
+        glm::vec3 controlPoints[4][4];  // [u][v]
+        std::vector<Copy> copies;
+    };
+
+private:
+    int grid;           // Quads along each side of a patch
+    ThreadPool * pool;  // NULL to evaluate on the calling thread
+    Kernel kernel;
+
+    std::vector<float> basis;       // Bernstein basis at each grid point, 4 rows of stride floats
+    std::vector<float> derivative;  // Its derivative, laid out the same
+    int stride;                     // Grid points per row rounded up to a whole AVX register
+
+    void tessellatePatch(const Patch & patch, MeshData & mesh) const;
+
+public:
+    BezierTessellator(int grid, ThreadPool * pool = NULL, Kernel kernel = bestKernel());
+
+    // Resizes mesh to hold every copy of every patch and fills it.
+    void tessellate(const std::vector<Patch> & patches, MeshData & mesh) const;
+
+    Kernel getKernel() const;
+
+    static Kernel bestKernel();     // The widest kernel this CPU supports
+    static const char * kernelName(Kernel kernel);
+};
+
+#endif // BEZIERTESSELLATOR_H
@@ -0,0 +1,393 @@
+#include "blockcompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    // Mean of the pixels and the direction they vary along most, in the first
+    // channels of each. Power iteration on the covariance from the diagonal
+    // converges within a few steps for the 16 pixels of a block.
+    template <int C>
+    void principalAxis(const unsigned char * pixels, float mean[C], float axis[C])
+    {
+        for (int c = 0; c < C; c++) mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < C; c++) mean[c] += pixels[i * 4 + c];
+        for (int c = 0; c < C; c++) mean[c] /= 16.0f;
+
+        float covariance[C][C] = {};
+        for (int i = 0; i < 16; i++) {
+            float d[C];
+            for (int c = 0; c < C; c++) d[c] = pixels[i * 4 + c] - mean[c];
+            for (int r = 0; r < C; r++)
+                for (int c = 0; c < C; c++) covariance[r][c] += d[r] * d[c];
+        }
+
+        for (int c = 0; c < C; c++) axis[c] = 1.0f;
+        for (int step = 0; step < 8; step++) {
+            float next[C] = {};
+            float largest = 0.0f;
+            for (int r = 0; r < C; r++) {
+                for (int c = 0; c < C; c++) next[r] += covariance[r][c] * axis[c];
+                largest = std::max(largest, std::abs(next[r]));
+            }
+            if (largest == 0.0f) break;     // All the pixels are the same
+            for (int c = 0; c < C; c++) axis[c] = next[c] / largest;
+        }
+    }
+
+    // The pixels furthest along the axis either way, as points on the line through the mean
+    template <int C>
+    void axisEnds(const unsigned char * pixels, const float mean[C], const float axis[C], float low[C], float high[C])
+    {
+        float length = 0.0f;
+        for (int c = 0; c < C; c++) length += axis[c] * axis[c];
+
+        float lowest = 0.0f, highest = 0.0f;
+        if (length > 0.0f) {
+            for (int i = 0; i < 16; i++) {
+                float t = 0.0f;
+                for (int c = 0; c < C; c++) t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+                lowest = std::min(lowest, t);
+                highest = std::max(highest, t);
+            }
+            lowest /= length;
+            highest /= length;
+        }
+        for (int c = 0; c < C; c++) {
+            low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lowest));
+            high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * highest));
+        }
+    }
+
+    int quantize(float value, int bits)
+    {
+        int levels = (1 << bits) - 1;
+        return std::min(levels, std::max(0, (int)(value * levels / 255.0f + 0.5f)));
+    }
+
+    unsigned short pack565(const float color[3])
+    {
+        return (unsigned short)((quantize(color[0], 5) << 11) | (quantize(color[1], 6) << 5) | quantize(color[2], 5));
+    }
+
+    void unpack565(unsigned short packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Picks the nearest of the 4 colours for every pixel and returns the squared error
+    int colorIndices(const unsigned char * pixels, unsigned short c0, unsigned short c1, unsigned int & indices)
+    {
+        int palette[4][3];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        int error = 0;
+        indices = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 0x7FFFFFFF;
+            for (int p = 0; p < 4; p++) {
+                int e = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = pixels[i * 4 + c] - palette[p][c];
+                    e += d * d;
+                }
+                if (e < bestError) {
+                    bestError = e;
+                    best = p;
+                }
+            }
+            indices |= (unsigned int)best << (2 * i);
+            error += bestError;
+        }
+        return error;
+    }
+
+    // Endpoints that fit the pixels best in least squares for the indices they were given
+    bool refineColors(const unsigned char * pixels, unsigned int indices, float first[3], float second[3])
+    {
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {}, bx[3] = {};
+        for (int i = 0; i < 16; i++) {
+            float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * pixels[i * 4 + c];
+                bx[c] += b * pixels[i * 4 + c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) return false;
+        for (int c = 0; c < 3; c++) {
+            first[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+            second[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+        }
+        return true;
+    }
+
+    // Four colour mode needs the first endpoint larger; equal endpoints make every index 0
+    unsigned int orderColors(unsigned short & c0, unsigned short & c1, unsigned int indices)
+    {
+        if (c0 == c1) return 0;
+        if (c0 > c1) return indices;
+        std::swap(c0, c1);
+        return indices ^ 0x55555555;    // 0 and 1 swap, as do 2 and 3
+    }
+
+    void compressColor(const unsigned char * pixels, unsigned char * block)
+    {
+        float mean[3], axis[3], low[3], high[3];
+        principalAxis<3>(pixels, mean, axis);
+        axisEnds<3>(pixels, mean, axis, low, high);
+
+        unsigned short c0 = pack565(high), c1 = pack565(low);
+        unsigned int indices;
+        int error = colorIndices(pixels, c0, c1, indices);
+
+        float first[3], second[3];
+        if (error > 0 && refineColors(pixels, indices, first, second)) {
+            unsigned short r0 = pack565(first), r1 = pack565(second);
+            unsigned int refined;
+            if (colorIndices(pixels, r0, r1, refined) < error) {
+                c0 = r0;
+                c1 = r1;
+                indices = refined;
+            }
+        }
+
+        indices = orderColors(c0, c1, indices);
+        block[0] = (unsigned char)(c0 & 0xFF);
+        block[1] = (unsigned char)(c0 >> 8);
+        block[2] = (unsigned char)(c1 & 0xFF);
+        block[3] = (unsigned char)(c1 >> 8);
+        for (int i = 0; i < 4; i++) block[4 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    // BC3's alpha block, 8 values between the largest and smallest alpha
+    void compressAlpha(const unsigned char * pixels, unsigned char * block)
+    {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; i++) {
+            a0 = std::max(a0, (int)pixels[i * 4 + 3]);
+            a1 = std::min(a1, (int)pixels[i * 4 + 3]);
+        }
+
+        int palette[8] = { a0, a1 };
+        for (int k = 1; k < 7; k++) palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+
+        unsigned long long indices = 0;
+        if (a0 > a1) {
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestError = 256;
+                for (int p = 0; p < 8; p++) {
+                    int e = std::abs(pixels[i * 4 + 3] - palette[p]);
+                    if (e < bestError) {
+                        bestError = e;
+                        best = p;
+                    }
+                }
+                indices |= (unsigned long long)best << (3 * i);
+            }
+        }
+
+        block[0] = (unsigned char)a0;
+        block[1] = (unsigned char)a1;
+        for (int i = 0; i < 6; i++) block[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    // Bits written from the least significant of the first byte up, as BC7 lays them out
+    struct BitWriter {
+        unsigned char * block;
+        int position;
+
+        void write(unsigned int value, int bits)
+        {
+            for (int i = 0; i < bits; i++, position++)
+                if ((value >> i) & 1) block[position >> 3] |= (unsigned char)(1 << (position & 7));
+        }
+    };
+
+    // BC7 mode 6: RGBA endpoints of 7 bits plus a low bit shared by each endpoint's channels
+    void compressBc7(const unsigned char * pixels, unsigned char * block)
+    {
+        static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        float mean[4], axis[4], low[4], high[4];
+        principalAxis<4>(pixels, mean, axis);
+        axisEnds<4>(pixels, mean, axis, low, high);
+
+        int bestError = 0x7FFFFFFF;
+        int endpoints[2][4] = {}, bits[2] = {};
+        unsigned char indices[16] = {};
+        for (int pbits = 0; pbits < 4; pbits++) {
+            int p[2] = { pbits & 1, pbits >> 1 };
+            int e[2][4];
+            for (int c = 0; c < 4; c++) {
+                e[0][c] = std::min(127, std::max(0, (int)((low[c] - p[0]) / 2.0f + 0.5f))) << 1 | p[0];
+                e[1][c] = std::min(127, std::max(0, (int)((high[c] - p[1]) / 2.0f + 0.5f))) << 1 | p[1];
+            }
+
+            int palette[16][4];
+            for (int k = 0; k < 16; k++)
+                for (int c = 0; c < 4; c++)
+                    palette[k][c] = ((64 - weights[k]) * e[0][c] + weights[k] * e[1][c] + 32) >> 6;
+
+            // The weights are close to k / 15, so projecting onto the endpoints finds
+            // the nearest palette entry to within one either side
+            int span[4], spanLength = 0;
+            for (int c = 0; c < 4; c++) {
+                span[c] = e[1][c] - e[0][c];
+                spanLength += span[c] * span[c];
+            }
+
+            int error = 0;
+            unsigned char chosen[16];
+            for (int i = 0; i < 16 && error < bestError; i++) {
+                int guess = 0;
+                if (spanLength > 0) {
+                    int dot = 0;
+                    for (int c = 0; c < 4; c++) dot += (pixels[i * 4 + c] - e[0][c]) * span[c];
+                    guess = std::min(15, std::max(0, (int)(15.0f * dot / spanLength + 0.5f)));
+                }
+
+                int best = 0, nearest = 0x7FFFFFFF;
+                for (int k = std::max(0, guess - 1); k <= std::min(15, guess + 1); k++) {
+                    int d = 0;
+                    for (int c = 0; c < 4; c++) {
+                        int diff = pixels[i * 4 + c] - palette[k][c];
+                        d += diff * diff;
+                    }
+                    if (d < nearest) {
+                        nearest = d;
+                        best = k;
+                    }
+                }
+                chosen[i] = (unsigned char)best;
+                error += nearest;
+            }
+
+            if (error < bestError) {
+                bestError = error;
+                memcpy(endpoints, e, sizeof(e));
+                bits[0] = p[0];
+                bits[1] = p[1];
+                memcpy(indices, chosen, sizeof(chosen));
+            }
+        }
+
+        // The first pixel's index is stored without its top bit, so it must be below 8
+        if (indices[0] & 8) {
+            for (int c = 0; c < 4; c++) std::swap(endpoints[0][c], endpoints[1][c]);
+            std::swap(bits[0], bits[1]);
+            for (int i = 0; i < 16; i++) indices[i] = (unsigned char)(15 - indices[i]);
+        }
+
+        memset(block, 0, 16);
+        BitWriter writer = { block, 0 };
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.write(endpoints[0][c] >> 1, 7);
+            writer.write(endpoints[1][c] >> 1, 7);
+        }
+        writer.write(bits[0], 1);
+        writer.write(bits[1], 1);
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; i++) writer.write(indices[i], 4);
+    }
+
+    // Copies the block at (x, y) in blocks, repeating the last row and column past the edge
+    void readBlock(const unsigned char * rgba, int width, int height, int x, int y, unsigned char * pixels)
+    {
+        for (int row = 0; row < 4; row++) {
+            int sy = std::min(y * 4 + row, height - 1);
+            for (int col = 0; col < 4; col++) {
+                int sx = std::min(x * 4 + col, width - 1);
+                memcpy(pixels + (row * 4 + col) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+            }
+        }
+    }
+}
+
+BlockCompressor::BlockCompressor(ThreadPool * pool) : pool(pool)
+{
+}
+
+void BlockCompressor::compress(Format format, const unsigned char * rgba, int width, int height, unsigned char * dest) const
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Cannot compress an empty image");
+
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    int bytes = blockBytes(format);
+
+    auto rows = [&](int first, int last) {
+        unsigned char pixels[64];
+        for (int y = first; y < last; y++) {
+            unsigned char * block = dest + (size_t)y * blocksWide * bytes;
+            for (int x = 0; x < blocksWide; x++, block += bytes) {
+                readBlock(rgba, width, height, x, y, pixels);
+                compressBlock(format, pixels, block);
+            }
+        }
+    };
+
+    if (!pool || blocksHigh < 2) {
+        rows(0, blocksHigh);
+        return;
+    }
+
+    int bands = std::min(blocksHigh, pool->getThreadCount() * 4);
+    pool->parallelFor(bands, [&](int band) {
+        rows((int)((long long)blocksHigh * band / bands), (int)((long long)blocksHigh * (band + 1) / bands));
+    });
+}
+
+void BlockCompressor::compressBlock(Format format, const unsigned char * pixels, unsigned char * block)
+{
+    switch (format) {
+    case BC1:
+        compressColor(pixels, block);
+        break;
+    case BC3:
+        compressAlpha(pixels, block);
+        compressColor(pixels, block + 8);
+        break;
+    default:
+        compressBc7(pixels, block);
+        break;
+    }
+}
+
+int BlockCompressor::blockBytes(Format format)
+{
+    return format == BC1 ? 8 : 16;
+}
+
+size_t BlockCompressor::compressedSize(Format format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+const char * BlockCompressor::formatName(Format format)
+{
+    switch (format) {
+    case BC1: return "bc1";
+    case BC3: return "bc3";
+    default: return "bc7";
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#include "threadpool.h"
+
+#include <cstddef>
+
+/**
+ Compresses RGBA8 images into the 4x4 pixel blocks GL samples directly.
+
+ BC1 keeps 2 colour endpoints in 5:6:5 bits and a 2-bit index per pixel
+ choosing one of 4 colours between them, 8 bytes a block, with no alpha.
+ BC3 adds a block of 8 alpha values between 2 endpoints with 3-bit indices,
+ 16 bytes a block. BC7 is written in its mode 6, one pair of 7-bit RGBA
+ endpoints each with a shared low bit and 16 colours between them, 16
+ bytes a block and much closer to the source than BC1 and BC3.
+
+ Endpoints start from the ends of the pixels' principal axis; BC1 colour
+ is then refined by least squares, and BC7 tries each pair of low bits.
+ Pixels take the nearest colour. Blocks past the edge of an image that is
+ not a multiple of 4 repeat its last row and column. Images can be split
+ into bands of block rows over a ThreadPool, giving the same bytes.
+ */
+class BlockCompressor
+{
+public:
+    enum Format {
+        BC1,
+        BC3,
+        BC7
+    };
+
+private:
+    ThreadPool * pool;  // NULL to compress on the calling thread
+
+public:
+    BlockCompressor(ThreadPool * pool = NULL);
+
+    // Compresses a width x height image into dest, which holds compressedSize(format, width, height) bytes.
+    void compress(Format format, const unsigned char * rgba, int width, int height, unsigned char * dest) const;
+
+    // Compresses the 16 pixels of one block, rows top to bottom, into blockBytes(format) bytes.
+    static void compressBlock(Format format, const unsigned char * pixels, unsigned char * block);
+
+    static int blockBytes(Format format);
+    static size_t compressedSize(Format format, int width, int height);
+    static const char * formatName(Format format);
+};
+
+#endif // BLOCKCOMPRESSOR_H
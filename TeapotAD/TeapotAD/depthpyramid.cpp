@@ -0,0 +1,133 @@
+#include "depthpyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DepthPyramid::DepthPyramid(int w, int h) : width(w), height(h), built(false)
+{
+    if( width <= 0 || height <= 0 )
+        throw std::runtime_error("Depth pyramid must have a positive size");
+
+    levels = 1;
+    while ((std::max(width, height) >> levels) > 0) levels++;
+
+    gl::GenRenderbuffers(1, &colourBuffer);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, colourBuffer);
+    gl::RenderbufferStorage(gl::RENDERBUFFER, gl::RGBA8, width, height);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, 0);
+
+    gl::GenTextures(1, &depthTexture);
+    gl::BindTexture(gl::TEXTURE_2D, depthTexture);
+    gl::TexStorage2D(gl::TEXTURE_2D, 1, gl::DEPTH_COMPONENT32F, width, height);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::NEAREST);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_COMPARE_MODE, gl::NONE);
+
+    // Fetched texel by texel at an explicit level, never filtered.
+    gl::GenTextures(1, &pyramidTexture);
+    gl::BindTexture(gl::TEXTURE_2D, pyramidTexture);
+    gl::TexStorage2D(gl::TEXTURE_2D, levels, gl::R32F, width, height);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::NEAREST_MIPMAP_NEAREST);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::CLAMP_TO_EDGE);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::CLAMP_TO_EDGE);
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+
+    gl::GenFramebuffers(1, &fboHandle);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0, gl::RENDERBUFFER, colourBuffer);
+    gl::FramebufferTexture(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT, depthTexture, 0);
+
+    GLenum status = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+
+    if( status != gl::FRAMEBUFFER_COMPLETE ) {
+        gl::DeleteFramebuffers(1, &fboHandle);
+        gl::DeleteRenderbuffers(1, &colourBuffer);
+        gl::DeleteTextures(1, &depthTexture);
+        gl::DeleteTextures(1, &pyramidTexture);
+        throw std::runtime_error("Depth pyramid framebuffer is incomplete");
+    }
+
+    reduceProg.compileShader("Shaders/depth_reduce.cs");
+    reduceProg.link();
+    reduceProg.use();
+    reduceProg.setUniform("Source", 0);
+    reduceProg.setUniform("Destination", 0);
+}
+
+DepthPyramid::~DepthPyramid()
+{
+    gl::DeleteFramebuffers(1, &fboHandle);
+    gl::DeleteRenderbuffers(1, &colourBuffer);
+    gl::DeleteTextures(1, &depthTexture);
+    gl::DeleteTextures(1, &pyramidTexture);
+}
+
+void DepthPyramid::bind() const
+{
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::Viewport(0, 0, width, height);
+}
+
+void DepthPyramid::build()
+{
+    reduceProg.use();
+    gl::ActiveTexture(gl::TEXTURE0);
+
+    // Level 0 is a copy of the depth buffer, each further level the maximum of the one before.
+    int sourceWidth = width, sourceHeight = height;
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = std::max(1, width >> level);
+        int levelHeight = std::max(1, height >> level);
+
+        gl::BindTexture(gl::TEXTURE_2D, level == 0 ? depthTexture : pyramidTexture);
+        gl::BindImageTexture(0, pyramidTexture, level, FALSE, 0, gl::WRITE_ONLY, gl::R32F);
+        reduceProg.setUniform("SourceLevel", std::max(0, level - 1));
+        reduceProg.setUniform("SourceSize", glm::vec2((float)sourceWidth, (float)sourceHeight));
+        reduceProg.setUniform("Copy", level == 0);
+
+        gl::DispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        gl::MemoryBarrier(gl::TEXTURE_FETCH_BARRIER_BIT | gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+    built = true;
+}
+
+void DepthPyramid::present(GLuint framebuffer) const
+{
+    gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fboHandle);
+    gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, framebuffer);
+    gl::BlitFramebuffer(0, 0, width, height, 0, 0, width, height, gl::COLOR_BUFFER_BIT, gl::NEAREST);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, framebuffer);
+}
+
+bool DepthPyramid::isBuilt() const
+{
+    return built;
+}
+
+GLuint DepthPyramid::getTexture() const
+{
+    return pyramidTexture;
+}
+
+int DepthPyramid::getLevels() const
+{
+    return levels;
+}
+
+int DepthPyramid::getWidth() const
+{
+    return width;
+}
+
+int DepthPyramid::getHeight() const
+{
+    return height;
+}
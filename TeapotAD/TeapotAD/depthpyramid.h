@@ -0,0 +1,54 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include "gl_core_4_3.hpp"
+#include "glslprogram.h"
+
+/**
+ A hierarchical depth buffer (Hi-Z) for occlusion culling.
+
+ The scene is rendered into this object's own framebuffer, whose depth
+ attachment is a texture. build() then reduces that depth into a mip chain
+ where every texel holds the furthest depth of the texels it covers, so a
+ single fetch at the right level tells whether anything in a screen
+ rectangle could be in front of a given depth. A compute shader testing
+ bounding boxes against the pyramid built from the previous frame can then
+ drop objects that were hidden behind others.
+ */
+class DepthPyramid
+{
+private:
+    int width, height;
+    int levels;
+    GLuint fboHandle;
+    GLuint colourBuffer;
+    GLuint depthTexture;    // Depth attachment, read by the first reduction
+    GLuint pyramidTexture;  // R32F, level 0 the size of the framebuffer
+    bool built;             // Whether build() has run since the pyramid was created
+    GLSLProgram reduceProg;
+
+    // Non-copyable, the GL objects are owned by this instance
+    DepthPyramid( const DepthPyramid & ) { }
+    DepthPyramid & operator=( const DepthPyramid & ) { return *this; }
+
+public:
+    DepthPyramid(int width, int height);
+    ~DepthPyramid();
+
+    void bind() const;      // Render into the pyramid's framebuffer
+
+    // Reduces the depth rendered since bind() into the pyramid. Leaves the
+    // pyramid's framebuffer bound.
+    void build();
+
+    // Copies the colour rendered since bind() into another framebuffer and binds that.
+    void present(GLuint framebuffer) const;
+
+    bool isBuilt() const;
+    GLuint getTexture() const;
+    int getLevels() const;
+    int getWidth() const;
+    int getHeight() const;
+};
+
+#endif // DEPTHPYRAMID_H
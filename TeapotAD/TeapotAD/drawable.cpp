@@ -1,7 +1,123 @@
+#include "drawable.h"
+#include "geometryarena.h"
 
+Drawable::Drawable() : vaoHandle(0), arena(NULL), vertexBytes(0), indexType(gl::UNSIGNED_INT)
+{
+    meshRange.firstIndex = 0;
+    meshRange.indexCount = 0;
+    meshRange.baseVertex = 0;
 
-#include "drawable.h"
+    VertexCache::Statistics none = { 0, 0.0f, 0.0f };
+    generatedCache = optimisedCache = none;
+
+    boundsMin = boundsMax = glm::vec3(0.0f);
+    boundingSphere = glm::vec4(0.0f);
+
+    for (int i = 0; i < 4; i++) bufferHandles[i] = 0;
+}
+
+Drawable::~Drawable()
+{
+    // A mesh in an arena is released with the arena
+    gl::DeleteBuffers(4, bufferHandles);
+    if (vaoHandle != 0) gl::DeleteVertexArrays(1, &vaoHandle);
+}
+
+void Drawable::setBounds(const float * positions, unsigned int count)
+{
+    if (count == 0) return;
+
+    boundsMin = boundsMax = glm::vec3(positions[0], positions[1], positions[2]);
+    for (unsigned int i = 1; i < count; i++) {
+        glm::vec3 p(positions[3*i], positions[3*i+1], positions[3*i+2]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+
+    // Centred on the box, but only as large as the furthest point needs.
+    glm::vec3 centre = 0.5f * (boundsMin + boundsMax);
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 p(positions[3*i], positions[3*i+1], positions[3*i+2]);
+        radius = glm::max(radius, glm::length(p - centre));
+    }
+    boundingSphere = glm::vec4(centre, radius);
+}
+
+void Drawable::setMesh(MeshData & mesh, GeometryArena * meshArena, VertexFormat::Format format)
+{
+    generatedCache = VertexCache::simulate(mesh.indices, mesh.getVertexCount());
+    VertexCache::tipsify(mesh.indices, mesh.getVertexCount());
+    optimisedCache = VertexCache::simulate(mesh.indices, mesh.getVertexCount());
+    setBounds(&mesh.positions[0], mesh.getVertexCount());
+
+    arena = meshArena;
+    if (arena != NULL) {
+        // The arena only knows its index type once every mesh is added, see getIndexBytes().
+        meshRange = arena->add(mesh);
+        format = arena->getFormat();
+    } else {
+        vaoHandle = mesh.createVertexArray(format, bufferHandles);
+        indexType = mesh.getIndexType();
+        meshRange.firstIndex = 0;
+        meshRange.indexCount = mesh.getIndexCount();
+        meshRange.baseVertex = 0;
+    }
+    vertexBytes = (GLsizeiptr)mesh.getVertexCount() * MeshData::vertexSize(format);
+}
+
+void Drawable::drawMesh(int instances) const
+{
+    if (arena != NULL) {
+        arena->draw(meshRange, instances);
+    } else {
+        gl::BindVertexArray(vaoHandle);
+        gl::DrawElementsInstanced(gl::TRIANGLES, meshRange.indexCount, indexType, ((GLubyte *)NULL + (0)), instances);
+    }
+}
+
+const MeshRange & Drawable::getMeshRange() const
+{
+    return meshRange;
+}
+
+GeometryArena * Drawable::getArena() const
+{
+    return arena;
+}
+
+GLsizeiptr Drawable::getVertexBytes() const
+{
+    return vertexBytes;
+}
+
+GLsizeiptr Drawable::getIndexBytes() const
+{
+    GLenum type = arena != NULL ? arena->getIndexType() : indexType;
+    return (GLsizeiptr)meshRange.indexCount * MeshData::indexSize(type);
+}
+
+const VertexCache::Statistics & Drawable::getGeneratedCacheStatistics() const
+{
+    return generatedCache;
+}
+
+const VertexCache::Statistics & Drawable::getOptimisedCacheStatistics() const
+{
+    return optimisedCache;
+}
+
+const glm::vec3 & Drawable::getBoundsMin() const
+{
+    return boundsMin;
+}
+
+const glm::vec3 & Drawable::getBoundsMax() const
+{
+    return boundsMax;
+}
 
-Drawable::Drawable()
+const glm::vec4 & Drawable::getBoundingSphere() const
 {
+    return boundingSphere;
 }
@@ -1,12 +1,67 @@
 #ifndef DRAWABLE_H
 #define DRAWABLE_H
 
+#include "meshdata.h"
+#include "vertexcache.h"
+
+#include <glm.hpp>
+
+class GeometryArena;
+
 class Drawable
 {
+protected:
+    GLuint vaoHandle;       // Vertex array of the mesh when it has its own buffers
+    GLuint bufferHandles[4];    // and those buffers, deleted with the object, unused ones 0
+    GeometryArena * arena;  // Shared buffers holding the mesh, or NULL
+    MeshRange meshRange;    // Where the mesh is in its buffers
+    GLsizeiptr vertexBytes; // Size of the mesh's vertex data on the GPU
+    GLenum indexType;       // Type of the mesh's indices on the GPU
+
+    VertexCache::Statistics generatedCache; // Vertex cache behaviour of the triangles as the builder generated them
+    VertexCache::Statistics optimisedCache; // and after they were reordered
+
+    glm::vec3 boundsMin, boundsMax; // Object space box around every vertex
+    glm::vec4 boundingSphere;       // Object space centre and radius
+
+    // Fits the bounding box and sphere to count points of 3 floats each.
+    void setBounds(const float * positions, unsigned int count);
+
+    // Reorders the triangles of a finished mesh for the vertex cache, then
+    // uploads it into the arena if one is given or into buffers of its own
+    // in the given format if not. An arena uses its own vertex format.
+    // The bounds are fitted to the mesh.
+    void setMesh(MeshData & mesh, GeometryArena * arena, VertexFormat::Format format);
+
+    void drawMesh(int instances) const;
+
+    // Non-copyable, the buffers are owned by this instance
+    Drawable( const Drawable & ) { }
+    Drawable & operator=( const Drawable & ) { return *this; }
+
 public:
     Drawable();
+    virtual ~Drawable();
 
     virtual void render() const = 0;
+
+    // Draws the mesh instances times in one call, per-instance data is
+    // looked up by the shader using gl_InstanceID.
+    virtual void renderInstanced(int instances) const = 0;
+
+    // Only meaningful for meshes in a GeometryArena, used to build indirect draw commands.
+    const MeshRange & getMeshRange() const;
+    GeometryArena * getArena() const;
+
+    GLsizeiptr getVertexBytes() const;
+    GLsizeiptr getIndexBytes() const;
+
+    const VertexCache::Statistics & getGeneratedCacheStatistics() const;
+    const VertexCache::Statistics & getOptimisedCacheStatistics() const;
+
+    const glm::vec3 & getBoundsMin() const;
+    const glm::vec3 & getBoundsMax() const;
+    const glm::vec4 & getBoundingSphere() const;
 };
 
 #endif // DRAWABLE_H
@@ -0,0 +1,75 @@
+#include "frustum.h"
+
+#include <xmmintrin.h>
+
+Frustum::Frustum(const glm::mat4 & clip)
+{
+    // A point is inside when -w <= x, y, z <= w in clip space, each inequality
+    // is a plane made from the fourth row of the matrix plus or minus another row.
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; r++)
+        row[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+
+    glm::vec4 planes[8] = {
+        row[3] + row[0],    // Left
+        row[3] - row[0],    // Right
+        row[3] + row[1],    // Bottom
+        row[3] - row[1],    // Top
+        row[3] + row[2],    // Near
+        row[3] - row[2],    // Far
+        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),  // Padding, every point is inside
+        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+    };
+
+    for (int i = 0; i < 8; i++) {
+        // Normalised so the plane equation gives distances, which sphere radii are compared with.
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f) planes[i] /= length;
+
+        planeX[i] = planes[i].x;
+        planeY[i] = planes[i].y;
+        planeZ[i] = planes[i].z;
+        planeW[i] = planes[i].w;
+    }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3 & centre, float radius) const
+{
+    __m128 x = _mm_set1_ps(centre.x);
+    __m128 y = _mm_set1_ps(centre.y);
+    __m128 z = _mm_set1_ps(centre.z);
+    __m128 r = _mm_set1_ps(-radius);
+
+    int outside = 0;
+    for (int i = 0; i < 8; i += 4) {
+        // Signed distance of the centre from four planes at once.
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planeX + i), x),
+                                         _mm_mul_ps(_mm_loadu_ps(planeY + i), y)),
+                              _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planeZ + i), z),
+                                         _mm_loadu_ps(planeW + i)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(d, r));
+    }
+    return outside == 0;
+}
+
+bool Frustum::intersectsBox(const glm::vec3 & boxMin, const glm::vec3 & boxMax) const
+{
+    __m128 minX = _mm_set1_ps(boxMin.x), maxX = _mm_set1_ps(boxMax.x);
+    __m128 minY = _mm_set1_ps(boxMin.y), maxY = _mm_set1_ps(boxMax.y);
+    __m128 minZ = _mm_set1_ps(boxMin.z), maxZ = _mm_set1_ps(boxMax.z);
+
+    int outside = 0;
+    for (int i = 0; i < 8; i += 4) {
+        // The distance of the corner furthest along each plane's normal: per axis
+        // the larger of the plane's component times the box's minimum or maximum.
+        __m128 px = _mm_loadu_ps(planeX + i);
+        __m128 py = _mm_loadu_ps(planeY + i);
+        __m128 pz = _mm_loadu_ps(planeZ + i);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_max_ps(_mm_mul_ps(px, minX), _mm_mul_ps(px, maxX)),
+                                         _mm_max_ps(_mm_mul_ps(py, minY), _mm_mul_ps(py, maxY))),
+                              _mm_add_ps(_mm_max_ps(_mm_mul_ps(pz, minZ), _mm_mul_ps(pz, maxZ)),
+                                         _mm_loadu_ps(planeW + i)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(d, _mm_setzero_ps()));
+    }
+    return outside == 0;
+}
@@ -0,0 +1,37 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm.hpp>
+
+/**
+ The six planes of a view frustum, for rejecting objects the camera cannot
+ see before their data is uploaded or their draw call issued.
+
+ The planes are extracted from a clip matrix (Gribb and Hartmann) and lie in
+ whatever space that matrix transforms from: projection * view gives world
+ space planes, projection * view * model gives the model's own space, so an
+ object space box can be tested without transforming it.
+
+ The planes are stored as four-wide columns so each test evaluates four
+ planes per SSE instruction; the unused lanes hold planes nothing is
+ outside of.
+ */
+class Frustum
+{
+private:
+    // x, y, z and w of planes 0-3 then 4-5 and the two padding planes,
+    // each plane normalised and facing into the frustum.
+    float planeX[8], planeY[8], planeZ[8], planeW[8];
+
+public:
+    Frustum(const glm::mat4 & clip);
+
+    // False if the sphere is entirely outside one of the planes.
+    bool intersectsSphere(const glm::vec3 & centre, float radius) const;
+
+    // False if the axis aligned box is entirely outside one of the planes.
+    // Conservative: a box straddling two planes near a corner is kept.
+    bool intersectsBox(const glm::vec3 & boxMin, const glm::vec3 & boxMax) const;
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,115 @@
+#include "gbuffer.h"
+
+#include <stdexcept>
+
+namespace
+{
+    const GLenum formats[GBuffer::TARGETS] = { gl::RGBA8, gl::RGB10_A2, gl::R32F, gl::RGBA16F };
+    const GLsizeiptr formatBytes[GBuffer::TARGETS] = { 4, 4, 4, 8 };
+}
+
+GBuffer::GBuffer(int w, int h) : width(w), height(h)
+{
+    if( width <= 0 || height <= 0 )
+        throw std::runtime_error("G-buffer must have a positive size");
+
+    // Read texel by texel with texelFetch, never filtered.
+    gl::GenTextures(TARGETS, textures);
+    for (int i = 0; i < TARGETS; i++) {
+        gl::BindTexture(gl::TEXTURE_2D, textures[i]);
+        gl::TexStorage2D(gl::TEXTURE_2D, 1, formats[i], width, height);
+        gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::NEAREST);
+        gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+    }
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+
+    gl::GenRenderbuffers(1, &depthBuffer);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, depthBuffer);
+    gl::RenderbufferStorage(gl::RENDERBUFFER, gl::DEPTH_COMPONENT32F, width, height);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, 0);
+
+    gl::GenFramebuffers(1, &fboHandle);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    for (int i = 0; i < TARGETS; i++)
+        gl::FramebufferTexture(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0 + i, textures[i], 0);
+    gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT, gl::RENDERBUFFER, depthBuffer);
+
+    GLenum status = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+
+    if( status != gl::FRAMEBUFFER_COMPLETE ) {
+        gl::DeleteFramebuffers(1, &fboHandle);
+        gl::DeleteTextures(TARGETS, textures);
+        gl::DeleteRenderbuffers(1, &depthBuffer);
+        throw std::runtime_error("G-buffer framebuffer is incomplete");
+    }
+}
+
+GBuffer::~GBuffer()
+{
+    gl::DeleteFramebuffers(1, &fboHandle);
+    gl::DeleteTextures(TARGETS, textures);
+    gl::DeleteRenderbuffers(1, &depthBuffer);
+}
+
+void GBuffer::clear() const
+{
+    bindLighting();
+    gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+
+    bindGeometry();
+    const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = ALBEDO; i <= DEPTH; i++)
+        gl::ClearBufferfv(gl::COLOR, i, zero);
+}
+
+void GBuffer::bindGeometry() const
+{
+    const GLenum buffers[3] = { gl::COLOR_ATTACHMENT0 + ALBEDO, gl::COLOR_ATTACHMENT0 + NORMAL, gl::COLOR_ATTACHMENT0 + DEPTH };
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::DrawBuffers(3, buffers);
+    gl::Viewport(0, 0, width, height);
+}
+
+void GBuffer::bindLighting() const
+{
+    const GLenum buffer = gl::COLOR_ATTACHMENT0 + LIGHTING;
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::DrawBuffers(1, &buffer);
+    gl::Viewport(0, 0, width, height);
+}
+
+void GBuffer::bindTextures(GLuint firstUnit) const
+{
+    for (int i = ALBEDO; i <= DEPTH; i++) {
+        gl::ActiveTexture(gl::TEXTURE0 + firstUnit + i);
+        gl::BindTexture(gl::TEXTURE_2D, textures[i]);
+    }
+    gl::ActiveTexture(gl::TEXTURE0);
+}
+
+void GBuffer::present(GLuint framebuffer) const
+{
+    gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fboHandle);
+    gl::ReadBuffer(gl::COLOR_ATTACHMENT0 + LIGHTING);
+    gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, framebuffer);
+    gl::BlitFramebuffer(0, 0, width, height, 0, 0, width, height, gl::COLOR_BUFFER_BIT, gl::NEAREST);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, framebuffer);
+}
+
+int GBuffer::getWidth() const
+{
+    return width;
+}
+
+int GBuffer::getHeight() const
+{
+    return height;
+}
+
+GLsizeiptr GBuffer::getBytes() const
+{
+    GLsizeiptr perPixel = 4;    // The depth buffer
+    for (int i = 0; i < TARGETS; i++) perPixel += formatBytes[i];
+    return perPixel * width * height;
+}
@@ -0,0 +1,64 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "gl_core_4_3.hpp"
+
+/**
+ The geometry buffer of a deferred renderer.
+
+ The geometry pass writes the surface nearest the camera at each pixel into
+ the surface targets. Lighting passes then read them back as textures and
+ add every light's contribution into the lit colour target, which shares
+ the geometry pass's depth buffer so light volumes can be depth tested
+ against the scene. A light then costs the pixels it covers, however much
+ geometry or overdraw is behind them.
+
+   ALBEDO    RGBA8     Diffuse reflectivity, material index / 255 in alpha
+   NORMAL    RGB10_A2  Eye space normal, scaled and biased into [0,1]
+   DEPTH     R32F      Distance in front of the camera, 0 where nothing was drawn
+   LIGHTING  RGBA16F   Lit colour
+ */
+class GBuffer
+{
+public:
+    enum Target {
+        ALBEDO,
+        NORMAL,
+        DEPTH,
+        LIGHTING,
+        TARGETS
+    };
+
+private:
+    int width, height;
+    GLuint fboHandle;
+    GLuint textures[TARGETS];
+    GLuint depthBuffer;     // Depth test of both passes, never sampled
+
+    // Non-copyable, the GL objects are owned by this instance
+    GBuffer( const GBuffer & ) { }
+    GBuffer & operator=( const GBuffer & ) { return *this; }
+
+public:
+    GBuffer(int width, int height);
+    ~GBuffer();
+
+    // Clears the lit colour to the clear colour, the surfaces to 0 and the
+    // depth to 1, and leaves the surface targets bound.
+    void clear() const;
+
+    void bindGeometry() const;  // Render into ALBEDO, NORMAL and DEPTH
+    void bindLighting() const;  // Render into LIGHTING
+
+    // Binds ALBEDO, NORMAL and DEPTH to texture units firstUnit onwards.
+    void bindTextures(GLuint firstUnit) const;
+
+    // Copies the lit colour into another framebuffer and binds that.
+    void present(GLuint framebuffer) const;
+
+    int getWidth() const;
+    int getHeight() const;
+    GLsizeiptr getBytes() const;    // Memory of every target and the depth buffer
+};
+
+#endif // GBUFFER_H
@@ -0,0 +1,109 @@
+#include "geometryarena.h"
+
+#include <stdexcept>
+
+GeometryArena::GeometryArena(VertexFormat::Format format) : format(format), indexType(gl::UNSIGNED_INT), vaoHandle(0)
+{
+    for (int i = 0; i < 5; i++) buffers[i] = 0;
+}
+
+GeometryArena::~GeometryArena()
+{
+    if (vaoHandle != 0) {
+        gl::DeleteBuffers(5, buffers);
+        gl::DeleteVertexArrays(1, &vaoHandle);
+    }
+}
+
+MeshRange GeometryArena::add(const MeshData & mesh)
+{
+    if (isUploaded())
+        throw std::runtime_error("Meshes cannot be added to a geometry arena after it is uploaded");
+
+    MeshRange range;
+    range.firstIndex = staged.getIndexCount();
+    range.indexCount = mesh.getIndexCount();
+    range.baseVertex = (GLint)staged.getVertexCount();
+
+    // The indices are kept relative to the mesh, baseVertex moves them to its vertices.
+    staged.positions.insert(staged.positions.end(), mesh.positions.begin(), mesh.positions.end());
+    staged.normals.insert(staged.normals.end(), mesh.normals.begin(), mesh.normals.end());
+    staged.texCoords.insert(staged.texCoords.end(), mesh.texCoords.begin(), mesh.texCoords.end());
+    staged.indices.insert(staged.indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+    return range;
+}
+
+void GeometryArena::upload(GLuint drawIndices)
+{
+    if (isUploaded())
+        throw std::runtime_error("Geometry arena is already uploaded");
+    if (staged.getIndexCount() == 0)
+        throw std::runtime_error("Geometry arena has no meshes to upload");
+
+    // The same layout as MeshData::createVertexArray, plus the draw index.
+    indexType = staged.getIndexType();
+    vaoHandle = staged.createVertexArray(format, buffers);
+    gl::BindVertexArray(vaoHandle);
+
+    if (drawIndices > 0) {
+        std::vector<GLuint> iota(drawIndices);
+        for (GLuint i = 0; i < drawIndices; i++) iota[i] = i;
+
+        gl::GenBuffers(1, &buffers[4]);
+        gl::BindBuffer(gl::ARRAY_BUFFER, buffers[4]);
+        gl::BufferData(gl::ARRAY_BUFFER, drawIndices * sizeof(GLuint), &iota[0], gl::STATIC_DRAW);
+        gl::VertexAttribIPointer( (GLuint)3, 1, gl::UNSIGNED_INT, 0, ((GLubyte *)NULL + (0)) );
+        gl::VertexAttribDivisor(3, 1);
+        gl::EnableVertexAttribArray(3);  // Draw index
+    }
+
+    gl::BindVertexArray(0);
+
+    // The CPU copy is no longer needed.
+    staged = MeshData();
+}
+
+bool GeometryArena::isUploaded() const
+{
+    return vaoHandle != 0;
+}
+
+VertexFormat::Format GeometryArena::getFormat() const
+{
+    return format;
+}
+
+GLenum GeometryArena::getIndexType() const
+{
+    return indexType;
+}
+
+void GeometryArena::bind() const
+{
+    gl::BindVertexArray(vaoHandle);
+}
+
+void GeometryArena::draw(const MeshRange & range, int instances) const
+{
+    bind();
+    gl::DrawElementsInstancedBaseVertexBaseInstance(gl::TRIANGLES, range.indexCount, indexType,
+        ((GLubyte *)NULL + range.firstIndex * MeshData::indexSize(indexType)), instances, range.baseVertex, 0);
+}
+
+void GeometryArena::multiDraw(GLintptr offset, GLsizei drawCount) const
+{
+    bind();
+    gl::MultiDrawElementsIndirect(gl::TRIANGLES, indexType, ((GLubyte *)NULL + offset), drawCount, 0);
+}
+
+DrawElementsIndirectCommand GeometryArena::command(const MeshRange & range, GLuint instanceCount, GLuint baseInstance)
+{
+    DrawElementsIndirectCommand cmd;
+    cmd.count = range.indexCount;
+    cmd.instanceCount = instanceCount;
+    cmd.firstIndex = range.firstIndex;
+    cmd.baseVertex = range.baseVertex;
+    cmd.baseInstance = baseInstance;
+    return cmd;
+}
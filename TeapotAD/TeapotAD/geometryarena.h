@@ -0,0 +1,73 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include "gl_core_4_3.hpp"
+#include "meshdata.h"
+
+#include <vector>
+
+/**
+ The command layout read by gl::MultiDrawElementsIndirect.
+ */
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+/**
+ One vertex array holding the meshes of many Drawables.
+
+ Meshes are added on the CPU, then upload() creates a single set of vertex
+ buffers and a single index buffer for all of them. With every mesh behind
+ the same vertex array a whole scene can be drawn with one
+ gl::MultiDrawElementsIndirect call.
+
+ Attribute 3 (DrawIndex) is an instanced attribute reading 0, 1, 2, ... so
+ it takes the value baseInstance + instance. Shaders use it to find the
+ per-draw data, which gl_InstanceID alone cannot do as it ignores
+ baseInstance.
+ */
+class GeometryArena
+{
+private:
+    MeshData staged;        // Every mesh added so far, indices relative to each mesh
+    VertexFormat::Format format;
+    GLenum indexType;       // Chosen at upload, 16 bits if every mesh's indices fit
+    GLuint vaoHandle;
+    GLuint buffers[5];      // Positions, normals, texture coordinates, indices, draw indices
+
+    // Non-copyable, the GL objects are owned by this instance
+    GeometryArena( const GeometryArena & ) { }
+    GeometryArena & operator=( const GeometryArena & ) { return *this; }
+
+public:
+    GeometryArena(VertexFormat::Format format = VertexFormat::SEPARATE);
+    ~GeometryArena();
+
+    // Appends a mesh and returns where it will be in the shared buffers.
+    // Must be called before upload().
+    MeshRange add(const MeshData & mesh);
+
+    // Creates the GL buffers. drawIndices is one more than the highest
+    // baseInstance + instance any command may use, or 0 to leave the draw
+    // index out for arenas whose shaders do not read it.
+    void upload(GLuint drawIndices = 65536);
+
+    bool isUploaded() const;
+    VertexFormat::Format getFormat() const;
+    GLenum getIndexType() const;
+
+    void bind() const;
+    void draw(const MeshRange & range, int instances = 1) const;   // One draw call for one mesh, binds the arena
+
+    // Draws every command in the bound DRAW_INDIRECT_BUFFER, starting at offset.
+    void multiDraw(GLintptr offset, GLsizei drawCount) const;
+
+    static DrawElementsIndirectCommand command(const MeshRange & range, GLuint instanceCount, GLuint baseInstance);
+};
+
+#endif // GEOMETRYARENA_H
@@ -82,21 +82,25 @@ static PROC WinGetProcAddress(const char *name)
 	return (PROC)GetProcAddress(glMod, (LPCSTR)name);
 }
 	
-#define IntGetProcAddress(name) WinGetProcAddress(name)
+#define PlatformGetProcAddress(name) WinGetProcAddress(name)
 #else
 	#if defined(__APPLE__)
-		#define IntGetProcAddress(name) AppleGLGetProcAddress(name)
+		#define PlatformGetProcAddress(name) AppleGLGetProcAddress(name)
 	#else
 		#if defined(__sgi) || defined(__sun)
-			#define IntGetProcAddress(name) SunGetProcAddress(name)
+			#define PlatformGetProcAddress(name) SunGetProcAddress(name)
 		#else /* GLX */
 		    #include <GL/glx.h>
 
-			#define IntGetProcAddress(name) (*glXGetProcAddressARB)((const GLubyte*)name)
+			#define PlatformGetProcAddress(name) (*glXGetProcAddressARB)((const GLubyte*)name)
 		#endif
 	#endif
 #endif
 
+/* Contexts the window system did not create, e.g. through EGL, give their own lookup to gl::sys::SetProcAddressLoader(). */
+static void *(*ProcAddressLoader)(const char *) = NULL;
+#define IntGetProcAddress(name) (ProcAddressLoader ? ProcAddressLoader(name) : (void *)PlatformGetProcAddress(name))
+
 namespace gl
 {
 	namespace exts
@@ -2456,6 +2460,11 @@ namespace gl
 			
 		} //namespace 
 		
+		void SetProcAddressLoader(void *(*loader)(const char *name))
+		{
+			ProcAddressLoader = loader;
+		}
+		
 		exts::LoadTest LoadFunctions()
 		{
 			ClearExtensionVars();
@@ -2050,6 +2050,8 @@ namespace gl
 	namespace sys
 	{
 		
+		// Looks the functions up with loader instead of the window system's function, NULL to go back to it.
+		void SetProcAddressLoader(void *(*loader)(const char *name));
 		exts::LoadTest LoadFunctions();
 		
 		int GetMinorVersion();
@@ -7,7 +7,14 @@ using std::ifstream;
 using std::ios;
 
 #include <sstream>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
 #include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
 
 namespace GLSLShaderInfo {
   struct shader_file_extension {
@@ -29,25 +36,36 @@ namespace GLSLShaderInfo {
   };
 }
 
-GLSLProgram::GLSLProgram() : handle(0), linked(false) { }
+string GLSLProgram::binaryCacheDirectory;
+unsigned int GLSLProgram::binariesLoaded = 0;
+unsigned int GLSLProgram::binariesRejected = 0;
+unsigned int GLSLProgram::programsCompiled = 0;
+
+GLSLProgram::GLSLProgram() : handle(0), linked(false), loadedFromCache(false), pendingHandle(0), pendingFence(0),
+  pendingKey(0), pendingFromCache(false), uniformUploads(0), uniformsElided(0) { }
 
 GLSLProgram::~GLSLProgram() {
+  discardBuild();
   if(handle == 0) return;
 
+  deleteProgram(handle);
+}
+
+void GLSLProgram::deleteProgram( GLuint program ) {
   // Query the number of attached shaders
   GLint numShaders = 0;
-  gl::GetProgramiv(handle, gl::ATTACHED_SHADERS, &numShaders);
+  gl::GetProgramiv(program, gl::ATTACHED_SHADERS, &numShaders);
 
   // Get the shader names
   GLuint * shaderNames = new GLuint[numShaders];
-  gl::GetAttachedShaders(handle, numShaders, NULL, shaderNames);
+  gl::GetAttachedShaders(program, numShaders, NULL, shaderNames);
 
   // Delete the shaders
   for (int i = 0; i < numShaders; i++)
     gl::DeleteShader(shaderNames[i]);
 
   // Delete the program
-  gl::DeleteProgram (handle);
+  gl::DeleteProgram (program);
 
   delete[] shaderNames;
 }
@@ -105,18 +123,54 @@ throw( GLSLProgramException )
     }
   }
 
-  ifstream inFile( fileName, ios::in );
-  if( !inFile ) {
-    string message = string("Unable to open: ") + fileName;
-    throw GLSLProgramException(message);
-  }
-
   // Get file contents
+  std::vector<string> includes;
+  string code = readShaderFile(fileName, includes);
+
+  compileShader(code, type, fileName);
+  sources.back().includes = includes;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Reads a shader file, replacing each #include "name" line with the named
+// file from the same directory. The included files are added to includes.
+// A #line after each one keeps the compiler's line numbers those of the
+// including file.
+/////////////////////////////////////////////////////////////////////////////
+string GLSLProgram::readShaderFile( const string & fileName, std::vector<string> & includes, int depth )
+{
+  ifstream inFile( fileName.c_str(), ios::in );
+  if( !inFile )
+    throw GLSLProgramException("Unable to open: " + fileName);
+
+  size_t slash = fileName.find_last_of("/\\");
+  string directory = slash == string::npos ? "" : fileName.substr(0, slash + 1);
+
   std::stringstream code;
-  code << inFile.rdbuf();
-  inFile.close();
+  string line;
+  int lineNumber = 0;
+  while( std::getline(inFile, line) ) {
+    lineNumber++;
+    size_t start = line.find_first_not_of(" \t");
+    if( start == string::npos || line.compare(start, 8, "#include") != 0 ) {
+      code << line << '\n';
+      continue;
+    }
 
-  compileShader(code.str(), type, fileName);
+    size_t open = line.find('"', start + 8);
+    size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+    if( close == string::npos )
+      throw GLSLProgramException(fileName + "(" + std::to_string(lineNumber) + "): #include needs a \"name\"");
+    if( depth >= 8 )
+      throw GLSLProgramException(fileName + ": #include nested too deeply");
+
+    string included = directory + line.substr(open + 1, close - open - 1);
+    if( std::find(includes.begin(), includes.end(), included) == includes.end() )
+      includes.push_back(included);
+    code << readShaderFile(included, includes, depth + 1);
+    code << "#line " << lineNumber + 1 << '\n';
+  }
+  return code.str();
 }
 
 void GLSLProgram::compileShader( const string & source, 
@@ -124,82 +178,474 @@ void GLSLProgram::compileShader( const string & source,
     const char * fileName )
 throw(GLSLProgramException)
 {
-  if( handle <= 0 ) {
-    handle = gl::CreateProgram();
-    if( handle == 0) {
-      throw GLSLProgramException("Unable to create shader program.");
+  // Kept until link(), which only compiles it if the binary cache misses
+  ShaderSource stage;
+  stage.type = type;
+  stage.source = source;
+  if( fileName ) stage.fileName = fileName;
+  sources.push_back(stage);
+}
+
+// Remembers a name's binding, so every program built later can be given it
+static void recordBinding( std::vector< std::pair<string, GLuint> > & bindings, const char * name, GLuint binding )
+{
+  for( size_t i = 0; i < bindings.size(); i++ ) {
+    if( bindings[i].first == name ) {
+      bindings[i].second = binding;
+      return;
     }
   }
+  bindings.push_back(std::make_pair(string(name), binding));
+}
 
-  GLuint shaderHandle = gl::CreateShader(type);
-
-  const char * c_code = source.c_str();
-  gl::ShaderSource( shaderHandle, 1, &c_code, NULL );
-
-  // Compile the shader
-  gl::CompileShader(shaderHandle);
-
-  // Check for errors
-  int result;
-  gl::GetShaderiv( shaderHandle, gl::COMPILE_STATUS, &result );
-  if( FALSE == result ) {
-    // Compile failed, get log
-    int length = 0;
-    string logString;
-    gl::GetShaderiv(shaderHandle, gl::INFO_LOG_LENGTH, &length );
-    if( length > 0 ) {
-      char * c_log = new char[length];
-      int written = 0;
-      gl::GetShaderInfoLog(shaderHandle, length, &written, c_log);
-      logString = c_log;
-      delete [] c_log;
-    }
-    string msg;
-    if( fileName ) {
-      msg = string(fileName) + ": shader compliation failed\n";
-    } else {
-      msg = "Shader compilation failed.\n";
-    }
-    msg += logString;
+string GLSLProgram::getProgramLog( GLuint program )
+{
+  int length = 0;
+  string logString;
 
-    throw GLSLProgramException(msg);
+  gl::GetProgramiv(program, gl::INFO_LOG_LENGTH, &length );
 
-  } else {
-    // Compile succeeded, attach shader
-    gl::AttachShader(handle, shaderHandle);
+  if( length > 0 ) {
+    char * c_log = new char[length];
+    int written = 0;
+    gl::GetProgramInfoLog(program, length, &written, c_log);
+    logString = c_log;
+    delete [] c_log;
   }
+  return logString;
 }
 
 void GLSLProgram::link() throw(GLSLProgramException)
 {
   if( linked ) return;
-  if( handle <= 0 ) 
+
+  // The same steps as an asynchronous link, waiting for the driver straight away
+  linkAsync();
+  if( pendingHandle != 0 ) finishBuild();
+}
+
+void GLSLProgram::linkAsync() throw(GLSLProgramException)
+{
+  if( linked || pendingHandle != 0 ) return;
+  if( sources.empty() ) 
     throw GLSLProgramException("Program has not been compiled.");
 
-  gl::LinkProgram(handle);
+  startBuild(sources);
+  sources.clear();
+}
 
-  int status = 0;
-  gl::GetProgramiv( handle, gl::LINK_STATUS, &status);
-  if( FALSE == status ) {
-    // Store log and return false
-    int length = 0;
-    string logString;
-
-    gl::GetProgramiv(handle, gl::INFO_LOG_LENGTH, &length );
-
-    if( length > 0 ) {
-      char * c_log = new char[length];
-      int written = 0;
-      gl::GetProgramInfoLog(handle, length, &written, c_log);
-      logString = c_log;
-      delete [] c_log;
+void GLSLProgram::reload() throw(GLSLProgramException)
+{
+  if( !linked || pendingHandle != 0 ) return;
+
+  std::vector<ShaderSource> stages(shaderFiles);
+  for( size_t i = 0; i < stages.size(); i++ ) {
+    if( stages[i].fileName.empty() )
+      throw GLSLProgramException("Programs compiled from strings cannot be reloaded");
+
+    stages[i].includes.clear();
+    stages[i].source = readShaderFile(stages[i].fileName, stages[i].includes);
+  }
+
+  startBuild(stages);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Creates the program object of a build and hands every stage to the driver
+// without asking for any status, which would wait for the compiler. A
+// cached binary makes the build complete at once.
+/////////////////////////////////////////////////////////////////////////////
+void GLSLProgram::startBuild( const std::vector<ShaderSource> & stages )
+{
+  pendingHandle = gl::CreateProgram();
+  if( pendingHandle == 0 )
+    throw GLSLProgramException("Unable to create shader program.");
+  pendingStages = stages;
+
+  pendingFromCache = false;
+  if( !binaryCacheDirectory.empty() ) {
+    pendingKey = binaryKey(stages);
+    pendingFromCache = loadBinary(pendingHandle, pendingKey);
+  }
+  if( pendingFromCache ) return;
+
+  for( size_t i = 0; i < stages.size(); i++ ) {
+    GLuint shaderHandle = gl::CreateShader(stages[i].type);
+    const char * c_code = stages[i].source.c_str();
+    gl::ShaderSource( shaderHandle, 1, &c_code, NULL );
+    gl::CompileShader(shaderHandle);
+    gl::AttachShader(pendingHandle, shaderHandle);
+    pendingShaders.push_back(shaderHandle);
+  }
+
+  for( size_t i = 0; i < attribBindings.size(); i++ )
+    gl::BindAttribLocation(pendingHandle, attribBindings[i].second, attribBindings[i].first.c_str());
+  for( size_t i = 0; i < fragDataBindings.size(); i++ )
+    gl::BindFragDataLocation(pendingHandle, fragDataBindings[i].second, fragDataBindings[i].first.c_str());
+
+  if( !binaryCacheDirectory.empty() )
+    gl::ProgramParameteri(pendingHandle, gl::PROGRAM_BINARY_RETRIEVABLE_HINT, TRUE);
+  gl::LinkProgram(pendingHandle);
+
+  if( !parallelCompileSupported() )
+    pendingFence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// From ARB/KHR_parallel_shader_compile, which the 4.3 core loader does not know
+static const GLenum COMPLETION_STATUS = 0x91B1;
+
+bool GLSLProgram::parallelCompileSupported()
+{
+  static int supported = -1;
+  if( supported < 0 ) {
+    supported = 0;
+    GLint count = 0;
+    gl::GetIntegerv(gl::NUM_EXTENSIONS, &count);
+    for( GLint i = 0; i < count; i++ ) {
+      const char * name = (const char *)gl::GetStringi(gl::EXTENSIONS, i);
+      if( strcmp(name, "GL_ARB_parallel_shader_compile") == 0 || strcmp(name, "GL_KHR_parallel_shader_compile") == 0 )
+        supported = 1;
     }
+  }
+  return supported != 0;
+}
 
-    throw GLSLProgramException(string("Program link failed:\n") + logString);
+/////////////////////////////////////////////////////////////////////////////
+// Whether the status of the pending build can be read without a stall.
+// Without the parallel compile extension a fence placed after the link is
+// the best available sign that the driver has moved past it.
+/////////////////////////////////////////////////////////////////////////////
+bool GLSLProgram::buildComplete()
+{
+  if( pendingFromCache ) return true;
+
+  if( parallelCompileSupported() ) {
+    GLint done = 0;
+    gl::GetProgramiv(pendingHandle, COMPLETION_STATUS, &done);
+    return done != 0;
+  }
+
+  GLenum result = gl::ClientWaitSync(pendingFence, 0, 0);
+  return result == gl::ALREADY_SIGNALED || result == gl::CONDITION_SATISFIED;
+}
+
+void GLSLProgram::finishBuild() throw(GLSLProgramException)
+{
+  if( !pendingFromCache ) {
+    // Check for errors, stage by stage so the message names the file
+    for( size_t i = 0; i < pendingShaders.size(); i++ ) {
+      int result;
+      gl::GetShaderiv( pendingShaders[i], gl::COMPILE_STATUS, &result );
+      if( FALSE == result ) {
+        // Compile failed, get log
+        int length = 0;
+        string logString;
+        gl::GetShaderiv(pendingShaders[i], gl::INFO_LOG_LENGTH, &length );
+        if( length > 0 ) {
+          char * c_log = new char[length];
+          int written = 0;
+          gl::GetShaderInfoLog(pendingShaders[i], length, &written, c_log);
+          logString = c_log;
+          delete [] c_log;
+        }
+
+        string msg;
+        if( !pendingStages[i].fileName.empty() ) {
+          msg = pendingStages[i].fileName + ": shader compliation failed\n";
+        } else {
+          msg = "Shader compilation failed.\n";
+        }
+        msg += logString;
+
+        discardBuild();
+        throw GLSLProgramException(msg);
+      }
+    }
+
+    int status = 0;
+    gl::GetProgramiv( pendingHandle, gl::LINK_STATUS, &status);
+    if( FALSE == status ) {
+      string msg = string("Program link failed:\n") + getProgramLog(pendingHandle);
+      discardBuild();
+      throw GLSLProgramException(msg);
+    }
+
+    programsCompiled++;
+    if( !binaryCacheDirectory.empty() ) saveBinary(pendingHandle, pendingKey);
+  }
+
+  // Swap the new program in. A reload carries the old one's settings over.
+  GLuint oldHandle = handle;
+  bool reloaded = linked;
+  handle = pendingHandle;
+  loadedFromCache = pendingFromCache;
+  linked = true;
+
+  shaderFiles = pendingStages;
+  for( size_t i = 0; i < shaderFiles.size(); i++ ) shaderFiles[i].source.clear();
+
+  if( reloaded ) {
+    restoreState(oldHandle);
   } else {
     uniformLocations.clear();
-    linked = true;
-  }    
+    uniformStates.clear();
+  }
+  if( oldHandle != 0 ) deleteProgram(oldHandle);
+
+  if( pendingFence ) gl::DeleteSync(pendingFence);
+  pendingHandle = 0;
+  pendingFence = 0;
+  pendingShaders.clear();
+  pendingStages.clear();
+}
+
+void GLSLProgram::discardBuild()
+{
+  if( pendingHandle == 0 ) return;
+
+  deleteProgram(pendingHandle);     // Also deletes its shaders
+  if( pendingFence ) gl::DeleteSync(pendingFence);
+  pendingHandle = 0;
+  pendingFence = 0;
+  pendingShaders.clear();
+  pendingStages.clear();
+}
+
+bool GLSLProgram::poll() throw(GLSLProgramException)
+{
+  if( pendingHandle == 0 || !buildComplete() ) return false;
+
+  finishBuild();
+  return true;
+}
+
+bool GLSLProgram::isPending() const
+{
+  return pendingHandle != 0;
+}
+
+std::vector<string> GLSLProgram::getShaderFiles() const
+{
+  std::vector<string> files;
+  for( size_t i = 0; i < shaderFiles.size(); i++ ) {
+    if( !shaderFiles[i].fileName.empty() ) files.push_back(shaderFiles[i].fileName);
+
+    // A file included by several stages is only watched once
+    const std::vector<string> & includes = shaderFiles[i].includes;
+    for( size_t j = 0; j < includes.size(); j++ )
+      if( std::find(files.begin(), files.end(), includes[j]) == files.end() ) files.push_back(includes[j]);
+  }
+  return files;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Gives the program just swapped in the block bindings and uniform values of
+// the one it replaces. Uniforms are matched by name, as their locations may
+// have changed; the names of the old locations come from the old program.
+/////////////////////////////////////////////////////////////////////////////
+void GLSLProgram::restoreState( GLuint oldHandle )
+{
+  for( size_t i = 0; i < uniformBlockBindings.size(); i++ ) {
+    GLuint index = gl::GetUniformBlockIndex(handle, uniformBlockBindings[i].first.c_str());
+    if( index != gl::INVALID_INDEX )
+      gl::UniformBlockBinding(handle, index, uniformBlockBindings[i].second);
+  }
+  for( size_t i = 0; i < storageBlockBindings.size(); i++ ) {
+    GLuint index = gl::GetProgramResourceIndex(handle, gl::SHADER_STORAGE_BLOCK, storageBlockBindings[i].first.c_str());
+    if( index != gl::INVALID_INDEX )
+      gl::ShaderStorageBlockBinding(handle, index, storageBlockBindings[i].second);
+  }
+
+  std::vector<UniformState> oldStates;
+  oldStates.swap(uniformStates);
+  uniformLocations.clear();
+
+  GLint numUniforms = 0;
+  gl::GetProgramInterfaceiv( oldHandle, gl::UNIFORM, gl::ACTIVE_RESOURCES, &numUniforms);
+  GLenum properties[] = {gl::NAME_LENGTH, gl::LOCATION, gl::ARRAY_SIZE};
+
+  for( int i = 0; i < numUniforms; ++i ) {
+    GLint results[3];
+    gl::GetProgramResourceiv(oldHandle, gl::UNIFORM, i, 3, properties, 3, NULL, results);
+    if( results[1] < 0 ) continue;    // In a block
+
+    std::vector<char> name(results[0] + 1);
+    gl::GetProgramResourceName(oldHandle, gl::UNIFORM, i, (GLsizei)name.size(), NULL, &name[0]);
+    string baseName(&name[0]);
+    if( results[2] > 1 && baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0 )
+      baseName.erase(baseName.size() - 3);
+
+    // Each element of an array has a location of its own
+    for( GLint element = 0; element < results[2]; element++ ) {
+      size_t oldLocation = (size_t)(results[1] + element);
+      if( oldLocation >= oldStates.size() || !oldStates[oldLocation].valid ) continue;
+
+      string elementName = baseName;
+      if( results[2] > 1 ) {
+        std::ostringstream indexed;
+        indexed << baseName << "[" << element << "]";
+        elementName = indexed.str();
+      }
+
+      const UniformState & state = oldStates[oldLocation];
+      GLint location = gl::GetUniformLocation(handle, elementName.c_str());
+      if( location < 0 ) continue;
+
+      switch( state.type ) {
+      case gl::FLOAT_VEC2: gl::ProgramUniform2fv(handle, location, 1, (const GLfloat *)state.value); break;
+      case gl::FLOAT_VEC3: gl::ProgramUniform3fv(handle, location, 1, (const GLfloat *)state.value); break;
+      case gl::FLOAT_VEC4: gl::ProgramUniform4fv(handle, location, 1, (const GLfloat *)state.value); break;
+      case gl::FLOAT_MAT3: gl::ProgramUniformMatrix3fv(handle, location, 1, FALSE, (const GLfloat *)state.value); break;
+      case gl::FLOAT_MAT4: gl::ProgramUniformMatrix4fv(handle, location, 1, FALSE, (const GLfloat *)state.value); break;
+      case gl::FLOAT: gl::ProgramUniform1fv(handle, location, 1, (const GLfloat *)state.value); break;
+      case gl::UNSIGNED_INT: gl::ProgramUniform1uiv(handle, location, 1, (const GLuint *)state.value); break;
+      default: gl::ProgramUniform1iv(handle, location, 1, (const GLint *)state.value); break;  // int, bool and samplers
+      }
+
+      if( location >= (GLint)uniformStates.size() ) {
+        UniformState unset;
+        unset.valid = false;
+        unset.size = 0;
+        uniformStates.resize(location + 1, unset);
+      }
+      uniformStates[location] = state;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// FNV-1a over the driver's identity and every stage, so a new driver or an
+// edited shader never picks up a stale binary.
+/////////////////////////////////////////////////////////////////////////////
+static void hashBytes( unsigned long long & hash, const void * data, size_t size )
+{
+  const unsigned char * bytes = (const unsigned char *)data;
+  for( size_t i = 0; i < size; i++ ) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+static void hashString( unsigned long long & hash, const char * text )
+{
+  if( text ) hashBytes(hash, text, strlen(text) + 1);
+}
+
+unsigned long long GLSLProgram::binaryKey( const std::vector<ShaderSource> & sources )
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  hashString(hash, (const char *)gl::GetString(gl::VENDOR));
+  hashString(hash, (const char *)gl::GetString(gl::RENDERER));
+  hashString(hash, (const char *)gl::GetString(gl::VERSION));
+  hashString(hash, (const char *)gl::GetString(gl::SHADING_LANGUAGE_VERSION));
+
+  for( size_t i = 0; i < sources.size(); i++ ) {
+    GLenum type = sources[i].type;
+    hashBytes(hash, &type, sizeof(type));
+    hashString(hash, sources[i].source.c_str());
+  }
+  return hash;
+}
+
+string GLSLProgram::binaryFileName( unsigned long long key )
+{
+  std::ostringstream name;
+  name << binaryCacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+  return name.str();
+}
+
+// Cache files start with this, followed by the key, the binary format and size, then the binary
+static const char binaryMagic[8] = { 'G', 'L', 'S', 'L', 'B', 'I', 'N', '1' };
+
+bool GLSLProgram::loadBinary( GLuint program, unsigned long long key )
+{
+  ifstream in( binaryFileName(key).c_str(), ios::in | ios::binary );
+  if( !in ) return false;
+
+  char magic[8];
+  unsigned long long fileKey = 0;
+  GLenum format = 0;
+  GLsizei length = 0;
+  in.read(magic, sizeof(magic));
+  in.read((char *)&fileKey, sizeof(fileKey));
+  in.read((char *)&format, sizeof(format));
+  in.read((char *)&length, sizeof(length));
+  if( !in || memcmp(magic, binaryMagic, sizeof(magic)) != 0 || fileKey != key || length <= 0 ) return false;
+
+  std::vector<char> binary(length);
+  in.read(&binary[0], length);
+  if( !in ) return false;
+
+  // The driver may still refuse it, e.g. after an update that kept its version string
+  gl::ProgramBinary(program, format, &binary[0], length);
+  int status = 0;
+  gl::GetProgramiv( program, gl::LINK_STATUS, &status);
+  if( FALSE == status ) {
+    binariesRejected++;
+    return false;
+  }
+
+  binariesLoaded++;
+  return true;
+}
+
+void GLSLProgram::saveBinary( GLuint program, unsigned long long key )
+{
+  GLint length = 0;
+  gl::GetProgramiv(program, gl::PROGRAM_BINARY_LENGTH, &length);
+  if( length <= 0 ) return;     // The driver has no binary formats
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  gl::GetProgramBinary(program, length, &length, &format, &binary[0]);
+
+  // Written to the side and renamed, so another instance never reads half a file
+  string fileName = binaryFileName(key);
+  string tempName = fileName + ".tmp";
+  {
+    std::ofstream out( tempName.c_str(), ios::out | ios::binary | ios::trunc );
+    if( !out ) return;      // Caching is only an optimisation
+    out.write(binaryMagic, sizeof(binaryMagic));
+    out.write((const char *)&key, sizeof(key));
+    out.write((const char *)&format, sizeof(format));
+    out.write((const char *)&length, sizeof(length));
+    out.write(&binary[0], length);
+    if( !out ) {
+      out.close();
+      remove(tempName.c_str());
+      return;
+    }
+  }
+  remove(fileName.c_str());
+  rename(tempName.c_str(), fileName.c_str());
+}
+
+void GLSLProgram::setBinaryCacheDirectory( const string & directory )
+{
+  binaryCacheDirectory = directory;
+  if( directory.empty() ) return;
+
+  // Fails harmlessly if it already exists
+#ifdef WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+}
+
+unsigned int GLSLProgram::getBinariesLoaded()
+{
+  return binariesLoaded;
+}
+
+unsigned int GLSLProgram::getBinariesRejected()
+{
+  return binariesRejected;
+}
+
+unsigned int GLSLProgram::getProgramsCompiled()
+{
+  return programsCompiled;
 }
 
 void GLSLProgram::use() throw(GLSLProgramException)
@@ -219,73 +665,193 @@ bool GLSLProgram::isLinked()
   return linked;
 }
 
+bool GLSLProgram::isFromBinaryCache() const
+{
+  return loadedFromCache;
+}
+
 void GLSLProgram::bindAttribLocation( GLuint location, const char * name)
 {
-  gl::BindAttribLocation(handle, location, name);
+  // Applied to the program object when it is linked
+  recordBinding(attribBindings, name, location);
 }
 
 void GLSLProgram::bindFragDataLocation( GLuint location, const char * name )
 {
-  gl::BindFragDataLocation(handle, location, name);
+  recordBinding(fragDataBindings, name, location);
+}
+
+void GLSLProgram::bindUniformBlock( const char * blockName, GLuint binding )
+{
+  recordBinding(uniformBlockBindings, blockName, binding);
+  GLuint index = gl::GetUniformBlockIndex(handle, blockName);
+  if( index != gl::INVALID_INDEX )
+    gl::UniformBlockBinding(handle, index, binding);
+}
+
+GLint GLSLProgram::getUniformBlockSize( const char * blockName )
+{
+  GLuint index = gl::GetUniformBlockIndex(handle, blockName);
+  if( index == gl::INVALID_INDEX ) return 0;
+
+  GLint size = 0;
+  gl::GetActiveUniformBlockiv(handle, index, gl::UNIFORM_BLOCK_DATA_SIZE, &size);
+  return size;
+}
+
+void GLSLProgram::bindShaderStorageBlock( const char * blockName, GLuint binding )
+{
+  recordBinding(storageBlockBindings, blockName, binding);
+  GLuint index = gl::GetProgramResourceIndex(handle, gl::SHADER_STORAGE_BLOCK, blockName);
+  if( index != gl::INVALID_INDEX )
+    gl::ShaderStorageBlockBinding(handle, index, binding);
 }
 
 void GLSLProgram::setUniform( const char *name, float x, float y, float z)
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform3f(loc,x,y,z);
+  setUniform(UniformHandle<vec3>(getUniformLocation(name)), vec3(x,y,z));
 }
 
 void GLSLProgram::setUniform( const char *name, const vec3 & v)
 {
-  this->setUniform(name,v.x,v.y,v.z);
+  setUniform(UniformHandle<vec3>(getUniformLocation(name)), v);
 }
 
 void GLSLProgram::setUniform( const char *name, const vec4 & v)
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform4f(loc,v.x,v.y,v.z,v.w);
+  setUniform(UniformHandle<vec4>(getUniformLocation(name)), v);
 }
 
 void GLSLProgram::setUniform( const char *name, const vec2 & v)
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform2f(loc,v.x,v.y);
+  setUniform(UniformHandle<vec2>(getUniformLocation(name)), v);
 }
 
 void GLSLProgram::setUniform( const char *name, const mat4 & m)
 {
-  GLint loc = getUniformLocation(name);
-  gl::UniformMatrix4fv(loc, 1, FALSE, &m[0][0]);
+  setUniform(UniformHandle<mat4>(getUniformLocation(name)), m);
 }
 
 void GLSLProgram::setUniform( const char *name, const mat3 & m)
 {
-  GLint loc = getUniformLocation(name);
-  gl::UniformMatrix3fv(loc, 1, FALSE, &m[0][0]);
+  setUniform(UniformHandle<mat3>(getUniformLocation(name)), m);
 }
 
 void GLSLProgram::setUniform( const char *name, float val )
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform1f(loc, val);
+  setUniform(UniformHandle<float>(getUniformLocation(name)), val);
 }
 
 void GLSLProgram::setUniform( const char *name, int val )
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform1i(loc, val);
+  setUniform(UniformHandle<int>(getUniformLocation(name)), val);
 }
 
 void GLSLProgram::setUniform( const char *name, GLuint val )
 {
-  GLint loc = getUniformLocation(name);
-  gl::Uniform1ui(loc, val);
+  setUniform(UniformHandle<GLuint>(getUniformLocation(name)), val);
 }
 
 void GLSLProgram::setUniform( const char *name, bool val )
 {
-  int loc = getUniformLocation(name);
-  gl::Uniform1i(loc, val);
+  setUniform(UniformHandle<bool>(getUniformLocation(name)), val);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<vec2> & u, const vec2 & v )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT_VEC2, &v, sizeof(v)) ) gl::Uniform2f(loc,v.x,v.y);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<vec3> & u, const vec3 & v )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT_VEC3, &v, sizeof(v)) ) gl::Uniform3f(loc,v.x,v.y,v.z);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<vec4> & u, const vec4 & v )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT_VEC4, &v, sizeof(v)) ) gl::Uniform4f(loc,v.x,v.y,v.z,v.w);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<mat4> & u, const mat4 & m )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT_MAT4, &m, sizeof(m)) ) gl::UniformMatrix4fv(loc, 1, FALSE, &m[0][0]);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<mat3> & u, const mat3 & m )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT_MAT3, &m, sizeof(m)) ) gl::UniformMatrix3fv(loc, 1, FALSE, &m[0][0]);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<float> & u, float val )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::FLOAT, &val, sizeof(val)) ) gl::Uniform1f(loc, val);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<int> & u, int val )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::INT, &val, sizeof(val)) ) gl::Uniform1i(loc, val);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<bool> & u, bool val )
+{
+  GLint loc = u.getLocation();
+  GLint i = val;
+  if( uniformChanged(loc, gl::BOOL, &i, sizeof(i)) ) gl::Uniform1i(loc, i);
+}
+
+void GLSLProgram::setUniform( const UniformHandle<GLuint> & u, GLuint val )
+{
+  GLint loc = u.getLocation();
+  if( uniformChanged(loc, gl::UNSIGNED_INT, &val, sizeof(val)) ) gl::Uniform1ui(loc, val);
+}
+
+bool GLSLProgram::uniformChanged( GLint location, GLenum type, const void * value, GLint size )
+{
+  // Uniforms that are not active are ignored by GL anyway
+  if( location < 0 ) return false;
+
+  if( location >= (GLint)uniformStates.size() ) {
+    UniformState unset;
+    unset.valid = false;
+    unset.size = 0;
+    uniformStates.resize(location + 1, unset);
+  }
+
+  UniformState & state = uniformStates[location];
+  if( state.valid && state.size == size && memcmp(state.value, value, size) == 0 ) {
+    uniformsElided++;
+    return false;
+  }
+
+  state.valid = true;
+  state.type = type;
+  state.size = size;
+  memcpy(state.value, value, size);
+  uniformUploads++;
+  return true;
+}
+
+unsigned int GLSLProgram::getUniformUploadCount() const
+{
+  return uniformUploads;
+}
+
+unsigned int GLSLProgram::getElidedUniformCount() const
+{
+  return uniformsElided;
+}
+
+void GLSLProgram::resetUniformCounters()
+{
+  uniformUploads = 0;
+  uniformsElided = 0;
 }
 
 void GLSLProgram::printActiveUniforms() {
@@ -404,36 +970,21 @@ void GLSLProgram::validate() throw(GLSLProgramException)
   gl::ValidateProgram( handle );
   gl::GetProgramiv( handle, gl::VALIDATE_STATUS, &status );
 
-  if( FALSE == status ) {
-    // Store log and return false
-    int length = 0;
-    string logString;
-
-    gl::GetProgramiv(handle, gl::INFO_LOG_LENGTH, &length );
-
-    if( length > 0 ) {
-      char * c_log = new char[length];
-      int written = 0;
-      gl::GetProgramInfoLog(handle, length, &written, c_log);
-      logString = c_log;
-      delete [] c_log;
-    }
-
-    throw GLSLProgramException(string("Program failed to validate\n") + logString);
-
-  }
+  if( FALSE == status )
+    throw GLSLProgramException(string("Program failed to validate\n") + getProgramLog(handle));
 }
 
 int GLSLProgram::getUniformLocation(const char * name )
 {
-  std::map<string, int>::iterator pos;
+  // The transparent comparator finds names without building a temporary string
+  std::map<string, int, std::less<> >::iterator pos;
   pos = uniformLocations.find(name);
 
   if( pos == uniformLocations.end() ) {
-    uniformLocations[name] = gl::GetUniformLocation(handle, name);
+    pos = uniformLocations.insert(std::make_pair(string(name), gl::GetUniformLocation(handle, name))).first;
   }
 
-  return uniformLocations[name];
+  return pos->second;
 }
 
 bool GLSLProgram::fileExists( const string & fileName )
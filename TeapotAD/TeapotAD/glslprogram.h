@@ -14,7 +14,9 @@
 
 #include <string>
 using std::string;
+#include <functional>
 #include <map>
+#include <vector>
 
 using glm::vec2;
 using glm::vec3;
@@ -30,6 +32,25 @@ class GLSLProgramException : public std::runtime_error {
       std::runtime_error(msg) { }
 };
 
+/**
+ A uniform location looked up once after link(), typed by the value it holds.
+
+ Setting a uniform through a handle needs no name lookup, so handles should
+ be used for anything set every frame.
+ */
+template <typename T>
+class UniformHandle {
+  public:
+    UniformHandle() : location(-1) { }
+    explicit UniformHandle( GLint loc ) : location(loc) { }
+
+    GLint getLocation() const { return location; }
+    bool  isActive() const { return location >= 0; }
+
+  private:
+    GLint location;
+};
+
 namespace GLSLShader {
   enum GLSLShaderType {
     VERTEX = gl::VERTEX_SHADER, 
@@ -44,13 +65,66 @@ namespace GLSLShader {
 class GLSLProgram
 {
   private:
+    // Last value uploaded to a uniform location, so unchanged values are not sent again
+    struct UniformState {
+      bool  valid;
+      GLenum type;              // GL type of the value, to upload it again after a reload
+      GLint size;               // Size of value in bytes
+      GLubyte value[sizeof(mat4)];
+    };
+
+    // A stage given to compileShader(), compiled by link() unless a cached binary is used
+    struct ShaderSource {
+      GLSLShader::GLSLShaderType type;
+      string source;
+      string fileName;
+      std::vector<string> includes;     // Files pulled in by #include, watched along with fileName
+    };
+
     int  handle;
     bool linked;
-    std::map<string, int> uniformLocations;
+    bool loadedFromCache;
+    std::vector<ShaderSource> sources;        // Stages given since the last link
+    std::vector<ShaderSource> shaderFiles;    // Types and files of the linked stages, for reload()
+    std::vector< std::pair<string, GLuint> > uniformBlockBindings;   // Reapplied after a reload
+    std::vector< std::pair<string, GLuint> > storageBlockBindings;
+    std::vector< std::pair<string, GLuint> > attribBindings;         // Applied before every link
+    std::vector< std::pair<string, GLuint> > fragDataBindings;
+
+    // A program being built by linkAsync() or reload(), swapped in once the driver is done
+    GLuint pendingHandle;
+    std::vector<GLuint> pendingShaders;
+    std::vector<ShaderSource> pendingStages;
+    GLsync pendingFence;        // Waited on when the driver cannot report completion itself
+    unsigned long long pendingKey;
+    bool pendingFromCache;
+    std::map<string, int, std::less<> > uniformLocations;
+    std::vector<UniformState> uniformStates;  // Indexed by uniform location
+    unsigned int uniformUploads;
+    unsigned int uniformsElided;
 
     GLint  getUniformLocation(const char * name );
+    bool   uniformChanged( GLint location, GLenum type, const void * value, GLint size );
     bool fileExists( const string & fileName );
     string getExtension( const char * fileName );
+    static string readShaderFile( const string & fileName, std::vector<string> & includes, int depth = 0 );
+
+    void   startBuild( const std::vector<ShaderSource> & stages );
+    bool   buildComplete();
+    void   finishBuild() throw (GLSLProgramException);
+    void   discardBuild();
+    void   restoreState( GLuint oldHandle );
+    static void deleteProgram( GLuint program );
+    static string getProgramLog( GLuint program );
+    static bool parallelCompileSupported();
+
+    static unsigned long long binaryKey( const std::vector<ShaderSource> & stages );
+    static string binaryFileName( unsigned long long key );
+    static bool loadBinary( GLuint program, unsigned long long key );
+    static void saveBinary( GLuint program, unsigned long long key );
+
+    static string binaryCacheDirectory;   // Empty when the cache is off
+    static unsigned int binariesLoaded, binariesRejected, programsCompiled;
 
     // Make these private in order to make the object non-copyable
     GLSLProgram( const GLSLProgram & other ) { }
@@ -60,21 +134,61 @@ class GLSLProgram
     GLSLProgram();
     ~GLSLProgram();
 
+    // The stages are compiled by link(), or not at all when the binary
+    // cache holds the linked program. Shader files may #include "name" other
+    // files, found in the same directory.
     void   compileShader( const char *fileName ) throw (GLSLProgramException);
     void   compileShader( const char * fileName, GLSLShader::GLSLShaderType type ) throw (GLSLProgramException);
     void   compileShader( const string & source, GLSLShader::GLSLShaderType type, 
         const char *fileName = NULL ) throw (GLSLProgramException);
 
     void   link() throw (GLSLProgramException);
+
+    // Compiles and links without waiting for the driver, which may build the
+    // program on threads of its own. poll() finishes the link once it is done.
+    void   linkAsync() throw (GLSLProgramException);
+
+    // Starts rebuilding a linked program from its shader files. The current
+    // program stays in use until poll() swaps in the new one, which keeps the
+    // block bindings and uniform values set so far. Uniform handles must be
+    // resolved again after the swap.
+    void   reload() throw (GLSLProgramException);
+
+    // Returns true if a linkAsync() or reload() has finished and the new
+    // program was swapped in by this call, false if it is still building or
+    // nothing was pending. Never blocks. A build that failed throws, leaving
+    // the previous program in use.
+    bool   poll() throw (GLSLProgramException);
+    bool   isPending() const;
+    std::vector<string> getShaderFiles() const;
     void   validate() throw(GLSLProgramException);
     void   use() throw (GLSLProgramException);
 
     int    getHandle();
     bool   isLinked();
+    bool   isFromBinaryCache() const;
+
+    // Linked programs are kept in this directory, keyed by a hash of their
+    // sources and the driver, and later links of the same sources load them
+    // instead of compiling. A binary the driver rejects is rebuilt from the
+    // sources. Pass an empty string to turn the cache off, as it is by default.
+    static void setBinaryCacheDirectory( const string & directory );
+
+    // Programs loaded from the cache, binaries rejected by the driver, and
+    // programs compiled from source, since the start.
+    static unsigned int getBinariesLoaded();
+    static unsigned int getBinariesRejected();
+    static unsigned int getProgramsCompiled();
 
     void   bindAttribLocation( GLuint location, const char * name);
     void   bindFragDataLocation( GLuint location, const char * name );
 
+    // Uniform blocks that are not active in the program are ignored, and
+    // report a size of 0.
+    void   bindUniformBlock( const char * blockName, GLuint binding );
+    GLint  getUniformBlockSize( const char * blockName );
+    void   bindShaderStorageBlock( const char * blockName, GLuint binding );
+
     void   setUniform( const char *name, float x, float y, float z);
     void   setUniform( const char *name, const vec2 & v);
     void   setUniform( const char *name, const vec3 & v);
@@ -86,6 +200,30 @@ class GLSLProgram
     void   setUniform( const char *name, bool val );
     void   setUniform( const char *name, GLuint val );
 
+    // Resolves a uniform name to a handle. The program must be linked, and
+    // handles must be resolved again if it is re-linked.
+    template <typename T>
+    UniformHandle<T> getUniformHandle( const char *name ) throw (GLSLProgramException) {
+      if( ! linked ) throw GLSLProgramException("Program is not linked");
+      return UniformHandle<T>(getUniformLocation(name));
+    }
+
+    void   setUniform( const UniformHandle<vec2> & u, const vec2 & v );
+    void   setUniform( const UniformHandle<vec3> & u, const vec3 & v );
+    void   setUniform( const UniformHandle<vec4> & u, const vec4 & v );
+    void   setUniform( const UniformHandle<mat4> & u, const mat4 & m );
+    void   setUniform( const UniformHandle<mat3> & u, const mat3 & m );
+    void   setUniform( const UniformHandle<float> & u, float val );
+    void   setUniform( const UniformHandle<int> & u, int val );
+    void   setUniform( const UniformHandle<bool> & u, bool val );
+    void   setUniform( const UniformHandle<GLuint> & u, GLuint val );
+
+    // Number of setUniform() calls that reached GL, and that were skipped
+    // because the value had not changed, since resetUniformCounters().
+    unsigned int getUniformUploadCount() const;
+    unsigned int getElidedUniformCount() const;
+    void   resetUniformCounters();
+
     void   printActiveUniforms();
     void   printActiveUniformBlocks();
     void   printActiveAttribs();
@@ -1,9 +1,13 @@
 
 #include "glutils.h"
 #include "gl_core_4_3.hpp"
+#include "headlesscontext.h"
+
+#include <glfw3.h>
 
 
 #include <cstdio>
+#include <cstring>
 
 GLUtils::GLUtils() {}
 
@@ -71,3 +75,18 @@ void GLUtils::dumpGLInfo(bool dumpExtensions) {
         }
     }
 }
+
+bool GLUtils::hasExtension(const char * name) {
+    GLint nExtensions = 0;
+    gl::GetIntegerv(gl::NUM_EXTENSIONS, &nExtensions);
+    for( int i = 0; i < nExtensions; i++ ) {
+        if( strcmp((const char *)gl::GetStringi(gl::EXTENSIONS, i), name) == 0 )
+            return true;
+    }
+    return false;
+}
+
+void * GLUtils::getProcAddress(const char * name) {
+    void * function = HeadlessContext::getProcAddress(name);
+    return function ? function : (void *)glfwGetProcAddress(name);
+}
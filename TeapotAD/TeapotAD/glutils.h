@@ -8,6 +8,10 @@ public:
 
     static int checkForOpenGLError(const char *, int);
     static void dumpGLInfo(bool dumpExtensions = false);
+    static bool hasExtension(const char * name);
+
+    // A GL function of the current context, made by GLFW or a HeadlessContext.
+    static void * getProcAddress(const char * name);
 };
 
 #endif // GLUTILS_H
@@ -0,0 +1,222 @@
+#include "headlesscontext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#define EGLAPIENTRY __stdcall
+#else
+#include <dlfcn.h>
+#define EGLAPIENTRY
+#endif
+
+// EGL is loaded at run time, so its headers are not needed, only these
+typedef int EGLint;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+
+static const EGLint EGL_NONE = 0x3038;
+static const EGLint EGL_EXTENSIONS = 0x3055;
+static const EGLint EGL_SURFACE_TYPE = 0x3033;
+static const EGLint EGL_PBUFFER_BIT = 0x0001;
+static const EGLint EGL_RENDERABLE_TYPE = 0x3040;
+static const EGLint EGL_OPENGL_BIT = 0x0008;
+static const EGLint EGL_WIDTH = 0x3057;
+static const EGLint EGL_HEIGHT = 0x3056;
+static const EGLenum EGL_OPENGL_API = 0x30A2;
+static const EGLenum EGL_PLATFORM_SURFACELESS_MESA = 0x31DD;
+static const EGLint EGL_CONTEXT_MAJOR_VERSION_KHR = 0x3098;
+static const EGLint EGL_CONTEXT_MINOR_VERSION_KHR = 0x30FB;
+static const EGLint EGL_CONTEXT_FLAGS_KHR = 0x30FC;
+static const EGLint EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR = 0x30FD;
+static const EGLint EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR = 0x0001;
+static const EGLint EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR = 0x0001;
+static const EGLint EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE_BIT_KHR = 0x0002;
+
+// The entry points used, looked up once the library is loaded
+namespace {
+    struct Egl {
+        void * (EGLAPIENTRY * GetProcAddress)(const char * name);
+        void * (EGLAPIENTRY * GetDisplay)(void * nativeDisplay);
+        void * (EGLAPIENTRY * GetPlatformDisplayEXT)(EGLenum platform, void * nativeDisplay, const EGLint * attribs);
+        EGLBoolean (EGLAPIENTRY * Initialize)(void * display, EGLint * major, EGLint * minor);
+        EGLBoolean (EGLAPIENTRY * Terminate)(void * display);
+        const char * (EGLAPIENTRY * QueryString)(void * display, EGLint name);
+        EGLBoolean (EGLAPIENTRY * ChooseConfig)(void * display, const EGLint * attribs, void ** configs, EGLint size, EGLint * count);
+        EGLBoolean (EGLAPIENTRY * BindAPI)(EGLenum api);
+        void * (EGLAPIENTRY * CreateContext)(void * display, void * config, void * shareContext, const EGLint * attribs);
+        EGLBoolean (EGLAPIENTRY * DestroyContext)(void * display, void * context);
+        void * (EGLAPIENTRY * CreatePbufferSurface)(void * display, void * config, const EGLint * attribs);
+        EGLBoolean (EGLAPIENTRY * DestroySurface)(void * display, void * surface);
+        EGLBoolean (EGLAPIENTRY * MakeCurrent)(void * display, void * draw, void * read, void * context);
+        EGLint (EGLAPIENTRY * GetError)();
+    };
+
+    Egl egl;
+    bool eglLoaded = false;     // True while a HeadlessContext exists
+
+    void * loadLibrary()
+    {
+#ifdef _WIN32
+        return (void *)LoadLibraryA("libEGL.dll");
+#else
+        void * library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+        return library ? library : dlopen("libEGL.so", RTLD_NOW | RTLD_LOCAL);
+#endif
+    }
+
+    void freeLibrary(void * library)
+    {
+#ifdef _WIN32
+        FreeLibrary((HMODULE)library);
+#else
+        dlclose(library);
+#endif
+    }
+
+    template <typename T> void loadSymbol(void * library, const char * name, T & function)
+    {
+#ifdef _WIN32
+        function = (T)GetProcAddress((HMODULE)library, name);
+#else
+        function = (T)dlsym(library, name);
+#endif
+        if (function == NULL)
+            throw std::runtime_error(std::string("libEGL has no ") + name);
+    }
+
+    // Whether the space separated list names the extension
+    bool hasExtension(const char * extensions, const char * name)
+    {
+        if (extensions == NULL) return false;
+        size_t length = strlen(name);
+        for (const char * p = strstr(extensions, name); p != NULL; p = strstr(p + length, name)) {
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+
+    std::string errorMessage(const char * what)
+    {
+        char code[16];
+        sprintf(code, "0x%04X", egl.GetError());
+        return std::string(what) + " failed with EGL error " + code;
+    }
+}
+
+HeadlessContext::HeadlessContext() : library(NULL), display(NULL), context(NULL), surface(NULL)
+{
+    if (eglLoaded)
+        throw std::runtime_error("Only one headless context can exist at a time");
+
+    library = loadLibrary();
+    if (library == NULL)
+        throw std::runtime_error("libEGL could not be loaded");
+
+    try {
+        loadSymbol(library, "eglGetProcAddress", egl.GetProcAddress);
+        loadSymbol(library, "eglGetDisplay", egl.GetDisplay);
+        loadSymbol(library, "eglInitialize", egl.Initialize);
+        loadSymbol(library, "eglTerminate", egl.Terminate);
+        loadSymbol(library, "eglQueryString", egl.QueryString);
+        loadSymbol(library, "eglChooseConfig", egl.ChooseConfig);
+        loadSymbol(library, "eglBindAPI", egl.BindAPI);
+        loadSymbol(library, "eglCreateContext", egl.CreateContext);
+        loadSymbol(library, "eglDestroyContext", egl.DestroyContext);
+        loadSymbol(library, "eglCreatePbufferSurface", egl.CreatePbufferSurface);
+        loadSymbol(library, "eglDestroySurface", egl.DestroySurface);
+        loadSymbol(library, "eglMakeCurrent", egl.MakeCurrent);
+        loadSymbol(library, "eglGetError", egl.GetError);
+
+        // The surfaceless platform needs no display server, the default display may
+        const char * clientExtensions = egl.QueryString(NULL, EGL_EXTENSIONS);
+        if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless") && hasExtension(clientExtensions, "EGL_EXT_platform_base")) {
+            *(void **)&egl.GetPlatformDisplayEXT = egl.GetProcAddress("eglGetPlatformDisplayEXT");
+            if (egl.GetPlatformDisplayEXT != NULL)
+                display = egl.GetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+        }
+        if (display == NULL)
+            display = egl.GetDisplay(NULL);
+        if (display == NULL)
+            throw std::runtime_error("No EGL display is available");
+
+        EGLint major, minor;
+        if (!egl.Initialize(display, &major, &minor)) {
+            display = NULL;
+            throw std::runtime_error(errorMessage("eglInitialize"));
+        }
+
+        const char * extensions = egl.QueryString(display, EGL_EXTENSIONS);
+        if (!hasExtension(extensions, "EGL_KHR_create_context"))
+            throw std::runtime_error("EGL cannot create OpenGL 4.3 core contexts without EGL_KHR_create_context");
+        bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context");
+
+        // Only a pbuffer needs a surface type, the framebuffers are the application's own
+        const EGLint configAttribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_NONE
+        };
+        void * config = NULL;
+        EGLint configs = 0;
+        if (!egl.ChooseConfig(display, configAttribs, &config, 1, &configs) || configs == 0)
+            throw std::runtime_error("EGL has no configuration for desktop OpenGL");
+
+        // The same context GLFW is asked for: 4.3, forward compatible core profile, with debug output
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+            EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+            EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE_BIT_KHR | EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+            EGL_NONE
+        };
+        if (!egl.BindAPI(EGL_OPENGL_API))
+            throw std::runtime_error(errorMessage("eglBindAPI"));
+        context = egl.CreateContext(display, config, NULL, contextAttribs);
+        if (context == NULL)
+            throw std::runtime_error(errorMessage("Creating an OpenGL 4.3 core context"));
+
+        if (!surfaceless) {
+            const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = egl.CreatePbufferSurface(display, config, pbufferAttribs);
+            if (surface == NULL)
+                throw std::runtime_error(errorMessage("eglCreatePbufferSurface"));
+        }
+        if (!egl.MakeCurrent(display, surface, surface, context))
+            throw std::runtime_error(errorMessage("eglMakeCurrent"));
+    }
+    catch (...) {
+        release();
+        throw;
+    }
+    eglLoaded = true;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    release();
+    eglLoaded = false;
+}
+
+void HeadlessContext::release()
+{
+    if (display != NULL) {
+        egl.MakeCurrent(display, NULL, NULL, NULL);
+        if (surface != NULL) egl.DestroySurface(display, surface);
+        if (context != NULL) egl.DestroyContext(display, context);
+        egl.Terminate(display);
+    }
+    freeLibrary(library);
+    library = display = context = surface = NULL;
+}
+
+void * HeadlessContext::getProcAddress(const char * name)
+{
+    return eglLoaded ? egl.GetProcAddress(name) : NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef HEADLESSCONTEXT_H
+#define HEADLESSCONTEXT_H
+
+/**
+ An OpenGL 4.3 core context with no window, created through EGL.
+
+ Where libEGL offers EGL_MESA_platform_surfaceless, as Mesa does for every
+ driver including llvmpipe, no display server is needed at all; otherwise
+ the default EGL display is used. The context is made current without a
+ surface if EGL_KHR_surfaceless_context allows it and with a 1x1 pbuffer if
+ not, so everything has to be drawn into a framebuffer object such as
+ OffscreenTarget.
+
+ libEGL is loaded when the context is created rather than linked, so a
+ machine without it only loses this context: the constructor throws and
+ the caller can open a window instead. While it exists, the GL functions
+ are looked up through eglGetProcAddress.
+ */
+class HeadlessContext
+{
+private:
+    void * library;     // libEGL
+    void * display;
+    void * context;
+    void * surface;     // The pbuffer, NULL when surfaceless
+
+    void release();
+
+    // Non-copyable, the context is owned by this instance
+    HeadlessContext( const HeadlessContext & ) { }
+    HeadlessContext & operator=( const HeadlessContext & ) { return *this; }
+
+public:
+    // Creates the context and makes it current on the calling thread.
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // A GL function of the context, NULL if no HeadlessContext exists.
+    static void * getProcAddress(const char * name);
+};
+
+#endif // HEADLESSCONTEXT_H
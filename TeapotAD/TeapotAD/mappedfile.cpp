@@ -0,0 +1,80 @@
+#include "mappedfile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string & path) : data(NULL), size(0)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Unable to open " + path);
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to get the size of " + path);
+    }
+    size = (size_t)fileSize.QuadPart;
+
+    // The view keeps the mapping and the file open once both handles are closed
+    if (size > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        throw std::runtime_error("Unable to open " + path);
+
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        throw std::runtime_error("Unable to get the size of " + path);
+    }
+    size = (size_t)info.st_size;
+
+    if (size > 0) {
+        void * view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) data = (const unsigned char *)view;
+    }
+    close(file);
+#endif
+
+    if (size > 0 && !data)
+        throw std::runtime_error("Unable to map " + path + " into memory");
+}
+
+MappedFile::~MappedFile()
+{
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap((void *)data, size);
+#endif
+}
+
+const unsigned char * MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
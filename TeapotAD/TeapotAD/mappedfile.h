@@ -0,0 +1,33 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ A whole file mapped read-only into memory.
+
+ Pages are read by the operating system as they are first touched, straight
+ from its file cache, so a decoder reading the file does not need a buffer
+ of its own or a copy through read calls. The mapping stays valid until the
+ MappedFile is destroyed. Empty files have no data.
+ */
+class MappedFile
+{
+private:
+    const unsigned char * data;
+    size_t size;
+
+    // Non-copyable, the mapping is owned by this instance
+    MappedFile( const MappedFile & ) { }
+    MappedFile & operator=( const MappedFile & ) { return *this; }
+
+public:
+    explicit MappedFile(const std::string & path);
+    ~MappedFile();
+
+    const unsigned char * getData() const;
+    size_t getSize() const;
+};
+
+#endif // MAPPEDFILE_H
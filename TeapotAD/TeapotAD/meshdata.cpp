@@ -0,0 +1,139 @@
+#include "meshdata.h"
+
+#include <algorithm>
+
+#include <glm.hpp>
+#include <gtc/packing.hpp>
+
+namespace
+{
+    // One vertex in VertexFormat::COMPACT
+    struct CompactVertex {
+        glm::uint64 position;   // Four half floats, w is 1
+        glm::uint32 normal;     // Signed normalised 10_10_10_2, w unused
+        glm::uint32 texCoord;   // Two unsigned normalised shorts
+    };
+}
+
+void MeshData::resize(unsigned int vertices, unsigned int triangles)
+{
+    positions.resize(3 * vertices);
+    normals.resize(3 * vertices);
+    texCoords.resize(2 * vertices);
+    indices.resize(3 * triangles);
+}
+
+unsigned int MeshData::getVertexCount() const
+{
+    return (unsigned int)(positions.size() / 3);
+}
+
+unsigned int MeshData::getIndexCount() const
+{
+    return (unsigned int)indices.size();
+}
+
+GLenum MeshData::getIndexType() const
+{
+    if (indices.empty() || *std::max_element(indices.begin(), indices.end()) <= 0xFFFF)
+        return gl::UNSIGNED_SHORT;
+    return gl::UNSIGNED_INT;
+}
+
+GLsizei MeshData::indexSize(GLenum indexType)
+{
+    return indexType == gl::UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+GLsizei MeshData::vertexSize(VertexFormat::Format format)
+{
+    if (format == VertexFormat::COMPACT) return sizeof(CompactVertex);
+    return 8 * sizeof(float);
+}
+
+GLuint MeshData::createVertexArray(VertexFormat::Format format, GLuint * bufferHandles) const
+{
+    GLuint vaoHandle;
+    gl::GenVertexArrays( 1, &vaoHandle );
+    gl::BindVertexArray(vaoHandle);
+
+    unsigned int handle[4] = { 0, 0, 0, 0 };
+    unsigned int vertices = getVertexCount();
+
+    if (format == VertexFormat::SEPARATE) {
+        gl::GenBuffers(4, handle);
+
+        gl::BindBuffer(gl::ARRAY_BUFFER, handle[0]);
+        gl::BufferData(gl::ARRAY_BUFFER, positions.size() * sizeof(float), &positions[0], gl::STATIC_DRAW);
+        gl::VertexAttribPointer( (GLuint)0, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
+        gl::EnableVertexAttribArray(0);  // Vertex position
+
+        gl::BindBuffer(gl::ARRAY_BUFFER, handle[1]);
+        gl::BufferData(gl::ARRAY_BUFFER, normals.size() * sizeof(float), &normals[0], gl::STATIC_DRAW);
+        gl::VertexAttribPointer( (GLuint)1, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
+        gl::EnableVertexAttribArray(1);  // Vertex normal
+
+        gl::BindBuffer(gl::ARRAY_BUFFER, handle[2]);
+        gl::BufferData(gl::ARRAY_BUFFER, texCoords.size() * sizeof(float), &texCoords[0], gl::STATIC_DRAW);
+        gl::VertexAttribPointer( (GLuint)2, 2, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
+        gl::EnableVertexAttribArray(2);  // Texture coords
+    }
+    else if (format == VertexFormat::INTERLEAVED) {
+        std::vector<float> data(8 * vertices);
+        for (unsigned int i = 0; i < vertices; i++) {
+            float * v = &data[8 * i];
+            v[0] = positions[3*i]; v[1] = positions[3*i+1]; v[2] = positions[3*i+2];
+            v[3] = normals[3*i];   v[4] = normals[3*i+1];   v[5] = normals[3*i+2];
+            v[6] = texCoords[2*i]; v[7] = texCoords[2*i+1];
+        }
+
+        gl::GenBuffers(1, &handle[0]);
+        gl::GenBuffers(1, &handle[3]);
+
+        GLsizei stride = vertexSize(format);
+        gl::BindBuffer(gl::ARRAY_BUFFER, handle[0]);
+        gl::BufferData(gl::ARRAY_BUFFER, data.size() * sizeof(float), &data[0], gl::STATIC_DRAW);
+        gl::VertexAttribPointer( (GLuint)0, 3, gl::FLOAT, FALSE, stride, ((GLubyte *)NULL + (0)) );
+        gl::EnableVertexAttribArray(0);  // Vertex position
+        gl::VertexAttribPointer( (GLuint)1, 3, gl::FLOAT, FALSE, stride, ((GLubyte *)NULL + (3 * sizeof(float))) );
+        gl::EnableVertexAttribArray(1);  // Vertex normal
+        gl::VertexAttribPointer( (GLuint)2, 2, gl::FLOAT, FALSE, stride, ((GLubyte *)NULL + (6 * sizeof(float))) );
+        gl::EnableVertexAttribArray(2);  // Texture coords
+    }
+    else {
+        std::vector<CompactVertex> data(vertices);
+        for (unsigned int i = 0; i < vertices; i++) {
+            data[i].position = glm::packHalf4x16(glm::vec4(positions[3*i], positions[3*i+1], positions[3*i+2], 1.0f));
+            data[i].normal = glm::packSnorm3x10_1x2(glm::vec4(normals[3*i], normals[3*i+1], normals[3*i+2], 0.0f));
+            data[i].texCoord = glm::packUnorm2x16(glm::vec2(texCoords[2*i], texCoords[2*i+1]));
+        }
+
+        gl::GenBuffers(1, &handle[0]);
+        gl::GenBuffers(1, &handle[3]);
+
+        GLsizei stride = vertexSize(format);
+        gl::BindBuffer(gl::ARRAY_BUFFER, handle[0]);
+        gl::BufferData(gl::ARRAY_BUFFER, data.size() * sizeof(CompactVertex), &data[0], gl::STATIC_DRAW);
+        gl::VertexAttribPointer( (GLuint)0, 4, gl::HALF_FLOAT, FALSE, stride, ((GLubyte *)NULL + (0)) );
+        gl::EnableVertexAttribArray(0);  // Vertex position
+        gl::VertexAttribPointer( (GLuint)1, 4, gl::INT_2_10_10_10_REV, TRUE, stride, ((GLubyte *)NULL + (8)) );
+        gl::EnableVertexAttribArray(1);  // Vertex normal
+        gl::VertexAttribPointer( (GLuint)2, 2, gl::UNSIGNED_SHORT, TRUE, stride, ((GLubyte *)NULL + (12)) );
+        gl::EnableVertexAttribArray(2);  // Texture coords
+    }
+
+    gl::BindBuffer(gl::ELEMENT_ARRAY_BUFFER, handle[3]);
+    if (getIndexType() == gl::UNSIGNED_SHORT) {
+        std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+        gl::BufferData(gl::ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), &shortIndices[0], gl::STATIC_DRAW);
+    } else {
+        gl::BufferData(gl::ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], gl::STATIC_DRAW);
+    }
+
+    gl::BindVertexArray(0);
+
+    if (bufferHandles != NULL)
+        for (int i = 0; i < 4; i++) bufferHandles[i] = handle[i];
+
+    return vaoHandle;
+}
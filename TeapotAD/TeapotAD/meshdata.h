@@ -0,0 +1,63 @@
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+#include "gl_core_4_3.hpp"
+
+#include <vector>
+
+namespace VertexFormat {
+    // How the vertices of a mesh are laid out in GL buffers
+    enum Format {
+        SEPARATE,       // Three float streams: position, normal, texture coordinates (32 bytes)
+        INTERLEAVED,    // The same floats interleaved in one stream (32 bytes)
+        COMPACT         // One stream of half float positions, 10_10_10_2 normals and unorm16 texture coordinates (16 bytes)
+    };
+}
+
+/**
+ The vertices and triangle indices of a mesh while it is on the CPU.
+
+ Mesh builders (VBOTeapot, VBOPlane) fill one of these, then either upload
+ it into a vertex array of its own or add it to a shared GeometryArena.
+ */
+class MeshData
+{
+public:
+    std::vector<float> positions;       // 3 floats per vertex
+    std::vector<float> normals;         // 3 floats per vertex
+    std::vector<float> texCoords;       // 2 floats per vertex, in [0,1]
+    std::vector<unsigned int> indices;  // 3 per triangle
+
+    void resize(unsigned int vertices, unsigned int triangles);
+
+    unsigned int getVertexCount() const;
+    unsigned int getIndexCount() const;
+
+    // gl::UNSIGNED_SHORT if every index fits in 16 bits, else gl::UNSIGNED_INT.
+    // Indices are relative to the mesh, so this holds in a GeometryArena too.
+    GLenum getIndexType() const;
+
+    // Uploads the mesh into new buffers and returns a vertex array that
+    // reads them with the attribute layout the shaders expect. If
+    // bufferHandles is given it receives the four buffers created, unused
+    // ones are 0. The indices are uploaded as getIndexType().
+    GLuint createVertexArray(VertexFormat::Format format = VertexFormat::SEPARATE, GLuint * bufferHandles = NULL) const;
+
+    // Bytes of vertex data per vertex in the given format.
+    static GLsizei vertexSize(VertexFormat::Format format);
+
+    // Bytes per index of gl::UNSIGNED_SHORT or gl::UNSIGNED_INT.
+    static GLsizei indexSize(GLenum indexType);
+};
+
+/**
+ The part of a shared vertex and index buffer that holds one mesh.
+ */
+struct MeshRange
+{
+    GLuint firstIndex;      // First index of the mesh in the index buffer
+    GLuint indexCount;
+    GLint  baseVertex;      // Added to every index of the mesh
+};
+
+#endif // MESHDATA_H
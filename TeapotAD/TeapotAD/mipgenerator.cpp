@@ -0,0 +1,203 @@
+#include "mipgenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function, other compilers only when building for them.
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define MIP_AVX2_KERNEL
+#endif
+
+namespace
+{
+    // sRGB to and from 16-bit linear values, built once. The encoding table
+    // has 3 bytes of padding so a gather can read 4 bytes at its last entry.
+    struct GammaTables {
+        int toLinear[256];
+        unsigned char toSrgb[65536 + 3];
+
+        GammaTables()
+        {
+            for (int i = 0; i < 256; i++) {
+                double c = i / 255.0;
+                double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                toLinear[i] = (int)(linear * 65535.0 + 0.5);
+            }
+            for (int i = 0; i < 65536; i++) {
+                double linear = i / 65535.0;
+                double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                toSrgb[i] = (unsigned char)(c * 255.0 + 0.5);
+            }
+            toSrgb[65536] = toSrgb[65537] = toSrgb[65538] = 0;
+        }
+    };
+
+    const GammaTables & gammaTables()
+    {
+        static const GammaTables tables;
+        return tables;
+    }
+
+    // Output pixels first to last of one row, from source rows a and b
+    void downsampleScalar(const unsigned char * a, const unsigned char * b, int width, unsigned char * dest, int first, int last)
+    {
+        const GammaTables & t = gammaTables();
+        for (int x = first; x < last; x++, dest += 4) {
+            int x0 = 2 * x * 4;
+            int x1 = std::min(2 * x + 1, width - 1) * 4;
+            for (int c = 0; c < 3; c++) {
+                int sum = t.toLinear[a[x0 + c]] + t.toLinear[a[x1 + c]] + t.toLinear[b[x0 + c]] + t.toLinear[b[x1 + c]];
+                dest[c] = t.toSrgb[(sum + 2) >> 2];
+            }
+            dest[3] = (unsigned char)((a[x0 + 3] + a[x1 + 3] + b[x0 + 3] + b[x1 + 3] + 2) >> 2);
+        }
+    }
+
+#ifdef MIP_AVX2_KERNEL
+    // Two source pixels from each row, summed in linear light; alpha lanes keep their bytes
+    inline __m256i linearSum(const unsigned char * a, const unsigned char * b, const int * toLinear)
+    {
+        __m256i ia = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)a));
+        __m256i ib = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)b));
+        __m256i la = _mm256_blend_epi32(_mm256_i32gather_epi32(toLinear, ia, 4), ia, 0x88);
+        __m256i lb = _mm256_blend_epi32(_mm256_i32gather_epi32(toLinear, ib, 4), ib, 0x88);
+        return _mm256_add_epi32(la, lb);
+    }
+
+    // Two output pixels from the sums of source pixels 0 and 1, and 2 and 3
+    inline __m256i average(__m256i s01, __m256i s23, const unsigned char * toSrgb)
+    {
+        __m256i even = _mm256_permute2x128_si256(s01, s23, 0x20);
+        __m256i odd = _mm256_permute2x128_si256(s01, s23, 0x31);
+        __m256i mean = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(even, odd), _mm256_set1_epi32(2)), 2);
+        __m256i srgb = _mm256_and_si256(_mm256_i32gather_epi32((const int *)toSrgb, mean, 1), _mm256_set1_epi32(0xFF));
+        return _mm256_blend_epi32(srgb, mean, 0x88);
+    }
+
+    // Returns the output pixels done, whole groups of 4 that have all 8 source pixels
+    int downsampleAvx2(const unsigned char * a, const unsigned char * b, int width, unsigned char * dest, int first, int last)
+    {
+        const GammaTables & t = gammaTables();
+        int x = first;
+        for (; x + 4 <= last && 2 * (x + 4) <= width; x += 4) {
+            const unsigned char * pa = a + 8 * x;
+            const unsigned char * pb = b + 8 * x;
+            __m256i p01 = average(linearSum(pa, pb, t.toLinear), linearSum(pa + 8, pb + 8, t.toLinear), t.toSrgb);
+            __m256i p23 = average(linearSum(pa + 16, pb + 16, t.toLinear), linearSum(pa + 24, pb + 24, t.toLinear), t.toSrgb);
+
+            // Lanes hold pixels 0 and 2, then 1 and 3, once packed to 16 bits
+            __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(p01, p23), _MM_SHUFFLE(3, 1, 2, 0));
+            __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i *)(dest + 4 * (x - first)), _mm256_castsi256_si128(bytes));
+        }
+        return x - first;
+    }
+#endif
+}
+
+MipGenerator::MipGenerator(ThreadPool * pool, Kernel kernel) : pool(pool), kernel(kernel)
+{
+#ifndef MIP_AVX2_KERNEL
+    if (this->kernel == AVX2) this->kernel = SCALAR;
+#endif
+    gammaTables();
+}
+
+void MipGenerator::downsample(const unsigned char * src, int width, int height, unsigned char * dest) const
+{
+    int destWidth = levelSize(width, 1);
+    int destHeight = levelSize(height, 1);
+    const size_t srcStride = (size_t)width * 4;
+    const size_t destStride = (size_t)destWidth * 4;
+
+    auto rows = [&](int first, int last) {
+        for (int y = first; y < last; y++) {
+            const unsigned char * a = src + 2 * y * srcStride;
+            const unsigned char * b = src + std::min(2 * y + 1, height - 1) * srcStride;
+            unsigned char * d = dest + y * destStride;
+
+            int done = 0;
+#ifdef MIP_AVX2_KERNEL
+            if (kernel == AVX2) done = downsampleAvx2(a, b, width, d, 0, destWidth);
+#endif
+            downsampleScalar(a, b, width, d + 4 * done, done, destWidth);
+        }
+    };
+
+    if (!pool || destHeight < 2) {
+        rows(0, destHeight);
+        return;
+    }
+
+    int bands = std::min(destHeight, pool->getThreadCount() * 4);
+    pool->parallelFor(bands, [&](int band) {
+        rows((int)((long long)destHeight * band / bands), (int)((long long)destHeight * (band + 1) / bands));
+    });
+}
+
+void MipGenerator::generate(const unsigned char * src, int width, int height, std::vector< std::vector<unsigned char> > & levels) const
+{
+    int count = levelCount(width, height);
+    levels.resize(count - 1);
+    for (int level = 1; level < count; level++) {
+        const unsigned char * above = level == 1 ? src : &levels[level - 2][0];
+        int aboveWidth = levelSize(width, level - 1);
+        int aboveHeight = levelSize(height, level - 1);
+
+        levels[level - 1].resize((size_t)levelSize(width, level) * levelSize(height, level) * 4);
+        downsample(above, aboveWidth, aboveHeight, &levels[level - 1][0]);
+    }
+}
+
+MipGenerator::Kernel MipGenerator::getKernel() const
+{
+    return kernel;
+}
+
+int MipGenerator::levelCount(int width, int height)
+{
+    int count = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        count++;
+    return count;
+}
+
+int MipGenerator::levelSize(int size, int level)
+{
+    return std::max(1, size >> level);
+}
+
+MipGenerator::Kernel MipGenerator::bestKernel()
+{
+#if defined(_MSC_VER)
+    // AVX2 needs the CPU to support it and the OS to save the YMM registers.
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+            return AVX2;
+    }
+#elif defined(MIP_AVX2_KERNEL)
+    return AVX2;
+#endif
+    return SCALAR;
+}
+
+const char * MipGenerator::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
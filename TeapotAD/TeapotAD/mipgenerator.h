@@ -0,0 +1,56 @@
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include "threadpool.h"
+
+#include <vector>
+
+/**
+ Builds the mip levels of RGBA8 images whose colour channels are sRGB.
+
+ Each pixel of a level is the average of 2x2 pixels of the one above,
+ taken in linear light: red, green and blue go through a table to 16-bit
+ linear values, are averaged, and come back through a second table, so a
+ level keeps the brightness of the one above instead of darkening where
+ light and dark pixels meet. Alpha is averaged as it is. An odd width or
+ height drops its last column or row, as GL's level sizes do.
+
+ The AVX2 kernel does both table lookups with gathers, 4 output pixels at
+ a time, and gives exactly the same bytes as the scalar one. Levels can be
+ split into bands of rows over a ThreadPool.
+ */
+class MipGenerator
+{
+public:
+    enum Kernel {
+        SCALAR,
+        AVX2
+    };
+
+private:
+    ThreadPool * pool;  // NULL to downsample on the calling thread
+    Kernel kernel;
+
+public:
+    MipGenerator(ThreadPool * pool = NULL, Kernel kernel = bestKernel());
+
+    // Writes the next level of a width x height image to dest, which holds
+    // levelSize(width, 1) x levelSize(height, 1) pixels.
+    void downsample(const unsigned char * src, int width, int height, unsigned char * dest) const;
+
+    // Every level below the given image, down to 1x1. levels[0] is level 1.
+    void generate(const unsigned char * src, int width, int height, std::vector< std::vector<unsigned char> > & levels) const;
+
+    Kernel getKernel() const;
+
+    // Levels of a full chain, including level 0
+    static int levelCount(int width, int height);
+
+    // Width or height of a level
+    static int levelSize(int size, int level);
+
+    static Kernel bestKernel();     // The widest kernel this CPU and the build support
+    static const char * kernelName(Kernel kernel);
+};
+
+#endif // MIPGENERATOR_H
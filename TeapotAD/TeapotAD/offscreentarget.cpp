@@ -0,0 +1,61 @@
+#include "offscreentarget.h"
+
+#include <stdexcept>
+
+OffscreenTarget::OffscreenTarget(int w, int h) : width(w), height(h)
+{
+    if( width <= 0 || height <= 0 )
+        throw std::runtime_error("Offscreen target must have a positive size");
+
+    gl::GenRenderbuffers(1, &colourBuffer);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, colourBuffer);
+    gl::RenderbufferStorage(gl::RENDERBUFFER, gl::RGBA8, width, height);
+
+    gl::GenRenderbuffers(1, &depthBuffer);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, depthBuffer);
+    gl::RenderbufferStorage(gl::RENDERBUFFER, gl::DEPTH_COMPONENT24, width, height);
+    gl::BindRenderbuffer(gl::RENDERBUFFER, 0);
+
+    gl::GenFramebuffers(1, &fboHandle);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0, gl::RENDERBUFFER, colourBuffer);
+    gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT, gl::RENDERBUFFER, depthBuffer);
+
+    GLenum status = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+
+    if( status != gl::FRAMEBUFFER_COMPLETE ) {
+        gl::DeleteFramebuffers(1, &fboHandle);
+        gl::DeleteRenderbuffers(1, &colourBuffer);
+        gl::DeleteRenderbuffers(1, &depthBuffer);
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+    }
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    gl::DeleteFramebuffers(1, &fboHandle);
+    gl::DeleteRenderbuffers(1, &colourBuffer);
+    gl::DeleteRenderbuffers(1, &depthBuffer);
+}
+
+void OffscreenTarget::bind() const
+{
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fboHandle);
+    gl::Viewport(0, 0, width, height);
+}
+
+void OffscreenTarget::unbind() const
+{
+    gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+}
+
+int OffscreenTarget::getWidth() const
+{
+    return width;
+}
+
+int OffscreenTarget::getHeight() const
+{
+    return height;
+}
@@ -0,0 +1,35 @@
+#ifndef OFFSCREENTARGET_H
+#define OFFSCREENTARGET_H
+
+#include "gl_core_4_3.hpp"
+
+/**
+ A framebuffer object with a colour and a depth attachment.
+
+ Lets the scene be rendered without presenting to a window, e.g. when
+ benchmarking on a machine with no display.
+ */
+class OffscreenTarget
+{
+private:
+    GLuint fboHandle;
+    GLuint colourBuffer;
+    GLuint depthBuffer;
+    int width, height;
+
+    // Non-copyable, the GL objects are owned by this instance
+    OffscreenTarget( const OffscreenTarget & ) { }
+    OffscreenTarget & operator=( const OffscreenTarget & ) { return *this; }
+
+public:
+    OffscreenTarget(int width, int height);
+    ~OffscreenTarget();
+
+    void bind() const;      // Render into this target
+    void unbind() const;    // Render into the default framebuffer again
+
+    int getWidth() const;
+    int getHeight() const;
+};
+
+#endif // OFFSCREENTARGET_H
@@ -0,0 +1,371 @@
+#include "pixelconverter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC accepts SSSE3 and AVX2 intrinsics in any function, other compilers only when building for them.
+#if defined(_MSC_VER) || defined(__SSSE3__)
+#define PIXEL_SSSE3_KERNEL
+#endif
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define PIXEL_AVX2_KERNEL
+#endif
+
+namespace
+{
+    enum { AVERAGE = -2, OPAQUE = -1 };
+
+    // The source channel a destination channel is copied from, OPAQUE for an
+    // alpha of 255 or AVERAGE for gray from red, green and blue.
+    constexpr int channelSource(int srcChannels, int destChannels, int channel)
+    {
+        if ((destChannels == 2 || destChannels == 4) && channel == destChannels - 1)
+            return srcChannels == 2 ? 1 : srcChannels == 4 ? 3 : OPAQUE;
+        if (srcChannels < 3) return 0;
+        return destChannels >= 3 ? channel : AVERAGE;
+    }
+
+    template <int S, int D>
+    void convertScalar(const unsigned char * src, unsigned char * dest, int width)
+    {
+        for (int i = 0; i < width; i++, src += S, dest += D) {
+            for (int c = 0; c < D; c++) {
+                int from = channelSource(S, D, c);
+                if (from >= 0) dest[c] = src[from];
+                else if (from == OPAQUE) dest[c] = 255;
+                else dest[c] = (unsigned char)((src[0] + src[1] + src[2]) / 3);
+            }
+        }
+    }
+
+    typedef void (*RowFunc)(const unsigned char * src, unsigned char * dest, int width);
+
+    // [source channels - 1][destination channels - 1], the diagonal is a copy
+    const RowFunc scalarRows[4][4] = {
+        { NULL, convertScalar<1, 2>, convertScalar<1, 3>, convertScalar<1, 4> },
+        { convertScalar<2, 1>, NULL, convertScalar<2, 3>, convertScalar<2, 4> },
+        { convertScalar<3, 1>, convertScalar<3, 2>, NULL, convertScalar<3, 4> },
+        { convertScalar<4, 1>, convertScalar<4, 2>, convertScalar<4, 3>, NULL }
+    };
+
+    // Byte shuffles for a group of 16 pixels, which take up exactly S input
+    // and D output registers of 16 bytes. Conversions that copy channels build
+    // each output register from the input registers it takes bytes from.
+    // Those that average work on RGBA, so RGB is first spread out as RGB to
+    // RGBA would be; alpha for grayscale alpha output is gathered as a plane.
+    struct ShuffleTable {
+        bool average;
+        unsigned char out[4][4][16];    // [output register][input register], 0x80 zeroes the byte
+        bool outUses[4][4];
+        unsigned char fill[4][16];      // ORed into each output register, 255 where alpha is opaque
+        unsigned char alpha[4][16];     // [input register], the alpha plane
+        bool alphaUses[4];
+    };
+
+    ShuffleTable buildTable(int S, int D)
+    {
+        ShuffleTable table;
+        memset(table.out, 0x80, sizeof(table.out));
+        memset(table.alpha, 0x80, sizeof(table.alpha));
+        memset(table.fill, 0, sizeof(table.fill));
+        memset(table.outUses, 0, sizeof(table.outUses));
+        memset(table.alphaUses, 0, sizeof(table.alphaUses));
+        table.average = channelSource(S, D, 0) == AVERAGE;
+
+        // Averaging RGB spreads it out without the opaque alpha, which is not averaged
+        int outChannels = table.average ? 4 : D;
+        for (int b = 0; b < 16 * outChannels && (!table.average || S == 3); b++) {
+            int from = table.average ? (b % 4 < 3 ? b % 4 : OPAQUE) : channelSource(S, D, b % D);
+            if (from == OPAQUE) {
+                if (!table.average) table.fill[b / 16][b % 16] = 255;
+                continue;
+            }
+            int sb = (b / outChannels) * S + from;
+            table.out[b / 16][sb / 16][b % 16] = (unsigned char)(sb % 16);
+            table.outUses[b / 16][sb / 16] = true;
+        }
+
+        if (table.average && S == 4 && D == 2) {
+            for (int k = 0; k < 16; k++) {
+                int sb = k * S + 3;
+                table.alpha[sb / 16][k] = (unsigned char)(sb % 16);
+                table.alphaUses[sb / 16] = true;
+            }
+        }
+        return table;
+    }
+
+    const ShuffleTable & shuffleTable(int S, int D)
+    {
+        struct Tables {
+            std::vector<ShuffleTable> tables;
+            Tables() {
+                for (int s = 1; s <= 4; s++)
+                    for (int d = 1; d <= 4; d++)
+                        tables.push_back(buildTable(s, d));
+            }
+        };
+        static const Tables all;
+        return all.tables[(S - 1) * 4 + D - 1];
+    }
+
+#ifdef PIXEL_SSSE3_KERNEL
+    // One group of 16 pixels per register
+    struct SsseLanes {
+        typedef __m128i Value;
+        enum { GROUPS = 1 };
+        static Value load(const unsigned char * group, int reg, int /*channels*/) { return _mm_loadu_si128((const __m128i *)(group + reg * 16)); }
+        static void store(unsigned char * group, int reg, int /*channels*/, Value v) { _mm_storeu_si128((__m128i *)(group + reg * 16), v); }
+        static Value table(const unsigned char * bytes) { return _mm_loadu_si128((const __m128i *)bytes); }
+        static Value shuffle(Value v, Value mask) { return _mm_shuffle_epi8(v, mask); }
+        static Value bitOr(Value a, Value b) { return _mm_or_si128(a, b); }
+        static Value zero() { return _mm_setzero_si128(); }
+        static Value set16(short x) { return _mm_set1_epi16(x); }
+        static Value set8(char x) { return _mm_set1_epi8(x); }
+        static Value set32(int x) { return _mm_set1_epi32(x); }
+        static Value multiplyAdd8(Value a, Value b) { return _mm_maddubs_epi16(a, b); }
+        static Value horizontalAdd16(Value a, Value b) { return _mm_hadd_epi16(a, b); }
+        static Value unpackLo8(Value a, Value b) { return _mm_unpacklo_epi8(a, b); }
+        static Value unpackHi8(Value a, Value b) { return _mm_unpackhi_epi8(a, b); }
+        static Value mulHi16(Value a, Value b) { return _mm_mulhi_epu16(a, b); }
+        static Value shiftRight16(Value a, int n) { return _mm_srli_epi16(a, n); }
+        static Value pack16(Value a, Value b) { return _mm_packus_epi16(a, b); }
+    };
+#endif
+
+#ifdef PIXEL_AVX2_KERNEL
+    // Two groups of 16 pixels per register, one in each 128-bit lane, as the
+    // byte shuffles do not cross lanes
+    struct Avx2Lanes {
+        typedef __m256i Value;
+        enum { GROUPS = 2 };
+        static Value load(const unsigned char * group, int reg, int channels) {
+            __m128i first = _mm_loadu_si128((const __m128i *)(group + reg * 16));
+            __m128i second = _mm_loadu_si128((const __m128i *)(group + 16 * channels + reg * 16));
+            return _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+        }
+        static void store(unsigned char * group, int reg, int channels, Value v) {
+            _mm_storeu_si128((__m128i *)(group + reg * 16), _mm256_castsi256_si128(v));
+            _mm_storeu_si128((__m128i *)(group + 16 * channels + reg * 16), _mm256_extracti128_si256(v, 1));
+        }
+        static Value table(const unsigned char * bytes) { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)bytes)); }
+        static Value shuffle(Value v, Value mask) { return _mm256_shuffle_epi8(v, mask); }
+        static Value bitOr(Value a, Value b) { return _mm256_or_si256(a, b); }
+        static Value zero() { return _mm256_setzero_si256(); }
+        static Value set16(short x) { return _mm256_set1_epi16(x); }
+        static Value set8(char x) { return _mm256_set1_epi8(x); }
+        static Value set32(int x) { return _mm256_set1_epi32(x); }
+        static Value multiplyAdd8(Value a, Value b) { return _mm256_maddubs_epi16(a, b); }
+        static Value horizontalAdd16(Value a, Value b) { return _mm256_hadd_epi16(a, b); }
+        static Value unpackLo8(Value a, Value b) { return _mm256_unpacklo_epi8(a, b); }
+        static Value unpackHi8(Value a, Value b) { return _mm256_unpackhi_epi8(a, b); }
+        static Value mulHi16(Value a, Value b) { return _mm256_mulhi_epu16(a, b); }
+        static Value shiftRight16(Value a, int n) { return _mm256_srli_epi16(a, n); }
+        static Value pack16(Value a, Value b) { return _mm256_packus_epi16(a, b); }
+    };
+#endif
+
+#if defined(PIXEL_SSSE3_KERNEL) || defined(PIXEL_AVX2_KERNEL)
+    // The shuffles of one output register or plane, loaded once for a whole row
+    template <class Lanes, int S>
+    struct Gather {
+        typename Lanes::Value masks[S];
+        bool uses[S];
+
+        void load(const unsigned char (*tableMasks)[16], const bool * tableUses) {
+            for (int j = 0; j < S; j++) {
+                masks[j] = Lanes::table(tableMasks[j]);
+                uses[j] = tableUses[j];
+            }
+        }
+
+        typename Lanes::Value apply(const typename Lanes::Value * in) const {
+            typename Lanes::Value result = Lanes::zero();
+            for (int j = 0; j < S; j++)
+                if (uses[j]) result = Lanes::bitOr(result, Lanes::shuffle(in[j], masks[j]));
+            return result;
+        }
+    };
+
+    // Converts whole groups of pixels and returns how many pixels that was.
+    template <class Lanes, int S, int D>
+    int convertVector(const unsigned char * src, unsigned char * dest, int width)
+    {
+        typedef typename Lanes::Value Value;
+        const ShuffleTable & table = shuffleTable(S, D);
+        const int step = 16 * Lanes::GROUPS;
+
+        Gather<Lanes, S> gathers[4];
+        Gather<Lanes, S> alphaGather;
+        Value fill[4];
+        for (int o = 0; o < 4; o++) {
+            gathers[o].load(table.out[o], table.outUses[o]);
+            fill[o] = Lanes::table(table.fill[o]);
+        }
+        alphaGather.load(table.alpha, table.alphaUses);
+
+        // Gray is (r + g + b) / 3 with the sum from multiplying RGBA by (1, 1, 1, 0)
+        // and adding neighbours, then divided as (sum * 0xAAAB) >> 17, which is
+        // exact for sums up to 765
+        const Value weights = Lanes::set32(0x00010101);
+        const Value third = Lanes::set16((short)0xAAAB);
+        const Value opaque = Lanes::set8((char)255);
+
+        int done = 0;
+        for (; done + step <= width; done += step) {
+            const unsigned char * group = src + done * S;
+            unsigned char * out = dest + done * D;
+
+            Value in[S];
+            for (int j = 0; j < S; j++) in[j] = Lanes::load(group, j, S);
+
+            if (!table.average) {
+                for (int o = 0; o < D; o++)
+                    Lanes::store(out, o, D, Lanes::bitOr(gathers[o].apply(in), fill[o]));
+                continue;
+            }
+
+            Value rgba[4];
+            for (int j = 0; j < 4; j++) rgba[j] = S == 3 ? gathers[j].apply(in) : in[j % S];
+            Value lo = Lanes::horizontalAdd16(Lanes::multiplyAdd8(rgba[0], weights), Lanes::multiplyAdd8(rgba[1], weights));
+            Value hi = Lanes::horizontalAdd16(Lanes::multiplyAdd8(rgba[2], weights), Lanes::multiplyAdd8(rgba[3], weights));
+            lo = Lanes::shiftRight16(Lanes::mulHi16(lo, third), 1);
+            hi = Lanes::shiftRight16(Lanes::mulHi16(hi, third), 1);
+            Value gray = Lanes::pack16(lo, hi);
+
+            if (D == 1) {
+                Lanes::store(out, 0, D, gray);
+            } else {
+                Value alpha = S == 4 ? alphaGather.apply(in) : opaque;
+                Lanes::store(out, 0, D, Lanes::unpackLo8(gray, alpha));
+                Lanes::store(out, 1, D, Lanes::unpackHi8(gray, alpha));
+            }
+        }
+        return done;
+    }
+
+    typedef int (*VectorRowFunc)(const unsigned char * src, unsigned char * dest, int width);
+
+    // Laid out as scalarRows
+    template <class Lanes>
+    struct VectorRows {
+        static const VectorRowFunc rows[4][4];
+    };
+
+    template <class Lanes>
+    const VectorRowFunc VectorRows<Lanes>::rows[4][4] = {
+        { NULL, convertVector<Lanes, 1, 2>, convertVector<Lanes, 1, 3>, convertVector<Lanes, 1, 4> },
+        { convertVector<Lanes, 2, 1>, NULL, convertVector<Lanes, 2, 3>, convertVector<Lanes, 2, 4> },
+        { convertVector<Lanes, 3, 1>, convertVector<Lanes, 3, 2>, NULL, convertVector<Lanes, 3, 4> },
+        { convertVector<Lanes, 4, 1>, convertVector<Lanes, 4, 2>, convertVector<Lanes, 4, 3>, NULL }
+    };
+#endif
+}
+
+PixelConverter::PixelConverter(ThreadPool * pool, Kernel kernel) : pool(pool), kernel(kernel)
+{
+#ifndef PIXEL_AVX2_KERNEL
+    if (this->kernel == AVX2) this->kernel = SSSE3;
+#endif
+#ifndef PIXEL_SSSE3_KERNEL
+    if (this->kernel == SSSE3) this->kernel = SCALAR;
+#endif
+}
+
+void PixelConverter::convertRow(const unsigned char * src, int srcChannels, unsigned char * dest, int destChannels, int width) const
+{
+    if (srcChannels < 1 || srcChannels > 4 || destChannels < 1 || destChannels > 4)
+        throw std::runtime_error("Pixels must have 1 to 4 channels");
+
+    if (srcChannels == destChannels) {
+        memcpy(dest, src, (size_t)width * srcChannels);
+        return;
+    }
+
+    int done = 0;
+    switch (kernel) {
+#ifdef PIXEL_AVX2_KERNEL
+    case AVX2:
+        done = VectorRows<Avx2Lanes>::rows[srcChannels - 1][destChannels - 1](src, dest, width);
+        break;
+#endif
+#ifdef PIXEL_SSSE3_KERNEL
+    case SSSE3:
+        done = VectorRows<SsseLanes>::rows[srcChannels - 1][destChannels - 1](src, dest, width);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    // The pixels left over from the last whole group
+    if (done < width)
+        scalarRows[srcChannels - 1][destChannels - 1](src + done * srcChannels, dest + done * destChannels, width - done);
+}
+
+void PixelConverter::convert(const unsigned char * src, size_t srcStride, int srcChannels,
+                             unsigned char * dest, size_t destStride, int destChannels, int width, int height) const
+{
+    if (!pool || height < 2) {
+        for (int row = 0; row < height; row++)
+            convertRow(src + row * srcStride, srcChannels, dest + row * destStride, destChannels, width);
+        return;
+    }
+
+    // A few bands per thread so an unlucky thread does not hold the others up
+    int bands = std::min(height, pool->getThreadCount() * 4);
+    pool->parallelFor(bands, [&](int band) {
+        int first = (int)((long long)height * band / bands);
+        int last = (int)((long long)height * (band + 1) / bands);
+        for (int row = first; row < last; row++)
+            convertRow(src + row * srcStride, srcChannels, dest + row * destStride, destChannels, width);
+    });
+}
+
+PixelConverter::Kernel PixelConverter::getKernel() const
+{
+    return kernel;
+}
+
+PixelConverter::Kernel PixelConverter::bestKernel()
+{
+#if defined(_MSC_VER)
+    // AVX2 needs the CPU to support it and the OS to save the YMM registers.
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+            return AVX2;
+    }
+    if (ssse3)
+        return SSSE3;
+#elif defined(PIXEL_AVX2_KERNEL)
+    return AVX2;
+#elif defined(PIXEL_SSSE3_KERNEL)
+    return SSSE3;
+#endif
+    return SCALAR;
+}
+
+const char * PixelConverter::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case AVX2: return "avx2";
+    case SSSE3: return "ssse3";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef PIXELCONVERTER_H
+#define PIXELCONVERTER_H
+
+#include "threadpool.h"
+
+#include <cstddef>
+
+/**
+ Converts rows of 8-bit pixels between the channel layouts of Bitmap:
+ 1 grayscale, 2 grayscale and alpha, 3 RGB and 4 RGBA.
+
+ Channels are copied or duplicated, a missing alpha becomes 255 and gray
+ is the truncated average of red, green and blue. The vector kernels
+ convert 16 pixels (SSSE3) or 32 pixels (AVX2) at a time: byte shuffles
+ gather the channels each output register needs from the input registers,
+ and gray is computed in 16-bit lanes. Every kernel gives exactly the same
+ bytes. Whole images can be split into bands of rows over a ThreadPool.
+ */
+class PixelConverter
+{
+public:
+    enum Kernel {
+        SCALAR,
+        SSSE3,
+        AVX2
+    };
+
+private:
+    ThreadPool * pool;  // NULL to convert on the calling thread
+    Kernel kernel;
+
+public:
+    PixelConverter(ThreadPool * pool = NULL, Kernel kernel = bestKernel());
+
+    // Converts width pixels. The same channel count is a plain copy.
+    void convertRow(const unsigned char * src, int srcChannels, unsigned char * dest, int destChannels, int width) const;
+
+    // Converts height rows of width pixels, strides in bytes.
+    void convert(const unsigned char * src, size_t srcStride, int srcChannels,
+                 unsigned char * dest, size_t destStride, int destChannels, int width, int height) const;
+
+    Kernel getKernel() const;
+
+    static Kernel bestKernel();     // The widest kernel this CPU and the build support
+    static const char * kernelName(Kernel kernel);
+};
+
+#endif // PIXELCONVERTER_H
@@ -0,0 +1,256 @@
+#include "pixeltransform.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    enum { TILE = 32 };     // Pixels along each side of the tiles copied directly
+
+    // A fixed size copy compiles to a single move
+    template <int C>
+    inline void copyPixel(unsigned char * dest, const unsigned char * src)
+    {
+        memcpy(dest, src, C);
+    }
+
+    template <int C>
+    inline void swapPixels(unsigned char * a, unsigned char * b)
+    {
+        unsigned char t[C];
+        memcpy(t, a, C);
+        memcpy(a, b, C);
+        memcpy(b, t, C);
+    }
+
+    // An operation that turns source columns into destination rows
+    struct Transpose {
+        const unsigned char * src;
+        unsigned char * dest;
+        int width, height;
+        bool reverseRows;       // Source column c becomes destination row width - 1 - c, else row c
+        bool reverseColumns;    // Source row r becomes destination column height - 1 - r, else column r
+    };
+
+    template <int C>
+    void transposeTile(const Transpose & t, int r0, int r1, int c0, int c1)
+    {
+        const size_t srcStride = (size_t)t.width * C;
+        const size_t destStride = (size_t)t.height * C;
+        const ptrdiff_t step = t.reverseColumns ? -C : C;
+
+        for (int c = c0; c < c1; c++) {
+            int destRow = t.reverseRows ? t.width - 1 - c : c;
+            int destCol = t.reverseColumns ? t.height - 1 - r0 : r0;
+            unsigned char * d = t.dest + destRow * destStride + (size_t)destCol * C;
+            const unsigned char * s = t.src + r0 * srcStride + (size_t)c * C;
+            for (int r = r0; r < r1; r++, d += step, s += srcStride)
+                copyPixel<C>(d, s);
+        }
+    }
+
+    template <int C>
+    void transposeRecursive(const Transpose & t, int r0, int r1, int c0, int c1)
+    {
+        if (r1 - r0 <= TILE && c1 - c0 <= TILE) {
+            transposeTile<C>(t, r0, r1, c0, c1);
+        } else if (r1 - r0 >= c1 - c0) {
+            int middle = r0 + (r1 - r0) / 2;
+            transposeRecursive<C>(t, r0, middle, c0, c1);
+            transposeRecursive<C>(t, middle, r1, c0, c1);
+        } else {
+            int middle = c0 + (c1 - c0) / 2;
+            transposeRecursive<C>(t, r0, r1, c0, middle);
+            transposeRecursive<C>(t, r0, r1, middle, c1);
+        }
+    }
+
+    // Copies a row with its pixels in reverse order
+    template <int C>
+    void reverseRow(const unsigned char * src, unsigned char * dest, int width)
+    {
+        dest += (size_t)(width - 1) * C;
+        for (int i = 0; i < width; i++, src += C, dest -= C)
+            copyPixel<C>(dest, src);
+    }
+
+    // Swaps two rows of the same image, reversing both, which may be the same row
+    template <int C>
+    void swapReversedRows(unsigned char * a, unsigned char * b, int width)
+    {
+        unsigned char * end = b + (size_t)(width - 1) * C;
+        int count = a == b ? width / 2 : width;
+        for (int i = 0; i < count; i++, a += C, end -= C)
+            swapPixels<C>(a, end);
+    }
+
+    template <int C>
+    void transformRows(PixelTransform::Operation operation, const unsigned char * src, unsigned char * dest, int width, int height, int first, int last)
+    {
+        const size_t stride = (size_t)width * C;
+        for (int row = first; row < last; row++) {
+            const unsigned char * s = src + row * stride;
+            switch (operation) {
+            case PixelTransform::FLIP_VERTICAL:
+                memcpy(dest + (height - 1 - row) * stride, s, stride);
+                break;
+            case PixelTransform::FLIP_HORIZONTAL:
+                reverseRow<C>(s, dest + row * stride, width);
+                break;
+            default:    // ROTATE_180
+                reverseRow<C>(s, dest + (height - 1 - row) * stride, width);
+                break;
+            }
+        }
+    }
+
+    // Rows first to last of the top half, and their partners in the bottom half
+    template <int C>
+    void transformRowsInPlace(PixelTransform::Operation operation, unsigned char * pixels, int width, int height, int first, int last)
+    {
+        const size_t stride = (size_t)width * C;
+        for (int row = first; row < last; row++) {
+            unsigned char * top = pixels + row * stride;
+            unsigned char * bottom = pixels + (height - 1 - row) * stride;
+            switch (operation) {
+            case PixelTransform::FLIP_VERTICAL:
+                std::swap_ranges(top, top + stride, bottom);
+                break;
+            case PixelTransform::FLIP_HORIZONTAL:
+                swapReversedRows<C>(top, top, width);
+                if (bottom != top) swapReversedRows<C>(bottom, bottom, width);
+                break;
+            default:    // ROTATE_180
+                swapReversedRows<C>(top, bottom, width);
+                break;
+            }
+        }
+    }
+
+    template <int C>
+    void applyBand(PixelTransform::Operation operation, const unsigned char * src, int width, int height, unsigned char * dest, int first, int last)
+    {
+        if (!PixelTransform::swapsSize(operation)) {
+            transformRows<C>(operation, src, dest, width, height, first, last);
+            return;
+        }
+
+        Transpose t;
+        t.src = src;
+        t.dest = dest;
+        t.width = width;
+        t.height = height;
+        t.reverseRows = operation == PixelTransform::ROTATE_90;
+        t.reverseColumns = operation == PixelTransform::ROTATE_270;
+        transposeRecursive<C>(t, 0, height, first, last);
+    }
+
+    // Bands are source columns for transposes, which are destination rows, and source rows otherwise
+    void applyBand(int channels, PixelTransform::Operation operation, const unsigned char * src, int width, int height, unsigned char * dest, int first, int last)
+    {
+        switch (channels) {
+        case 1: applyBand<1>(operation, src, width, height, dest, first, last); break;
+        case 2: applyBand<2>(operation, src, width, height, dest, first, last); break;
+        case 3: applyBand<3>(operation, src, width, height, dest, first, last); break;
+        default: applyBand<4>(operation, src, width, height, dest, first, last); break;
+        }
+    }
+
+    void applyBandInPlace(int channels, PixelTransform::Operation operation, unsigned char * pixels, int width, int height, int first, int last)
+    {
+        switch (channels) {
+        case 1: transformRowsInPlace<1>(operation, pixels, width, height, first, last); break;
+        case 2: transformRowsInPlace<2>(operation, pixels, width, height, first, last); break;
+        case 3: transformRowsInPlace<3>(operation, pixels, width, height, first, last); break;
+        default: transformRowsInPlace<4>(operation, pixels, width, height, first, last); break;
+        }
+    }
+}
+
+PixelTransform::PixelTransform(ThreadPool * pool) : pool(pool)
+{
+}
+
+void PixelTransform::apply(Operation operation, const unsigned char * src, int width, int height, int channels, unsigned char * dest) const
+{
+    if (channels < 1 || channels > 4)
+        throw std::runtime_error("Pixels must have 1 to 4 channels");
+
+    size_t bytes = (size_t)width * height * channels;
+    if (dest < src + bytes && src < dest + bytes)
+        throw std::runtime_error("Transformed image must not overlap its source");
+
+    int count = swapsSize(operation) ? width : height;
+    if (!pool) {
+        applyBand(channels, operation, src, width, height, dest, 0, count);
+        return;
+    }
+
+    int bands = std::max(1, std::min(count / TILE, pool->getThreadCount() * 4));
+    pool->parallelFor(bands, [&](int band) {
+        // Transpose bands start on whole tiles
+        int first = (int)((long long)count * band / bands);
+        int last = (int)((long long)count * (band + 1) / bands);
+        if (swapsSize(operation)) {
+            first = band == 0 ? 0 : first / TILE * TILE;
+            last = band == bands - 1 ? count : last / TILE * TILE;
+        }
+        applyBand(channels, operation, src, width, height, dest, first, last);
+    });
+}
+
+void PixelTransform::applyInPlace(Operation operation, unsigned char * pixels, int width, int height, int channels) const
+{
+    if (channels < 1 || channels > 4)
+        throw std::runtime_error("Pixels must have 1 to 4 channels");
+    if (swapsSize(operation))
+        throw std::runtime_error(std::string("Cannot ") + operationName(operation) + " in place");
+
+    // Each band takes rows from the top half with their partners from the bottom, and the
+    // middle row of an odd height unless the rows are only swapped.
+    int count = height / 2;
+    if (height % 2 == 1 && operation != FLIP_VERTICAL) count++;
+
+    if (!pool) {
+        applyBandInPlace(channels, operation, pixels, width, height, 0, count);
+        return;
+    }
+
+    int bands = std::max(1, std::min(count, pool->getThreadCount() * 4));
+    pool->parallelFor(bands, [&](int band) {
+        int first = (int)((long long)count * band / bands);
+        int last = (int)((long long)count * (band + 1) / bands);
+        applyBandInPlace(channels, operation, pixels, width, height, first, last);
+    });
+}
+
+bool PixelTransform::swapsSize(Operation operation)
+{
+    return operation == ROTATE_90 || operation == ROTATE_270 || operation == TRANSPOSE;
+}
+
+void PixelTransform::destination(Operation operation, int col, int row, int width, int height, int & destCol, int & destRow)
+{
+    switch (operation) {
+    case ROTATE_90:       destCol = row;              destRow = width - 1 - col;  break;
+    case ROTATE_180:      destCol = width - 1 - col;  destRow = height - 1 - row; break;
+    case ROTATE_270:      destCol = height - 1 - row; destRow = col;              break;
+    case TRANSPOSE:       destCol = row;              destRow = col;              break;
+    case FLIP_VERTICAL:   destCol = col;              destRow = height - 1 - row; break;
+    default:              destCol = width - 1 - col;  destRow = row;              break;
+    }
+}
+
+const char * PixelTransform::operationName(Operation operation)
+{
+    switch (operation) {
+    case ROTATE_90: return "rotate90";
+    case ROTATE_180: return "rotate180";
+    case ROTATE_270: return "rotate270";
+    case TRANSPOSE: return "transpose";
+    case FLIP_VERTICAL: return "flipv";
+    default: return "fliph";
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef PIXELTRANSFORM_H
+#define PIXELTRANSFORM_H
+
+#include "threadpool.h"
+
+/**
+ Rotates, transposes and flips images of 8-bit pixels with 1 to 4
+ channels, the layout of Bitmap: rows top to bottom, no padding.
+
+ Operations that turn rows into columns read and write along different
+ axes, so one of the two always strides through memory. They split the
+ image in half along its longer side, recursively, until a tile of at most
+ 32x32 pixels is left, whose source and destination both stay in the cache
+ while it is copied; this works for any cache size without tuning.
+ Operations that keep rows as rows stream through them and can work in
+ place. Images can be split into bands over a ThreadPool.
+ */
+class PixelTransform
+{
+public:
+    enum Operation {
+        ROTATE_90,          // Counter clockwise
+        ROTATE_180,
+        ROTATE_270,         // Counter clockwise, or 90 clockwise
+        TRANSPOSE,          // Rows become columns, about the top left to bottom right diagonal
+        FLIP_VERTICAL,      // Row order reversed
+        FLIP_HORIZONTAL     // Pixel order within each row reversed
+    };
+
+private:
+    ThreadPool * pool;  // NULL to transform on the calling thread
+
+public:
+    PixelTransform(ThreadPool * pool = NULL);
+
+    // Writes the transformed image to dest, which must not overlap src.
+    void apply(Operation operation, const unsigned char * src, int width, int height, int channels, unsigned char * dest) const;
+
+    // Transforms the image in its own memory, only for operations that keep
+    // the width and height (ROTATE_180 and the flips).
+    void applyInPlace(Operation operation, unsigned char * pixels, int width, int height, int channels) const;
+
+    // Whether the operation exchanges width and height
+    static bool swapsSize(Operation operation);
+
+    // Where the pixel at (col, row) of a width x height image ends up.
+    static void destination(Operation operation, int col, int row, int width, int height, int & destCol, int & destRow);
+
+    static const char * operationName(Operation operation);
+};
+
+#endif // PIXELTRANSFORM_H
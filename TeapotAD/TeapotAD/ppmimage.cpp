@@ -0,0 +1,81 @@
+#include "ppmimage.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+PPMImage::PPMImage() : width(0), height(0)
+{
+}
+
+PPMImage::PPMImage(int width, int height, const unsigned char * bottomUpRGBA) : width(width), height(height), rgb(3 * width * height)
+{
+    for (int y = 0; y < height; y++) {
+        const unsigned char * in = bottomUpRGBA + 4 * (height - 1 - y) * width;
+        unsigned char * out = &rgb[3 * y * width];
+        for (int x = 0; x < width; x++, in += 4, out += 3) {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+        }
+    }
+}
+
+void PPMImage::read(const std::string & path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Unable to open " + path);
+
+    std::string magic;
+    int maxValue = 0;
+    in >> magic >> width >> height >> maxValue;
+    if (!in || magic != "P6" || width <= 0 || height <= 0 || maxValue != 255)
+        throw std::runtime_error(path + " is not an 8 bit binary PPM image");
+    in.get();   // The single whitespace character before the pixels
+
+    rgb.resize(3 * width * height);
+    if (!in.read((char *)&rgb[0], rgb.size()))
+        throw std::runtime_error(path + " is truncated");
+}
+
+void PPMImage::write(const std::string & path) const
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Unable to open " + path + " for writing");
+
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write((const char *)&rgb[0], rgb.size());
+    if (!out)
+        throw std::runtime_error("Unable to write " + path);
+}
+
+int PPMImage::getWidth() const
+{
+    return width;
+}
+
+int PPMImage::getHeight() const
+{
+    return height;
+}
+
+int PPMImage::countDifferences(const PPMImage & other, int tolerance, int & largestDifference) const
+{
+    if (width != other.width || height != other.height)
+        throw std::runtime_error("Images of different sizes cannot be compared");
+
+    int differences = 0;
+    largestDifference = 0;
+    for (size_t p = 0; p < rgb.size(); p += 3) {
+        int pixelDifference = 0;
+        for (int c = 0; c < 3; c++) {
+            int d = std::abs((int)rgb[p + c] - (int)other.rgb[p + c]);
+            if (d > pixelDifference) pixelDifference = d;
+        }
+        if (pixelDifference > largestDifference) largestDifference = pixelDifference;
+        if (pixelDifference > tolerance) differences++;
+    }
+    return differences;
+}
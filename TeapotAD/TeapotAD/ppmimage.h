@@ -0,0 +1,37 @@
+#ifndef PPMIMAGE_H
+#define PPMIMAGE_H
+
+#include <string>
+#include <vector>
+
+/**
+ An 8 bit RGB image read from or written to a binary (P6) PPM file.
+
+ Holds screenshots of the GL renderer and images of the software
+ rasterizer, so either can be kept as a golden image and later frames
+ compared against it pixel by pixel.
+ */
+class PPMImage
+{
+private:
+    int width, height;
+    std::vector<unsigned char> rgb;     // Top row first, as the file stores it
+
+public:
+    PPMImage();
+
+    // From RGBA8 pixels with the bottom row first, as gl::ReadPixels returns them.
+    PPMImage(int width, int height, const unsigned char * bottomUpRGBA);
+
+    void read(const std::string & path);
+    void write(const std::string & path) const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+    // Pixels with a channel more than tolerance away from the other image's, which must be
+    // the same size. largestDifference receives the biggest channel difference found.
+    int countDifferences(const PPMImage & other, int tolerance, int & largestDifference) const;
+};
+
+#endif // PPMIMAGE_H
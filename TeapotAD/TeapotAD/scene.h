@@ -6,6 +6,11 @@
 #include <glfw3.h>
 #include "QuatCamera.h"
 
+#include <map>
+#include <string>
+
+class ShaderWatcher;
+
 namespace imat2908
 {
 
@@ -13,6 +18,7 @@ class Scene
 {
 public:
 	Scene() : m_animate(true) { }
+	virtual ~Scene() { }
 	
     /**
 		Load textures, initialize shaders, etc.
@@ -33,6 +39,21 @@ public:
 		Used to update the lighting parameters based on the user's keyboard input.
 	 */
 	virtual void animate(bool &shift, bool &a, bool &d, bool &s, bool &space, bool &r) = 0;
+
+	/**
+		Named statistics about the last rendered frame, recorded by the benchmark.
+	 */
+	virtual void frameCounters(std::map<std::string, double> &/*counters*/) { }
+
+	/**
+		Hands the programs the scene draws with to the watcher, so edits to their shaders are reloaded.
+	 */
+	virtual void watchShaders(ShaderWatcher &/*watcher*/) { }
+
+	/**
+		Called after the watcher swapped in programs rebuilt from edited shaders, whose uniform handles must be resolved again.
+	 */
+	virtual void shadersReloaded() { }
     
 protected:
 	bool m_animate;
@@ -8,21 +8,64 @@ using std::cerr;
 using std::endl;
 
 #include "defines.h"
+#include "shaderwatcher.h"
 
 using glm::vec3;
 
 #include <gtc/matrix_transform.hpp>
 #include <gtx/transform2.hpp>
 
+#include <random>
+
 namespace imat2908
 {
+	namespace
+	{
+		// The objects' materials, chosen by index. The deferred lighting passes read the same table.
+		enum Material { PLANE_MATERIAL, TEAPOT_MATERIAL, MATERIAL_COUNT };
+		const StorageBlock::MaterialData materials[MATERIAL_COUNT] = {
+			{ vec4(0.51f, 1.0f, 0.49f, 0.0f), vec4(0.51f, 1.0f, 0.49f, 0.0f), vec4(0.1f, 0.1f, 0.1f, 0.0f) },		// Plane green.
+			{ vec4(0.46f, 0.29f, 0.0f, 0.0f), vec4(0.46f, 0.29f, 0.0f, 0.0f), vec4(0.29f, 0.29f, 0.29f, 0.0f) }	// Teapot brown.
+		};
+
+		// Clusters the view frustum is split into for the clustered renderer, across, up and in depth,
+		// and the most lights each can hold. Must match cluster_lights.cs and phong_clustered.frag.
+		const int clusterGrid[3] = { 16, 12, 24 };
+		const int maxClusterLights = 256;
+	}
+
 	/////////////////////////////////////////////////////////////////////////////////////////////
 	///// Default Constructor
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	SceneDiffuse::SceneDiffuse()
+	SceneDiffuse::SceneDiffuse(bool multiDraw, VertexFormat::Format vertexFormat, bool gpuTessellation, int lodLevels, bool culling, int deferredLights, int clusteredLights, bool shadows) :
+		teapot(NULL), plane(NULL), multiDraw(multiDraw), arena(NULL), objectBuffer(NULL), commandBuffer(NULL), vertexFormat(vertexFormat), gpuTessellation(gpuTessellation),
+		lodLevels(lodLevels), culling(culling), objectsVisible(0), deferredLights(deferredLights), gbuffer(NULL), lightVolume(NULL),
+		materialBuffer(0), pointLightBuffer(0), emptyVao(0), clusteredLights(clusteredLights), clusterCountBuffer(0), clusterLightBuffer(0),
+		shadows(shadows), shadowMap(NULL), shadowTeapotLod(-1), planeModel(1.0f), teapotModel(1.0f), uniformBuffer(NULL)
 	{
 	}
 
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Release everything initScene(), createPointLights() and resize() created.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	SceneDiffuse::~SceneDiffuse()
+	{
+		delete teapot;
+		delete plane;
+		delete lightVolume;
+		delete arena;
+		delete objectBuffer;
+		delete commandBuffer;
+		delete uniformBuffer;
+		delete gbuffer;
+		delete shadowMap;
+
+		// Deleting buffer 0 or vertex array 0 is ignored.
+		GLuint buffers[] = { pointLightBuffer, clusterCountBuffer, clusterLightBuffer, materialBuffer };
+		gl::DeleteBuffers(4, buffers);
+		gl::DeleteVertexArrays(1, &emptyVao);
+	}
+
 	/////////////////////////////////////////////////////////////////////////////////////////////
 	///// Initialise the Scene
 	/////////////////////////////////////////////////////////////////////////////////////////////
@@ -33,6 +76,17 @@ namespace imat2908
 
 		gl::Enable(gl::DEPTH_TEST);
 
+		// Room for the frame's block and plenty of object blocks, whatever the offset alignment.
+		uniformBuffer = new StreamBuffer(gl::UNIFORM_BUFFER, 64 * 1024);
+
+		if (multiDraw)
+		{
+			// Both meshes go into one set of buffers, the objects' data and the draw commands are streamed.
+			arena = new GeometryArena(vertexFormat);
+			objectBuffer = new StreamBuffer(gl::SHADER_STORAGE_BUFFER, 2 * sizeof(UniformBlock::ObjectData));
+			commandBuffer = new StreamBuffer(gl::DRAW_INDIRECT_BUFFER, 2 * sizeof(DrawElementsIndirectCommand));
+		}
+
 		// Set the Initial and Current Lighting Parameters for Each of the Lighting Elements
 		for (int i = 0; i < numOfLightingParams; i++)
 		{
@@ -59,14 +113,120 @@ namespace imat2908
 		setLightParams();
 
 		// Create the plane to represent the ground.
-		plane = new VBOPlane(100.0, 100.0, 100, 100);
+		plane = new VBOPlane(100.0, 100.0, 100, 100, arena, vertexFormat);
 
 		// A matrix to move the teapot lid upwards.
 		glm::mat4 lid = glm::mat4(1.0);
 		lid *= glm::translate(vec3(0.0,0.0,0.1));
 
-		//Create the teapot with translated lid.
-		teapot = new VBOTeapot(16, lid);
+		//Create the teapot with translated lid, either as a mesh or as patches for the tessellation shaders.
+		//With levels of detail the finest mesh has a grid of 32, each coarser one half the grid of the last.
+		if (gpuTessellation)
+			teapot = new VBOTeapotPatches(lid);
+		else
+			teapot = new VBOTeapot(lodLevels > 1 ? 32 : 16, lid, arena, vertexFormat, lodLevels);
+
+		// One draw index for each object.
+		if (arena) arena->upload(2);
+
+		if (deferredLights > 0 || clusteredLights > 0) createPointLights();
+
+		if (shadows)
+		{
+			try {
+				shadowMap = new ShadowMap(shadowSize);
+			}
+			catch (std::exception & e) {
+				cerr << e.what() << endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Create the buffers of the deferred or clustered renderer and its point lights.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::createPointLights()
+	{
+		gl::GenBuffers(1, &pointLightBuffer);
+		scatterPointLights();
+
+		if (clusteredLights > 0)
+		{
+			// Rewritten by binLights() every frame.
+			GLsizeiptr clusters = clusterGrid[0] * clusterGrid[1] * clusterGrid[2];
+			gl::GenBuffers(1, &clusterCountBuffer);
+			gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, clusterCountBuffer);
+			gl::BufferData(gl::SHADER_STORAGE_BUFFER, clusters * sizeof(GLuint), NULL, gl::DYNAMIC_COPY);
+			gl::GenBuffers(1, &clusterLightBuffer);
+			gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, clusterLightBuffer);
+			gl::BufferData(gl::SHADER_STORAGE_BUFFER, clusters * maxClusterLights * sizeof(GLuint), NULL, gl::DYNAMIC_COPY);
+		}
+		else
+		{
+			// The deferred lighting passes find the materials by the index in the G-buffer.
+			gl::GenBuffers(1, &materialBuffer);
+			gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, materialBuffer);
+			gl::BufferData(gl::SHADER_STORAGE_BUFFER, sizeof(materials), materials, gl::STATIC_DRAW);
+
+			lightVolume = new VBOSphere(1.0f, 16, 8);
+			lightVolumeProg.use();
+			lightVolumeProg.setUniform(volumeScaleUniform, lightVolume->getCircumscribedScale());
+
+			gl::GenVertexArrays(1, &emptyVao);
+		}
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+		prog.use();
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Scatter the point lights over the plane, a little above it, each a bright colour. A fixed
+	// seed places them the same way every run, and the first lights are the same whatever the
+	// count. A light's radius is where its brightest channel falls below one 8-bit step, so the
+	// volume drawn around it, or the clusters it is listed in, cover every pixel it can visibly
+	// light.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::scatterPointLights()
+	{
+		int lightCount = deferredLights > 0 ? deferredLights : clusteredLights;
+
+		const float falloff = 10.0f;	// Quadratic attenuation, the light is half as bright 0.3 units away.
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> across(-30.0f, 30.0f), above(0.25f, 2.0f), unit(0.0f, 1.0f);
+
+		std::vector<StorageBlock::PointLightData> lights(lightCount);
+		for (int i = 0; i < lightCount; i++)
+		{
+			vec3 colour = glm::normalize(vec3(unit(random), unit(random), unit(random)) + vec3(0.05f));
+			float brightest = glm::max(colour.r, glm::max(colour.g, colour.b));
+			float radius = glm::sqrt((256.0f * brightest - 1.0f) / falloff);
+
+			lights[i].positionRadius = vec4(across(random), above(random), across(random), radius);
+			lights[i].colourFalloff = vec4(colour, falloff);
+		}
+
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, pointLightBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, lights.size() * sizeof(lights[0]), &lights[0], gl::STATIC_DRAW);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+
+		if (clusteredLights > 0)
+		{
+			clusterProg.use();
+			clusterProg.setUniform(lightCountUniform, (GLuint)clusteredLights);
+			prog.use();
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Change the number of point lights, for a scene created with some.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::setPointLightCount(int count)
+	{
+		if (deferredLights > 0) deferredLights = count;
+		else if (clusteredLights > 0) clusteredLights = count;
+		else return;
+
+		scatterPointLights();
 	}
 
 	/////////////////////////////////////////////////////////////////////////////////////////////
@@ -76,67 +236,397 @@ namespace imat2908
 	{
 		vec3 worldLight = vec3(10.0f, 10.0f, 10.0f);	// Position of the light source.
 
-		prog.setUniform("matrixProperties.LightPosition", worldLight);	// Setting the light position to its uniform value in the vertex shader.
-		prog.setUniform("Light.attenuation", attunationParameter.currentVal);	// Setting the light attenuation to its uniform value in the fragment shader.
+		// The light's values are copied into the per-frame uniform block, which is uploaded by render().
+		frameData.lightPosition = vec4(worldLight, 1.0f);
+		frameData.attenuation = attunationParameter.currentVal;
+		frameData.La = vec4(lightingParameter[0].currentVal, 0.0f);	// Setting the ambience to its current value.
+		frameData.Ld = vec4(lightingParameter[1].currentVal, 0.0f);	// Setting the diffusion to its current value.
+		frameData.Ls = vec4(lightingParameter[2].currentVal, 0.0f);	// Setting the specularity to its current value.
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Render the scene to the camera.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::render(QuatCamera camera)
+	{
+		// Count the uniform uploads of this frame only.
+		GLSLProgram *programs[] = { &prog, &tessProg, &gbufferProg, &deferredProg, &lightVolumeProg, &clusterProg, &shadowProg };
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+			programs[i]->resetUniformCounters();
 
-		// Setting each of the lighting element's intensities in their respective new current values to their uniform values in the fragment shader.
-		for (int i = 0; i < numOfLightingParams; i++)
+		// Deferred, the objects only write their surfaces and are lit afterwards by lightScene().
+		GLint framebuffer = 0;
+		if (deferredLights > 0)
 		{
-			switch (i)
-			{
-			case 0:
-				prog.setUniform("Light.La", lightingParameter[i].currentVal);	// Setting the ambience to its current value.
-				break;
-			case 1:
-				prog.setUniform("Light.Ld", lightingParameter[i].currentVal);	// Setting the diffusion to its current value.
-				break;
-			case 2:
-				prog.setUniform("Light.Ls", lightingParameter[i].currentVal);	// Setting the specularity to its current value.
-				break;
-			}
+			gl::GetIntegerv(gl::DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			gbuffer->clear();
+			gbufferProg.use();
+		}
+		else
+		{
+			gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);	// Clear the buffers.
+			prog.use();
+		}
+
+		mat4 view = camera.view();
+		uniformBuffer->beginFrame();
+
+		// Camera and light data shared by every object this frame.
+		frameData.V = view;
+		frameData.P = camera.projection();
+		GLintptr frameOffset = uniformBuffer->push(&frameData, sizeof(frameData));
+
+		// The clusters' light lists must be ready before anything is shaded.
+		if (clusteredLights > 0)
+		{
+			uniformBuffer->flush();
+			uniformBuffer->bindRange(UniformBlock::FRAME, frameOffset, sizeof(UniformBlock::FrameData));
+			binLights(camera);
 		}
+
+		if (lodLevels > 1) chooseTeapotLod(camera, view);
+
+		if (shadows) renderShadows(view);
+
+		mat4 viewProjection = frameData.P * view;
+		objectsVisible = 0;
+
+		if (multiDraw)
+		{
+			uniformBuffer->flush();
+			uniformBuffer->bindRange(UniformBlock::FRAME, frameOffset, sizeof(UniformBlock::FrameData));
+			renderMultiDraw(view, viewProjection);
+			uniformBuffer->endFrame();
+			return;
+		}
+
+		// Initialise the model matrix for the plane and set its material properties, if it can be seen.
+		model = planeModel;
+		bool planeVisible = isVisible(plane, viewProjection);
+		GLintptr planeOffset = 0;
+		if (planeVisible) planeOffset = pushObjectData(view, PLANE_MATERIAL);
+
+		// Initialise the model matrix for the teapot and set its material properties, if it can be seen.
+		model = teapotModel;
+		bool teapotVisible = isVisible(teapot, viewProjection);
+		GLintptr teapotOffset = 0;
+		if (teapotVisible) teapotOffset = pushObjectData(view, TEAPOT_MATERIAL);
+
+		// Upload everything in one go, then each object only needs its range of the buffer bound.
+		uniformBuffer->flush();
+		uniformBuffer->bindRange(UniformBlock::FRAME, frameOffset, sizeof(UniformBlock::FrameData));
+
+		if (planeVisible)
+		{
+			uniformBuffer->bindRange(UniformBlock::OBJECT, planeOffset, sizeof(UniformBlock::ObjectData));
+			plane->render();	// Binds the vertex's VAO handle to the VAO then draws/renders them as triangles.
+		}
+
+		if (teapotVisible)
+		{
+			uniformBuffer->bindRange(UniformBlock::OBJECT, teapotOffset, sizeof(UniformBlock::ObjectData));
+			if (gpuTessellation) tessProg.use();	// The same blocks, but the patches are evaluated by the tessellation shaders.
+			teapot->render();	// Binds the vertex's VAO handle to the VAO then draws/renders them as triangles.
+		}
+
+		if (deferredLights > 0)
+		{
+			lightScene();
+			gbuffer->present(framebuffer);
+		}
+
+		uniformBuffer->endFrame();
 	}
 
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	///// Render the scene to the camera.
+	// Bring the shadow map of the scene's light up to date. The plane is only drawn into the static
+	// layer when the light or the plane moves. The teapot is drawn on top when the light moves, or
+	// where its shadow was and now is when it moves or changes its level of detail.
+	// Otherwise last frame's shadow map is used as it is.
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	void SceneDiffuse::render(QuatCamera camera)
+	void SceneDiffuse::renderShadows(const mat4 &view)
+	{
+		// A square frustum from the light towards the teapot, wide enough for its shadow.
+		vec3 lightPosition = vec3(frameData.lightPosition);
+		mat4 lightProjection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+		shadowMap->resetStatistics();
+		shadowMap->setLight(lightProjection * glm::lookAt(lightPosition, vec3(0.0f), vec3(0.0f, 1.0f, 0.0f)));
+
+		if (planeModel != shadowPlaneModel)
+		{
+			shadowMap->invalidateStatic();
+			shadowPlaneModel = planeModel;
+		}
+
+		int teapotLod = static_cast<VBOTeapot *>(teapot)->getSelectedLod();
+		if (teapotModel != shadowTeapotModel || teapotLod != shadowTeapotLod)
+		{
+			shadowMap->invalidateCaster(teapot->getBoundsMin(), teapot->getBoundsMax(), shadowTeapotModel);
+			shadowMap->invalidateCaster(teapot->getBoundsMin(), teapot->getBoundsMax(), teapotModel);
+			shadowTeapotModel = teapotModel;
+			shadowTeapotLod = teapotLod;
+		}
+
+		GLint drawFramebuffer = 0, readFramebuffer = 0;
+		gl::GetIntegerv(gl::DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+		gl::GetIntegerv(gl::READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+
+		const mat4 &lightMatrix = shadowMap->getLightMatrix();
+		if (shadowMap->beginStatic())
+		{
+			shadowProg.use();
+			shadowProg.setUniform(shadowMVPUniform, lightMatrix * planeModel);
+			plane->render();
+		}
+		if (shadowMap->beginDynamic())
+		{
+			shadowProg.use();
+			shadowProg.setUniform(shadowMVPUniform, lightMatrix * teapotModel);
+			teapot->render();
+		}
+		shadowMap->end(drawFramebuffer, readFramebuffer, width, height);
+
+		// Whether or not anything was redrawn, the camera moved.
+		prog.use();
+		prog.setUniform(shadowMatrixUniform, shadowMap->textureMatrix(view));
+		shadowMap->bindTexture(0);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Bin the point lights into the clusters of the view frustum: a 16x12 grid of tiles on screen
+	// split into 24 slices spaced evenly in log(depth). A work group per cluster tests every light's
+	// sphere against the cluster's box, then phong_clustered.frag only shades the lights listed for
+	// the fragment's cluster. At most maxClusterLights lights are kept per cluster, so the cost of a
+	// fragment is bounded however many lights there are.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::binLights(QuatCamera &camera)
+	{
+		float depthScale = clusterGrid[2] / glm::log(camera.farPlane() / camera.nearPlane());
+		float depthBias = -glm::log(camera.nearPlane()) * depthScale;
+
+		clusterProg.use();
+		clusterProg.setUniform(binUniforms.depthScale, depthScale);
+		clusterProg.setUniform(binUniforms.depthBias, depthBias);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::POINT_LIGHTS, pointLightBuffer);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::CLUSTER_COUNTS, clusterCountBuffer);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::CLUSTER_LIGHTS, clusterLightBuffer);
+		gl::DispatchCompute(clusterGrid[0], clusterGrid[1], clusterGrid[2]);
+		gl::MemoryBarrier(gl::SHADER_STORAGE_BARRIER_BIT);
+
+		// The shading programs find the fragment's slice the same way.
+		if (gpuTessellation)
+		{
+			tessProg.use();
+			tessProg.setUniform(tessClusteredUniforms.depthScale, depthScale);
+			tessProg.setUniform(tessClusteredUniforms.depthBias, depthBias);
+		}
+		prog.use();
+		prog.setUniform(clusteredUniforms.depthScale, depthScale);
+		prog.setUniform(clusteredUniforms.depthBias, depthBias);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Light the surfaces in the G-buffer. A full screen pass applies the scene's light with its
+	// ambient term to every pixel something was drawn at, then a sphere around each point light
+	// adds that light to the pixels inside it. Only the spheres' back faces are drawn, where
+	// they are behind the surface, so each lit pixel is shaded once per light even with the
+	// camera inside a sphere.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::lightScene()
 	{
-		gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);	// Clear the buffers.
+		gbuffer->bindLighting();
+		gbuffer->bindTextures(0);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::MATERIALS, materialBuffer);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::POINT_LIGHTS, pointLightBuffer);
+		gl::DepthMask(FALSE);
 
-		// Initialise the model matrix for the plane.
-		model = mat4(1.0f);
-		// Set the matrices for the plane although it is only the model matrix that changes so could be made more efficient.
-		setMatrices(camera);
-		// Set the plane's material properties in the shader and render.
-		prog.setUniform("Material.Ka", 0.51f, 1.0f, 0.49f); // Values for ambience's RGB colour.
-		prog.setUniform("Material.Kd", 0.51f, 1.0f, 0.49f); // Values for diffusion's RGB colour.
-		prog.setUniform("Material.Ks", 0.1f, 0.1f, 0.1f);	// Values for specularity's RGB colour.
-		plane->render();	// Binds the vertex's VAO handle to the VAO then draws/renders them as triangles.
+		gl::Disable(gl::DEPTH_TEST);
+		deferredProg.use();
+		gl::BindVertexArray(emptyVao);
+		gl::DrawArrays(gl::TRIANGLES, 0, 3);
 
-		// Initialise the model matrix for the teapot. 
-		model = mat4(1.0f);
-		setMatrices(camera);
-		// Set the Teapot material properties in the shader and render.
-		prog.setUniform("Material.Ka", 0.46f, 0.29f, 0.0f);  // Values for ambience's RGB colour.
-		prog.setUniform("Material.Kd", 0.46f, 0.29f, 0.0f);  // Values for diffusion's RGB colour.
-		prog.setUniform("Material.Ks", 0.29f, 0.29f, 0.29f); // Values for specularity's RGB colour.
-		teapot->render();	// Binds the vertex's VAO handle to the VAO then draws/renders them as triangles.
+		gl::Enable(gl::DEPTH_TEST);
+		gl::DepthFunc(gl::GEQUAL);
+		gl::Enable(gl::CULL_FACE);
+		gl::CullFace(gl::FRONT);
+		gl::Enable(gl::BLEND);
+		gl::BlendFunc(gl::ONE, gl::ONE);
+		lightVolumeProg.use();
+		lightVolume->renderInstanced(deferredLights);
+
+		gl::Disable(gl::BLEND);
+		gl::Disable(gl::CULL_FACE);
+		gl::DepthFunc(gl::LESS);
+		gl::DepthMask(TRUE);
+		gl::BindVertexArray(0);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Draw the plane and the teapot from the geometry arena with one gl::MultiDrawElementsIndirect.
+	// Each command's baseInstance selects its object's entry in the object buffer. Objects
+	// outside the frustum get neither.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::renderMultiDraw(const mat4 &view, const mat4 &viewProjection)
+	{
+		objectBuffer->beginFrame();
+		commandBuffer->beginFrame();
+
+		UniformBlock::ObjectData objects[2];
+		DrawElementsIndirectCommand commands[2];
+		GLuint draws = 0;
+
+		model = planeModel;
+		if (isVisible(plane, viewProjection))
+		{
+			objects[draws] = objectData(view, PLANE_MATERIAL);		// The plane.
+			commands[draws] = GeometryArena::command(plane->getMeshRange(), 1, draws);
+			draws++;
+		}
+		model = teapotModel;
+		if (isVisible(teapot, viewProjection))
+		{
+			objects[draws] = objectData(view, TEAPOT_MATERIAL);	// The teapot.
+			commands[draws] = GeometryArena::command(teapot->getMeshRange(), 1, draws);
+			draws++;
+		}
+
+		if (draws > 0)
+		{
+			GLintptr objectOffset = objectBuffer->push(objects, draws * sizeof(objects[0]));
+			GLintptr commandOffset = commandBuffer->push(commands, draws * sizeof(commands[0]));
+			objectBuffer->flush();
+			commandBuffer->flush();
+
+			objectBuffer->bindRange(StorageBlock::OBJECTS, objectOffset, draws * sizeof(objects[0]));
+			gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, commandBuffer->getHandle());
+			arena->multiDraw(commandOffset, draws);
+		}
+
+		objectBuffer->endFrame();
+		commandBuffer->endFrame();
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Pick the coarsest teapot mesh whose error stays under maxPixelError pixels at the
+	// teapot's distance from the camera.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::chooseTeapotLod(QuatCamera &camera, const mat4 &view)
+	{
+		VBOTeapot *mesh = static_cast<VBOTeapot *>(teapot);
+		float distance = glm::length(vec3(view * teapotModel * vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		mesh->selectLod(mesh->chooseLod(distance, camera.fieldOfView(), height, maxPixelError));
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Test an object's bounds at the current model matrix against the view frustum. The planes
+	// are taken from the whole model view projection so they are in the object's own space:
+	// the cheap sphere test first, then the tighter box.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	bool SceneDiffuse::isVisible(const Drawable *object, const mat4 &viewProjection)
+	{
+		if (culling)
+		{
+			Frustum frustum(viewProjection * model);
+			vec4 sphere = object->getBoundingSphere();
+			if (!frustum.intersectsSphere(vec3(sphere), sphere.w) ||
+				!frustum.intersectsBox(object->getBoundsMin(), object->getBoundsMax()))
+				return false;
+		}
+		objectsVisible++;
+		return true;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Fill in the object data for the current model matrix and a material of the material table.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	UniformBlock::ObjectData SceneDiffuse::objectData(const mat4 &view, unsigned int material)
+	{
+		UniformBlock::ObjectData object;
+		mat4 mv = view * model;						// The model's matrix translated into the camera view co-ordinates.
+
+		object.M = model;
+		object.normalMatrix = mat4(mat3(vec3(mv[0]), vec3(mv[1]), vec3(mv[2])));
+		object.Ka = materials[material].Ka;	// Values for ambience's RGB colour.
+		object.Kd = vec4(vec3(materials[material].Kd), (float)material);	// Values for diffusion's RGB colour, and where the lighting passes find the rest.
+		object.Ks = materials[material].Ks;	// Values for specularity's RGB colour.
+
+		return object;
 	}
 
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	// Send the MVP matrices to the GPU/Vertex Shader
+	// Copy the model matrix and a material into the uniform buffer, returns where they were written.
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	void SceneDiffuse::setMatrices(QuatCamera camera)
+	GLintptr SceneDiffuse::pushObjectData(const mat4 &view, unsigned int material)
 	{
-		mat4 mv = camera.view() * model;							// The model's matrix translated into the camera view co-ordinates.
-		prog.setUniform("ModelViewMatrix", mv);						
-		prog.setUniform("matrixProperties.NormalMatrix", mat3(vec3(mv[0]), vec3(mv[1]), vec3(mv[2])));
-		prog.setUniform("MVP", camera.projection() * mv);
-		mat3 normMat = glm::transpose(glm::inverse(mat3(model)));	// Inverses and transposes the co-ordinate system of the model.
-		prog.setUniform("matrixProperties.M", model);
-		prog.setUniform("matrixProperties.V", camera.view());
-		prog.setUniform("matrixProperties.P", camera.projection());
+		UniformBlock::ObjectData object = objectData(view, material);
+		return uniformBuffer->push(&object, sizeof(object));
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Report how much uniform block data the last frame streamed, how many of the uniforms set
+	// outside the blocks were uploaded and how many were unchanged, how many objects the frustum
+	// test rejected, the size of the meshes, how well they use the vertex cache and which teapot
+	// mesh was drawn.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::frameCounters(std::map<std::string, double> &counters)
+	{
+		GLSLProgram *programs[] = { &prog, &tessProg, &gbufferProg, &deferredProg, &lightVolumeProg, &clusterProg, &shadowProg };
+		unsigned int uploads = 0, elided = 0;
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+		{
+			uploads += programs[i]->getUniformUploadCount();
+			elided += programs[i]->getElidedUniformCount();
+		}
+		counters["uniformUploads"] = uploads;
+		counters["uniformsElided"] = elided;
+		counters["uniformBlockBytes"] = (double)uniformBuffer->bytesThisFrame();
+		counters["drawCalls"] = multiDraw ? (objectsVisible > 0 ? 1 : 0) : objectsVisible;
+		counters["objectsVisible"] = objectsVisible;
+		counters["objectsCulled"] = 2 - objectsVisible;
+		counters["vertexBytes"] = (double)(plane->getVertexBytes() + teapot->getVertexBytes());
+		counters["indexBytes"] = (double)(plane->getIndexBytes() + teapot->getIndexBytes());
+		if (deferredLights > 0)
+		{
+			counters["pointLights"] = deferredLights;
+			counters["gbufferBytes"] = (double)gbuffer->getBytes();
+		}
+		if (shadows)
+		{
+			const ShadowMap::Statistics &shadowStats = shadowMap->getStatistics();
+			counters["shadowPassesExecuted"] = shadowStats.passesExecuted;
+			counters["shadowPassesSkipped"] = shadowStats.passesSkipped;
+			counters["shadowTexelsUpdated"] = shadowStats.texelsUpdated;
+			counters["shadowMapBytes"] = (double)shadowMap->getBytes();
+		}
+		if (clusteredLights > 0)
+		{
+			counters["pointLights"] = clusteredLights;
+			counters["clusterBytes"] = (double)(clusterGrid[0] * clusterGrid[1] * clusterGrid[2] * (1 + maxClusterLights) * sizeof(GLuint));
+		}
+
+		// Simulated vertex cache behaviour of the teapot, before and after its triangles were reordered.
+		if (gpuTessellation) return;	// The patches have no triangles until the GPU makes them.
+		counters["teapotACMRGenerated"] = teapot->getGeneratedCacheStatistics().acmr;
+		counters["teapotACMR"] = teapot->getOptimisedCacheStatistics().acmr;
+		counters["teapotATVRGenerated"] = teapot->getGeneratedCacheStatistics().atvr;
+		counters["teapotATVR"] = teapot->getOptimisedCacheStatistics().atvr;
+
+		// The teapot mesh drawn this frame, the statistics above are for the finest.
+		VBOTeapot *mesh = static_cast<VBOTeapot *>(teapot);
+		counters["teapotLod"] = mesh->getSelectedLod();
+		counters["teapotTriangles"] = mesh->getLodTriangles(mesh->getSelectedLod());
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Watch the programs that were linked for this configuration of the scene.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::watchShaders(ShaderWatcher &watcher)
+	{
+		GLSLProgram *programs[] = { &prog, &tessProg, &gbufferProg, &deferredProg, &lightVolumeProg, &clusterProg, &shadowProg };
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+		{
+			if (programs[i]->isLinked()) watcher.watch(*programs[i]);
+		}
 	}
 
 	/////////////////////////////////////////////////////////////////////////////////////////////
@@ -148,6 +638,38 @@ namespace imat2908
 		width = w;
 		height = h;
 		camera.setAspectRatio((float)w / h);
+
+		// The G-buffer matches the viewport.
+		if (deferredLights > 0)
+		{
+			try {
+				delete gbuffer;
+				gbuffer = new GBuffer(w, h);
+			}
+			catch (std::exception & e) {
+				cerr << e.what() << endl;
+				exit(EXIT_FAILURE);
+			}
+
+			// The lighting passes read the G-buffer at their pixel.
+			deferredProg.use();
+			deferredProg.setUniform(deferredViewportUniform, vec2((float)w, (float)h));
+			lightVolumeProg.use();
+			lightVolumeProg.setUniform(volumeViewportUniform, vec2((float)w, (float)h));
+			prog.use();
+		}
+
+		// The clustered fragment shaders find their tile from the pixel.
+		if (clusteredLights > 0)
+		{
+			if (gpuTessellation)
+			{
+				tessProg.use();
+				tessProg.setUniform(tessClusteredUniforms.viewportSize, vec2((float)w, (float)h));
+			}
+			prog.use();
+			prog.setUniform(clusteredUniforms.viewportSize, vec2((float)w, (float)h));
+		}
 	}
 
 	/////////////////////////////////////////////////////////////////////////////////////////////
@@ -156,11 +678,125 @@ namespace imat2908
 	void SceneDiffuse::compileAndLinkShader()
 	{
 		try {
-			prog.compileShader("Shaders/phong.vert");
-			prog.compileShader("Shaders/phong.frag");
+			// The clustered renderer adds the point lights to the same shading.
+			const char *fragmentShader = clusteredLights > 0 ? "Shaders/phong_clustered.frag" : "Shaders/phong.frag";
+
+			prog.compileShader(multiDraw ? "Shaders/phong_indirect.vert" : "Shaders/phong.vert");
+			prog.compileShader(fragmentShader);
 			prog.link();
-			prog.validate();
+
+			// Both blocks are streamed from the C++ structures, so they must be at least as big as the shader's.
+			// The indirect shader reads its object data from shader storage instead.
+			prog.bindUniformBlock("FrameData", UniformBlock::FRAME);
+			if (multiDraw)
+				prog.bindShaderStorageBlock("Objects", StorageBlock::OBJECTS);
+			else
+				prog.bindUniformBlock("ObjectData", UniformBlock::OBJECT);
+			if (prog.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData) ||
+				prog.getUniformBlockSize("ObjectData") > (GLint)sizeof(UniformBlock::ObjectData))
+				throw GLSLProgramException("Uniform block layout does not match uniformblocks.h");
+
+			// A binary from the program cache was validated on the start that built it.
+			if (!prog.isFromBinaryCache())
+				prog.validate();
 			prog.use();
+
+			if (gpuTessellation)
+			{
+				tessProg.compileShader("Shaders/teapot_patches.vert");
+				tessProg.compileShader("Shaders/teapot_patches.tcs");
+				tessProg.compileShader("Shaders/teapot_patches.tes");
+				tessProg.compileShader(fragmentShader);
+				tessProg.link();
+
+				tessProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				tessProg.bindUniformBlock("ObjectData", UniformBlock::OBJECT);
+				if (tessProg.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData) ||
+					tessProg.getUniformBlockSize("ObjectData") > (GLint)sizeof(UniformBlock::ObjectData))
+					throw GLSLProgramException("Uniform block layout does not match uniformblocks.h");
+
+				if (!tessProg.isFromBinaryCache())
+					tessProg.validate();
+			}
+
+			if (shadows)
+			{
+				// Depth only, so the program needs no fragment shader.
+				shadowProg.compileShader("Shaders/shadow.vert");
+				shadowProg.link();
+			}
+
+			if (clusteredLights > 0)
+			{
+				clusterProg.compileShader("Shaders/cluster_lights.cs");
+				clusterProg.link();
+				clusterProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+
+				GLSLProgram *clusteredProgs[] = { &clusterProg, &prog, &tessProg };
+				for (int i = 0; i < (gpuTessellation ? 3 : 2); i++)
+				{
+					clusteredProgs[i]->bindShaderStorageBlock("PointLights", StorageBlock::POINT_LIGHTS);
+					clusteredProgs[i]->bindShaderStorageBlock("ClusterCounts", StorageBlock::CLUSTER_COUNTS);
+					clusteredProgs[i]->bindShaderStorageBlock("ClusterLights", StorageBlock::CLUSTER_LIGHTS);
+				}
+			}
+
+			if (deferredLights > 0)
+			{
+				// The forward vertex shader writes the surfaces, the lighting passes read them back.
+				gbufferProg.compileShader("Shaders/phong.vert");
+				gbufferProg.compileShader("Shaders/gbuffer.frag");
+				gbufferProg.link();
+				gbufferProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				gbufferProg.bindUniformBlock("ObjectData", UniformBlock::OBJECT);
+				if (gbufferProg.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData) ||
+					gbufferProg.getUniformBlockSize("ObjectData") > (GLint)sizeof(UniformBlock::ObjectData))
+					throw GLSLProgramException("Uniform block layout does not match uniformblocks.h");
+
+				deferredProg.compileShader("Shaders/fullscreen.vert");
+				deferredProg.compileShader("Shaders/deferred_light.frag");
+				deferredProg.link();
+				deferredProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				deferredProg.bindShaderStorageBlock("Materials", StorageBlock::MATERIALS);
+
+				lightVolumeProg.compileShader("Shaders/light_volume.vert");
+				lightVolumeProg.compileShader("Shaders/light_volume.frag");
+				lightVolumeProg.link();
+				lightVolumeProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				lightVolumeProg.bindShaderStorageBlock("Materials", StorageBlock::MATERIALS);
+				lightVolumeProg.bindShaderStorageBlock("PointLights", StorageBlock::POINT_LIGHTS);
+
+				// The G-buffer is always bound to the first three texture units.
+				GLSLProgram *lightingProgs[] = { &deferredProg, &lightVolumeProg };
+				for (int i = 0; i < 2; i++)
+				{
+					lightingProgs[i]->use();
+					lightingProgs[i]->setUniform("AlbedoTexture", GBuffer::ALBEDO);
+					lightingProgs[i]->setUniform("NormalTexture", GBuffer::NORMAL);
+					lightingProgs[i]->setUniform("DepthTexture", GBuffer::DEPTH);
+				}
+				prog.use();
+			}
+
+			resolveUniforms();
+
+			if (gpuTessellation)
+			{
+				// The detail only depends on distance, so the levels are set once.
+				GLint maxLevel = 64;
+				gl::GetIntegerv(gl::MAX_TESS_GEN_LEVEL, &maxLevel);
+				tessProg.use();
+				tessProg.setUniform(tessLevelScaleUniform, tessLevelScale);
+				tessProg.setUniform(maxTessLevelUniform, (float)glm::min(maxLevel, 64));
+				prog.use();
+			}
+
+			if (shadows)
+			{
+				// The shadow map is always bound to the first texture unit.
+				prog.setUniform(shadowsUniform, true);
+				prog.setUniform(shadowMapUniform, 0);
+			}
 		}
 		catch (GLSLProgramException & e) {
 			cerr << e.what() << endl;
@@ -168,6 +804,57 @@ namespace imat2908
 		}
 	}
 
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Look up the uniforms set by the C++ code. A reload may move them, so this runs again then.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneDiffuse::resolveUniforms()
+	{
+		if (gpuTessellation)
+		{
+			tessLevelScaleUniform = tessProg.getUniformHandle<float>("TessLevelScale");
+			maxTessLevelUniform = tessProg.getUniformHandle<float>("MaxTessLevel");
+		}
+
+		if (shadows)
+		{
+			shadowMVPUniform = shadowProg.getUniformHandle<mat4>("ShadowMVP");
+			shadowMatrixUniform = prog.getUniformHandle<mat4>("ShadowMatrix");
+			shadowsUniform = prog.getUniformHandle<bool>("Shadows");
+			shadowMapUniform = prog.getUniformHandle<int>("ShadowMap");
+		}
+
+		if (clusteredLights > 0)
+		{
+			lightCountUniform = clusterProg.getUniformHandle<GLuint>("LightCount");
+
+			GLSLProgram *clusteredProgs[] = { &clusterProg, &prog, &tessProg };
+			ClusterUniforms *uniforms[] = { &binUniforms, &clusteredUniforms, &tessClusteredUniforms };
+			for (int i = 0; i < (gpuTessellation ? 3 : 2); i++)
+			{
+				uniforms[i]->depthScale = clusteredProgs[i]->getUniformHandle<float>("ClusterDepthScale");
+				uniforms[i]->depthBias = clusteredProgs[i]->getUniformHandle<float>("ClusterDepthBias");
+				uniforms[i]->viewportSize = clusteredProgs[i]->getUniformHandle<vec2>("ViewportSize");
+			}
+		}
+
+		if (deferredLights > 0)
+		{
+			deferredViewportUniform = deferredProg.getUniformHandle<vec2>("ViewportSize");
+			volumeViewportUniform = lightVolumeProg.getUniformHandle<vec2>("ViewportSize");
+			volumeScaleUniform = lightVolumeProg.getUniformHandle<float>("VolumeScale");
+		}
+	}
+
+	void SceneDiffuse::shadersReloaded()
+	{
+		try {
+			resolveUniforms();
+		}
+		catch (GLSLProgramException & e) {
+			cerr << e.what() << endl;
+		}
+	}
+
 	void SceneDiffuse::animate(bool &shift, bool &a, bool &d, bool &s, bool &space, bool &r)
 	{
 		// If the "R" key has is being pressed, reset all the lighting element's parameters back to their initial values then set the key back to false.
@@ -6,9 +6,17 @@
 #include <glfw3.h>
 #include "scene.h"
 #include "glslprogram.h"
+#include "streambuffer.h"
+#include "geometryarena.h"
+#include "uniformblocks.h"
+#include "frustum.h"
+#include "gbuffer.h"
+#include "shadowmap.h"
 
 #include "vboteapot.h"
 #include "vboplane.h"
+#include "vboteapotpatches.h"
+#include "vbosphere.h"
 
 #include <glm.hpp>
 
@@ -42,17 +50,96 @@ private:
 	}; 
 	AttunParam attunationParameter;
 
-	VBOTeapot *teapot;  // Teapot VBO.
+	Drawable *teapot;  // Teapot VBO, or its Bezier patches when tessellated on the GPU.
 	VBOPlane *plane;  // Plane VBO.
 
+	bool multiDraw;					// Draw both objects with one indirect call from a shared geometry arena.
+	GeometryArena *arena;			// Vertex and index buffers of both objects when multiDraw is set.
+	StreamBuffer *objectBuffer;		// Per-draw object data read by phong_indirect.vert.
+	StreamBuffer *commandBuffer;	// Indirect draw commands, rewritten every frame.
+	VertexFormat::Format vertexFormat;	// Layout of the meshes' vertex buffers.
+
+	bool gpuTessellation;				// Draw the teapot's patches with the tessellation shaders.
+	GLSLProgram tessProg;				// Program evaluating the teapot's patches.
+	UniformHandle<float> tessLevelScaleUniform;	// Its tessellation levels.
+	UniformHandle<float> maxTessLevelUniform;
+	float tessLevelScale = 160.0f;		// Tessellation level of an edge one unit from the camera (16 at ten units).
+
+	int lodLevels;						// Teapot meshes to choose from, 1 for a single mesh.
+	float maxPixelError = 1.0f;			// Furthest the chosen mesh may be from the true surface on screen.
+
+	bool culling;						// Skip objects outside the view frustum.
+	int objectsVisible;					// Objects that passed the frustum test in the last frame.
+
+	int deferredLights;					// Point lights of the deferred renderer, 0 to render forward with the one light.
+	GBuffer *gbuffer;					// Surfaces of the deferred renderer, the size of the viewport.
+	GLSLProgram gbufferProg;			// Writes the objects' surfaces into the G-buffer.
+	GLSLProgram deferredProg;			// Lights the G-buffer with the scene's light as phong.frag would.
+	GLSLProgram lightVolumeProg;		// Adds one point light for each instance of the light volume.
+	UniformHandle<vec2> deferredViewportUniform;	// The G-buffer's size, for the lighting passes to find their pixel in it.
+	UniformHandle<vec2> volumeViewportUniform;
+	UniformHandle<float> volumeScaleUniform;	// Enlarges the light volume to enclose the light's sphere.
+	VBOSphere *lightVolume;				// Sphere drawn around each point light.
+	GLuint materialBuffer;				// The objects' materials, read by the lighting passes.
+	GLuint pointLightBuffer;			// The point lights, read by the light volumes.
+	GLuint emptyVao;					// Bound for the full screen triangle, which has no attributes.
+
+	int clusteredLights;				// Point lights shaded forward from per-cluster light lists, 0 for none.
+	GLSLProgram clusterProg;			// Bins the point lights into the clusters of the view frustum.
+	UniformHandle<GLuint> lightCountUniform;	// Its number of lights to bin.
+	struct ClusterUniforms				// Handles of the uniforms finding a fragment's cluster, in one program.
+	{
+		UniformHandle<float> depthScale;
+		UniformHandle<float> depthBias;
+		UniformHandle<vec2> viewportSize;	// Not in clusterProg, which works on whole clusters.
+	};
+	ClusterUniforms binUniforms;		// clusterProg's.
+	ClusterUniforms clusteredUniforms;	// prog's.
+	ClusterUniforms tessClusteredUniforms;	// tessProg's.
+	GLuint clusterCountBuffer;			// Lights touching each cluster.
+	GLuint clusterLightBuffer;			// The lights touching each cluster, a fixed number of slots each.
+
+	bool shadows;						// Shadow the scene's light with a cached shadow map.
+	ShadowMap *shadowMap;				// The plane in its static layer, the teapot drawn on top.
+	GLSLProgram shadowProg;				// Writes the casters' depth into the shadow map.
+	UniformHandle<mat4> shadowMVPUniform;		// Its light space transform of the caster drawn.
+	UniformHandle<mat4> shadowMatrixUniform;	// The forward program's lookup into the shadow map,
+	UniformHandle<bool> shadowsUniform;			// whether to shadow at all,
+	UniformHandle<int> shadowMapUniform;		// and the texture unit of the map.
+	static const int shadowSize = 2048;	// Texels along each side of the shadow map.
+	mat4 shadowPlaneModel;				// Where the plane was when last drawn into the shadow map.
+	mat4 shadowTeapotModel;				// Where the teapot was when last drawn into the shadow map,
+	int shadowTeapotLod;				// and which of its meshes.
+
     mat4 model; // Model matrix.
+	mat4 planeModel;	// Where the plane is placed, used for drawing, culling and the shadow map alike.
+	mat4 teapotModel;	// Where the teapot is placed.
+
+	UniformBlock::FrameData frameData;	// Camera and light data, uploaded once per frame.
+	StreamBuffer *uniformBuffer;		// Ring buffer the uniform blocks are streamed through every frame.
+
+	UniformBlock::ObjectData objectData(const mat4 &view, unsigned int material); // The model matrix and material of an object.
+	GLintptr pushObjectData(const mat4 &view, unsigned int material); // Stream the model matrix and material of an object.
+
+	void renderMultiDraw(const mat4 &view, const mat4 &viewProjection); // Draw the visible objects with a single indirect call.
 
-    void setMatrices(QuatCamera camera); // Set the camera matrices.
+	void chooseTeapotLod(QuatCamera &camera, const mat4 &view); // Select the teapot's level of detail for its size on screen.
+
+	bool isVisible(const Drawable *object, const mat4 &viewProjection); // Frustum test of an object at the current model matrix, counts it if visible.
+
+	void createPointLights();	// Create the deferred or clustered renderer's buffers and point lights.
+	void scatterPointLights();	// Place the point lights over the plane and upload them.
+	void binLights(QuatCamera &camera);	// List the point lights touching each cluster for this frame.
+	void renderShadows(const mat4 &view);	// Bring the shadow map up to date, redrawing only what moved.
+	void lightScene();			// Light the G-buffer with the scene's light and the point lights.
 
     void compileAndLinkShader(); // Compile and link the shader.
+	void resolveUniforms();		// Look up the handles of the uniforms set outside the uniform blocks, after every link.
 
 public:
-    SceneDiffuse(); // Constructor.
+    SceneDiffuse(bool multiDraw = false, VertexFormat::Format vertexFormat = VertexFormat::SEPARATE, bool gpuTessellation = false, int lodLevels = 1, bool culling = true,
+		int deferredLights = 0, int clusteredLights = 0, bool shadows = false); // Constructor.
+	~SceneDiffuse();					// Destructor, releases the scene's GL objects.
 
 	void setLightParams();				// Setup the lighting's parameters.
 
@@ -63,6 +150,14 @@ public:
     void resize(QuatCamera camera, int, int); // Resize.
 
 	void animate(bool &shift, bool &a, bool &d, bool &s, bool &space, bool &r); // Used to update the lighting parameters based on the user's keyboard input.
+
+	void setPointLightCount(int count); // Rescatter the deferred or clustered renderer's point lights, for the light count sweep.
+
+	void frameCounters(std::map<std::string, double> &counters); // Statistics about the last rendered frame.
+
+	void watchShaders(ShaderWatcher &watcher); // Reload the programs this configuration draws with when their shaders are edited.
+
+	void shadersReloaded(); // Resolve the uniform handles of the reloaded programs.
 };
 }
 
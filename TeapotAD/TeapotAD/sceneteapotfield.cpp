@@ -0,0 +1,543 @@
+#include "sceneteapotfield.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+using std::cerr;
+using std::endl;
+
+#include "defines.h"
+#include "shaderwatcher.h"
+
+using glm::vec3;
+using glm::vec4;
+
+#include <gtc/matrix_transform.hpp>
+#include <gtx/transform2.hpp>
+
+namespace imat2908
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Constructor
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	SceneTeapotField::SceneTeapotField(int teapots, VertexFormat::Format format, int lods, bool cull, bool occlusion) :
+		numTeapots(teapots), vertexFormat(format), uniformBuffer(NULL), instanceBuffer(0), materialBuffer(0), identityBuffer(0), lodLevels(lods),
+		culling(cull), planeVisible(true), instanceIndexBuffer(NULL), occlusionCulling(occlusion), depthPyramid(NULL), teapotArena(NULL),
+		commandBuffer(0), culledIndexBuffer(0), occlusionFrame(0), teapot(NULL), plane(NULL)
+	{
+		for (int i = 0; i < 3; i++) commandFences[i] = 0;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Release everything initScene() and resize() created.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	SceneTeapotField::~SceneTeapotField()
+	{
+		delete teapot;
+		delete plane;
+		delete teapotArena;
+		delete uniformBuffer;
+		delete instanceIndexBuffer;
+		delete depthPyramid;
+
+		// Deleting buffer 0 is ignored, and fences are only made once a frame is culled.
+		GLuint buffers[] = { instanceBuffer, materialBuffer, identityBuffer, commandBuffer, culledIndexBuffer };
+		gl::DeleteBuffers(5, buffers);
+		for (int i = 0; i < 3; i++)
+		{
+			if (commandFences[i] != 0) gl::DeleteSync(commandFences[i]);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Initialise the Scene
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::initScene(QuatCamera /*camera*/)
+	{
+		//|Compile and link the shader
+		compileAndLinkShader();
+
+		gl::Enable(gl::DEPTH_TEST);
+
+		uniformBuffer = new StreamBuffer(gl::UNIFORM_BUFFER, sizeof(UniformBlock::FrameData));
+
+		// A single light above the field, with the same intensities as SceneDiffuse starts with.
+		frameData.lightPosition = vec4(0.0f, 30.0f, 0.0f, 1.0f);
+		frameData.La = vec4(0.3f, 0.3f, 0.3f, 0.0f);
+		frameData.Ld = vec4(0.9f, 0.9f, 0.9f, 0.0f);
+		frameData.Ls = vec4(0.3f, 0.3f, 0.3f, 0.0f);
+		frameData.attenuation = 60.0f;
+
+		// The plane is sized to fit under the whole field.
+		int side = (int)ceil(sqrt((float)numTeapots));
+		float extent = glm::max(100.0f, side * spacing + 20.0f);
+		plane = new VBOPlane(extent, extent, 100, 100, NULL, vertexFormat);
+
+		// A matrix to move the teapot lid upwards.
+		glm::mat4 lid = glm::mat4(1.0);
+		lid *= glm::translate(vec3(0.0, 0.0, 0.1));
+
+		//Create the teapot with translated lid.
+		//With levels of detail the finest mesh has a grid of 32, each coarser one half the grid of the last.
+		//The GPU culling pass draws it from an arena so the commands can be indirect.
+		if (occlusionCulling) teapotArena = new GeometryArena(vertexFormat);
+		teapot = new VBOTeapot(lodLevels > 1 ? 32 : 16, lid, teapotArena, vertexFormat, lodLevels);
+
+		createInstances();
+
+		if (occlusionCulling)
+			createOcclusionCulling();
+		else if (culling || lodLevels > 1)
+		{
+			// Room for every teapot's index, plus the padding each list's aligned start may need.
+			visibleInstances.resize(teapot->getLodCount());
+			instanceIndexBuffer = new StreamBuffer(gl::SHADER_STORAGE_BUFFER, numTeapots * sizeof(GLuint) + teapot->getLodCount() * 256);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Lay the teapots out on a square grid centred on the origin, each turned by a different
+	// amount and given one of a small palette of materials.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::createInstances()
+	{
+		const StorageBlock::MaterialData palette[] = {
+			{ vec4(0.46f, 0.29f, 0.0f, 0.0f), vec4(0.46f, 0.29f, 0.0f, 0.0f), vec4(0.29f, 0.29f, 0.29f, 0.0f) },	// Teapot brown.
+			{ vec4(0.51f, 1.0f, 0.49f, 0.0f), vec4(0.51f, 1.0f, 0.49f, 0.0f), vec4(0.1f, 0.1f, 0.1f, 0.0f) },		// Plane green.
+			{ vec4(0.6f, 0.1f, 0.1f, 0.0f), vec4(0.8f, 0.1f, 0.1f, 0.0f), vec4(0.5f, 0.5f, 0.5f, 0.0f) },
+			{ vec4(0.1f, 0.1f, 0.6f, 0.0f), vec4(0.1f, 0.2f, 0.8f, 0.0f), vec4(0.5f, 0.5f, 0.5f, 0.0f) },
+			{ vec4(0.5f, 0.5f, 0.5f, 0.0f), vec4(0.7f, 0.7f, 0.7f, 0.0f), vec4(0.9f, 0.9f, 0.9f, 0.0f) },
+			{ vec4(0.6f, 0.5f, 0.1f, 0.0f), vec4(0.8f, 0.7f, 0.1f, 0.0f), vec4(0.6f, 0.6f, 0.3f, 0.0f) }
+		};
+		const unsigned int planeMaterial = 1;
+		const unsigned int teapotMaterials[] = { 0, 2, 3, 4, 5 };	// Every material except the plane's.
+		const unsigned int numTeapotMaterials = sizeof(teapotMaterials) / sizeof(teapotMaterials[0]);
+
+		gl::GenBuffers(1, &materialBuffer);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, materialBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, sizeof(palette), palette, gl::STATIC_DRAW);
+
+		// The teapots' instances start at the first aligned offset after the plane's.
+		GLint alignment = 16;
+		gl::GetIntegerv(gl::SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		GLintptr instanceSize = sizeof(StorageBlock::InstanceData);
+		teapotOffset = (instanceSize + alignment - 1) / alignment * alignment;
+
+		std::vector<GLubyte> data(teapotOffset + numTeapots * instanceSize);
+		StorageBlock::InstanceData *planeInstance = (StorageBlock::InstanceData *)&data[0];
+		StorageBlock::InstanceData *teapots = (StorageBlock::InstanceData *)&data[teapotOffset];
+
+		planeInstance->M = mat4(1.0f);
+		planeInstance->materialIndex = planeMaterial;
+
+		int side = (int)ceil(sqrt((float)numTeapots));
+		float start = -0.5f * (side - 1) * spacing;
+		vec4 sphere = teapot->getBoundingSphere();
+		teapotSpheres.resize(numTeapots);
+		for (int i = 0; i < numTeapots; i++)
+		{
+			float x = start + (i % side) * spacing;
+			float z = start + (i / side) * spacing;
+			float yaw = (float)((i * 2654435761u) % 360u);	// Scrambled but repeatable rotation.
+
+			teapots[i].M = glm::translate(vec3(x, 0.0f, z)) * glm::rotate(glm::radians(yaw), vec3(0.0f, 1.0f, 0.0f));
+			teapotSpheres[i] = vec4(vec3(teapots[i].M * vec4(vec3(sphere), 1.0f)), sphere.w);	// Rigid, so the radius is unchanged.
+			teapots[i].materialIndex = teapotMaterials[i % numTeapotMaterials];
+		}
+
+		gl::GenBuffers(1, &instanceBuffer);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, instanceBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, data.size(), &data[0], gl::STATIC_DRAW);
+
+		// Draws of every instance in order look themselves up through this.
+		std::vector<GLuint> identity(numTeapots);
+		for (int i = 0; i < numTeapots; i++) identity[i] = i;
+
+		gl::GenBuffers(1, &identityBuffer);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, identityBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, identity.size() * sizeof(GLuint), &identity[0], gl::STATIC_DRAW);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Set up the GPU culling pass. Each level of detail has an indirect draw command whose
+	// baseInstance is the start of its part of the culled index list, and the arena's draw
+	// index gives the vertex shader baseInstance plus the instance to look the list up with.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::createOcclusionCulling()
+	{
+		int levels = teapot->getLodCount();
+		teapotArena->upload(levels * numTeapots);
+		culledCounts.assign(levels, 0);
+
+		GLint alignment = 16;
+		gl::GetIntegerv(gl::SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		commandStride = (levels * sizeof(DrawElementsIndirectCommand) + alignment - 1) / alignment * alignment;
+
+		gl::GenBuffers(1, &commandBuffer);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, commandBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, 3 * commandStride, NULL, gl::DYNAMIC_DRAW);
+
+		gl::GenBuffers(1, &culledIndexBuffer);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, culledIndexBuffer);
+		gl::BufferData(gl::SHADER_STORAGE_BUFFER, levels * numTeapots * sizeof(GLuint), NULL, gl::DYNAMIC_COPY);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+
+		// Everything the pass needs to know about the teapot is fixed.
+		vec4 sphere = teapot->getBoundingSphere();
+		cullProg.use();
+		cullProg.setUniform("InstanceCount", (GLuint)numTeapots);
+		cullProg.setUniform("BoundsMin", teapot->getBoundsMin());
+		cullProg.setUniform("BoundsMax", teapot->getBoundsMax());
+		cullProg.setUniform("SphereCentre", vec3(sphere));
+		cullProg.setUniform("LodCount", glm::min(levels, 8));
+		for (int l = 0; l < levels && l < 8; l++)
+			cullProg.setUniform(("LodErrors[" + std::to_string(l) + "]").c_str(), teapot->getLodError(l));
+		cullProg.setUniform("MaxPixelError", maxPixelError);
+		cullProg.setUniform("DepthPyramid", 0);
+		prog.use();
+
+		resolveCullUniforms();
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Look up the culling pass's per-frame uniforms. A reload may move them, so this runs again then.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::resolveCullUniforms()
+	{
+		pixelsPerUnitUniform = cullProg.getUniformHandle<float>("PixelsPerUnit");
+		pyramidLevelsUniform = cullProg.getUniformHandle<int>("PyramidLevels");
+		pyramidSizeUniform = cullProg.getUniformHandle<vec2>("PyramidSize");
+		pyramidValidUniform = cullProg.getUniformHandle<bool>("PyramidValid");
+	}
+
+	void SceneTeapotField::shadersReloaded()
+	{
+		if (!occlusionCulling) return;
+
+		try {
+			resolveCullUniforms();
+		}
+		catch (GLSLProgramException & e) {
+			cerr << e.what() << endl;
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	///// Render the scene to the camera.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::render(QuatCamera camera)
+	{
+		// Count the uniform uploads of this frame only.
+		GLSLProgram *programs[] = { &prog, &cullProg, &culledProg };
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+			programs[i]->resetUniformCounters();
+
+		// With occlusion culling the frame is rendered into the depth pyramid's framebuffer, then
+		// copied to the one that was bound.
+		GLint outputFramebuffer = 0;
+		if (depthPyramid != NULL)
+		{
+			gl::GetIntegerv(gl::DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+			depthPyramid->bind();
+		}
+
+		gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);	// Clear the buffers.
+		prog.use();
+
+		uniformBuffer->beginFrame();
+		frameData.V = camera.view();
+		frameData.P = camera.projection();
+		GLintptr frameOffset = uniformBuffer->push(&frameData, sizeof(frameData));
+		uniformBuffer->flush();
+		uniformBuffer->bindRange(UniformBlock::FRAME, frameOffset, sizeof(UniformBlock::FrameData));
+
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::MATERIALS, materialBuffer);
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::INSTANCE_INDICES, identityBuffer);
+
+		// World space planes, the instances' bounds are moved into world space up front.
+		Frustum frustum(frameData.P * frameData.V);
+
+		// The plane is a single instance at the start of the instance buffer, its model matrix is the identity.
+		planeVisible = !culling || frustum.intersectsBox(plane->getBoundsMin(), plane->getBoundsMax());
+		if (planeVisible)
+		{
+			gl::BindBufferRange(gl::SHADER_STORAGE_BUFFER, StorageBlock::INSTANCES, instanceBuffer, 0, sizeof(StorageBlock::InstanceData));
+			plane->renderInstanced(1);
+		}
+
+		// Every teapot in one draw call, or the visible ones with one draw call per level of detail.
+		gl::BindBufferRange(gl::SHADER_STORAGE_BUFFER, StorageBlock::INSTANCES, instanceBuffer, teapotOffset, numTeapots * sizeof(StorageBlock::InstanceData));
+		if (depthPyramid != NULL)
+			renderOccluded(camera);
+		else if (instanceIndexBuffer != NULL)
+			renderVisible(camera, frustum);
+		else
+			teapot->renderInstanced(numTeapots);
+
+		uniformBuffer->endFrame();
+
+		// This frame's depth is what the next frame's teapots are tested against.
+		if (depthPyramid != NULL)
+		{
+			depthPyramid->build();
+			depthPyramid->present(outputFramebuffer);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Reset this frame's draw commands, let the compute shader cull every teapot against the
+	// frustum and the depth pyramid and append the survivors to their level's command, then
+	// draw all the levels with one indirect call. Nothing is read back to the CPU.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::renderOccluded(QuatCamera &camera)
+	{
+		int levels = teapot->getLodCount();
+		int set = occlusionFrame % 3;
+		GLintptr commandOffset = set * commandStride;
+
+		std::vector<DrawElementsIndirectCommand> commands(levels);
+		for (int l = 0; l < levels; l++)
+			commands[l] = GeometryArena::command(teapot->getLodRange(l), 0, l * numTeapots);
+
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, commandBuffer);
+		gl::BufferSubData(gl::SHADER_STORAGE_BUFFER, commandOffset, levels * sizeof(DrawElementsIndirectCommand), &commands[0]);
+		gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+
+		cullProg.use();
+		cullProg.setUniform(pixelsPerUnitUniform, height / (2.0f * glm::tan(0.5f * camera.fieldOfView())));
+		cullProg.setUniform(pyramidLevelsUniform, depthPyramid->getLevels());
+		cullProg.setUniform(pyramidSizeUniform, glm::vec2((float)depthPyramid->getWidth(), (float)depthPyramid->getHeight()));
+		cullProg.setUniform(pyramidValidUniform, depthPyramid->isBuilt());
+
+		gl::BindBufferRange(gl::SHADER_STORAGE_BUFFER, StorageBlock::DRAW_COMMANDS, commandBuffer, commandOffset, levels * sizeof(DrawElementsIndirectCommand));
+		gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, StorageBlock::INSTANCE_INDICES, culledIndexBuffer);
+		gl::ActiveTexture(gl::TEXTURE0);
+		gl::BindTexture(gl::TEXTURE_2D, depthPyramid->getTexture());
+
+		gl::DispatchCompute((numTeapots + 63) / 64, 1, 1);
+		gl::MemoryBarrier(gl::COMMAND_BARRIER_BIT | gl::SHADER_STORAGE_BARRIER_BIT);
+		gl::BindTexture(gl::TEXTURE_2D, 0);
+
+		culledProg.use();
+		gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, commandBuffer);
+		teapotArena->multiDraw(commandOffset, levels);
+
+		// Lets frameCounters() read the counts back once the GPU is done with them.
+		if (commandFences[set] != 0) gl::DeleteSync(commandFences[set]);
+		commandFences[set] = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+		occlusionFrame++;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Drop the teapots whose bounding spheres are outside the frustum, give each of the rest
+	// the coarsest mesh whose error stays under maxPixelError pixels at its distance from the
+	// camera, then draw each mesh once for all the teapots that chose it.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::renderVisible(QuatCamera &camera, const Frustum &frustum)
+	{
+		mat4 view = camera.view();
+		float fieldOfView = camera.fieldOfView();
+		int levels = (int)visibleInstances.size();
+
+		for (int l = 0; l < levels; l++) visibleInstances[l].clear();
+		for (int i = 0; i < numTeapots; i++)
+		{
+			vec3 centre = vec3(teapotSpheres[i]);
+			if (culling && !frustum.intersectsSphere(centre, teapotSpheres[i].w)) continue;
+
+			int level = 0;
+			if (levels > 1)
+			{
+				float distance = glm::length(vec3(view * vec4(centre, 1.0f)));
+				level = teapot->chooseLod(distance, fieldOfView, height, maxPixelError);
+			}
+			visibleInstances[level].push_back(i);
+		}
+
+		// Upload every list before the first draw reads one.
+		instanceIndexBuffer->beginFrame();
+		std::vector<GLintptr> offsets(levels);
+		for (int l = 0; l < levels; l++)
+			if (!visibleInstances[l].empty())
+				offsets[l] = instanceIndexBuffer->push(&visibleInstances[l][0], visibleInstances[l].size() * sizeof(GLuint));
+		instanceIndexBuffer->flush();
+
+		for (int l = 0; l < levels; l++)
+		{
+			if (visibleInstances[l].empty()) continue;
+
+			instanceIndexBuffer->bindRange(StorageBlock::INSTANCE_INDICES, offsets[l], visibleInstances[l].size() * sizeof(GLuint));
+			teapot->selectLod(l);
+			teapot->renderInstanced((int)visibleInstances[l].size());
+		}
+		instanceIndexBuffer->endFrame();
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Report how many teapots were drawn and how many the frustum test rejected, with how many
+	// draw calls, the size of the mesh data they were drawn from and how many vertices the
+	// vertex shader had to transform. With levels of detail also report how many teapots each
+	// level drew. The GPU culling pass's counts are read from the oldest set of commands in
+	// flight, two frames late, and only if the GPU has finished with it so there is no stall.
+	// Also report how many uniform uploads the frame made and how many were unchanged.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::frameCounters(std::map<std::string, double> &counters)
+	{
+		GLSLProgram *programs[] = { &prog, &cullProg, &culledProg };
+		unsigned int uploads = 0, elided = 0;
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+		{
+			uploads += programs[i]->getUniformUploadCount();
+			elided += programs[i]->getElidedUniformCount();
+		}
+		counters["uniformUploads"] = uploads;
+		counters["uniformsElided"] = elided;
+
+		if (depthPyramid != NULL)
+		{
+			int oldest = occlusionFrame % 3;
+			if (commandFences[oldest] != 0 && gl::ClientWaitSync(commandFences[oldest], 0, 0) != gl::TIMEOUT_EXPIRED)
+			{
+				std::vector<DrawElementsIndirectCommand> commands(culledCounts.size());
+				gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, commandBuffer);
+				gl::GetBufferSubData(gl::SHADER_STORAGE_BUFFER, oldest * commandStride, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0]);
+				gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+				for (size_t l = 0; l < commands.size(); l++) culledCounts[l] = commands[l].instanceCount;
+			}
+		}
+
+		double drawCalls = planeVisible ? 1.0 : 0.0;
+		double vertexFetchBytes = planeVisible ? (double)plane->getVertexBytes() : 0.0;
+		double vertexShaderInvocations = 0.0;
+		double triangles = 0.0;
+		double teapotsVisible = 0.0;
+
+		for (int l = 0; l < teapot->getLodCount(); l++)
+		{
+			double drawn = (double)numTeapots;
+			if (depthPyramid != NULL) drawn = (double)culledCounts[l];
+			else if (instanceIndexBuffer != NULL) drawn = (double)visibleInstances[l].size();
+			if (drawn > 0.0 && depthPyramid == NULL) drawCalls += 1.0;
+			vertexFetchBytes += drawn * teapot->getLodVertexBytes(l);
+			vertexShaderInvocations += drawn * teapot->getLodTransforms(l);
+			triangles += drawn * teapot->getLodTriangles(l);
+			teapotsVisible += drawn;
+
+			if (lodLevels > 1) counters["lod" + std::to_string(l)] = drawn;
+		}
+
+		if (depthPyramid != NULL) drawCalls += 1.0;	// Every level in one indirect call.
+
+		counters["instances"] = teapotsVisible;
+		counters["objectsVisible"] = teapotsVisible + (planeVisible ? 1 : 0);
+		counters["objectsCulled"] = (numTeapots - teapotsVisible) + (planeVisible ? 0 : 1);
+		counters["drawCalls"] = drawCalls;
+		counters["vertexBytes"] = (double)(plane->getVertexBytes() + teapot->getVertexBytes());
+		counters["vertexFetchBytes"] = vertexFetchBytes;
+		counters["indexBytes"] = (double)(plane->getIndexBytes() + teapot->getIndexBytes());
+		counters["teapotTriangles"] = triangles;
+
+		// Vertex shader invocations of the visible teapots as the vertex cache simulation predicts them,
+		// before the triangles were reordered only for a single mesh.
+		if (lodLevels == 1)
+			counters["vertexShaderInvocationsGenerated"] = teapotsVisible * teapot->getGeneratedCacheStatistics().transforms;
+		counters["vertexShaderInvocations"] = vertexShaderInvocations;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Watch the programs that were linked for this configuration of the scene.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::watchShaders(ShaderWatcher &watcher)
+	{
+		GLSLProgram *programs[] = { &prog, &cullProg, &culledProg };
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+		{
+			if (programs[i]->isLinked()) watcher.watch(*programs[i]);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Resize the viewport.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::resize(QuatCamera camera, int w, int h)
+	{
+		gl::Viewport(0, 0, w, h);
+		height = h;
+		camera.setAspectRatio((float)w / h);
+
+		// The depth pyramid matches the viewport, and starts again empty.
+		if (occlusionCulling)
+		{
+			try {
+				delete depthPyramid;
+				depthPyramid = new DepthPyramid(w, h);
+			}
+			catch (std::exception & e) {
+				cerr << e.what() << endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// Compile and link the shader.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::compileAndLinkShader()
+	{
+		try {
+			prog.compileShader("Shaders/phong_instanced.vert");
+			prog.compileShader("Shaders/phong.frag");
+			prog.link();
+
+			prog.bindUniformBlock("FrameData", UniformBlock::FRAME);
+			prog.bindShaderStorageBlock("Instances", StorageBlock::INSTANCES);
+			prog.bindShaderStorageBlock("Materials", StorageBlock::MATERIALS);
+			prog.bindShaderStorageBlock("InstanceIndices", StorageBlock::INSTANCE_INDICES);
+			if (prog.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData))
+				throw GLSLProgramException("Uniform block layout does not match uniformblocks.h");
+
+			// Validation is only needed the first time, cached binaries skip it on warm starts.
+			if (!prog.isFromBinaryCache())
+				prog.validate();
+
+			if (occlusionCulling)
+			{
+				cullProg.compileShader("Shaders/teapot_cull.cs");
+				cullProg.link();
+				cullProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				cullProg.bindShaderStorageBlock("Instances", StorageBlock::INSTANCES);
+				cullProg.bindShaderStorageBlock("DrawCommands", StorageBlock::DRAW_COMMANDS);
+				cullProg.bindShaderStorageBlock("InstanceIndices", StorageBlock::INSTANCE_INDICES);
+
+				culledProg.compileShader("Shaders/phong_culled.vert");
+				culledProg.compileShader("Shaders/phong.frag");
+				culledProg.link();
+				culledProg.bindUniformBlock("FrameData", UniformBlock::FRAME);
+				culledProg.bindShaderStorageBlock("Instances", StorageBlock::INSTANCES);
+				culledProg.bindShaderStorageBlock("Materials", StorageBlock::MATERIALS);
+				culledProg.bindShaderStorageBlock("InstanceIndices", StorageBlock::INSTANCE_INDICES);
+				if (cullProg.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData) ||
+					culledProg.getUniformBlockSize("FrameData") > (GLint)sizeof(UniformBlock::FrameData))
+					throw GLSLProgramException("Uniform block layout does not match uniformblocks.h");
+			}
+
+			prog.use();
+		}
+		catch (GLSLProgramException & e) {
+			cerr << e.what() << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// The lighting of the field is fixed, the reset key only resets the camera.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	void SceneTeapotField::animate(bool &/*shift*/, bool &/*a*/, bool &/*d*/, bool &/*s*/, bool &/*space*/, bool &r)
+	{
+		r = false;
+	}
+}
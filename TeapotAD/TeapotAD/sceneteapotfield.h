@@ -0,0 +1,121 @@
+#ifndef SCENETEAPOTFIELD_H
+#define SCENETEAPOTFIELD_H
+
+#include "gl_core_4_3.hpp"
+
+#include <glfw3.h>
+#include "scene.h"
+#include "glslprogram.h"
+#include "streambuffer.h"
+#include "uniformblocks.h"
+#include "frustum.h"
+#include "geometryarena.h"
+#include "depthpyramid.h"
+
+#include "vboteapot.h"
+#include "vboplane.h"
+
+#include <glm.hpp>
+#include <vector>
+
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+namespace imat2908
+{
+
+/**
+	A grid of thousands of teapots drawn with a single instanced draw call.
+
+	Every teapot's model matrix and material index live in a shader storage buffer that is
+	uploaded once, so the CPU cost of a frame does not depend on the number of teapots.
+
+	Every frame the teapots outside the view frustum are dropped and, with levels of detail,
+	the rest are sorted by the mesh their size on screen needs, then each mesh is drawn once
+	for the teapots that chose it. The shader finds its instance through a list of instance
+	indices streamed for each draw call.
+
+	With occlusion culling the same work moves to a compute shader, which also drops the
+	teapots hidden behind others in the previous frame's depth pyramid and writes the lists
+	and the instance counts of one indirect draw command per level of detail.
+ */
+class SceneTeapotField : public Scene
+{
+private:
+    GLSLProgram prog;
+
+	int numTeapots;						// Number of teapot instances in the field.
+	float spacing = 4.0f;				// Distance between neighbouring teapots.
+	VertexFormat::Format vertexFormat;	// Layout of the meshes' vertex buffers.
+
+	UniformBlock::FrameData frameData;	// Camera and light data, uploaded once per frame.
+	StreamBuffer *uniformBuffer;		// Ring buffer the frame's uniform block is streamed through.
+
+	GLuint instanceBuffer;				// Static per-instance data, the plane followed by the teapots.
+	GLintptr teapotOffset;				// Where the teapots' instance data starts in instanceBuffer.
+	GLuint materialBuffer;				// Material palette indexed by the instances.
+	GLuint identityBuffer;				// Instance indices 0, 1, 2, ... for draws of every instance in order.
+
+	int lodLevels;						// Teapot meshes to choose from, 1 for a single mesh.
+	float maxPixelError = 1.0f;			// Furthest the chosen mesh may be from the true surface on screen.
+	int height;							// Viewport height in pixels.
+	bool culling;						// Skip teapots outside the view frustum.
+	bool planeVisible;					// Whether the plane passed the frustum test in the last frame.
+
+	std::vector<vec4> teapotSpheres;	// World space bounding sphere of each teapot, centre and radius.
+	std::vector<std::vector<GLuint> > visibleInstances;	// The visible teapots drawn with each mesh this frame.
+	StreamBuffer *instanceIndexBuffer;	// Ring buffer the lists of teapots are streamed through.
+
+	bool occlusionCulling;				// Cull and choose levels of detail on the GPU, against a depth pyramid.
+	DepthPyramid *depthPyramid;			// Render target and Hi-Z of the last frame, sized by resize().
+	GeometryArena *teapotArena;			// The teapot's meshes, with a draw index for every teapot of every level.
+	GLSLProgram cullProg;				// Compute shader writing the draw commands.
+	UniformHandle<float> pixelsPerUnitUniform;	// Its per-frame uniforms: the projection's scale,
+	UniformHandle<int> pyramidLevelsUniform;	// and the depth pyramid it tests against.
+	UniformHandle<vec2> pyramidSizeUniform;
+	UniformHandle<bool> pyramidValidUniform;
+	GLSLProgram culledProg;				// Draws the teapots through the lists the compute shader wrote.
+	GLuint commandBuffer;				// One set of draw commands per frame in flight.
+	GLsizeiptr commandStride;			// Bytes between the sets, aligned for binding as shader storage.
+	GLuint culledIndexBuffer;			// The visible teapots of each level, numTeapots entries per level.
+	GLsync commandFences[3];			// Signalled once the GPU has finished with each set.
+	int occlusionFrame;					// Frames culled on the GPU so far.
+	std::vector<GLuint> culledCounts;	// Teapots drawn with each level, read back two frames late.
+
+	VBOTeapot *teapot;  // Teapot VBO.
+	VBOPlane *plane;  // Plane VBO.
+
+    void compileAndLinkShader(); // Compile and link the shader.
+
+	void createInstances(); // Lay out the teapots and upload their instance data.
+
+	void renderVisible(QuatCamera &camera, const Frustum &frustum); // Sort the visible teapots by level of detail and draw each level.
+
+	void createOcclusionCulling(); // Buffers and programs of the GPU culling pass.
+
+	void resolveCullUniforms(); // Look up the handles of the uniforms the culling pass sets every frame.
+
+	void renderOccluded(QuatCamera &camera); // Cull the teapots on the GPU, then draw the survivors with one indirect call.
+
+public:
+    SceneTeapotField(int numTeapots, VertexFormat::Format vertexFormat = VertexFormat::SEPARATE, int lodLevels = 1, bool culling = true, bool occlusionCulling = false); // Constructor.
+	~SceneTeapotField();				// Destructor, releases the scene's GL objects.
+
+    void initScene(QuatCamera camera);	// Initialise the scene.
+
+    void render(QuatCamera camera);		// Render the scene.
+
+    void resize(QuatCamera camera, int, int); // Resize.
+
+	void animate(bool &shift, bool &a, bool &d, bool &s, bool &space, bool &r); // Keyboard input, only the reset key is used.
+
+	void frameCounters(std::map<std::string, double> &counters); // Statistics about the last rendered frame.
+
+	void watchShaders(ShaderWatcher &watcher); // Reload the programs this configuration draws with when their shaders are edited.
+
+	void shadersReloaded(); // Resolve the culling pass's uniform handles again.
+};
+}
+
+#endif // SCENETEAPOTFIELD_H
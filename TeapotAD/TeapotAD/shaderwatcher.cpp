@@ -0,0 +1,70 @@
+#include "shaderwatcher.h"
+
+#include <iostream>
+#include <sys/stat.h>
+
+ShaderWatcher::ShaderWatcher(double interval) : interval(interval), lastCheck(0.0), reloadCount(0)
+{
+}
+
+time_t ShaderWatcher::modificationTime(const std::string & fileName)
+{
+    struct stat info;
+    if( stat(fileName.c_str(), &info) != 0 ) return 0;    // Missing, perhaps mid-save
+    return info.st_mtime;
+}
+
+void ShaderWatcher::watch(GLSLProgram & program)
+{
+    WatchedProgram watched;
+    watched.program = &program;
+    watched.files = program.getShaderFiles();
+    for( size_t i = 0; i < watched.files.size(); i++ )
+        watched.modified.push_back(modificationTime(watched.files[i]));
+    programs.push_back(watched);
+}
+
+void ShaderWatcher::update(double time)
+{
+    // Swap in the programs the driver has finished with
+    for( size_t i = 0; i < programs.size(); i++ ) {
+        if( !programs[i].program->isPending() ) continue;
+        try {
+            if( programs[i].program->poll() ) {
+                reloadCount++;
+                std::cout << "Reloaded " << programs[i].files.back() << std::endl;
+            }
+        } catch( GLSLProgramException & e ) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    if( time - lastCheck < interval ) return;
+    lastCheck = time;
+
+    for( size_t i = 0; i < programs.size(); i++ ) {
+        WatchedProgram & watched = programs[i];
+        if( watched.program->isPending() ) continue;
+
+        bool edited = false;
+        for( size_t f = 0; f < watched.files.size(); f++ ) {
+            time_t modified = modificationTime(watched.files[f]);
+            if( modified != 0 && modified != watched.modified[f] ) {
+                watched.modified[f] = modified;
+                edited = true;
+            }
+        }
+        if( !edited ) continue;
+
+        try {
+            watched.program->reload();
+        } catch( GLSLProgramException & e ) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+}
+
+int ShaderWatcher::getReloadCount() const
+{
+    return reloadCount;
+}
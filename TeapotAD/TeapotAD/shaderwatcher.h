@@ -0,0 +1,54 @@
+#ifndef SHADERWATCHER_H
+#define SHADERWATCHER_H
+
+#include "glslprogram.h"
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ Rebuilds programs whose shader files were edited, without stalling the
+ frame they are edited in.
+
+ update() is called once a frame. It looks at the files' modification
+ times every so often and calls reload() on the programs using an edited
+ file, then swaps each one in with poll() once the driver has built it.
+ Until then, or for good if the edit does not compile, the program keeps
+ drawing with what it had; compile errors are printed to cerr.
+ */
+class ShaderWatcher
+{
+private:
+    struct WatchedProgram {
+        GLSLProgram * program;
+        std::vector<std::string> files;
+        std::vector<time_t> modified;   // Modification time of each file when last built
+    };
+
+    std::vector<WatchedProgram> programs;
+    double interval;            // Seconds between looks at the files
+    double lastCheck;
+    int reloadCount;
+
+    static time_t modificationTime(const std::string & fileName);
+
+    // Non-copyable, holds pointers to the programs it watches
+    ShaderWatcher( const ShaderWatcher & ) { }
+    ShaderWatcher & operator=( const ShaderWatcher & ) { return *this; }
+
+public:
+    ShaderWatcher(double interval = 0.5);
+
+    // Watches the files a linked program was compiled from. The program
+    // must outlive the watcher.
+    void watch(GLSLProgram & program);
+
+    // Call once a frame with the current time in seconds.
+    void update(double time);
+
+    // Programs swapped in after an edit so far
+    int getReloadCount() const;
+};
+
+#endif // SHADERWATCHER_H
@@ -0,0 +1,243 @@
+#include "shadowmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static GLuint createDepthTexture(int size)
+{
+    GLuint texture;
+    gl::GenTextures(1, &texture);
+    gl::BindTexture(gl::TEXTURE_2D, texture);
+    gl::TexStorage2D(gl::TEXTURE_2D, 1, gl::DEPTH_COMPONENT32F, size, size);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::NEAREST);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+    return texture;
+}
+
+static GLuint createDepthFramebuffer(GLuint texture)
+{
+    GLuint fbo;
+    gl::GenFramebuffers(1, &fbo);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, fbo);
+    gl::FramebufferTexture(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT, texture, 0);
+    gl::DrawBuffer(gl::NONE);   // Depth only
+    gl::ReadBuffer(gl::NONE);
+    return fbo;
+}
+
+ShadowMap::ShadowMap(int size) : size(size), hasLight(false)
+{
+    if( size <= 0 )
+        throw std::runtime_error("Shadow map must have a positive size");
+
+    staticTexture = createDepthTexture(size);
+    shadowTexture = createDepthTexture(size);
+
+    // Sampled with depth comparison. Linear filtering blends the four nearest
+    // comparisons, and anything outside the map is lit.
+    const GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    gl::BindTexture(gl::TEXTURE_2D, shadowTexture);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::CLAMP_TO_BORDER);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::CLAMP_TO_BORDER);
+    gl::TexParameterfv(gl::TEXTURE_2D, gl::TEXTURE_BORDER_COLOR, border);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_COMPARE_MODE, gl::COMPARE_REF_TO_TEXTURE);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_COMPARE_FUNC, gl::LEQUAL);
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+
+    staticFbo = createDepthFramebuffer(staticTexture);
+    GLenum staticStatus = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+    shadowFbo = createDepthFramebuffer(shadowTexture);
+    GLenum shadowStatus = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+    gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+
+    if( staticStatus != gl::FRAMEBUFFER_COMPLETE || shadowStatus != gl::FRAMEBUFFER_COMPLETE ) {
+        gl::DeleteFramebuffers(1, &staticFbo);
+        gl::DeleteFramebuffers(1, &shadowFbo);
+        gl::DeleteTextures(1, &staticTexture);
+        gl::DeleteTextures(1, &shadowTexture);
+        throw std::runtime_error("Shadow map framebuffer is incomplete");
+    }
+
+    invalidateAll();
+    resetStatistics();
+}
+
+ShadowMap::~ShadowMap()
+{
+    gl::DeleteFramebuffers(1, &staticFbo);
+    gl::DeleteFramebuffers(1, &shadowFbo);
+    gl::DeleteTextures(1, &staticTexture);
+    gl::DeleteTextures(1, &shadowTexture);
+}
+
+void ShadowMap::invalidateAll()
+{
+    staticDirty = true;
+    dirtyMin[0] = dirtyMin[1] = 0;
+    dirtyMax[0] = dirtyMax[1] = size - 1;
+}
+
+void ShadowMap::addDirty(int minX, int minY, int maxX, int maxY)
+{
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, size - 1);
+    maxY = std::min(maxY, size - 1);
+    if( minX > maxX || minY > maxY ) return;    // Off the map
+
+    if( dirtyMin[0] > dirtyMax[0] ) {
+        dirtyMin[0] = minX; dirtyMin[1] = minY;
+        dirtyMax[0] = maxX; dirtyMax[1] = maxY;
+        return;
+    }
+    dirtyMin[0] = std::min(dirtyMin[0], minX);
+    dirtyMin[1] = std::min(dirtyMin[1], minY);
+    dirtyMax[0] = std::max(dirtyMax[0], maxX);
+    dirtyMax[1] = std::max(dirtyMax[1], maxY);
+}
+
+void ShadowMap::setLight(const glm::mat4 & viewProjection)
+{
+    if( hasLight && viewProjection == lightMatrix ) return;
+
+    lightMatrix = viewProjection;
+    hasLight = true;
+    invalidateAll();
+}
+
+void ShadowMap::invalidateStatic()
+{
+    invalidateAll();
+}
+
+void ShadowMap::invalidateCaster(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax, const glm::mat4 & model)
+{
+    glm::mat4 toClip = lightMatrix * model;
+    glm::vec2 lower(1.0f), upper(-1.0f);
+
+    for( int corner = 0; corner < 8; corner++ ) {
+        glm::vec4 position((corner & 1) ? boundsMax.x : boundsMin.x,
+                           (corner & 2) ? boundsMax.y : boundsMin.y,
+                           (corner & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+        glm::vec4 clip = toClip * position;
+
+        // A box reaching behind the light has no sensible footprint.
+        if( clip.w <= 0.0f ) {
+            addDirty(0, 0, size - 1, size - 1);
+            return;
+        }
+
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        lower = corner == 0 ? ndc : glm::min(lower, ndc);
+        upper = corner == 0 ? ndc : glm::max(upper, ndc);
+    }
+
+    // Every texel whose centre the box's shadow can cover.
+    glm::vec2 texelMin = (lower * 0.5f + 0.5f) * (float)size;
+    glm::vec2 texelMax = (upper * 0.5f + 0.5f) * (float)size;
+    addDirty((int)std::floor(texelMin.x), (int)std::floor(texelMin.y), (int)std::ceil(texelMax.x), (int)std::ceil(texelMax.y));
+}
+
+bool ShadowMap::beginStatic()
+{
+    if( !staticDirty ) {
+        statistics.passesSkipped++;
+        return false;
+    }
+
+    gl::BindFramebuffer(gl::FRAMEBUFFER, staticFbo);
+    gl::Viewport(0, 0, size, size);
+    gl::Clear(gl::DEPTH_BUFFER_BIT);
+
+    // Pushes the casters' depth back a little, so surfaces do not shadow themselves.
+    gl::Enable(gl::POLYGON_OFFSET_FILL);
+    gl::PolygonOffset(2.0f, 4.0f);
+
+    staticDirty = false;
+    statistics.passesExecuted++;
+    statistics.texelsUpdated += size * size;
+    return true;
+}
+
+bool ShadowMap::beginDynamic()
+{
+    if( dirtyMin[0] > dirtyMax[0] ) {
+        statistics.passesSkipped++;
+        return false;
+    }
+
+    int x = dirtyMin[0], y = dirtyMin[1];
+    int w = dirtyMax[0] - x + 1, h = dirtyMax[1] - y + 1;
+
+    // Everything in the rectangle goes back to the static casters' depth first.
+    gl::CopyImageSubData(staticTexture, gl::TEXTURE_2D, 0, x, y, 0, shadowTexture, gl::TEXTURE_2D, 0, x, y, 0, w, h, 1);
+
+    gl::BindFramebuffer(gl::FRAMEBUFFER, shadowFbo);
+    gl::Viewport(0, 0, size, size);
+    gl::Enable(gl::SCISSOR_TEST);
+    gl::Scissor(x, y, w, h);
+    gl::Enable(gl::POLYGON_OFFSET_FILL);
+    gl::PolygonOffset(2.0f, 4.0f);
+
+    dirtyMin[0] = dirtyMin[1] = 1;
+    dirtyMax[0] = dirtyMax[1] = 0;
+    statistics.passesExecuted++;
+    statistics.texelsUpdated += w * h;
+    return true;
+}
+
+void ShadowMap::end(GLuint drawFramebuffer, GLuint readFramebuffer, int width, int height)
+{
+    gl::Disable(gl::SCISSOR_TEST);
+    gl::Disable(gl::POLYGON_OFFSET_FILL);
+    gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, drawFramebuffer);
+    gl::BindFramebuffer(gl::READ_FRAMEBUFFER, readFramebuffer);
+    gl::Viewport(0, 0, width, height);
+}
+
+void ShadowMap::bindTexture(GLuint unit) const
+{
+    gl::ActiveTexture(gl::TEXTURE0 + unit);
+    gl::BindTexture(gl::TEXTURE_2D, shadowTexture);
+}
+
+const glm::mat4 & ShadowMap::getLightMatrix() const
+{
+    return lightMatrix;
+}
+
+glm::mat4 ShadowMap::textureMatrix(const glm::mat4 & view) const
+{
+    // Clip space [-1,1] to texture coordinates and depth in [0,1].
+    const glm::mat4 bias(0.5f, 0.0f, 0.0f, 0.0f,
+                         0.0f, 0.5f, 0.0f, 0.0f,
+                         0.0f, 0.0f, 0.5f, 0.0f,
+                         0.5f, 0.5f, 0.5f, 1.0f);
+    return bias * lightMatrix * glm::inverse(view);
+}
+
+void ShadowMap::resetStatistics()
+{
+    statistics.passesExecuted = 0;
+    statistics.passesSkipped = 0;
+    statistics.texelsUpdated = 0;
+}
+
+const ShadowMap::Statistics & ShadowMap::getStatistics() const
+{
+    return statistics;
+}
+
+int ShadowMap::getSize() const
+{
+    return size;
+}
+
+GLsizeiptr ShadowMap::getBytes() const
+{
+    return 2 * (GLsizeiptr)size * size * 4;    // Two 32-bit depth layers
+}
@@ -0,0 +1,103 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include "gl_core_4_3.hpp"
+
+#include <glm.hpp>
+
+/**
+ A shadow map that is only re-rendered where something changed.
+
+ Casters are split into two layers. Static casters, which never move, are
+ rendered into a depth texture of their own once and again only when the
+ light moves. The shadow map itself starts as a copy of that layer with the
+ dynamic casters drawn on top. When a dynamic caster moves, only the texels
+ its shadow covered before and after are refreshed: that rectangle is copied
+ back from the static layer and the dynamic casters are redrawn with the
+ scissor test limited to it. Frames where nothing moved render nothing.
+
+ The scene drives the passes:
+
+     shadowMap.setLight(lightViewProjection);
+     if (caster moved) {
+         shadowMap.invalidateCaster(oldMin, oldMax, oldModel);
+         shadowMap.invalidateCaster(newMin, newMax, newModel);
+     }
+     if (shadowMap.beginStatic()) { draw the static casters }
+     if (shadowMap.beginDynamic()) { draw the dynamic casters }
+     shadowMap.end(drawFramebuffer, readFramebuffer, width, height);
+ */
+class ShadowMap
+{
+public:
+    // Passes since the last resetStatistics()
+    struct Statistics {
+        int passesExecuted;     // Static or dynamic layer passes rendered
+        int passesSkipped;      // Passes that reused the cached layer
+        int texelsUpdated;      // Shadow map texels refreshed
+    };
+
+private:
+    int size;
+    GLuint staticFbo;
+    GLuint shadowFbo;
+    GLuint staticTexture;   // Depth of the static casters alone
+    GLuint shadowTexture;   // The static layer with the dynamic casters added, sampled by the shaders
+
+    glm::mat4 lightMatrix;  // The light's view projection
+    bool hasLight;          // Whether setLight() has been called
+    bool staticDirty;
+    int dirtyMin[2], dirtyMax[2];   // Texels of the shadow map to refresh, inclusive, empty if min > max
+
+    Statistics statistics;
+
+    void invalidateAll();
+    void addDirty(int minX, int minY, int maxX, int maxY);
+
+    // Non-copyable, the GL objects are owned by this instance
+    ShadowMap( const ShadowMap & ) { }
+    ShadowMap & operator=( const ShadowMap & ) { return *this; }
+
+public:
+    ShadowMap(int size);
+    ~ShadowMap();
+
+    // Sets the light's view projection, everything is re-rendered if it changed.
+    void setLight(const glm::mat4 & viewProjection);
+
+    // A static caster was added, removed or moved.
+    void invalidateStatic();
+
+    // Marks the shadow map texels under a dynamic caster's bounding box
+    // dirty. Call with the caster's old and new placements when it moves.
+    void invalidateCaster(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax, const glm::mat4 & model);
+
+    // Returns false if the static layer can be reused. Otherwise binds its
+    // framebuffer, cleared, for the static casters to be drawn.
+    bool beginStatic();
+
+    // Returns false if nothing has to be refreshed. Otherwise copies the
+    // static layer into the dirty rectangle and binds the shadow map with the
+    // scissor test limited to it, for the dynamic casters to be drawn.
+    bool beginDynamic();
+
+    // Restores the state changed by the passes and binds the draw and read
+    // framebuffers and viewport rendering carries on with.
+    void end(GLuint drawFramebuffer, GLuint readFramebuffer, int width, int height);
+
+    // Binds the shadow map for depth comparison, with hardware filtering.
+    void bindTexture(GLuint unit) const;
+
+    const glm::mat4 & getLightMatrix() const;
+
+    // Maps eye space positions of a camera with this view to shadow map
+    // texture coordinates and depth, for textureProj().
+    glm::mat4 textureMatrix(const glm::mat4 & view) const;
+
+    void resetStatistics();
+    const Statistics & getStatistics() const;
+    int getSize() const;
+    GLsizeiptr getBytes() const;
+};
+
+#endif // SHADOWMAP_H
@@ -0,0 +1,607 @@
+#include "softwarerasterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function, other compilers only when building for AVX2.
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define SOFTWARE_AVX2_KERNEL
+#endif
+
+namespace
+{
+    const int TILE_SIZE = 64;
+    const int BLOCK_SIZE = 8;
+    const int TILE_BLOCKS = TILE_SIZE / BLOCK_SIZE;
+    const int VERTEX_CHUNK = 4096;      // Vertices transformed per task
+    const int TRIANGLE_CHUNK = 2048;    // Triangles set up and binned per task
+
+    // Centres of the pixels of a block row, relative to its left edge
+    const float laneCentres[BLOCK_SIZE] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+
+    // Converts a colour channel to 8 bits the way GL does, rounding to nearest.
+    inline glm::uint32 toUnorm8(float c)
+    {
+        c = c < 0.0f ? 0.0f : c;
+        c = c > 1.0f ? 1.0f : c;
+        return (glm::uint32)(int)(c * 255.0f + 0.5f);
+    }
+
+    inline glm::uint32 packColour(float r, float g, float b)
+    {
+        return toUnorm8(r) | (toUnorm8(g) << 8) | (toUnorm8(b) << 16) | 0xFF000000u;
+    }
+
+    inline int countBits(int bits)
+    {
+        int count = 0;
+        for (; bits != 0; bits &= bits - 1) count++;
+        return count;
+    }
+
+    // One pixel at a time
+    struct ScalarLanes {
+        typedef float Value;
+        typedef bool Mask;
+        enum { WIDTH = 1 };
+        static Value set(float x) { return x; }
+        static Value load(const float * p) { return *p; }
+        static void store(float * p, Value v) { *p = v; }
+        static Value add(Value a, Value b) { return a + b; }
+        static Value sub(Value a, Value b) { return a - b; }
+        static Value mul(Value a, Value b) { return a * b; }
+        static Value div(Value a, Value b) { return a / b; }
+        static Value sqrt(Value a) { return std::sqrt(a); }
+        static Value min(Value a, Value b) { return a < b ? a : b; }
+        static Value max(Value a, Value b) { return a > b ? a : b; }
+        static Mask greaterEqual(Value a, Value b) { return a >= b; }
+        static Mask greater(Value a, Value b) { return a > b; }
+        static Mask less(Value a, Value b) { return a < b; }
+        static Mask both(Mask a, Mask b) { return a && b; }
+        static int bits(Mask m) { return m ? 1 : 0; }
+        static Value select(Mask m, Value a, Value b) { return m ? a : b; }
+        static void storeColour(glm::uint32 * p, Mask m, Value r, Value g, Value b) {
+            if (m) *p = packColour(r, g, b);
+        }
+    };
+
+#ifdef SOFTWARE_AVX2_KERNEL
+    // Eight pixels per instruction
+    struct Avx2Lanes {
+        typedef __m256 Value;
+        typedef __m256 Mask;
+        enum { WIDTH = 8 };
+        static Value set(float x) { return _mm256_set1_ps(x); }
+        static Value load(const float * p) { return _mm256_loadu_ps(p); }
+        static void store(float * p, Value v) { _mm256_storeu_ps(p, v); }
+        static Value add(Value a, Value b) { return _mm256_add_ps(a, b); }
+        static Value sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+        static Value mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+        static Value div(Value a, Value b) { return _mm256_div_ps(a, b); }
+        static Value sqrt(Value a) { return _mm256_sqrt_ps(a); }
+        static Value min(Value a, Value b) { return _mm256_min_ps(a, b); }
+        static Value max(Value a, Value b) { return _mm256_max_ps(a, b); }
+        static Mask greaterEqual(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Mask greater(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static Mask less(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static int bits(Mask m) { return _mm256_movemask_ps(m); }
+        static Value select(Mask m, Value a, Value b) { return _mm256_blendv_ps(b, a, m); }
+
+        // The same rounding as packColour(), then a masked store of the packed pixels.
+        static void storeColour(glm::uint32 * p, Mask m, Value r, Value g, Value b) {
+            Value zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+            Value scale = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+            __m256i ri = _mm256_cvttps_epi32(add(mul(min(max(r, zero), one), scale), half));
+            __m256i gi = _mm256_cvttps_epi32(add(mul(min(max(g, zero), one), scale), half));
+            __m256i bi = _mm256_cvttps_epi32(add(mul(min(max(b, zero), one), scale), half));
+            __m256i rgba = _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 8)),
+                                           _mm256_or_si256(_mm256_slli_epi32(bi, 16), _mm256_set1_epi32((int)0xFF000000u)));
+            _mm256_maskstore_epi32((int *)p, _mm256_castps_si256(m), rgba);
+        }
+    };
+#endif
+
+    // Rasterises and shades one 8x8 block of a triangle, returns the pixels that passed the
+    // depth test. x and y are the block's bottom left pixel, depth and colour its first row.
+    template <class Lanes, class Triangle, class Shading>
+    int rasterizeBlock(const Triangle & t, const Shading & s, int x, int y, float * depth, glm::uint32 * colour, int stride)
+    {
+        typedef typename Lanes::Value Value;
+        typedef typename Lanes::Mask Mask;
+
+        Value zero = Lanes::set(0.0f), one = Lanes::set(1.0f);
+        Value blockX = Lanes::set((float)x);
+        int shaded = 0;
+
+        for (int row = 0; row < BLOCK_SIZE; row++, depth += stride, colour += stride)
+        {
+            // Everything that only depends on y is worked out once per row.
+            float py = (float)(y + row) + 0.5f;
+            float rowEdge[3], rowPlane[8];
+            for (int e = 0; e < 3; e++) rowEdge[e] = t.edgeB[e] * (py - t.edgeY[e]);
+            for (int p = 0; p < 8; p++) rowPlane[p] = t.planeY[p] * (py - t.y0) + t.planeC[p];
+
+            for (int i = 0; i < BLOCK_SIZE; i += Lanes::WIDTH)
+            {
+                Value px = Lanes::add(blockX, Lanes::load(laneCentres + i));
+
+                Mask inside;
+                for (int e = 0; e < 3; e++) {
+                    Value edge = Lanes::add(Lanes::mul(Lanes::set(t.edgeA[e]), Lanes::sub(px, Lanes::set(t.edgeX[e]))), Lanes::set(rowEdge[e]));
+                    Mask m = t.inclusive[e] ? Lanes::greaterEqual(edge, zero) : Lanes::greater(edge, zero);
+                    inside = e == 0 ? m : Lanes::both(inside, m);
+                }
+                if (Lanes::bits(inside) == 0) continue;
+
+                Value dx = Lanes::sub(px, Lanes::set(t.x0));
+                Value plane[8];
+                plane[0] = Lanes::add(Lanes::mul(Lanes::set(t.planeX[0]), dx), Lanes::set(rowPlane[0]));
+
+                Value stored = Lanes::load(depth + i);
+                Mask pass = Lanes::both(inside, Lanes::less(plane[0], stored));
+                int passBits = Lanes::bits(pass);
+                if (passBits == 0) continue;
+                Lanes::store(depth + i, Lanes::select(pass, plane[0], stored));
+
+                for (int p = 1; p < 8; p++)
+                    plane[p] = Lanes::add(Lanes::mul(Lanes::set(t.planeX[p]), dx), Lanes::set(rowPlane[p]));
+
+                // Perspective correct eye position and normal. The normal is not renormalised,
+                // as in phong.frag.
+                Value w = Lanes::div(one, plane[1]);
+                Value ex = Lanes::mul(plane[2], w), ey = Lanes::mul(plane[3], w), ez = Lanes::mul(plane[4], w);
+                Value nx = Lanes::mul(plane[5], w), ny = Lanes::mul(plane[6], w), nz = Lanes::mul(plane[7], w);
+
+                // phong.frag's light() and attenuate().
+                Value lx = Lanes::sub(Lanes::set(s.lightEye.x), ex);
+                Value ly = Lanes::sub(Lanes::set(s.lightEye.y), ey);
+                Value lz = Lanes::sub(Lanes::set(s.lightEye.z), ez);
+                Value dist = Lanes::sqrt(Lanes::add(Lanes::add(Lanes::mul(lx, lx), Lanes::mul(ly, ly)), Lanes::mul(lz, lz)));
+                Value sx = Lanes::div(lx, dist), sy = Lanes::div(ly, dist), sz = Lanes::div(lz, dist);
+
+                Value nDotS = Lanes::add(Lanes::add(Lanes::mul(nx, sx), Lanes::mul(ny, sy)), Lanes::mul(nz, sz));
+                Value cosine = Lanes::max(nDotS, zero);
+
+                // reflect(-s, N) = 2 (N.s) N - s
+                Value twoNDotS = Lanes::mul(Lanes::set(2.0f), nDotS);
+                Value rx = Lanes::sub(Lanes::mul(twoNDotS, nx), sx);
+                Value ry = Lanes::sub(Lanes::mul(twoNDotS, ny), sy);
+                Value rz = Lanes::sub(Lanes::mul(twoNDotS, nz), sz);
+                Value rDotS = Lanes::add(Lanes::add(Lanes::mul(rx, sx), Lanes::mul(ry, sy)), Lanes::mul(rz, sz));
+                Value Is = Lanes::min(Lanes::max(rDotS, zero), one);
+
+                Value atten = Lanes::min(Lanes::max(Lanes::div(Lanes::set(s.attenuation), dist), zero), one);
+
+                Value channel[3];
+                for (int c = 0; c < 3; c++) {
+                    Value Id = Lanes::min(Lanes::max(Lanes::mul(Lanes::set(s.Ld[c]), cosine), zero), one);
+                    Value lit = Lanes::add(Lanes::add(Lanes::set(s.ambient[c]), Lanes::mul(Lanes::set(s.Kd[c]), Id)), Lanes::mul(Lanes::set(s.specular[c]), Is));
+                    channel[c] = Lanes::mul(atten, lit);
+                }
+
+                Lanes::storeColour(colour + i, pass, channel[0], channel[1], channel[2]);
+                shaded += countBits(passBits);
+            }
+        }
+
+        return shaded;
+    }
+
+    // Moves a point a fraction t of the way along an edge, for clipping.
+    template <class Vertex>
+    Vertex lerpVertex(const Vertex & a, const Vertex & b, float t)
+    {
+        Vertex v;
+        v.clip = a.clip + (b.clip - a.clip) * t;
+        v.eye = a.eye + (b.eye - a.eye) * t;
+        v.normal = a.normal + (b.normal - a.normal) * t;
+        return v;
+    }
+
+    // Clips a convex polygon to the half space where distance(v) >= 0, returns its new vertex count.
+    template <class Vertex, class Distance>
+    int clipPolygon(const Vertex * in, int count, Vertex * out, Distance distance)
+    {
+        int result = 0;
+        for (int i = 0; i < count; i++) {
+            const Vertex & a = in[i];
+            const Vertex & b = in[(i + 1) % count];
+            float da = distance(a), db = distance(b);
+            if (da >= 0.0f) out[result++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) out[result++] = lerpVertex(a, b, da / (da - db));
+        }
+        return result;
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, ThreadPool * pool, Kernel kernel)
+    : width(width), height(height), pool(pool), kernel(kernel)
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Software rasterizer must have a positive size");
+
+#ifndef SOFTWARE_AVX2_KERNEL
+    this->kernel = SCALAR;
+#endif
+
+    // Pad the buffers to whole tiles so blocks never need bounds checks; the padding is never read back.
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    stride = tilesX * TILE_SIZE;
+
+    depth.resize(stride * tilesY * TILE_SIZE);
+    colour.resize(stride * tilesY * TILE_SIZE);
+    blockDepth.resize(tilesX * TILE_BLOCKS * tilesY * TILE_BLOCKS);
+    tileDepth.resize(tilesX * tilesY);
+    tileStatistics.resize(tilesX * tilesY);
+
+    light.position = glm::vec3(0.0f);
+    light.La = light.Ld = light.Ls = glm::vec3(0.0f);
+    light.attenuation = 1.0f;
+
+    clear(glm::vec3(0.0f));
+}
+
+void SoftwareRasterizer::forEach(int count, const std::function<void(int)> & body) const
+{
+    if (pool != NULL) {
+        pool->parallelFor(count, body);
+    } else {
+        for (int i = 0; i < count; i++) body(i);
+    }
+}
+
+void SoftwareRasterizer::clear(const glm::vec3 & clearColour)
+{
+    std::fill(colour.begin(), colour.end(), packColour(clearColour.r, clearColour.g, clearColour.b));
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(blockDepth.begin(), blockDepth.end(), 1.0f);
+    std::fill(tileDepth.begin(), tileDepth.end(), 1.0f);
+
+    Statistics zero = { 0, 0, 0, 0, 0, 0 };
+    statistics = zero;
+}
+
+void SoftwareRasterizer::setCamera(const glm::mat4 & view, const glm::mat4 & projection)
+{
+    this->view = view;
+    this->projection = projection;
+}
+
+void SoftwareRasterizer::setLight(const Light & light)
+{
+    this->light = light;
+}
+
+void SoftwareRasterizer::draw(const MeshData & mesh, const glm::mat4 & model, const Material & material)
+{
+    unsigned int triangles = mesh.getIndexCount() / 3;
+    if (triangles == 0) return;
+
+    // Vertex stage, phong.vert for every vertex.
+    glm::mat4 mv = view * model;
+    glm::mat4 mvp = projection * mv;
+    glm::mat3 normalMatrix = glm::mat3(mv);
+
+    unsigned int vertexCount = mesh.getVertexCount();
+    vertices.resize(vertexCount);
+    forEach((vertexCount + VERTEX_CHUNK - 1) / VERTEX_CHUNK, [&](int chunk) {
+        unsigned int end = glm::min(vertexCount, (unsigned int)(chunk + 1) * VERTEX_CHUNK);
+        for (unsigned int i = chunk * VERTEX_CHUNK; i < end; i++) {
+            glm::vec4 position(mesh.positions[3 * i], mesh.positions[3 * i + 1], mesh.positions[3 * i + 2], 1.0f);
+            glm::vec3 normal(mesh.normals[3 * i], mesh.normals[3 * i + 1], mesh.normals[3 * i + 2]);
+            vertices[i].clip = mvp * position;
+            vertices[i].eye = glm::vec3(mv * position);
+            vertices[i].normal = glm::normalize(normalMatrix * normal);
+        }
+    });
+
+    // Set up and bin the triangles, each chunk into bins of its own.
+    int chunks = (int)((triangles + TRIANGLE_CHUNK - 1) / TRIANGLE_CHUNK);
+    int tiles = tilesX * tilesY;
+    if ((int)chunkTriangles.size() < chunks) chunkTriangles.resize(chunks);
+    if ((int)bins.size() < chunks * tiles) bins.resize(chunks * tiles);
+    forEach(chunks, [&](int chunk) { setupChunk(mesh, chunk); });
+
+    Shading shading;
+    shading.lightEye = glm::vec3(mv * glm::vec4(light.position, 1.0f));
+    shading.ambient = glm::clamp(light.La * material.Ka, 0.0f, 1.0f);
+    shading.Ld = light.Ld;
+    shading.Kd = material.Kd;
+    shading.specular = light.Ls * material.Ks;
+    shading.attenuation = light.attenuation;
+
+    // Rasterise the tiles, walking the chunks' bins in order so triangles land in submission order.
+    forEach(tiles, [&](int tile) { rasterizeTile(tile, chunks, shading); });
+
+    statistics.triangles += triangles;
+    for (int c = 0; c < chunks; c++)
+        statistics.rasterized += chunkTriangles[c].size();
+    for (int t = 0; t < tiles; t++) {
+        statistics.tilesRejected += tileStatistics[t].tilesRejected;
+        statistics.blocksTested += tileStatistics[t].blocksTested;
+        statistics.blocksRejected += tileStatistics[t].blocksRejected;
+        statistics.pixelsShaded += tileStatistics[t].pixelsShaded;
+    }
+}
+
+void SoftwareRasterizer::setupChunk(const MeshData & mesh, int chunk)
+{
+    std::vector<Triangle> & triangles = chunkTriangles[chunk];
+    triangles.clear();
+
+    unsigned int first = chunk * TRIANGLE_CHUNK;
+    unsigned int end = glm::min(mesh.getIndexCount() / 3, first + TRIANGLE_CHUNK);
+
+    for (unsigned int i = first; i < end; i++)
+    {
+        const Vertex * v[3] = { &vertices[mesh.indices[3 * i]], &vertices[mesh.indices[3 * i + 1]], &vertices[mesh.indices[3 * i + 2]] };
+
+        // Trivially reject triangles wholly outside one of the frustum's planes.
+        int outside[6] = { 0, 0, 0, 0, 0, 0 }, clipNear = 0, clipFar = 0;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 & c = v[k]->clip;
+            outside[0] += c.x < -c.w; outside[1] += c.x > c.w;
+            outside[2] += c.y < -c.w; outside[3] += c.y > c.w;
+            outside[4] += c.z < -c.w; outside[5] += c.z > c.w;
+        }
+        bool rejected = false;
+        for (int p = 0; p < 6; p++) rejected = rejected || outside[p] == 3;
+        if (rejected) continue;
+        clipNear = outside[4];
+        clipFar = outside[5];
+
+        if (clipNear == 0 && clipFar == 0) {
+            setupTriangle(*v[0], *v[1], *v[2], triangles);
+            continue;
+        }
+
+        // Clip to the near and far planes only. The sides are left to the bounds and the
+        // edge functions, so only triangles crossing w = 0 are ever split.
+        Vertex polygon[5], clipped[5];
+        for (int k = 0; k < 3; k++) polygon[k] = *v[k];
+        int count = clipPolygon(polygon, 3, clipped, [](const Vertex & p) { return p.clip.z + p.clip.w; });
+        count = clipPolygon(clipped, count, polygon, [](const Vertex & p) { return p.clip.w - p.clip.z; });
+        for (int k = 1; k + 1 < count; k++)
+            setupTriangle(polygon[0], polygon[k], polygon[k + 1], triangles);
+    }
+
+    // Bin the triangles into every tile their bounds overlap.
+    int tiles = tilesX * tilesY;
+    for (int t = 0; t < tiles; t++) bins[chunk * tiles + t].clear();
+    for (unsigned int i = 0; i < triangles.size(); i++) {
+        const Triangle & t = triangles[i];
+        for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+            for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+                bins[chunk * tiles + ty * tilesX + tx].push_back(i);
+    }
+}
+
+void SoftwareRasterizer::setupTriangle(const Vertex & a, const Vertex & b, const Vertex & c, std::vector<Triangle> & triangles) const
+{
+    const Vertex * v[3] = { &a, &b, &c };
+    float x[3], y[3], values[3][8];
+
+    for (int k = 0; k < 3; k++) {
+        // Window coordinates, snapped to 1/256 of a pixel like a GL rasteriser's sub-pixel grid.
+        float invW = 1.0f / v[k]->clip.w;
+        x[k] = std::floor(((v[k]->clip.x * invW + 1.0f) * (0.5f * width)) * 256.0f + 0.5f) / 256.0f;
+        y[k] = std::floor(((v[k]->clip.y * invW + 1.0f) * (0.5f * height)) * 256.0f + 0.5f) / 256.0f;
+
+        values[k][0] = v[k]->clip.z * invW * 0.5f + 0.5f;
+        values[k][1] = invW;
+        for (int i = 0; i < 3; i++) {
+            values[k][2 + i] = v[k]->eye[i] * invW;
+            values[k][5 + i] = v[k]->normal[i] * invW;
+        }
+    }
+
+    // No face culling, clockwise triangles are turned anticlockwise.
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(std::fabs(area) > 0.0f)) return;
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f) {
+        std::swap(order[1], order[2]);
+        area = -area;
+    }
+
+    Triangle t;
+
+    // Pixels whose centres are inside the triangle's bounds, clamped to the viewport before
+    // converting so far off screen vertices cannot overflow.
+    float minX = glm::min(x[0], glm::min(x[1], x[2])), maxX = glm::max(x[0], glm::max(x[1], x[2]));
+    float minY = glm::min(y[0], glm::min(y[1], y[2])), maxY = glm::max(y[0], glm::max(y[1], y[2]));
+    t.minX = (int)std::ceil(glm::clamp(minX - 0.5f, 0.0f, (float)width));
+    t.maxX = (int)std::floor(glm::clamp(maxX - 0.5f, -1.0f, (float)(width - 1)));
+    t.minY = (int)std::ceil(glm::clamp(minY - 0.5f, 0.0f, (float)height));
+    t.maxY = (int)std::floor(glm::clamp(maxY - 0.5f, -1.0f, (float)(height - 1)));
+    if (t.minX > t.maxX || t.minY > t.maxY) return;
+
+    for (int e = 0; e < 3; e++) {
+        int p = order[e], q = order[(e + 1) % 3];
+
+        // Inside is where E >= 0 for an anticlockwise triangle. The origin is the lower of the
+        // edge's ends so the triangle on the other side of the edge gets exactly -E.
+        float A = y[p] - y[q];
+        float B = x[q] - x[p];
+        bool pFirst = y[p] < y[q] || (y[p] == y[q] && x[p] < x[q]);
+        t.edgeA[e] = A;
+        t.edgeB[e] = B;
+        t.edgeX[e] = pFirst ? x[p] : x[q];
+        t.edgeY[e] = pFirst ? y[p] : y[q];
+        t.edgeMargin[e] = (std::fabs(A) * (width + std::fabs(t.edgeX[e])) + std::fabs(B) * (height + std::fabs(t.edgeY[e]))) * 4.0f * FLT_EPSILON;
+
+        // Top-left rule: left edges run downwards, top edges run left along a row.
+        t.inclusive[e] = A > 0.0f || (A == 0.0f && B < 0.0f);
+    }
+
+    // Planes through the vertices' values, relative to the first vertex.
+    int i0 = order[0], i1 = order[1], i2 = order[2];
+    float dx1 = x[i1] - x[i0], dy1 = y[i1] - y[i0];
+    float dx2 = x[i2] - x[i0], dy2 = y[i2] - y[i0];
+    t.x0 = x[i0];
+    t.y0 = y[i0];
+    for (int p = 0; p < 8; p++) {
+        float d1 = values[i1][p] - values[i0][p];
+        float d2 = values[i2][p] - values[i0][p];
+        t.planeX[p] = (d1 * dy2 - d2 * dy1) / area;
+        t.planeY[p] = (d2 * dx1 - d1 * dx2) / area;
+        t.planeC[p] = values[i0][p];
+    }
+    t.minZ = glm::min(values[0][0], glm::min(values[1][0], values[2][0]));
+
+    triangles.push_back(t);
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile, int chunks, const Shading & shading)
+{
+    TileStatistics & stats = tileStatistics[tile];
+    TileStatistics zero = { 0, 0, 0, 0 };
+    stats = zero;
+
+    int tiles = tilesX * tilesY;
+    int tileX = (tile % tilesX) * TILE_SIZE;
+    int tileY = (tile / tilesX) * TILE_SIZE;
+    int blockStride = tilesX * TILE_BLOCKS;
+
+    for (int c = 0; c < chunks; c++)
+    {
+        const std::vector<unsigned int> & bin = bins[c * tiles + tile];
+        for (size_t b = 0; b < bin.size(); b++)
+        {
+            const Triangle & t = chunkTriangles[c][bin[b]];
+
+            // Nothing of the triangle can pass GL_LESS if its nearest point is behind the whole tile.
+            if (t.minZ >= tileDepth[tile]) {
+                stats.tilesRejected++;
+                continue;
+            }
+
+            int bx0 = glm::max(t.minX, tileX) / BLOCK_SIZE, bx1 = glm::min(t.maxX, tileX + TILE_SIZE - 1) / BLOCK_SIZE;
+            int by0 = glm::max(t.minY, tileY) / BLOCK_SIZE, by1 = glm::min(t.maxY, tileY + TILE_SIZE - 1) / BLOCK_SIZE;
+            bool written = false;
+
+            for (int by = by0; by <= by1; by++) {
+                for (int bx = bx0; bx <= bx1; bx++) {
+                    stats.blocksTested++;
+                    float & furthest = blockDepth[by * blockStride + bx];
+                    if (t.minZ >= furthest) {
+                        stats.blocksRejected++;
+                        continue;
+                    }
+
+                    // Skip blocks wholly outside an edge, judged at the block's most inside pixel.
+                    int x = bx * BLOCK_SIZE, y = by * BLOCK_SIZE;
+                    bool outside = false;
+                    for (int e = 0; e < 3 && !outside; e++) {
+                        float px = x + (t.edgeA[e] > 0.0f ? BLOCK_SIZE - 0.5f : 0.5f);
+                        float py = y + (t.edgeB[e] > 0.0f ? BLOCK_SIZE - 0.5f : 0.5f);
+                        outside = t.edgeA[e] * (px - t.edgeX[e]) + t.edgeB[e] * (py - t.edgeY[e]) < -t.edgeMargin[e];
+                    }
+                    if (outside) continue;
+
+                    float * depthBlock = &depth[y * stride + x];
+                    glm::uint32 * colourBlock = &colour[y * stride + x];
+                    int shaded;
+#ifdef SOFTWARE_AVX2_KERNEL
+                    if (kernel == AVX2)
+                        shaded = rasterizeBlock<Avx2Lanes>(t, shading, x, y, depthBlock, colourBlock, stride);
+                    else
+#endif
+                        shaded = rasterizeBlock<ScalarLanes>(t, shading, x, y, depthBlock, colourBlock, stride);
+                    if (shaded == 0) continue;
+
+                    // Refresh the block's furthest depth for the blocks and triangles that follow.
+                    float blockMax = 0.0f;
+                    for (int row = 0; row < BLOCK_SIZE; row++)
+                        for (int i = 0; i < BLOCK_SIZE; i++)
+                            blockMax = glm::max(blockMax, depthBlock[row * stride + i]);
+                    furthest = blockMax;
+                    stats.pixelsShaded += shaded;
+                    written = true;
+                }
+            }
+
+            if (written) {
+                float tileMax = 0.0f;
+                int firstBlock = (tileY / BLOCK_SIZE) * blockStride + tileX / BLOCK_SIZE;
+                for (int by = 0; by < TILE_BLOCKS; by++)
+                    for (int bx = 0; bx < TILE_BLOCKS; bx++)
+                        tileMax = glm::max(tileMax, blockDepth[firstBlock + by * blockStride + bx]);
+                tileDepth[tile] = tileMax;
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::readPixels(std::vector<unsigned char> & rgba) const
+{
+    rgba.resize(4 * width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            glm::uint32 pixel = colour[y * stride + x];
+            unsigned char * out = &rgba[4 * (y * width + x)];
+            out[0] = (unsigned char)(pixel & 0xFF);
+            out[1] = (unsigned char)((pixel >> 8) & 0xFF);
+            out[2] = (unsigned char)((pixel >> 16) & 0xFF);
+            out[3] = (unsigned char)(pixel >> 24);
+        }
+    }
+}
+
+const SoftwareRasterizer::Statistics & SoftwareRasterizer::getStatistics() const
+{
+    return statistics;
+}
+
+SoftwareRasterizer::Kernel SoftwareRasterizer::getKernel() const
+{
+    return kernel;
+}
+
+int SoftwareRasterizer::getWidth() const
+{
+    return width;
+}
+
+int SoftwareRasterizer::getHeight() const
+{
+    return height;
+}
+
+SoftwareRasterizer::Kernel SoftwareRasterizer::bestKernel()
+{
+#if defined(_MSC_VER)
+    // AVX2 needs the CPU to support it and the OS to save the YMM registers.
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+            return AVX2;
+    }
+#elif defined(SOFTWARE_AVX2_KERNEL)
+    return AVX2;
+#endif
+    return SCALAR;
+}
+
+const char * SoftwareRasterizer::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef SOFTWARERASTERIZER_H
+#define SOFTWARERASTERIZER_H
+
+#include "meshdata.h"
+#include "threadpool.h"
+
+#include <glm.hpp>
+#include <functional>
+#include <vector>
+
+/**
+ Draws meshes with the Phong lighting of phong.vert and phong.frag on the
+ CPU, as a reference for the GL renderer and a baseline to measure it by.
+
+ Triangles are set up and binned into 64x64 pixel tiles, then the tiles
+ are rasterised in parallel. Each tile walks its triangles in submission
+ order over 8x8 pixel blocks, evaluating the edge functions, depth and
+ shading for a row of a block at once (8 pixels per instruction with
+ AVX2). The depth buffer keeps the furthest depth of every block and tile,
+ so triangles and blocks behind what is already drawn are skipped before
+ any pixel is touched.
+
+ The image does not depend on the kernel or on the number of threads:
+ every kernel evaluates the same float operations in the same order and
+ each pixel is only ever written by one thread, in submission order.
+ */
+class SoftwareRasterizer
+{
+public:
+    enum Kernel {
+        SCALAR,
+        AVX2
+    };
+
+    // The light of scenediffuse.cpp's setLightParams(), position in world space.
+    struct Light {
+        glm::vec3 position;
+        glm::vec3 La, Ld, Ls;
+        float attenuation;
+    };
+
+    struct Material {
+        glm::vec3 Ka, Kd, Ks;
+    };
+
+    // Totals since the last clear()
+    struct Statistics {
+        unsigned long long triangles;       // Submitted to draw()
+        unsigned long long rasterized;      // Left after clipping and culling
+        unsigned long long tilesRejected;   // Triangles skipped in a tile by the tile's furthest depth
+        unsigned long long blocksTested;    // 8x8 blocks that a triangle's bounds touched
+        unsigned long long blocksRejected;  // Of those, skipped by their furthest depth
+        unsigned long long pixelsShaded;    // Pixels that passed the depth test
+    };
+
+private:
+    // A vertex after the vertex stage, the outputs of phong.vert
+    struct Vertex {
+        glm::vec4 clip;
+        glm::vec3 eye;
+        glm::vec3 normal;
+    };
+
+    // A triangle ready to rasterise, in window coordinates
+    struct Triangle {
+        float edgeA[3], edgeB[3];       // E = A (x - originX) + B (y - originY)
+        float edgeX[3], edgeY[3];       // Origin of each edge, the same for both triangles sharing it
+        float edgeMargin[3];            // Rounding allowed for when rejecting whole blocks
+        bool inclusive[3];              // Top-left fill rule, pixels on the edge are drawn
+        float x0, y0;                   // Origin of the interpolation planes
+        float planeX[8], planeY[8], planeC[8];  // Depth, 1/w, then eye position and normal over w
+        int minX, minY, maxX, maxY;     // Pixel bounds, inclusive
+        float minZ;
+    };
+
+    // The constants of phong.frag for one draw
+    struct Shading {
+        glm::vec3 lightEye;         // Light position in eye space
+        glm::vec3 ambient;          // La * Ka, clamped
+        glm::vec3 Ld, Kd;
+        glm::vec3 specular;         // Ls * Ks
+        float attenuation;
+    };
+
+    // Per-tile counters so the tiles need no atomics
+    struct TileStatistics {
+        unsigned long long tilesRejected, blocksTested, blocksRejected, pixelsShaded;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    int stride;                 // Pixels per row, rounded up to whole tiles
+    ThreadPool * pool;          // NULL to rasterise on the calling thread
+    Kernel kernel;
+
+    std::vector<float> depth;
+    std::vector<glm::uint32> colour;    // RGBA8, bottom row first as GL reads it back
+    std::vector<float> blockDepth;      // Furthest depth in each 8x8 block
+    std::vector<float> tileDepth;       // Furthest depth in each tile
+
+    glm::mat4 view, projection;
+    Light light;
+    Statistics statistics;
+
+    std::vector<Vertex> vertices;
+    std::vector<std::vector<Triangle> > chunkTriangles;     // Set up triangles of each chunk of the mesh
+    std::vector<std::vector<unsigned int> > bins;           // [chunk * tiles + tile], indices into chunkTriangles
+    std::vector<TileStatistics> tileStatistics;
+
+    void forEach(int count, const std::function<void(int)> & body) const;
+    void setupChunk(const MeshData & mesh, int chunk);
+    void setupTriangle(const Vertex & a, const Vertex & b, const Vertex & c, std::vector<Triangle> & triangles) const;
+    void rasterizeTile(int tile, int chunks, const Shading & shading);
+
+    // Non-copyable, the buffers are large
+    SoftwareRasterizer( const SoftwareRasterizer & ) { }
+    SoftwareRasterizer & operator=( const SoftwareRasterizer & ) { return *this; }
+
+public:
+    SoftwareRasterizer(int width, int height, ThreadPool * pool = NULL, Kernel kernel = bestKernel());
+
+    // Fills the colour buffer, resets the depth buffer to 1 and the statistics to 0.
+    void clear(const glm::vec3 & clearColour);
+
+    void setCamera(const glm::mat4 & view, const glm::mat4 & projection);
+    void setLight(const Light & light);
+
+    // Draws the mesh's triangles with depth testing (GL_LESS) and no face culling.
+    void draw(const MeshData & mesh, const glm::mat4 & model, const Material & material);
+
+    // The colour buffer as gl::ReadPixels would return it, RGBA8 with the bottom row first.
+    void readPixels(std::vector<unsigned char> & rgba) const;
+
+    const Statistics & getStatistics() const;
+    Kernel getKernel() const;
+    int getWidth() const;
+    int getHeight() const;
+
+    static Kernel bestKernel();     // AVX2 if the CPU and the build support it
+    static const char * kernelName(Kernel kernel);
+};
+
+#endif // SOFTWARERASTERIZER_H
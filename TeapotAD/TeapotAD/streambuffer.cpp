@@ -0,0 +1,154 @@
+#include "streambuffer.h"
+#include "glutils.h"
+
+#include <cstring>
+#include <stdexcept>
+
+// ARB_buffer_storage is core in 4.4 only, so it is not in the 4.3 loader
+static const GLbitfield MAP_PERSISTENT_BIT = 0x0040;
+static const GLbitfield MAP_COHERENT_BIT = 0x0080;
+
+typedef void (CODEGEN_FUNCPTR *BufferStorageFunc)(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+
+static BufferStorageFunc loadBufferStorage()
+{
+    if( !GLUtils::hasExtension("GL_ARB_buffer_storage") ) return NULL;
+    return (BufferStorageFunc)GLUtils::getProcAddress("glBufferStorage");
+}
+
+static GLint offsetAlignment(GLenum target)
+{
+    GLint alignment = 16;
+    if( target == gl::UNIFORM_BUFFER )
+        gl::GetIntegerv(gl::UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    else if( target == gl::SHADER_STORAGE_BUFFER )
+        gl::GetIntegerv(gl::SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+static GLsizeiptr alignUp(GLsizeiptr value, GLint alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+StreamBuffer::StreamBuffer(GLenum bufferTarget, GLsizeiptr frameSize, int framesInFlight) :
+    target(bufferTarget), segments(framesInFlight), used(0), flushed(0), mapped(NULL)
+{
+    if( frameSize <= 0 || framesInFlight <= 0 )
+        throw std::runtime_error("Stream buffer needs a positive size");
+
+    alignment = offsetAlignment(target);
+    segmentSize = alignUp(frameSize, alignment);
+    segment = segments - 1;         // The first beginFrame() moves to segment 0
+    fences.resize(segments, (GLsync)0);
+
+    GLsizeiptr totalSize = segmentSize * segments;
+
+    gl::GenBuffers(1, &bufferHandle);
+    gl::BindBuffer(target, bufferHandle);
+
+    BufferStorageFunc bufferStorage = loadBufferStorage();
+    if( bufferStorage ) {
+        GLbitfield flags = gl::MAP_WRITE_BIT | MAP_PERSISTENT_BIT | MAP_COHERENT_BIT;
+        bufferStorage(target, totalSize, NULL, flags);
+        mapped = (GLubyte *)gl::MapBufferRange(target, 0, totalSize, flags);
+    }
+
+    if( !mapped ) {
+        gl::BufferData(target, totalSize, NULL, gl::STREAM_DRAW);
+        staging.resize(segmentSize);
+    }
+
+    gl::BindBuffer(target, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for( size_t i = 0; i < fences.size(); i++ )
+        if( fences[i] ) gl::DeleteSync(fences[i]);
+
+    if( mapped ) {
+        gl::BindBuffer(target, bufferHandle);
+        gl::UnmapBuffer(target);
+        gl::BindBuffer(target, 0);
+    }
+    gl::DeleteBuffers(1, &bufferHandle);
+}
+
+void StreamBuffer::beginFrame()
+{
+    segment = (segment + 1) % segments;
+    used = 0;
+    flushed = 0;
+
+    GLsync fence = fences[segment];
+    if( !fence ) return;
+
+    // Only blocks when the CPU is a whole ring ahead of the GPU
+    GLenum result = gl::ClientWaitSync(fence, gl::SYNC_FLUSH_COMMANDS_BIT, 0);
+    while( result == gl::TIMEOUT_EXPIRED )
+        result = gl::ClientWaitSync(fence, gl::SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+    gl::DeleteSync(fence);
+    fences[segment] = 0;
+}
+
+void StreamBuffer::endFrame()
+{
+    fences[segment] = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void * StreamBuffer::allocate(GLsizeiptr size, GLintptr & offset)
+{
+    GLsizeiptr start = alignUp(used, alignment);
+    if( start + size > segmentSize )
+        throw std::runtime_error("Stream buffer segment is full");
+
+    used = start + size;
+    offset = segment * segmentSize + start;
+
+    if( mapped ) return mapped + offset;
+    return &staging[start];
+}
+
+GLintptr StreamBuffer::push(const void * data, GLsizeiptr size)
+{
+    GLintptr offset;
+    memcpy(allocate(size, offset), data, size);
+    return offset;
+}
+
+void StreamBuffer::flush()
+{
+    // Coherent persistent mappings are visible to the GPU without any calls
+    if( mapped || flushed == used ) return;
+
+    gl::BindBuffer(target, bufferHandle);
+    GLbitfield access = gl::MAP_WRITE_BIT | gl::MAP_UNSYNCHRONIZED_BIT | gl::MAP_INVALIDATE_RANGE_BIT;
+    void * dest = gl::MapBufferRange(target, segment * segmentSize + flushed, used - flushed, access);
+    memcpy(dest, &staging[flushed], used - flushed);
+    gl::UnmapBuffer(target);
+    gl::BindBuffer(target, 0);
+
+    flushed = used;
+}
+
+void StreamBuffer::bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) const
+{
+    gl::BindBufferRange(target, binding, bufferHandle, offset, size);
+}
+
+GLuint StreamBuffer::getHandle() const
+{
+    return bufferHandle;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+    return mapped != NULL;
+}
+
+GLsizeiptr StreamBuffer::bytesThisFrame() const
+{
+    return used;
+}
@@ -0,0 +1,62 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "gl_core_4_3.hpp"
+
+#include <vector>
+
+/**
+ A ring buffer for data that is rewritten every frame (uniform blocks,
+ shader storage).
+
+ The buffer is split into one segment per frame in flight. Each frame writes
+ into the next segment, and a fence stops it from overwriting a segment the
+ GPU may still be reading. Where ARB_buffer_storage is available the buffer
+ is persistently mapped and push() copies straight into it; otherwise data is
+ staged and flush() uploads the whole frame with a single unsynchronised map.
+ */
+class StreamBuffer
+{
+private:
+    GLenum target;
+    GLuint bufferHandle;
+    GLsizeiptr segmentSize;     // Bytes available to each frame
+    GLint alignment;            // Required alignment of bound ranges
+    int segments;
+    int segment;                // Segment being written this frame
+    GLsizeiptr used;            // Bytes written to the current segment
+    GLsizeiptr flushed;         // Bytes of the current segment already uploaded
+    std::vector<GLsync> fences; // One per segment, 0 if unused
+
+    GLubyte * mapped;               // Whole buffer when persistently mapped, else NULL
+    std::vector<GLubyte> staging;   // Current segment when not persistently mapped
+
+    // Non-copyable, the GL objects are owned by this instance
+    StreamBuffer( const StreamBuffer & ) { }
+    StreamBuffer & operator=( const StreamBuffer & ) { return *this; }
+
+public:
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, int framesInFlight = 3);
+    ~StreamBuffer();
+
+    void beginFrame();      // Moves to the next segment, waiting for the GPU if needed
+    void endFrame();        // Fences the segment after the frame's draw calls
+
+    // Reserves size bytes in this frame's segment and returns where to write
+    // them. offset receives the position in the buffer to bind.
+    void * allocate(GLsizeiptr size, GLintptr & offset);
+
+    // Copies data into this frame's segment and returns its offset.
+    GLintptr push(const void * data, GLsizeiptr size);
+
+    // Makes everything written since the last flush visible to the GPU.
+    void flush();
+
+    void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) const;
+
+    GLuint getHandle() const;
+    bool isPersistent() const;
+    GLsizeiptr bytesThisFrame() const;
+};
+
+#endif // STREAMBUFFER_H
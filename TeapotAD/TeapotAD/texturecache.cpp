@@ -0,0 +1,233 @@
+#include "texturecache.h"
+#include "Bitmap.h"
+#include "glutils.h"
+#include "mappedfile.h"
+#include "mipgenerator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+
+// The S3TC formats, EXT_texture_sRGB's versions of them and BPTC are not in the 4.3 loader
+static const GLenum COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+static const GLenum COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+static const GLenum COMPRESSED_SRGB_S3TC_DXT1_EXT = 0x8C4C;
+static const GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT = 0x8C4F;
+static const GLenum COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+// Cache files start with this, then the key, the format, the size of level 0 and the
+// number of levels, followed by the blocks of every level from the largest down. Version 1
+// files held the image bottom row first.
+static const char cacheMagic[8] = { 'B', 'C', 'N', 'M', 'I', 'P', 'S', '2' };
+
+struct CacheHeader {
+    char magic[8];
+    unsigned long long key;
+    int format;
+    int width, height;
+    int levels;
+};
+
+// FNV-1a over the file and the format, so either changing gives a new key
+static unsigned long long contentKey(const unsigned char * data, size_t size, BlockCompressor::Format format)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= (unsigned long long)format;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+// Bytes of every level of a width x height image together
+static size_t chainSize(BlockCompressor::Format format, int width, int height)
+{
+    size_t size = 0;
+    for (int level = 0; level < MipGenerator::levelCount(width, height); level++)
+        size += BlockCompressor::compressedSize(format, MipGenerator::levelSize(width, level), MipGenerator::levelSize(height, level));
+    return size;
+}
+
+TextureCache::TextureCache(const std::string & directory, BlockCompressor::Format format, ThreadPool * pool) :
+    directory(directory), format(format), pool(pool), srgb(true), hits(0), misses(0)
+{
+    if (format != BlockCompressor::BC7) {
+        if (!GLUtils::hasExtension("GL_EXT_texture_compression_s3tc"))
+            throw std::runtime_error(std::string("Cannot upload ") + BlockCompressor::formatName(format) + " textures without EXT_texture_compression_s3tc");
+        srgb = GLUtils::hasExtension("GL_EXT_texture_sRGB");
+    }
+
+    if (directory.empty()) return;
+
+    // Fails harmlessly if it already exists
+#ifdef WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
+
+GLuint TextureCache::load(const std::string & imagePath, int & width, int & height)
+{
+    MappedFile file(imagePath);
+    unsigned long long key = contentKey(file.getData(), file.getSize(), format);
+
+    GLuint texture;
+    gl::GenTextures(1, &texture);
+    gl::BindTexture(gl::TEXTURE_2D, texture);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::LINEAR_MIPMAP_LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::REPEAT);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::REPEAT);
+
+    if (!directory.empty() && loadCached(key, texture, width, height)) {
+        hits++;
+    } else {
+        misses++;
+        std::vector<unsigned char> levels;
+        try {
+            build(file.getData(), file.getSize(), levels, width, height);
+        } catch (...) {
+            gl::BindTexture(gl::TEXTURE_2D, 0);
+            gl::DeleteTextures(1, &texture);
+            throw;
+        }
+        if (!directory.empty()) save(key, levels, width, height);
+        upload(texture, &levels[0], width, height);
+    }
+
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+    return texture;
+}
+
+std::string TextureCache::fileName(unsigned long long key) const
+{
+    std::ostringstream name;
+    name << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << "." << BlockCompressor::formatName(format);
+    return name.str();
+}
+
+bool TextureCache::loadCached(unsigned long long key, GLuint texture, int & width, int & height)
+{
+    // A missing file is an ordinary miss
+    std::string name = fileName(key);
+    struct stat info;
+    if (stat(name.c_str(), &info) != 0) return false;
+
+    MappedFile file(name);
+    if (file.getSize() < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    memcpy(&header, file.getData(), sizeof(header));
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.key != key || header.format != format ||
+        header.width <= 0 || header.height <= 0 || header.levels != MipGenerator::levelCount(header.width, header.height) ||
+        file.getSize() != sizeof(CacheHeader) + chainSize(format, header.width, header.height))
+        return false;
+
+    width = header.width;
+    height = header.height;
+    upload(texture, file.getData() + sizeof(CacheHeader), width, height);
+    return true;
+}
+
+void TextureCache::build(const unsigned char * file, size_t size, std::vector<unsigned char> & levels, int & width, int & height) const
+{
+    // RGBA, kept top row first like DDS and KTX2 files
+    Bitmap rgba = Bitmap::bitmapFromMemory(file, size);
+    if (rgba.format() != Bitmap::Format_RGBA) {
+        Bitmap converted(rgba.width(), rgba.height(), Bitmap::Format_RGBA);
+        converted.copyRectFromBitmap(rgba, 0, 0, 0, 0, 0, 0);
+        rgba = std::move(converted);
+    }
+
+    width = (int)rgba.width();
+    height = (int)rgba.height();
+
+    std::vector< std::vector<unsigned char> > mips;
+    MipGenerator(pool).generate(rgba.pixelBuffer(), width, height, mips);
+
+    BlockCompressor compressor(pool);
+    levels.resize(chainSize(format, width, height));
+    unsigned char * dest = &levels[0];
+    for (int level = 0; level < MipGenerator::levelCount(width, height); level++) {
+        int levelWidth = MipGenerator::levelSize(width, level);
+        int levelHeight = MipGenerator::levelSize(height, level);
+        const unsigned char * pixels = level == 0 ? rgba.pixelBuffer() : &mips[level - 1][0];
+        compressor.compress(format, pixels, levelWidth, levelHeight, dest);
+        dest += BlockCompressor::compressedSize(format, levelWidth, levelHeight);
+    }
+}
+
+void TextureCache::save(unsigned long long key, const std::vector<unsigned char> & levels, int width, int height) const
+{
+    CacheHeader header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.key = key;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.levels = MipGenerator::levelCount(width, height);
+
+    // Written to the side and renamed, so another instance never reads half a file
+    std::string name = fileName(key);
+    std::string tempName = name + ".tmp";
+    {
+        std::ofstream out(tempName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return;       // Caching is only an optimisation
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)&levels[0], levels.size());
+        if (!out) {
+            out.close();
+            remove(tempName.c_str());
+            return;
+        }
+    }
+    remove(name.c_str());
+    rename(tempName.c_str(), name.c_str());
+}
+
+void TextureCache::upload(GLuint texture, const unsigned char * levels, int width, int height) const
+{
+    GLenum internal = internalFormat(format, srgb);
+    int count = MipGenerator::levelCount(width, height);
+
+    gl::BindTexture(gl::TEXTURE_2D, texture);
+    gl::TexStorage2D(gl::TEXTURE_2D, count, internal, width, height);
+    for (int level = 0; level < count; level++) {
+        int levelWidth = MipGenerator::levelSize(width, level);
+        int levelHeight = MipGenerator::levelSize(height, level);
+        GLsizei size = (GLsizei)BlockCompressor::compressedSize(format, levelWidth, levelHeight);
+        gl::CompressedTexSubImage2D(gl::TEXTURE_2D, level, 0, 0, levelWidth, levelHeight, internal, size, levels);
+        levels += size;
+    }
+}
+
+unsigned int TextureCache::getHits() const
+{
+    return hits;
+}
+
+unsigned int TextureCache::getMisses() const
+{
+    return misses;
+}
+
+GLenum TextureCache::internalFormat(BlockCompressor::Format format, bool srgb)
+{
+    // BC1 blocks are always in four colour mode, so the RGBA format decodes them as the RGB one would
+    switch (format) {
+    case BlockCompressor::BC1: return srgb ? COMPRESSED_SRGB_S3TC_DXT1_EXT : COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case BlockCompressor::BC3: return srgb ? COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default: return COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "gl_core_4_3.hpp"
+#include "blockcompressor.h"
+#include "threadpool.h"
+
+#include <string>
+#include <vector>
+
+/**
+ Loads images as block compressed textures with a full mip chain, keeping
+ the compressed levels on disk so later launches skip all of the work.
+
+ The cache key is a hash of the image file's bytes and the block format,
+ so an edited image is compressed again under a new key. On a miss the
+ image is decoded with Bitmap and turned to RGBA, its mips
+ are built in linear light by MipGenerator and every level is compressed
+ by BlockCompressor; the levels are written to the cache directory and
+ uploaded. On a hit the cache file is mapped into memory and its levels
+ are uploaded straight from the mapped pages, with no decode at all.
+
+ Rows are kept top row first, as in the image file, so these textures
+ have the same orientation as tdogl::Texture and TextureContainer: upside
+ down in GL's coordinates, to be sampled with V flipped.
+
+ Colour is sRGB, so the textures use the sRGB block formats and are
+ sampled in linear light. BC1 and BC3 need EXT_texture_compression_s3tc,
+ and fall back to its linear formats, sampled without the sRGB decode,
+ where EXT_texture_sRGB is missing. BC7 is core since GL 4.2.
+ */
+class TextureCache
+{
+private:
+    std::string directory;      // Empty to compress every time without caching
+    BlockCompressor::Format format;
+    ThreadPool * pool;          // NULL to build and compress on the calling thread
+    bool srgb;                  // False if S3TC has to be uploaded with the linear formats
+    unsigned int hits, misses;
+
+    std::string fileName(unsigned long long key) const;
+    bool loadCached(unsigned long long key, GLuint texture, int & width, int & height);
+    void build(const unsigned char * file, size_t size, std::vector<unsigned char> & levels, int & width, int & height) const;
+    void save(unsigned long long key, const std::vector<unsigned char> & levels, int width, int height) const;
+    void upload(GLuint texture, const unsigned char * levels, int width, int height) const;
+
+public:
+    TextureCache(const std::string & directory, BlockCompressor::Format format = BlockCompressor::BC7, ThreadPool * pool = NULL);
+
+    // Creates a texture from the image file, with every mip level. The caller
+    // owns it. width and height receive the size of level 0.
+    GLuint load(const std::string & imagePath, int & width, int & height);
+
+    unsigned int getHits() const;
+    unsigned int getMisses() const;
+
+    // The GL format of the compressed blocks, sRGB unless srgb is false
+    static GLenum internalFormat(BlockCompressor::Format format, bool srgb = true);
+};
+
+#endif // TEXTURECACHE_H
@@ -0,0 +1,308 @@
+#include "texturecontainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// EXT_texture_compression_s3tc, its sRGB forms from EXT_texture_sRGB, and BPTC are not in the 4.3 loader
+static const GLenum COMPRESSED_RGB_S3TC_DXT1_EXT = 0x83F0;
+static const GLenum COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+static const GLenum COMPRESSED_RGBA_S3TC_DXT3_EXT = 0x83F2;
+static const GLenum COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+static const GLenum COMPRESSED_SRGB_S3TC_DXT1_EXT = 0x8C4C;
+static const GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT = 0x8C4D;
+static const GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT = 0x8C4E;
+static const GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT = 0x8C4F;
+static const GLenum COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+static const GLenum COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+namespace
+{
+    // How a format is uploaded. Compressed formats have blockBytes, others pixelBytes.
+    struct FormatInfo {
+        GLenum internalFormat;
+        GLenum pixelFormat, pixelType;
+        int blockBytes, pixelBytes;
+    };
+
+    FormatInfo compressedInfo(GLenum internalFormat, int blockBytes)
+    {
+        FormatInfo info = { internalFormat, 0, 0, blockBytes, 0 };
+        return info;
+    }
+
+    FormatInfo pixelInfo(GLenum internalFormat, GLenum format, int pixelBytes)
+    {
+        FormatInfo info = { internalFormat, format, gl::UNSIGNED_BYTE, 0, pixelBytes };
+        return info;
+    }
+
+    // The formats of DXGI_FORMAT, used by DDS files with a DX10 header
+    bool dxgiFormat(unsigned int dxgi, FormatInfo & info)
+    {
+        switch (dxgi) {
+        case 28: info = pixelInfo(gl::RGBA8, gl::RGBA, 4); return true;                   // R8G8B8A8_UNORM
+        case 29: info = pixelInfo(gl::SRGB8_ALPHA8, gl::RGBA, 4); return true;            // R8G8B8A8_UNORM_SRGB
+        case 87: info = pixelInfo(gl::RGBA8, gl::BGRA, 4); return true;                   // B8G8R8A8_UNORM
+        case 91: info = pixelInfo(gl::SRGB8_ALPHA8, gl::BGRA, 4); return true;            // B8G8R8A8_UNORM_SRGB
+        case 71: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT1_EXT, 8); return true;    // BC1_UNORM
+        case 72: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8); return true;
+        case 74: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT3_EXT, 16); return true;   // BC2_UNORM
+        case 75: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16); return true;
+        case 77: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT5_EXT, 16); return true;   // BC3_UNORM
+        case 78: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16); return true;
+        case 80: info = compressedInfo(gl::COMPRESSED_RED_RGTC1, 8); return true;         // BC4_UNORM
+        case 81: info = compressedInfo(gl::COMPRESSED_SIGNED_RED_RGTC1, 8); return true;
+        case 83: info = compressedInfo(gl::COMPRESSED_RG_RGTC2, 16); return true;         // BC5_UNORM
+        case 84: info = compressedInfo(gl::COMPRESSED_SIGNED_RG_RGTC2, 16); return true;
+        case 98: info = compressedInfo(COMPRESSED_RGBA_BPTC_UNORM, 16); return true;      // BC7_UNORM
+        case 99: info = compressedInfo(COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16); return true;
+        default: return false;
+        }
+    }
+
+    // The formats of VkFormat, used by KTX2 files
+    bool vulkanFormat(unsigned int vk, FormatInfo & info)
+    {
+        switch (vk) {
+        case 37: info = pixelInfo(gl::RGBA8, gl::RGBA, 4); return true;                   // R8G8B8A8_UNORM
+        case 43: info = pixelInfo(gl::SRGB8_ALPHA8, gl::RGBA, 4); return true;            // R8G8B8A8_SRGB
+        case 44: info = pixelInfo(gl::RGBA8, gl::BGRA, 4); return true;                   // B8G8R8A8_UNORM
+        case 50: info = pixelInfo(gl::SRGB8_ALPHA8, gl::BGRA, 4); return true;            // B8G8R8A8_SRGB
+        case 131: info = compressedInfo(COMPRESSED_RGB_S3TC_DXT1_EXT, 8); return true;    // BC1_RGB_UNORM_BLOCK
+        case 132: info = compressedInfo(COMPRESSED_SRGB_S3TC_DXT1_EXT, 8); return true;
+        case 133: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT1_EXT, 8); return true;   // BC1_RGBA_UNORM_BLOCK
+        case 134: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8); return true;
+        case 135: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT3_EXT, 16); return true;  // BC2_UNORM_BLOCK
+        case 136: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16); return true;
+        case 137: info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT5_EXT, 16); return true;  // BC3_UNORM_BLOCK
+        case 138: info = compressedInfo(COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16); return true;
+        case 139: info = compressedInfo(gl::COMPRESSED_RED_RGTC1, 8); return true;        // BC4_UNORM_BLOCK
+        case 140: info = compressedInfo(gl::COMPRESSED_SIGNED_RED_RGTC1, 8); return true;
+        case 141: info = compressedInfo(gl::COMPRESSED_RG_RGTC2, 16); return true;        // BC5_UNORM_BLOCK
+        case 142: info = compressedInfo(gl::COMPRESSED_SIGNED_RG_RGTC2, 16); return true;
+        case 145: info = compressedInfo(COMPRESSED_RGBA_BPTC_UNORM, 16); return true;     // BC7_UNORM_BLOCK
+        case 146: info = compressedInfo(COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16); return true;
+        default: return false;
+        }
+    }
+
+    // Both formats are little endian, as is every platform this builds for
+    unsigned int read32(const unsigned char * data)
+    {
+        unsigned int value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    unsigned long long read64(const unsigned char * data)
+    {
+        unsigned long long value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    unsigned int fourCC(char a, char b, char c, char d)
+    {
+        return (unsigned char)a | (unsigned char)b << 8 | (unsigned char)c << 16 | (unsigned int)(unsigned char)d << 24;
+    }
+}
+
+TextureContainer::TextureContainer(const std::string & path) :
+    file(path), width(0), height(0), internalFormat(0), pixelFormat(0), pixelType(0), blockBytes(0), pixelBytes(0)
+{
+    static const unsigned char ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    if (file.getSize() >= 4 && memcmp(file.getData(), "DDS ", 4) == 0)
+        parseDds(path);
+    else if (file.getSize() >= sizeof(ktx2Identifier) && memcmp(file.getData(), ktx2Identifier, sizeof(ktx2Identifier)) == 0)
+        parseKtx2(path);
+    else
+        throw std::runtime_error(path + " is not a DDS or KTX2 file");
+}
+
+void TextureContainer::parseDds(const std::string & path)
+{
+    // The magic number, a 124 byte header and, for a FourCC of DX10, a 20 byte extension
+    const unsigned char * data = file.getData();
+    if (file.getSize() < 128 || read32(data + 4) != 124)
+        throw std::runtime_error(path + " has a truncated DDS header");
+
+    const unsigned int MIPMAPCOUNT = 0x20000, FOURCC = 0x4, RGB = 0x40, ALPHAPIXELS = 0x1;
+    const unsigned int CUBEMAP = 0x200, VOLUME = 0x200000;
+
+    unsigned int flags = read32(data + 8);
+    height = (int)read32(data + 12);
+    width = (int)read32(data + 16);
+    int count = (flags & MIPMAPCOUNT) ? std::max(1, (int)read32(data + 28)) : 1;
+    unsigned int pixelFlags = read32(data + 80);
+    unsigned int code = read32(data + 84);
+    if (read32(data + 112) & (CUBEMAP | VOLUME))
+        throw std::runtime_error(path + " is a cube map or volume, only 2D textures are supported");
+
+    FormatInfo info;
+    bool known = false;
+    size_t offset = 128;
+    if ((pixelFlags & FOURCC) && code == fourCC('D', 'X', '1', '0')) {
+        if (file.getSize() < 148)
+            throw std::runtime_error(path + " has a truncated DX10 header");
+        if (read32(data + 132) != 3 || read32(data + 140) > 1 || (read32(data + 136) & 0x4))
+            throw std::runtime_error(path + " is not a single 2D texture");
+        known = dxgiFormat(read32(data + 128), info);
+        offset = 148;
+    } else if (pixelFlags & FOURCC) {
+        known = true;
+        if (code == fourCC('D', 'X', 'T', '1')) info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT1_EXT, 8);
+        else if (code == fourCC('D', 'X', 'T', '3')) info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT3_EXT, 16);
+        else if (code == fourCC('D', 'X', 'T', '5')) info = compressedInfo(COMPRESSED_RGBA_S3TC_DXT5_EXT, 16);
+        else if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U')) info = compressedInfo(gl::COMPRESSED_RED_RGTC1, 8);
+        else if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U')) info = compressedInfo(gl::COMPRESSED_RG_RGTC2, 16);
+        else known = false;
+    } else if ((pixelFlags & RGB) && read32(data + 88) == 32) {
+        // 32-bit pixels in RGBA or BGRA order, with or without alpha
+        GLenum internal = (pixelFlags & ALPHAPIXELS) ? gl::RGBA8 : gl::RGB8;
+        unsigned int redMask = read32(data + 92), blueMask = read32(data + 100);
+        if (redMask == 0xFF && blueMask == 0xFF0000) {
+            info = pixelInfo(internal, gl::RGBA, 4);
+            known = true;
+        } else if (redMask == 0xFF0000 && blueMask == 0xFF) {
+            info = pixelInfo(internal, gl::BGRA, 4);
+            known = true;
+        }
+    }
+    if (!known)
+        throw std::runtime_error(path + " has a pixel format that is not supported");
+
+    internalFormat = info.internalFormat;
+    pixelFormat = info.pixelFormat;
+    pixelType = info.pixelType;
+    blockBytes = info.blockBytes;
+    pixelBytes = info.pixelBytes;
+
+    // Levels follow the headers, largest first
+    addLevels(path, count);
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (offset > file.getSize() || levels[i].size > file.getSize() - offset)
+            throw std::runtime_error(path + " is shorter than its levels");
+        levels[i].data = data + offset;
+        offset += levels[i].size;
+    }
+}
+
+void TextureContainer::parseKtx2(const std::string & path)
+{
+    // The identifier, 9 header fields, the index of the other sections, then 24 bytes a level
+    const unsigned char * data = file.getData();
+    if (file.getSize() < 80)
+        throw std::runtime_error(path + " has a truncated KTX2 header");
+
+    unsigned int vkFormat = read32(data + 12);
+    width = (int)read32(data + 20);
+    height = (int)read32(data + 24);
+    unsigned int depth = read32(data + 28), layers = read32(data + 32), faces = read32(data + 36);
+    int count = std::max(1, (int)read32(data + 40));     // 0 asks for mips to be generated, which compressed levels cannot be
+    unsigned int supercompression = read32(data + 44);
+
+    if (depth > 0 || layers > 1 || faces != 1)
+        throw std::runtime_error(path + " is not a single 2D texture");
+    if (supercompression != 0)
+        throw std::runtime_error(path + " is supercompressed, which is not supported");
+
+    FormatInfo info;
+    if (!vulkanFormat(vkFormat, info))
+        throw std::runtime_error(path + " has a pixel format that is not supported");
+    internalFormat = info.internalFormat;
+    pixelFormat = info.pixelFormat;
+    pixelType = info.pixelType;
+    blockBytes = info.blockBytes;
+    pixelBytes = info.pixelBytes;
+
+    if (file.getSize() < 80 + (size_t)count * 24)
+        throw std::runtime_error(path + " has a truncated level index");
+
+    // Each level is wherever the index says, usually smallest first in the file
+    addLevels(path, count);
+    if ((int)levels.size() < count)
+        throw std::runtime_error(path + " has more levels than a mip chain down to 1x1");
+    for (size_t i = 0; i < levels.size(); i++) {
+        unsigned long long offset = read64(data + 80 + i * 24);
+        unsigned long long length = read64(data + 80 + i * 24 + 8);
+        if (offset > file.getSize() || length > file.getSize() - offset || length < levels[i].size)
+            throw std::runtime_error(path + " has a level outside the file");
+        levels[i].data = data + offset;
+    }
+}
+
+void TextureContainer::addLevels(const std::string & path, int count)
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error(path + " has no pixels");
+
+    for (int i = 0; i < count; i++) {
+        Level level;
+        level.width = std::max(1, width >> i);
+        level.height = std::max(1, height >> i);
+        level.data = NULL;
+        level.size = levelSize(level.width, level.height);
+        levels.push_back(level);
+
+        // A file may claim more levels than a chain down to 1x1 has
+        if (level.width == 1 && level.height == 1) break;
+    }
+}
+
+size_t TextureContainer::levelSize(int levelWidth, int levelHeight) const
+{
+    if (blockBytes > 0)
+        return (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes;
+    return (size_t)levelWidth * levelHeight * pixelBytes;
+}
+
+GLuint TextureContainer::createTexture() const
+{
+    GLuint texture;
+    gl::GenTextures(1, &texture);
+    gl::BindTexture(gl::TEXTURE_2D, texture);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, levels.size() > 1 ? gl::LINEAR_MIPMAP_LINEAR : gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::REPEAT);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::REPEAT);
+    gl::TexStorage2D(gl::TEXTURE_2D, (GLsizei)levels.size(), internalFormat, width, height);
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const Level & level = levels[i];
+        if (blockBytes > 0) {
+            gl::CompressedTexSubImage2D(gl::TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, internalFormat, (GLsizei)level.size, level.data);
+        } else {
+            gl::TexSubImage2D(gl::TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, pixelFormat, pixelType, level.data);
+        }
+    }
+
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+    return texture;
+}
+
+int TextureContainer::getWidth() const
+{
+    return width;
+}
+
+int TextureContainer::getHeight() const
+{
+    return height;
+}
+
+GLenum TextureContainer::getInternalFormat() const
+{
+    return internalFormat;
+}
+
+bool TextureContainer::isCompressed() const
+{
+    return blockBytes > 0;
+}
+
+const std::vector<TextureContainer::Level> & TextureContainer::getLevels() const
+{
+    return levels;
+}
@@ -0,0 +1,64 @@
+#ifndef TEXTURECONTAINER_H
+#define TEXTURECONTAINER_H
+
+#include "gl_core_4_3.hpp"
+#include "mappedfile.h"
+
+#include <string>
+#include <vector>
+
+/**
+ A DDS or KTX2 texture file, mapped into memory, whose levels are ready to
+ upload as they are stored.
+
+ The file is mapped rather than read and only its headers are parsed, so
+ opening one costs next to nothing; createTexture() allocates every level
+ with TexStorage2D and hands each straight from the mapped pages to
+ CompressedTexSubImage2D, or TexSubImage2D for plain pixels. Nothing is
+ decoded or copied on the CPU.
+
+ 2D textures with any number of mip levels are supported, in BC1 to BC5,
+ BC7 and 8-bit RGBA or BGRA. Cube maps, arrays, volumes and supercompressed
+ KTX2 files are rejected with a runtime_error. Both formats store the top
+ row first, so, like tdogl::Texture and TextureCache, the texture is upside
+ down in GL's coordinates and is sampled with V flipped. tdogl::Texture can
+ be made from a TextureContainer to own the texture.
+ */
+class TextureContainer
+{
+public:
+    // Where one level is in the mapped file
+    struct Level {
+        int width, height;
+        const unsigned char * data;
+        size_t size;
+    };
+
+private:
+    MappedFile file;
+    int width, height;
+    GLenum internalFormat;
+    GLenum pixelFormat, pixelType;      // For uncompressed levels only
+    int blockBytes;                     // Bytes of a 4x4 block, 0 when uncompressed
+    int pixelBytes;                     // Bytes of a pixel when uncompressed
+    std::vector<Level> levels;
+
+    void parseDds(const std::string & path);
+    void parseKtx2(const std::string & path);
+    void addLevels(const std::string & path, int count);     // Sizes only, the parser sets where they are
+    size_t levelSize(int levelWidth, int levelHeight) const;
+
+public:
+    explicit TextureContainer(const std::string & path);
+
+    // Creates a texture holding every level of the file. The caller owns it.
+    GLuint createTexture() const;
+
+    int getWidth() const;
+    int getHeight() const;
+    GLenum getInternalFormat() const;
+    bool isCompressed() const;
+    const std::vector<Level> & getLevels() const;
+};
+
+#endif // TEXTURECONTAINER_H
@@ -0,0 +1,332 @@
+#include "texturestreamer.h"
+#include "glutils.h"
+#include "mappedfile.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+// ARB_buffer_storage is core in 4.4 only, so it is not in the 4.3 loader
+static const GLbitfield MAP_PERSISTENT_BIT = 0x0040;
+static const GLbitfield MAP_COHERENT_BIT = 0x0080;
+
+typedef void (CODEGEN_FUNCPTR *BufferStorageFunc)(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+
+static BufferStorageFunc loadBufferStorage()
+{
+    if( !GLUtils::hasExtension("GL_ARB_buffer_storage") ) return NULL;
+    return (BufferStorageFunc)GLUtils::getProcAddress("glBufferStorage");
+}
+
+// Ranges start on a 16 byte boundary so the copies into them are aligned
+static GLsizeiptr alignUp(GLsizeiptr value)
+{
+    return (value + 15) & ~(GLsizeiptr)15;
+}
+
+TextureStreamer::TextureStreamer(GLsizeiptr bufferSize, GLsizeiptr uploadBudget, int threads) :
+    bufferHandle(0), mapped(NULL), capacity(alignUp(bufferSize)), uploadBudget(uploadBudget), head(0), stopping(false),
+    outstanding(0), bytesUploaded(0)
+{
+    if( bufferSize <= 0 || uploadBudget <= 0 )
+        throw std::runtime_error("Texture streamer needs a positive buffer size and upload budget");
+
+    BufferStorageFunc bufferStorage = loadBufferStorage();
+    if( bufferStorage ) {
+        GLbitfield flags = gl::MAP_WRITE_BIT | MAP_PERSISTENT_BIT | MAP_COHERENT_BIT;
+        gl::GenBuffers(1, &bufferHandle);
+        gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, bufferHandle);
+        bufferStorage(gl::PIXEL_UNPACK_BUFFER, capacity, NULL, flags);
+        mapped = (GLubyte *)gl::MapBufferRange(gl::PIXEL_UNPACK_BUFFER, 0, capacity, flags);
+        gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if( threads <= 0 ) threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for( int i = 0; i < threads; i++ )
+        workers.push_back(std::thread(&TextureStreamer::workerLoop, this));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    spaceFreed.notify_all();
+    for( size_t i = 0; i < workers.size(); i++ )
+        workers[i].join();
+
+    for( size_t i = 0; i < inFlight.size(); i++ )
+        gl::DeleteSync(inFlight[i].fence);
+
+    if( bufferHandle ) {
+        if( mapped ) {
+            gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, bufferHandle);
+            gl::UnmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+            gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+        }
+        gl::DeleteBuffers(1, &bufferHandle);
+    }
+
+    for( size_t i = 0; i < entries.size(); i++ )
+        if( entries[i].texture ) gl::DeleteTextures(1, &entries[i].texture);
+}
+
+int TextureStreamer::request(const std::string & fileName)
+{
+    Entry entry;
+    entry.texture = 0;
+    entry.status = LOADING;
+    entry.width = entry.height = 0;
+    entries.push_back(entry);
+    outstanding++;
+
+    int ticket = (int)entries.size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::make_pair(ticket, fileName));
+    }
+    jobAdded.notify_one();
+    return ticket;
+}
+
+void TextureStreamer::workerLoop()
+{
+    for( ;; ) {
+        std::pair<int, std::string> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if( stopping ) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+        decode(job.first, job.second);
+    }
+}
+
+void TextureStreamer::decode(int ticket, const std::string & fileName)
+{
+    Decoded image;
+    image.ticket = ticket;
+    image.offset = -1;
+    image.size = 0;
+
+    // The file is decoded straight from its mapped pages. stb_image always
+    // decodes into memory of its own, so the copy below is the one that
+    // reaches the unpack buffer. The rows go through in stb_image's order,
+    // top row first, as the Texture class uploads them.
+    unsigned char * pixels = NULL;
+    try {
+        MappedFile file(fileName);
+        if( file.getSize() > 0 && file.getSize() <= INT_MAX )
+            pixels = stbi_load_from_memory(file.getData(), (int)file.getSize(), &image.width, &image.height, &image.channels, 0);
+    } catch( const std::exception & ) {
+    }
+    if( !pixels ) {
+        image.error = "Unable to decode " + fileName;
+    } else {
+        size_t rowSize = (size_t)image.width * image.channels;
+        image.size = (GLsizeiptr)(rowSize * image.height);
+
+        unsigned char * dest;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if( mapped && image.size <= capacity ) {
+                while( !stopping && !allocate(image.size, image.offset) )
+                    spaceFreed.wait(lock);
+                if( stopping ) {
+                    stbi_image_free(pixels);
+                    return;
+                }
+            }
+        }
+        if( image.offset >= 0 ) {
+            dest = mapped + image.offset;
+        } else {
+            image.pixels.resize(image.size);
+            dest = &image.pixels[0];
+        }
+
+        memcpy(dest, pixels, image.size);
+        stbi_image_free(pixels);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    decoded.push_back(std::move(image));
+}
+
+bool TextureStreamer::allocate(GLsizeiptr size, GLintptr & offset)
+{
+    size = alignUp(size);
+
+    if( ranges.empty() ) {
+        head = 0;
+        offset = 0;
+    } else {
+        GLintptr tail = ranges.front().offset;
+        if( head > tail ) {
+            // Free space after head and before tail, ranges do not wrap
+            if( capacity - head >= size ) offset = head;
+            else if( tail >= size ) offset = 0;
+            else return false;
+        } else {
+            // head == tail means the buffer is full
+            if( tail - head >= size ) offset = head;
+            else return false;
+        }
+    }
+
+    Range range;
+    range.offset = offset;
+    range.size = size;
+    range.released = false;
+    ranges.push_back(range);
+    head = offset + size;
+    return true;
+}
+
+void TextureStreamer::release(GLintptr offset)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for( size_t i = 0; i < ranges.size(); i++ ) {
+            if( ranges[i].offset == offset ) {
+                ranges[i].released = true;
+                break;
+            }
+        }
+        // Uploads can finish out of order, the ring only shrinks from its oldest range
+        while( !ranges.empty() && ranges.front().released )
+            ranges.pop_front();
+    }
+    spaceFreed.notify_all();
+}
+
+void TextureStreamer::update()
+{
+    // Recycle the buffer space of uploads the GPU has finished reading
+    while( !inFlight.empty() ) {
+        GLenum result = gl::ClientWaitSync(inFlight.front().fence, 0, 0);
+        if( result != gl::ALREADY_SIGNALED && result != gl::CONDITION_SATISFIED ) break;
+
+        gl::DeleteSync(inFlight.front().fence);
+        release(inFlight.front().offset);
+        inFlight.pop_front();
+    }
+
+    GLsizeiptr uploaded = 0;
+    while( uploaded < uploadBudget ) {
+        Decoded image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if( decoded.empty() ) break;
+            image = std::move(decoded.front());
+            decoded.pop_front();
+        }
+        upload(image);
+        uploaded += image.size;
+    }
+}
+
+void TextureStreamer::upload(Decoded & image)
+{
+    Entry & entry = entries[image.ticket];
+    outstanding--;
+
+    if( !image.error.empty() ) {
+        entry.status = FAILED;
+        entry.error = image.error;
+        return;
+    }
+
+    static const GLenum formats[] = { gl::RED, gl::RG, gl::RGB, gl::RGBA };
+    static const GLenum internalFormats[] = { gl::R8, gl::RG8, gl::RGB8, gl::RGBA8 };
+    GLenum format = formats[image.channels - 1];
+
+    gl::GenTextures(1, &entry.texture);
+    gl::BindTexture(gl::TEXTURE_2D, entry.texture);
+    gl::TexStorage2D(gl::TEXTURE_2D, 1, internalFormats[image.channels - 1], image.width, image.height);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::CLAMP_TO_EDGE);
+    gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::CLAMP_TO_EDGE);
+
+    // Grayscale images read as grey rather than red, with their alpha if they have one
+    if( image.channels <= 2 ) {
+        GLint alpha = image.channels == 2 ? gl::GREEN : gl::ONE;
+        GLint swizzle[] = { gl::RED, gl::RED, gl::RED, alpha };
+        gl::TexParameteriv(gl::TEXTURE_2D, gl::TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    // Rows of RGB and grayscale images are not padded to 4 bytes
+    gl::PixelStorei(gl::UNPACK_ALIGNMENT, 1);
+    if( image.offset >= 0 ) {
+        gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, bufferHandle);
+        gl::TexSubImage2D(gl::TEXTURE_2D, 0, 0, 0, image.width, image.height, format, gl::UNSIGNED_BYTE, (const void *)image.offset);
+        gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+        InFlight upload;
+        upload.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+        upload.offset = image.offset;
+        inFlight.push_back(upload);
+    } else {
+        gl::TexSubImage2D(gl::TEXTURE_2D, 0, 0, 0, image.width, image.height, format, gl::UNSIGNED_BYTE, &image.pixels[0]);
+    }
+    gl::PixelStorei(gl::UNPACK_ALIGNMENT, 4);
+    gl::BindTexture(gl::TEXTURE_2D, 0);
+
+    entry.status = READY;
+    entry.width = image.width;
+    entry.height = image.height;
+    bytesUploaded += image.size;
+}
+
+TextureStreamer::Status TextureStreamer::getStatus(int ticket) const
+{
+    return entries[ticket].status;
+}
+
+GLuint TextureStreamer::getTexture(int ticket) const
+{
+    return entries[ticket].texture;
+}
+
+const std::string & TextureStreamer::getError(int ticket) const
+{
+    return entries[ticket].error;
+}
+
+int TextureStreamer::getWidth(int ticket) const
+{
+    return entries[ticket].width;
+}
+
+int TextureStreamer::getHeight(int ticket) const
+{
+    return entries[ticket].height;
+}
+
+int TextureStreamer::getOutstanding() const
+{
+    return outstanding;
+}
+
+unsigned long long TextureStreamer::getBytesUploaded() const
+{
+    return bytesUploaded;
+}
+
+bool TextureStreamer::isPersistent() const
+{
+    return mapped != NULL;
+}
+
+int TextureStreamer::getThreadCount() const
+{
+    return (int)workers.size();
+}
@@ -0,0 +1,126 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include "gl_core_4_3.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ Loads image files into textures without stalling the render thread.
+
+ Worker threads decode the files with stb_image and copy the pixels, top
+ row first as decoded, straight into a persistently mapped pixel unpack
+ buffer. update(), called once a frame on
+ the GL thread, creates the textures of the images that are ready with
+ TexStorage2D and fills them from the buffer with TexSubImage2D, which the
+ driver can carry out by DMA without the CPU touching the pixels again. A
+ fence after each upload tells when its part of the buffer can be reused;
+ workers wait for space rather than the render thread.
+
+ A texture can be drawn with as soon as getTexture() returns it. Without
+ ARB_buffer_storage, or for an image larger than the whole buffer, the
+ pixels are kept in memory and uploaded from there instead.
+ */
+class TextureStreamer
+{
+public:
+    enum Status {
+        LOADING,
+        READY,
+        FAILED
+    };
+
+private:
+    // An image a worker has decoded, waiting for update() to upload it
+    struct Decoded {
+        int ticket;
+        int width, height, channels;
+        GLintptr offset;                    // Position in the unpack buffer, -1 if in pixels
+        GLsizeiptr size;
+        std::vector<unsigned char> pixels;  // Only used when the buffer cannot hold the image
+        std::string error;                  // Set if the file could not be decoded
+    };
+
+    // Part of the unpack buffer handed to a worker, in ring order
+    struct Range {
+        GLintptr offset;
+        GLsizeiptr size;
+        bool released;
+    };
+
+    // An upload whose buffer range is still being read by the GPU
+    struct InFlight {
+        GLsync fence;
+        GLintptr offset;
+    };
+
+    struct Entry {
+        GLuint texture;     // 0 until uploaded
+        Status status;
+        std::string error;
+        int width, height;
+    };
+
+    GLuint bufferHandle;
+    GLubyte * mapped;           // NULL when there is no persistent mapping
+    GLsizeiptr capacity;
+    GLsizeiptr uploadBudget;    // Bytes update() uploads per call, at least one image
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAdded;       // Signalled when a file is requested or the streamer stops
+    std::condition_variable spaceFreed;     // Signalled when an upload releases its range
+    std::deque< std::pair<int, std::string> > jobs;    // Ticket and file name
+    std::deque<Decoded> decoded;
+    std::deque<Range> ranges;
+    GLintptr head;              // Where the next range starts
+    bool stopping;
+
+    // Only used on the GL thread
+    std::vector<Entry> entries;             // Indexed by ticket
+    std::deque<InFlight> inFlight;
+    int outstanding;                        // Requested and not yet READY or FAILED
+    unsigned long long bytesUploaded;
+
+    void workerLoop();
+    void decode(int ticket, const std::string & fileName);
+    bool allocate(GLsizeiptr size, GLintptr & offset);     // Called with the mutex held
+    void release(GLintptr offset);
+    void upload(Decoded & image);
+
+    // Non-copyable, the GL objects and threads are owned by this instance
+    TextureStreamer( const TextureStreamer & ) { }
+    TextureStreamer & operator=( const TextureStreamer & ) { return *this; }
+
+public:
+    // bufferSize is the bytes of decoded pixels that can wait in the unpack
+    // buffer. threads is the number of decoding threads, 0 for one less than
+    // the hardware threads.
+    TextureStreamer(GLsizeiptr bufferSize = 64 << 20, GLsizeiptr uploadBudget = 16 << 20, int threads = 0);
+    ~TextureStreamer();
+
+    // Starts loading a file and returns the ticket to ask about it with.
+    int request(const std::string & fileName);
+
+    // Uploads the images decoded since the last call, up to the budget, and
+    // recycles the buffer space of finished uploads. Never blocks.
+    void update();
+
+    Status getStatus(int ticket) const;
+    GLuint getTexture(int ticket) const;            // 0 until READY, owned by the streamer
+    const std::string & getError(int ticket) const;
+    int getWidth(int ticket) const;
+    int getHeight(int ticket) const;
+
+    int getOutstanding() const;                     // Requests not yet READY or FAILED
+    unsigned long long getBytesUploaded() const;
+    bool isPersistent() const;
+    int getThreadCount() const;
+};
+
+#endif // TEXTURESTREAMER_H
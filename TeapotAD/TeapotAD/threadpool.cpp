@@ -0,0 +1,78 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int threads) : body(NULL), count(0), next(0), completed(0), generation(0), stopping(false)
+{
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    for (int i = 1; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+int ThreadPool::getThreadCount() const
+{
+    return (int)workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(int iterations, const std::function<void(int)> & loopBody)
+{
+    if (iterations <= 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = &loopBody;
+        count = iterations;
+        next = 0;
+        completed = 0;
+        generation++;
+    }
+    wake.notify_all();
+
+    runIterations();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return completed == count; });
+    body = NULL;
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        runIterations();
+    }
+}
+
+void ThreadPool::runIterations()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (body != NULL && next < count) {
+        const std::function<void(int)> * loopBody = body;
+        int i = next++;
+
+        lock.unlock();
+        (*loopBody)(i);
+        lock.lock();
+
+        if (++completed == count)
+            finished.notify_all();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ A fixed set of worker threads that run the iterations of a loop in
+ parallel.
+
+ parallelFor() hands out the iterations one at a time, so it suits loops
+ with a few dozen to a few thousand coarse iterations (mesh patches, image
+ tiles). The calling thread works on the loop too and returns once every
+ iteration has finished.
+ */
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // Signalled when a loop starts or the pool stops
+    std::condition_variable finished;   // Signalled when the last iteration of a loop ends
+
+    const std::function<void(int)> * body;  // Loop being run, NULL between loops
+    int count;              // Iterations in the loop
+    int next;               // Next iteration to hand out
+    int completed;          // Iterations that have ended
+    unsigned int generation;    // Incremented for every loop so workers notice new work
+    bool stopping;
+
+    void workerLoop();
+    void runIterations();
+
+    // Non-copyable, the threads are owned by this instance
+    ThreadPool( const ThreadPool & ) { }
+    ThreadPool & operator=( const ThreadPool & ) { return *this; }
+
+public:
+    // threads includes the calling thread, 0 uses one per hardware thread.
+    ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    int getThreadCount() const;
+
+    // Calls body(i) for every i in [0, count) and waits for them all.
+    void parallelFor(int count, const std::function<void(int)> & body);
+};
+
+#endif // THREADPOOL_H
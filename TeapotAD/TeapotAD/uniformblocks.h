@@ -0,0 +1,81 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <glm.hpp>
+
+/**
+ CPU side copies of the std140 uniform blocks and std430 shader storage
+ blocks declared in the shaders.
+
+ The member order and padding must match the GLSL declarations exactly;
+ SceneDiffuse checks the uniform block sizes against the linked program at
+ start up.
+ */
+namespace UniformBlock {
+
+    // Binding points shared by every program that declares the blocks
+    enum Binding {
+        FRAME = 0,
+        OBJECT = 1
+    };
+
+    // Per-frame camera and light data, "FrameData" in the shaders
+    struct FrameData {
+        glm::mat4 V;                // Camera view matrix
+        glm::mat4 P;                // Camera projection matrix
+        glm::vec4 lightPosition;    // World space, w unused
+        glm::vec4 La;               // Ambient light intensity, w unused
+        glm::vec4 Ld;               // Diffuse light intensity, w unused
+        glm::vec4 Ls;               // Specular light intensity, w unused
+        float attenuation;
+        float pad[3];
+    };
+
+    // Per-object transform and material, "ObjectData" in the shaders. Also
+    // an element of "Objects" in phong_indirect.vert, its std430 layout is
+    // the same.
+    struct ObjectData {
+        glm::mat4 M;                // Model matrix
+        glm::mat4 normalMatrix;     // Upper 3x3 of the model view matrix, padded to a mat4
+        glm::vec4 Ka;               // Ambient reflectivity, w unused
+        glm::vec4 Kd;               // Diffuse reflectivity, w the material's index for the deferred lighting passes
+        glm::vec4 Ks;               // Specular reflectivity, w unused
+    };
+}
+
+namespace StorageBlock {
+
+    // Shader storage binding points, separate from the uniform block ones
+    enum Binding {
+        INSTANCES = 0,
+        MATERIALS = 1,
+        OBJECTS = 2,    // UniformBlock::ObjectData array, one per indirect draw command
+        INSTANCE_INDICES = 3,   // Element of INSTANCES drawn by each instance of a draw call
+        DRAW_COMMANDS = 4,      // DrawElementsIndirectCommand array written by a culling pass
+        POINT_LIGHTS = 5,       // PointLightData array, one light volume instance each
+        CLUSTER_COUNTS = 6,     // Number of point lights touching each view frustum cluster
+        CLUSTER_LIGHTS = 7      // Elements of POINT_LIGHTS touching each cluster, a fixed number of slots per cluster
+    };
+
+    // One instanced object, an element of "Instances" in the shaders
+    struct InstanceData {
+        glm::mat4 M;                // Model matrix
+        unsigned int materialIndex; // Element of the material buffer to use
+        unsigned int pad[3];
+    };
+
+    // One material, an element of "Materials" in the shaders
+    struct MaterialData {
+        glm::vec4 Ka;               // Ambient reflectivity, w unused
+        glm::vec4 Kd;               // Diffuse reflectivity, w unused
+        glm::vec4 Ks;               // Specular reflectivity, w unused
+    };
+
+    // One light of the deferred and clustered renderers, an element of "PointLights" in the shaders
+    struct PointLightData {
+        glm::vec4 positionRadius;   // World space position, w the distance beyond which it adds nothing
+        glm::vec4 colourFalloff;    // Intensity, w the quadratic attenuation
+    };
+}
+
+#endif // UNIFORMBLOCKS_H
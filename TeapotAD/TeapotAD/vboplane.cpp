@@ -13,15 +13,23 @@
 #include <cstdio>
 #include <cmath>
 
-VBOPlane::VBOPlane(float xsize, float zsize, int xdivs, int zdivs)
+VBOPlane::VBOPlane(float xsize, float zsize, int xdivs, int zdivs, GeometryArena * arena, VertexFormat::Format format)
 {
 
 
     faces = xdivs * zdivs;
-    float * v = new float[3 * (xdivs + 1) * (zdivs + 1)];
-	float * n = new float[3 * (xdivs + 1) * (zdivs + 1)];
-    float * tex = new float[2 * (xdivs + 1) * (zdivs + 1)];
-    unsigned int * el = new unsigned int[6 * xdivs * zdivs];
+    MeshData mesh;
+    buildMesh(xsize, zsize, xdivs, zdivs, mesh);
+    setMesh(mesh, arena, format);
+}
+
+void VBOPlane::buildMesh(float xsize, float zsize, int xdivs, int zdivs, MeshData & mesh)
+{
+    mesh.resize((xdivs + 1) * (zdivs + 1), 2 * xdivs * zdivs);
+    float * v = &mesh.positions[0];
+	float * n = &mesh.normals[0];
+    float * tex = &mesh.texCoords[0];
+    unsigned int * el = &mesh.indices[0];
 
     float x2 = xsize / 2.0f;
     float z2 = zsize / 2.0f;
@@ -63,42 +71,12 @@ VBOPlane::VBOPlane(float xsize, float zsize, int xdivs, int zdivs)
             idx += 6;
         }
     }
-
-    unsigned int handle[4];
-    gl::GenBuffers(4, handle);
-
-	gl::GenVertexArrays( 1, &vaoHandle );
-    gl::BindVertexArray(vaoHandle);
-
-    gl::BindBuffer(gl::ARRAY_BUFFER, handle[0]);
-    gl::BufferData(gl::ARRAY_BUFFER, 3 * (xdivs+1) * (zdivs+1) * sizeof(float), v, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)0, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(0);  // Vertex position
-
-	gl::BindBuffer(gl::ARRAY_BUFFER, handle[1]);
-    gl::BufferData(gl::ARRAY_BUFFER, 3 * (xdivs+1) * (zdivs+1) * sizeof(float), n, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)1, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(1);  // Vertex normal
-
-    gl::BindBuffer(gl::ARRAY_BUFFER, handle[2]);
-    gl::BufferData(gl::ARRAY_BUFFER, 2 * (xdivs+1) * (zdivs+1) * sizeof(float), tex, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)2, 2, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(2);  // Texture coords
-
-    gl::BindBuffer(gl::ELEMENT_ARRAY_BUFFER, handle[3]);
-    gl::BufferData(gl::ELEMENT_ARRAY_BUFFER, 6 * xdivs * zdivs * sizeof(unsigned int), el, gl::STATIC_DRAW);
-
-    gl::BindVertexArray(0);
-    
-    delete [] v;
-	delete [] n;
-    delete [] tex;
-    delete [] el;
 }
 
 void VBOPlane::render() const {
-    //GLUtils::checkForOpenGLError(__FILE__,__LINE__);
-    gl::BindVertexArray(vaoHandle);
-    gl::DrawElements(gl::TRIANGLES, 6 * faces, gl::UNSIGNED_INT, ((GLubyte *)NULL + (0)));
-    //GLUtils::checkForOpenGLError(__FILE__,__LINE__);
+    drawMesh(1);
+}
+
+void VBOPlane::renderInstanced(int instances) const {
+    drawMesh(instances);
 }
@@ -6,13 +6,16 @@
 class VBOPlane : public Drawable
 {
 private:
-    unsigned int vaoHandle;
     int faces;
 
 public:
-    VBOPlane(float, float, int, int);
+    VBOPlane(float, float, int, int, GeometryArena * arena = NULL, VertexFormat::Format format = VertexFormat::SEPARATE);
 
     void render() const;
+    void renderInstanced(int instances) const;
+
+    // Fills mesh with the plane's vertices and triangles, without touching GL.
+    static void buildMesh(float xsize, float zsize, int xdivs, int zdivs, MeshData & mesh);
 };
 
 #endif // VBOPLANE_H
@@ -0,0 +1,72 @@
+#include "vbosphere.h"
+#include "defines.h"
+
+#include <cmath>
+
+VBOSphere::VBOSphere(float radius, int slices, int stacks, GeometryArena * arena, VertexFormat::Format format)
+    : slices(slices), stacks(stacks)
+{
+    MeshData mesh;
+    buildMesh(radius, slices, stacks, mesh);
+    setMesh(mesh, arena, format);
+}
+
+void VBOSphere::buildMesh(float radius, int slices, int stacks, MeshData & mesh)
+{
+    mesh.resize((slices + 1) * (stacks + 1), 2 * slices * stacks);
+    float * v = &mesh.positions[0];
+    float * n = &mesh.normals[0];
+    float * tex = &mesh.texCoords[0];
+    unsigned int * el = &mesh.indices[0];
+
+    // Rows of vertices from the south pole to the north, the seam column repeated for the texture coordinates.
+    int vidx = 0, tidx = 0;
+    for( int i = 0; i <= stacks; i++ ) {
+        float phi = (float)(PI * i / stacks - PI / 2.0);
+        for( int j = 0; j <= slices; j++ ) {
+            float theta = (float)(TWOPI * j / slices);
+            float nx = cos(phi) * sin(theta);
+            float ny = sin(phi);
+            float nz = cos(phi) * cos(theta);
+            v[vidx] = radius * nx;
+            v[vidx+1] = radius * ny;
+            v[vidx+2] = radius * nz;
+            n[vidx] = nx;
+            n[vidx+1] = ny;
+            n[vidx+2] = nz;
+            vidx += 3;
+            tex[tidx] = (float)j / slices;
+            tex[tidx+1] = (float)i / stacks;
+            tidx += 2;
+        }
+    }
+
+    int idx = 0;
+    for( int i = 0; i < stacks; i++ ) {
+        unsigned int rowStart = i * (slices + 1);
+        unsigned int nextRowStart = (i + 1) * (slices + 1);
+        for( int j = 0; j < slices; j++ ) {
+            el[idx] = rowStart + j;
+            el[idx+1] = rowStart + j + 1;
+            el[idx+2] = nextRowStart + j + 1;
+            el[idx+3] = rowStart + j;
+            el[idx+4] = nextRowStart + j + 1;
+            el[idx+5] = nextRowStart + j;
+            idx += 6;
+        }
+    }
+}
+
+float VBOSphere::getCircumscribedScale() const
+{
+    // Every face is at least this far from the centre, with a little to spare for rounding.
+    return 1.01f / (float)(cos(PI / slices) * cos(PI / (2 * stacks)));
+}
+
+void VBOSphere::render() const {
+    drawMesh(1);
+}
+
+void VBOSphere::renderInstanced(int instances) const {
+    drawMesh(instances);
+}
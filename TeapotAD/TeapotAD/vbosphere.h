@@ -0,0 +1,26 @@
+#ifndef VBOSPHERE_H
+#define VBOSPHERE_H
+
+#include "drawable.h"
+
+class VBOSphere : public Drawable
+{
+private:
+    int slices, stacks;
+
+public:
+    VBOSphere(float radius, int slices, int stacks, GeometryArena * arena = NULL, VertexFormat::Format format = VertexFormat::SEPARATE);
+
+    void render() const;
+    void renderInstanced(int instances) const;
+
+    // How much the mesh must be scaled to contain the true sphere, whose surface
+    // bulges out between the vertices.
+    float getCircumscribedScale() const;
+
+    // Fills mesh with a latitude and longitude sphere wound anticlockwise seen
+    // from outside, without touching GL.
+    static void buildMesh(float radius, int slices, int stacks, MeshData & mesh);
+};
+
+#endif // VBOSPHERE_H
@@ -1,42 +1,85 @@
 
 #include "vboteapot.h"
+#include "geometryarena.h"
 #include "teapotdata.h"
+#include "threadpool.h"
 #include "glutils.h"
 
 #include "gl_core_4_3.hpp"
 
+#include <cmath>
 #include <cstdio>
 
 #include <gtc/matrix_transform.hpp>
 using glm::mat4;
 using glm::vec4;
 
-VBOTeapot::VBOTeapot(int grid, mat4 lidTransform)
+// Every teapot is tessellated on the same pool, started by the first one and kept until exit
+static ThreadPool & tessellationPool()
 {
-    int verts = 32 * (grid + 1) * (grid + 1);
-    faces = grid * grid * 32;
-    float * v = new float[ verts * 3 ];
-    float * n = new float[ verts * 3 ];
-    float * tc = new float[ verts * 2 ];
-    unsigned int * el = new unsigned int[faces * 6];
+    static ThreadPool pool;
+    return pool;
+}
+
+VBOTeapot::VBOTeapot(int grid, mat4 lidTransform, GeometryArena * arena, VertexFormat::Format format, int lodLevels)
+    : ownArena(NULL), lod(0)
+{
+    std::vector<BezierTessellator::Patch> patches;
+    buildPatches(patches);
 
-    gl::GenVertexArrays( 1, &vaoHandle );
-    gl::BindVertexArray(vaoHandle);
+    ThreadPool * pool = &tessellationPool();
 
-    unsigned int handle[4];
-    gl::GenBuffers(4, handle);
+    // Every level of detail goes into one set of buffers, which the teapot
+    // owns unless it was given an arena to share.
+    if (lodLevels > 1 && arena == NULL)
+        arena = ownArena = new GeometryArena(format);
 
-    generatePatches( v, n, tc, el, grid );
+    // Each level halves the grid of the one before. They are built coarsest
+    // first so the finest, level 0, is the mesh left selected. Its vertices
+    // include every coarser level's, so the bounds it leaves hold them all.
+    lods.resize(glm::max(1, lodLevels));
 
-	moveLid(grid, v, lidTransform);
+    GLsizeiptr bytes = 0;
+    for (int level = (int)lods.size() - 1; level >= 0; level--)
+    {
+        Lod & l = lods[level];
+        l.grid = glm::max(1, grid >> level);
+
+        MeshData mesh;
+        buildMesh(l.grid, lidTransform, patches, pool, mesh);
+        setMesh(mesh, arena, format);
+
+        l.range = meshRange;
+        l.error = lods.size() > 1 ? tessellationError(l.grid, patches, pool) : 0.0f;
+        l.vertexBytes = vertexBytes;
+        l.transforms = optimisedCache.transforms;
+        bytes += vertexBytes;
+    }
+    vertexBytes = bytes;
+    faces = lods[0].grid * lods[0].grid * 32;
+
+    // Drawn with the teapot's own shaders, which have no use for the draw index.
+    if (ownArena != NULL) ownArena->upload(0);
+}
+
+VBOTeapot::~VBOTeapot()
+{
+    delete ownArena;
+}
+
+void VBOTeapot::buildMesh(int grid, mat4 lidTransform, const std::vector<BezierTessellator::Patch> & patches, ThreadPool * pool, MeshData & mesh)
+{
+    int verts = 32 * (grid + 1) * (grid + 1);
+
+    BezierTessellator tessellator(grid, pool);
+    tessellator.tessellate(patches, mesh);
 
-	mat4 rot1 = mat4(1.0, 0.0, 0.0, 0.0,
-					0.0, 0.0, -1.0, 0.0,
-					0.0, 1.0, 0.0, 0.0,
-					0.0, 0.0, 0.0, 1.0);
+    float * v = &mesh.positions[0];
+    float * n = &mesh.normals[0];
 
-	mat4 transform = rot1 ;
+	moveLid(grid, v, lidTransform);
 
+	mat4 transform = uprightTransform();
 
 	int s = 3 * verts;
 	for(int i=0; i<s; i+=3)
@@ -45,76 +88,150 @@ VBOTeapot::VBOTeapot(int grid, mat4 lidTransform)
 		vert = transform * vert;
 		v[i] = vert.x;
 		v[i+1] = vert.y;
-		v[i+2] = -vert.z;
+		v[i+2] = vert.z;
 
 		vec4 norm = vec4(n[i], n[i+1], n[i+2], 1.0f);
 		norm = transform * norm;
 		n[i] = norm.x;
 		n[i+1] = norm.y;
-		n[i+2] = -norm.z;
+		n[i+2] = norm.z;
 	}
-    gl::BindBuffer(gl::ARRAY_BUFFER, handle[0]);
-    gl::BufferData(gl::ARRAY_BUFFER, (3 * verts) * sizeof(float), v, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)0, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(0);  // Vertex position
-
-    gl::BindBuffer(gl::ARRAY_BUFFER, handle[1]);
-    gl::BufferData(gl::ARRAY_BUFFER, (3 * verts) * sizeof(float), n, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)1, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(1);  // Vertex normal
-
-    gl::BindBuffer(gl::ARRAY_BUFFER, handle[2]);
-    gl::BufferData(gl::ARRAY_BUFFER, (2 * verts) * sizeof(float), tc, gl::STATIC_DRAW);
-    gl::VertexAttribPointer( (GLuint)2, 2, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
-    gl::EnableVertexAttribArray(2);  // texture coords
-
-    gl::BindBuffer(gl::ELEMENT_ARRAY_BUFFER, handle[3]);
-    gl::BufferData(gl::ELEMENT_ARRAY_BUFFER, 6 * faces * sizeof(unsigned int), el, gl::STATIC_DRAW);
-
-    delete [] v;
-    delete [] n;
-    delete [] el;
-    delete [] tc;
-
-    gl::BindVertexArray(0);
 }
 
-void VBOTeapot::generatePatches(float * v, float * n, float * tc, unsigned int* el, int grid) {
-    float * B = new float[4*(grid+1)];  // Pre-computed Bernstein basis functions
-    float * dB = new float[4*(grid+1)]; // Pre-computed derivitives of basis functions
+float VBOTeapot::tessellationError(int grid, const std::vector<BezierTessellator::Patch> & patches, ThreadPool * pool)
+{
+    // Tessellating at twice the grid puts a vertex on the true surface at the middle of every
+    // edge and quad of the coarse mesh. The error is the furthest any of them is from the
+    // flat interpolation of the coarse vertices around it.
+    MeshData fine;
+    BezierTessellator tessellator(2 * grid, pool);
+    tessellator.tessellate(patches, fine);
+
+    int points = 2 * grid + 1;
+    int copies = fine.getVertexCount() / (points * points);
+    float error = 0.0f;
+
+    for (int c = 0; c < copies; c++)
+    {
+        const float * base = &fine.positions[3 * c * points * points];
+        for (int i = 0; i < points; i++)
+        {
+            for (int j = 0; j < points; j++)
+            {
+                if (i % 2 == 0 && j % 2 == 0) continue;    // A vertex of the coarse mesh
+
+                // The coarse vertices either side along u and v (the same one on even lines).
+                int i0 = i - i % 2, i1 = i + i % 2;
+                int j0 = j - j % 2, j1 = j + j % 2;
+                vec3 flat(0.0f);
+                flat += vec3(base[3 * (i0 * points + j0)], base[3 * (i0 * points + j0) + 1], base[3 * (i0 * points + j0) + 2]);
+                flat += vec3(base[3 * (i1 * points + j0)], base[3 * (i1 * points + j0) + 1], base[3 * (i1 * points + j0) + 2]);
+                flat += vec3(base[3 * (i0 * points + j1)], base[3 * (i0 * points + j1) + 1], base[3 * (i0 * points + j1) + 2]);
+                flat += vec3(base[3 * (i1 * points + j1)], base[3 * (i1 * points + j1) + 1], base[3 * (i1 * points + j1) + 2]);
+                flat *= 0.25f;
+
+                vec3 surface(base[3 * (i * points + j)], base[3 * (i * points + j) + 1], base[3 * (i * points + j) + 2]);
+                error = glm::max(error, glm::length(surface - flat));
+            }
+        }
+    }
+    return error;
+}
+
+int VBOTeapot::getLodCount() const
+{
+    return (int)lods.size();
+}
+
+void VBOTeapot::selectLod(int level)
+{
+    lod = glm::clamp(level, 0, getLodCount() - 1);
+    meshRange = lods[lod].range;
+    faces = lods[lod].grid * lods[lod].grid * 32;
+}
+
+int VBOTeapot::getSelectedLod() const
+{
+    return lod;
+}
+
+const MeshRange & VBOTeapot::getLodRange(int level) const
+{
+    return lods[level].range;
+}
 
-    int idx = 0, elIndex = 0, tcIndex = 0;
+unsigned int VBOTeapot::getLodTriangles(int level) const
+{
+    return lods[level].range.indexCount / 3;
+}
 
-    // Pre-compute the basis functions  (Bernstein polynomials)
-    // and their derivatives
-    computeBasisFunctions(B, dB, grid);
+GLsizeiptr VBOTeapot::getLodVertexBytes(int level) const
+{
+    return lods[level].vertexBytes;
+}
+
+unsigned int VBOTeapot::getLodTransforms(int level) const
+{
+    return lods[level].transforms;
+}
+
+float VBOTeapot::getLodError(int level) const
+{
+    return lods[level].error;
+}
+
+int VBOTeapot::chooseLod(float distance, float fieldOfView, int viewportHeight, float maxPixelError) const
+{
+    // Pixels per object space unit at this distance, for a symmetric perspective projection.
+    float pixelsPerUnit = viewportHeight / (2.0f * glm::max(distance, 0.001f) * tan(0.5f * fieldOfView));
+
+    // The coarsest level whose error still projects to less than maxPixelError.
+    int level = 0;
+    while (level + 1 < getLodCount() && lods[level + 1].error * pixelsPerUnit <= maxPixelError)
+        level++;
+    return level;
+}
+
+mat4 VBOTeapot::uprightTransform() {
+    // Rotates the patch data's z up to y, then mirrors z so the spout points along +x.
+    mat4 rot1 = mat4(1.0, 0.0, 0.0, 0.0,
+                    0.0, 0.0, -1.0, 0.0,
+                    0.0, 1.0, 0.0, 0.0,
+                    0.0, 0.0, 0.0, 1.0);
+    mat4 flipZ = mat4(1.0, 0.0, 0.0, 0.0,
+                    0.0, 1.0, 0.0, 0.0,
+                    0.0, 0.0, -1.0, 0.0,
+                    0.0, 0.0, 0.0, 1.0);
+    return flipZ * rot1;
+}
+
+void VBOTeapot::buildPatches(std::vector<BezierTessellator::Patch> & patches) {
+    // Each patch of the data is mirrored to make up the teapot. The copies are
+    // in the order the mesh has always had them, so moveLid() finds the lid.
+    unsigned int slot = 0;
 
-    // Build each patch
     // The rim
-    buildPatchReflect(0, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
+    addPatchReflect(patches, 0, slot, true, true);
     // The body
-    buildPatchReflect(1, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    buildPatchReflect(2, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
+    addPatchReflect(patches, 1, slot, true, true);
+    addPatchReflect(patches, 2, slot, true, true);
     // The lid
-    buildPatchReflect(3, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    buildPatchReflect(4, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
+    addPatchReflect(patches, 3, slot, true, true);
+    addPatchReflect(patches, 4, slot, true, true);
     // The bottom
-    buildPatchReflect(5, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
+    addPatchReflect(patches, 5, slot, true, true);
     // The handle
-    buildPatchReflect(6, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-    buildPatchReflect(7, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
+    addPatchReflect(patches, 6, slot, false, true);
+    addPatchReflect(patches, 7, slot, false, true);
     // The spout
-    buildPatchReflect(8, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-    buildPatchReflect(9, B, dB, v, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-
-    delete [] B;
-    delete [] dB;
+    addPatchReflect(patches, 8, slot, false, true);
+    addPatchReflect(patches, 9, slot, false, true);
 }
 
 void VBOTeapot::moveLid(int grid, float *v, mat4 lidTransform) {
 
-    int start = 3 * 12 * (grid+1) * (grid+1);
-    int end = 3 * 20 * (grid+1) * (grid+1);
+    int start = 3 * lidFirstSlot * (grid+1) * (grid+1);
+    int end = 3 * lidEndSlot * (grid+1) * (grid+1);
 
     for( int i = start; i < end; i+=3 )
     {
@@ -126,99 +243,46 @@ void VBOTeapot::moveLid(int grid, float *v, mat4 lidTransform) {
     }
 }
 
-void VBOTeapot::buildPatchReflect(int patchNum,
-                                    float *B, float *dB,
-                                    float *v, float *n,
-                                    float *tc, unsigned int *el,
-                                    int &index, int &elIndex, int &tcIndex, int grid,
-                                    bool reflectX, bool reflectY)
+void VBOTeapot::addPatchReflect(std::vector<BezierTessellator::Patch> & patches,
+                                 int patchNum, unsigned int &slot,
+                                 bool reflectX, bool reflectY)
 {
-    vec3 patch[4][4];
-    vec3 patchRevV[4][4];
-    getPatch(patchNum, patch, false);
-    getPatch(patchNum, patchRevV, true);
+    // The copies reflected in only one axis use the patch with v reversed, so
+    // that their triangles keep the same winding. Each version is evaluated once.
+    BezierTessellator::Patch patch, patchRevV;
+    getPatch(patchNum, patch.controlPoints, false);
+    getPatch(patchNum, patchRevV.controlPoints, true);
 
     // Patch without modification
-    buildPatch(patch, B, dB, v, n, tc, el,
-               index, elIndex, tcIndex, grid, mat3(1.0f), true);
+    addCopy(patch, vec3(1.0f, 1.0f, 1.0f), true, slot);
 
     // Patch reflected in x
     if( reflectX ) {
-        buildPatch(patchRevV, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(-1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, 1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), false );
+        addCopy(patchRevV, vec3(-1.0f, 1.0f, 1.0f), false, slot);
     }
 
     // Patch reflected in y
     if( reflectY ) {
-        buildPatch(patchRevV, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, -1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), false );
+        addCopy(patchRevV, vec3(1.0f, -1.0f, 1.0f), false, slot);
     }
 
     // Patch reflected in x and y
     if( reflectX && reflectY ) {
-        buildPatch(patch, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(-1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, -1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), true );
+        addCopy(patch, vec3(-1.0f, -1.0f, 1.0f), true, slot);
     }
+
+    patches.push_back(patch);
+    if( !patchRevV.copies.empty() )
+        patches.push_back(patchRevV);
 }
 
-void VBOTeapot::buildPatch(vec3 patch[][4],
-                           float *B, float *dB,
-                           float *v, float *n, float *tc,
-                           unsigned int *el,
-                           int &index, int &elIndex, int &tcIndex, int grid, mat3 reflect,
-                           bool invertNormal)
+void VBOTeapot::addCopy(BezierTessellator::Patch & patch, vec3 scale, bool invertNormal, unsigned int &slot)
 {
-    int startIndex = index / 3;
-    float tcFactor = 1.0f / grid;
-
-    for( int i = 0; i <= grid; i++ )
-    {
-        for( int j = 0 ; j <= grid; j++)
-        {
-            vec3 pt = reflect * evaluate(i,j,B,patch);
-            vec3 norm = reflect * evaluateNormal(i,j,B,dB,patch);
-            if( invertNormal )
-                norm = -norm;
-
-            v[index] = pt.x;
-            v[index+1] = pt.y;
-            v[index+2] = pt.z;
-
-            n[index] = norm.x;
-            n[index+1] = norm.y;
-            n[index+2] = norm.z;
-
-            tc[tcIndex] = i * tcFactor;
-            tc[tcIndex+1] = j * tcFactor;
-
-            index += 3;
-            tcIndex += 2;
-        }
-    }
-
-    for( int i = 0; i < grid; i++ )
-    {
-        int iStart = i * (grid+1) + startIndex;
-        int nextiStart = (i+1) * (grid+1) + startIndex;
-        for( int j = 0; j < grid; j++)
-        {
-            el[elIndex] = iStart + j;
-            el[elIndex+1] = nextiStart + j + 1;
-            el[elIndex+2] = nextiStart + j;
-
-            el[elIndex+3] = iStart + j;
-            el[elIndex+4] = iStart + j + 1;
-            el[elIndex+5] = nextiStart + j + 1;
-
-            elIndex += 6;
-        }
-    }
+    BezierTessellator::Copy copy;
+    copy.scale = scale;
+    copy.invertNormal = invertNormal;
+    copy.slot = slot++;
+    patch.copies.push_back(copy);
 }
 
 void VBOTeapot::getPatch( int patchNum, vec3 patch[][4], bool reverseV )
@@ -242,55 +306,12 @@ void VBOTeapot::getPatch( int patchNum, vec3 patch[][4], bool reverseV )
     }
 }
 
-void VBOTeapot::computeBasisFunctions( float * B, float * dB, int grid ) {
-    float inc = 1.0f / grid;
-    for( int i = 0; i <= grid; i++ )
-    {
-        float t = i * inc;
-        float tSqr = t * t;
-        float oneMinusT = (1.0f - t);
-        float oneMinusT2 = oneMinusT * oneMinusT;
-
-        B[i*4 + 0] = oneMinusT * oneMinusT2;
-        B[i*4 + 1] = 3.0f * oneMinusT2 * t;
-        B[i*4 + 2] = 3.0f * oneMinusT * tSqr;
-        B[i*4 + 3] = t * tSqr;
-
-        dB[i*4 + 0] = -3.0f * oneMinusT2;
-        dB[i*4 + 1] = -6.0f * t * oneMinusT + 3.0f * oneMinusT2;
-        dB[i*4 + 2] = -3.0f * tSqr + 6.0f * t * oneMinusT;
-        dB[i*4 + 3] = 3.0f * tSqr;
-    }
-}
-
-
-vec3 VBOTeapot::evaluate( int gridU, int gridV, float *B, vec3 patch[][4] )
-{
-    vec3 p(0.0f,0.0f,0.0f);
-    for( int i = 0; i < 4; i++) {
-        for( int j = 0; j < 4; j++) {
-            p += patch[i][j] * B[gridU*4+i] * B[gridV*4+j];
-        }
-    }
-    return p;
+void VBOTeapot::render() const {
+	
+    drawMesh(1);
 }
 
-vec3 VBOTeapot::evaluateNormal( int gridU, int gridV, float *B, float *dB, vec3 patch[][4] )
-{
-    vec3 du(0.0f,0.0f,0.0f);
-    vec3 dv(0.0f,0.0f,0.0f);
-
-    for( int i = 0; i < 4; i++) {
-        for( int j = 0; j < 4; j++) {
-            du += patch[i][j] * dB[gridU*4+i] * B[gridV*4+j];
-            dv += patch[i][j] * B[gridU*4+i] * dB[gridV*4+j];
-        }
-    }
-    return glm::normalize( glm::cross( du, dv ) );
-}
+void VBOTeapot::renderInstanced(int instances) const {
 
-void VBOTeapot::render() const {
-	
-    gl::BindVertexArray(vaoHandle);
-    gl::DrawElements(gl::TRIANGLES, 6 * faces, gl::UNSIGNED_INT, ((GLubyte *)NULL + (0)));
+    drawMesh(instances);
 }
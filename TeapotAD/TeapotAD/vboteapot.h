@@ -2,6 +2,7 @@
 #define VBOTEAPOT_H
 
 #include "drawable.h"
+#include "beziertessellator.h"
 #include <glm.hpp>
 using glm::vec3;
 using glm::mat3;
@@ -10,30 +11,70 @@ using glm::mat4;
 class VBOTeapot : public Drawable
 {
 private:
-    unsigned int vaoHandle;
     unsigned int faces;
 
-    void generatePatches(float * v, float * n, float *tc, unsigned int* el, int grid);
-    void buildPatchReflect(int patchNum,
-                           float *B, float *dB,
-                           float *v, float *n, float *, unsigned int *el,
-                           int &index, int &elIndex, int &, int grid,
-                           bool reflectX, bool reflectY);
-    void buildPatch(vec3 patch[][4],
-                    float *B, float *dB,
-                    float *v, float *n,float *, unsigned int *el,
-                    int &index, int &elIndex, int &, int grid, mat3 reflect, bool invertNormal);
-    void getPatch( int patchNum, vec3 patch[][4], bool reverseV );
-
-    void computeBasisFunctions( float * B, float * dB, int grid );
-    vec3 evaluate( int gridU, int gridV, float *B, vec3 patch[][4] );
-    vec3 evaluateNormal( int gridU, int gridV, float *B, float *dB, vec3 patch[][4] );
-    void moveLid(int,float *,mat4);
+    // One mesh of the level of detail chain
+    struct Lod {
+        MeshRange range;
+        int grid;
+        float error;                // Furthest the mesh strays from the true surface, in object units
+        GLsizeiptr vertexBytes;
+        unsigned int transforms;    // Vertex shader invocations per draw, from the vertex cache simulation
+    };
+
+    GeometryArena * ownArena;   // Holds the levels of detail when no arena was given
+    std::vector<Lod> lods;      // Level 0 is the finest
+    int lod;                    // Level drawn by render()
+
+    static float tessellationError(int grid, const std::vector<BezierTessellator::Patch> & patches, ThreadPool * pool);
+
+    static void addPatchReflect(std::vector<BezierTessellator::Patch> & patches,
+                                int patchNum, unsigned int &slot,
+                                bool reflectX, bool reflectY);
+    static void addCopy(BezierTessellator::Patch & patch, vec3 scale, bool invertNormal, unsigned int &slot);
+    static void getPatch( int patchNum, vec3 patch[][4], bool reverseV );
+
+    static void moveLid(int,float *,mat4);
+
+    // Non-copyable, an owned arena is deleted with the teapot
+    VBOTeapot( const VBOTeapot & ) { }
+    VBOTeapot & operator=( const VBOTeapot & ) { return *this; }
 
 public:
-    VBOTeapot(int grid, mat4 lidTransform);
+    // With lodLevels > 1 the grid is halved for each further level, e.g. a
+    // grid of 64 with 6 levels gives 64, 32, 16, 8, 4 and 2.
+    VBOTeapot(int grid, mat4 lidTransform, GeometryArena * arena = NULL, VertexFormat::Format format = VertexFormat::SEPARATE, int lodLevels = 1);
+    ~VBOTeapot();
 
     void render() const;
+    void renderInstanced(int instances) const;
+
+    int getLodCount() const;
+    void selectLod(int level);          // The level render() and getMeshRange() use
+    int getSelectedLod() const;
+    const MeshRange & getLodRange(int level) const;
+    unsigned int getLodTriangles(int level) const;
+    GLsizeiptr getLodVertexBytes(int level) const;
+    unsigned int getLodTransforms(int level) const;
+    float getLodError(int level) const;     // In object space units
+
+    // The coarsest level whose error covers at most maxPixelError pixels
+    // when the teapot is distance units from the camera.
+    int chooseLod(float distance, float fieldOfView, int viewportHeight, float maxPixelError) const;
+
+    // The patches and reflected copies that make up the teapot, before the
+    // lid is moved and the teapot is stood upright.
+    static void buildPatches(std::vector<BezierTessellator::Patch> & patches);
+
+    // Tessellates the patches into an upright teapot with its lid moved, without touching GL.
+    static void buildMesh(int grid, mat4 lidTransform, const std::vector<BezierTessellator::Patch> & patches, ThreadPool * pool, MeshData & mesh);
+
+    // Copies lidFirstSlot to lidEndSlot - 1 make up the lid.
+    static const unsigned int lidFirstSlot = 12;
+    static const unsigned int lidEndSlot = 20;
+
+    // Turns the patch data the right way up, applied after the lid is moved.
+    static mat4 uprightTransform();
 };
 
 #endif // VBOTEAPOT_H
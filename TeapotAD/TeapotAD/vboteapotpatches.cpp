@@ -0,0 +1,68 @@
+#include "vboteapotpatches.h"
+#include "vboteapot.h"
+
+#include "gl_core_4_3.hpp"
+
+VBOTeapotPatches::VBOTeapotPatches(mat4 lidTransform)
+{
+    std::vector<vec3> points;
+    buildControlPoints(lidTransform, points);
+    patches = (unsigned int)(points.size() / 16);
+
+    GLuint & handle = bufferHandles[0];
+    gl::GenBuffers(1, &handle);
+
+    gl::GenVertexArrays( 1, &vaoHandle );
+    gl::BindVertexArray(vaoHandle);
+
+    gl::BindBuffer(gl::ARRAY_BUFFER, handle);
+    gl::BufferData(gl::ARRAY_BUFFER, points.size() * sizeof(vec3), &points[0], gl::STATIC_DRAW);
+    gl::VertexAttribPointer( (GLuint)0, 3, gl::FLOAT, FALSE, 0, ((GLubyte *)NULL + (0)) );
+    gl::EnableVertexAttribArray(0);  // Control point position
+
+    gl::BindVertexArray(0);
+
+    vertexBytes = points.size() * sizeof(vec3);
+
+    // The surface lies inside the convex hull of its control points, so bounds around them hold it too.
+    setBounds(&points[0].x, (unsigned int)points.size());
+}
+
+void VBOTeapotPatches::buildControlPoints(mat4 lidTransform, std::vector<vec3> & points)
+{
+    std::vector<BezierTessellator::Patch> patchList;
+    VBOTeapot::buildPatches(patchList);
+
+    unsigned int slots = 0;
+    for (size_t p = 0; p < patchList.size(); p++)
+        slots += (unsigned int)patchList[p].copies.size();
+    points.resize(16 * slots);
+
+    // A Bezier surface moves with its control points, so reflecting and transforming them
+    // transforms the surface exactly.
+    mat4 upright = VBOTeapot::uprightTransform();
+    for (size_t p = 0; p < patchList.size(); p++)
+    {
+        const BezierTessellator::Patch & patch = patchList[p];
+        for (size_t c = 0; c < patch.copies.size(); c++)
+        {
+            const BezierTessellator::Copy & copy = patch.copies[c];
+            bool lid = copy.slot >= VBOTeapot::lidFirstSlot && copy.slot < VBOTeapot::lidEndSlot;
+            mat4 transform = lid ? upright * lidTransform : upright;
+
+            for (int u = 0; u < 4; u++)
+                for (int v = 0; v < 4; v++)
+                    points[16 * copy.slot + 4 * u + v] = vec3(transform * glm::vec4(copy.scale * patch.controlPoints[u][v], 1.0f));
+        }
+    }
+}
+
+void VBOTeapotPatches::render() const {
+    renderInstanced(1);
+}
+
+void VBOTeapotPatches::renderInstanced(int instances) const {
+    gl::BindVertexArray(vaoHandle);
+    gl::PatchParameteri(gl::PATCH_VERTICES, 16);
+    gl::DrawArraysInstanced(gl::PATCHES, 0, 16 * patches, instances);
+}
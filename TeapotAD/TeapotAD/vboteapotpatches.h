@@ -0,0 +1,34 @@
+#ifndef VBOTEAPOTPATCHES_H
+#define VBOTEAPOTPATCHES_H
+
+#include "drawable.h"
+#include <glm.hpp>
+#include <vector>
+using glm::vec3;
+using glm::mat4;
+
+/**
+ The teapot as its 32 bicubic Bezier patches, drawn as GL_PATCHES for the
+ tessellation shaders to evaluate.
+
+ Only the 16 control points of each patch are uploaded (a few KB), already
+ reflected, with the lid moved and stood upright like VBOTeapot, so the
+ shaders only have to evaluate them. The control points are in the same
+ (u, v) order as VBOTeapot's, so the surface and normals match its mesh.
+ */
+class VBOTeapotPatches : public Drawable
+{
+private:
+    unsigned int patches;
+
+public:
+    VBOTeapotPatches(mat4 lidTransform);
+
+    void render() const;
+    void renderInstanced(int instances) const;
+
+    // The control points of every patch, 16 per patch in [u][v] order.
+    static void buildControlPoints(mat4 lidTransform, std::vector<vec3> & points);
+};
+
+#endif // VBOTEAPOTPATCHES_H
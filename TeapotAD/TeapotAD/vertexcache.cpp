@@ -0,0 +1,110 @@
+#include "vertexcache.h"
+
+#include <cstddef>
+
+VertexCache::Statistics VertexCache::simulate(const std::vector<unsigned int> & indices, unsigned int vertexCount, int cacheSize)
+{
+    // A vertex is in the FIFO while fewer than cacheSize misses have happened since it was added.
+    std::vector<long> added(vertexCount, -(long)cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    long misses = 0;
+    unsigned int vertices = 0;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned int v = indices[i];
+        if (misses - added[v] >= cacheSize) {
+            added[v] = misses;
+            misses++;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            vertices++;
+        }
+    }
+
+    Statistics stats;
+    stats.transforms = (unsigned int)misses;
+    stats.acmr = indices.empty() ? 0.0f : (float)misses / (indices.size() / 3);
+    stats.atvr = vertices == 0 ? 0.0f : (float)misses / vertices;
+    return stats;
+}
+
+void VertexCache::tipsify(std::vector<unsigned int> & indices, unsigned int vertexCount, int cacheSize)
+{
+    unsigned int triangles = (unsigned int)(indices.size() / 3);
+    if (triangles == 0) return;
+
+    // The triangles using each vertex, as offsets into one list.
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) live[indices[i]]++;
+
+    std::vector<unsigned int> offset(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++) offset[v + 1] = offset[v] + live[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offset.begin(), offset.end() - 1);
+    for (unsigned int t = 0; t < triangles; t++)
+        for (int c = 0; c < 3; c++)
+            adjacency[fill[indices[3 * t + c]]++] = t;
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangles, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    int time = cacheSize + 1;
+    unsigned int cursor = 0;    // Next vertex to try when the dead end stack runs out
+    int fan = (int)indices[0];  // Vertex whose triangles are emitted next
+
+    while (fan >= 0) {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex.
+        for (unsigned int a = offset[fan]; a < offset[fan + 1]; a++) {
+            unsigned int t = adjacency[a];
+            if (emitted[t]) continue;
+
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = indices[3 * t + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // Fan next around the candidate that will stay in the cache longest
+        // while its remaining triangles are emitted.
+        fan = -1;
+        int best = -1;
+        for (size_t c = 0; c < candidates.size(); c++) {
+            unsigned int v = candidates[c];
+            if (live[v] == 0) continue;
+
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * (int)live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > best) {
+                best = priority;
+                fan = (int)v;
+            }
+        }
+
+        // Dead end: go back to a recently used vertex, or else the next unfinished one.
+        while (fan < 0 && !deadEnd.empty()) {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) fan = (int)v;
+        }
+        while (fan < 0 && cursor < vertexCount) {
+            if (live[cursor] > 0) fan = (int)cursor;
+            else cursor++;
+        }
+    }
+
+    indices.swap(output);
+}
@@ -0,0 +1,32 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <vector>
+
+/**
+ Post-transform vertex cache optimisation and statistics for indexed
+ triangle lists.
+
+ The GPU keeps the outputs of recently shaded vertices and reuses them when
+ an index repeats, so the order of the triangles decides how many times
+ each vertex is shaded. The cache is modelled as a FIFO of cacheSize
+ entries.
+ */
+class VertexCache
+{
+public:
+    struct Statistics {
+        unsigned int transforms;    // Cache misses, each one a vertex shader invocation
+        float acmr;                 // Average cache miss ratio, transforms per triangle (0.5 is ideal for a grid)
+        float atvr;                 // Average transform to vertex ratio, transforms per referenced vertex (1 is ideal)
+    };
+
+    // Simulates drawing the triangles through a FIFO vertex cache.
+    static Statistics simulate(const std::vector<unsigned int> & indices, unsigned int vertexCount, int cacheSize = 16);
+
+    // Reorders the triangles for the cache with the Tipsify algorithm
+    // (Sander, Nehab and Barczak, 2007). The vertices are not moved.
+    static void tipsify(std::vector<unsigned int> & indices, unsigned int vertexCount, int cacheSize = 16);
+};
+
+#endif // VERTEXCACHE_H